@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bus/frame_decoder.h"
+#include "bus/seqlock.h"
+
+/**
+ * @brief Throughput of the RX path of the panel on the host
+ *
+ * Usage: frame_decoder_bench [SECONDS]
+ *
+ * Builds the bytes a load sends on a busy link: full telemetry batches back to back, a measurement every
+ * BENCH_MEASUREMENT_EVERY frames, whole or delta, an acknowledgement now and then. The stream is decoded over and over
+ * in reads of the sizes the driver hands over, by the frame decoder and by the byte at a time parser it replaced,
+ * measurements being published through the seqlock as the RX task does. The cost is given per byte and as the share
+ * of a core the decoding takes at 1 Mbaud, 100000 bytes per second.
+ */
+
+/** Default run time of each variant */
+#define BENCH_SECONDS 1.0
+
+/** Bytes of the stream, about a second at 1 Mbaud */
+#define BENCH_STREAM_SIZE 100000U
+
+/** Frames between two measurements, every BENCH_KEYFRAME_INTERVAL-th one is whole */
+#define BENCH_MEASUREMENT_EVERY 8U
+#define BENCH_KEYFRAME_INTERVAL 10U
+
+/** Frames between two acknowledgements */
+#define BENCH_ACK_EVERY 25U
+
+/** Bytes per second at 1 Mbaud, 10 bits per byte */
+#define BENCH_LINK_BYTES_PER_S 100000.0
+
+/** Chunk of the byte at a time parser, as the RX task read them */
+#define BENCH_LEGACY_CHUNK 64U
+
+/** Reads of the frame decoder: a short burst, and the whole driver ring, UART_RX_DRIVER_SIZE */
+#define BENCH_BURST_CHUNK 120U
+#define BENCH_BULK_CHUNK 2048U
+
+typedef struct bench_counters
+{
+  uint32_t measurements;
+  uint32_t telemetry;
+  uint32_t acks;
+  uint32_t text;
+} bench_counters_t;
+
+static uint8_t bench_stream[BENCH_STREAM_SIZE];
+static uint32_t bench_stream_size = 0U;
+static bench_counters_t bench_expected;
+static bench_counters_t bench_counted;
+
+static seqlock_t bench_measurement_lock;
+static load_measurement_t bench_measurement;
+static load_measurement_t bench_rx_measurement;
+
+/**
+ * @brief CRC-16/CCITT-FALSE, a bit at a time, independent from the one of server.c
+ *
+ * @param data Bytes
+ * @param size Number of bytes
+ * @return uint16_t CRC
+ */
+static uint16_t bench_crc16(const uint8_t *data, uint32_t size)
+{
+  uint16_t crc = 0xFFFFU;
+
+  for (uint32_t i = 0U; i < size; i++) {
+    crc ^= (uint16_t)(data[i] << 8U);
+    for (uint32_t bit = 0U; bit < 8U; bit++) {
+      crc = (crc & 0x8000U) ? (uint16_t)((crc << 1U) ^ 0x1021U) : (uint16_t)(crc << 1U);
+    }
+  }
+
+  return crc;
+}
+
+/**
+ * @brief Appends a frame to the stream
+ *
+ * @param type Frame type
+ * @param payload Payload
+ * @param length Payload length
+ * @return int 0 on success, -1 once the stream is full
+ */
+static int bench_append(server_msg_type_t type, const void *payload, uint32_t length)
+{
+  static uint8_t seq = 0U;
+  uint8_t *frame = &bench_stream[bench_stream_size];
+
+  if (bench_stream_size + SERVER_HEADER_SIZE + length + SERVER_CRC_SIZE > BENCH_STREAM_SIZE) {
+    return -1;
+  }
+
+  frame[0] = SERVER_SYNC_BYTE;
+  frame[1] = (uint8_t)length;
+  frame[2] = (uint8_t)type;
+  frame[3] = seq++;
+  memcpy(&frame[SERVER_HEADER_SIZE], payload, length);
+
+  const uint16_t crc = bench_crc16(&frame[1], SERVER_HEADER_SIZE - 1U + length);
+  frame[SERVER_HEADER_SIZE + length] = (uint8_t)crc;
+  frame[SERVER_HEADER_SIZE + length + 1U] = (uint8_t)(crc >> 8U);
+
+  bench_stream_size += SERVER_HEADER_SIZE + length + SERVER_CRC_SIZE;
+  return 0;
+}
+
+/**
+ * @brief Builds the stream, the current and the voltage change on every measurement
+ *
+ * @return void
+ */
+static void bench_build(void)
+{
+  load_measurement_t measurement = { 1500U, 12000U, 8000U, 18000U, 2500U };
+  load_telemetry_t telemetry = { .mode = TELEMETRY_RAW, .count = TELEMETRY_BATCH_MAX, .decimation = 1U };
+  load_ack_t ack = { .key = COMMAND_CC, .status = ACK_APPLIED, .value = 1500U };
+  int full = 0;
+
+  for (uint32_t frame = 0U; !full; frame++) {
+    if (frame % BENCH_MEASUREMENT_EVERY == 0U) {
+      measurement.cc_milli += 1U;
+      measurement.cv_milli -= 1U;
+
+      if ((frame / BENCH_MEASUREMENT_EVERY) % BENCH_KEYFRAME_INTERVAL == 0U) {
+        full = bench_append(SERVER_MSG_MEASUREMENT, &measurement, sizeof(measurement)) != 0;
+      } else {
+        /** Mask of the two words that changed, then the words */
+        uint8_t delta[sizeof(uint16_t) + 2U * sizeof(uint32_t)] = { 0x03U, 0x00U };
+        memcpy(&delta[2], &measurement.cc_milli, sizeof(uint32_t));
+        memcpy(&delta[6], &measurement.cv_milli, sizeof(uint32_t));
+        full = bench_append(SERVER_MSG_MEASUREMENT_DELTA, delta, sizeof(delta)) != 0;
+      }
+      bench_expected.measurements += full ? 0U : 1U;
+    } else if (frame % BENCH_ACK_EVERY == 0U) {
+      ack.id++;
+      full = bench_append(SERVER_MSG_ACK, &ack, sizeof(ack)) != 0;
+      bench_expected.acks += full ? 0U : 1U;
+    } else {
+      for (uint32_t i = 0U; i < TELEMETRY_BATCH_MAX; i++) {
+        telemetry.samples[i].timestamp_us = frame * 1000U + i * 5000U;
+        telemetry.samples[i].voltage_milli = 12000U + i;
+        telemetry.samples[i].current_milli = 1500U + i;
+      }
+      full = bench_append(SERVER_MSG_TELEMETRY, &telemetry, sizeof(telemetry)) != 0;
+      bench_expected.telemetry += full ? 0U : 1U;
+    }
+  }
+}
+
+/**
+ * @brief Handles a frame as the RX task does, measurements are published
+ *
+ * @param frame Frame
+ * @param context Unused
+ * @return void
+ */
+static void bench_on_frame(const server_frame_t *frame, void *context)
+{
+  switch (server_frame_type(frame)) {
+    case SERVER_MSG_MEASUREMENT:
+    case SERVER_MSG_MEASUREMENT_DELTA:
+      if (rx_data(frame, &bench_rx_measurement) == 0) {
+        seqlock_write(&bench_measurement_lock, &bench_measurement, &bench_rx_measurement, sizeof(load_measurement_t));
+        bench_counted.measurements++;
+      }
+      break;
+    case SERVER_MSG_TELEMETRY:
+      bench_counted.telemetry++;
+      break;
+    case SERVER_MSG_ACK:
+      bench_counted.acks++;
+      break;
+    default:
+      break;
+  }
+}
+
+static void bench_on_text(const uint8_t *data, uint32_t length, void *context)
+{
+  bench_counted.text += length;
+}
+
+/**
+ * @brief Decodes the stream once with the frame decoder
+ *
+ * @param decoder Decoder
+ * @param chunk Bytes per driver read, 0 for all that fits the ring
+ * @return void
+ */
+static void bench_decode(frame_decoder_t *decoder, uint32_t chunk)
+{
+  uint32_t offset = 0U;
+
+  while (offset < bench_stream_size) {
+    uint32_t room;
+    uint8_t *space = frame_decoder_space(decoder, &room);
+    uint32_t size = bench_stream_size - offset;
+    size = (chunk != 0U && size > chunk) ? chunk : size;
+    size = (size > room) ? room : size;
+
+    memcpy(space, &bench_stream[offset], size);
+    frame_decoder_commit(decoder, size);
+    offset += size;
+  }
+}
+
+/**
+ * @brief Decodes the stream once a byte at a time, as the RX task did before the frame decoder
+ *
+ * @param decoder Unused
+ * @param chunk Bytes per driver read
+ * @return void
+ */
+static void bench_decode_legacy(frame_decoder_t *decoder, uint32_t chunk)
+{
+  uint8_t buffer[BENCH_LEGACY_CHUNK];
+
+  for (uint32_t offset = 0U; offset < bench_stream_size; offset += chunk) {
+    const uint32_t size = (bench_stream_size - offset < chunk) ? bench_stream_size - offset : chunk;
+    memcpy(buffer, &bench_stream[offset], size);
+
+    int text = -1;
+    for (uint32_t i = 0U; i < size; i++) {
+      if (parse_idle() && buffer[i] != SERVER_SYNC_BYTE) {
+        text = (text < 0) ? (int)i : text;
+        continue;
+      }
+
+      if (text >= 0) {
+        bench_on_text(&buffer[text], i - (uint32_t)text, NULL);
+        text = -1;
+      }
+
+      const server_frame_t *frame = parse_byte(buffer[i]);
+      if (frame != NULL) {
+        bench_on_frame(frame, NULL);
+      }
+    }
+
+    if (text >= 0) {
+      bench_on_text(&buffer[text], size - (uint32_t)text, NULL);
+    }
+  }
+}
+
+static double bench_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Runs a variant for the given time and checks every frame came out of it
+ *
+ * @param name Variant
+ * @param decode Decoding of the whole stream
+ * @param chunk Bytes per driver read
+ * @param seconds Run time
+ * @return int 0 if every frame was decoded, -1 otherwise
+ */
+static int bench_run(const char *name, void (*decode)(frame_decoder_t *, uint32_t), uint32_t chunk, double seconds)
+{
+  static frame_decoder_t decoder;
+  uint64_t passes = 0U;
+  int result = 0;
+
+  frame_decoder_init(&decoder, bench_on_frame, bench_on_text, NULL);
+
+  const double start = bench_now();
+  double elapsed = 0.0;
+  while (elapsed < seconds) {
+    memset(&bench_counted, 0, sizeof(bench_counted));
+    decode(&decoder, chunk);
+    passes++;
+    elapsed = bench_now() - start;
+
+    if (memcmp(&bench_counted, &bench_expected, sizeof(bench_counted)) != 0) {
+      result = -1;
+    }
+  }
+
+  load_measurement_t measurement;
+  seqlock_read(&bench_measurement_lock, &bench_measurement, &measurement, sizeof(measurement));
+
+  const double bytes = (double)passes * (double)bench_stream_size;
+  const double ns_per_byte = elapsed * 1e9 / bytes;
+  printf("%-24s %5u B reads: %7.1f MB/s, %6.2f ns/byte, %6.3f%% of a core at 1 Mbaud, last cc %u mA%s\n", name, chunk,
+         bytes / elapsed / 1e6, ns_per_byte, ns_per_byte * BENCH_LINK_BYTES_PER_S / 1e7, measurement.cc_milli,
+         result == 0 ? "" : ", FRAMES LOST");
+
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  const double seconds = (argc > 1) ? strtod(argv[1], NULL) : BENCH_SECONDS;
+  int failures = 0;
+
+  bench_build();
+  printf("stream: %u bytes, %u telemetry batches, %u measurements, %u acknowledgements\n", bench_stream_size,
+         bench_expected.telemetry, bench_expected.measurements, bench_expected.acks);
+
+  failures += bench_run("byte at a time parser", bench_decode_legacy, BENCH_LEGACY_CHUNK, seconds) != 0;
+  failures += bench_run("frame decoder", bench_decode, BENCH_BURST_CHUNK, seconds) != 0;
+  failures += bench_run("frame decoder", bench_decode, BENCH_BULK_CHUNK, seconds) != 0;
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
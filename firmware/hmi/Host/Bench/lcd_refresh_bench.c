@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lvgl.h"
+#include "demos/benchmark/lv_demo_benchmark.h"
+
+#include "peripherals/lcd_bands.h"
+#include "server/server.h"
+#include "ui/index.h"
+#include "ui/stream.h"
+
+/**
+ * @brief Frame rate and flushed bytes of the display settings, LVGL on the host
+ *
+ * Usage: lcd_refresh_bench [SECONDS]
+ *
+ * The LVGL task is simulated a millisecond at a time: the tick timer adds its period to the LVGL tick, the task runs
+ * lv_timer_handler() and sleeps for the delay it returns, clamped and rounded down to a FreeRTOS tick. The settings
+ * run before and after the change: the 100 ms tick with 20 line draw buffers, the 1 ms tick with the LVGL task woken
+ * up by the updates, then the bands of lcd_bands.c, with 20 line and whole frame buffers.
+ *
+ * Three screens are refreshed with each: the index and stream windows of the panel, updated every BENCH_PERIOD_MS as
+ * the control tasks do, and the scenes of lv_demo_benchmark, animated objects all over the screen. The flush callback
+ * counts the transfers and bytes that would go over SPI to the ST7735, the bus time adding LCD_BANDS_FLUSH_COST_BYTES
+ * per transfer to the bytes at 40 MHz. On the windows, the time from an update to its first flush is the delay the
+ * settings add before a new value shows.
+ */
+
+/** Simulated time of the panel windows, the demo runs to its end */
+#define BENCH_SECONDS 30U
+#define BENCH_DEMO_SECONDS_MAX 200U
+
+/** Period of the control tasks */
+#define BENCH_PERIOD_MS 100U
+
+/** Offset of the control task periods from the tick timer, the two aren't in phase */
+#define BENCH_PERIOD_PHASE_MS 37U
+
+/** Points of the stream */
+#define BENCH_POINT_MS 500U
+
+/** Display of the panel */
+#define BENCH_H_RES 160
+#define BENCH_V_RES 128
+
+/** Bytes per flush besides the pixels, as LCD_FLUSH_OVERHEAD_BYTES */
+#define BENCH_FLUSH_OVERHEAD_BYTES 11U
+
+/** SPI clock of the LCD, LCD_PIXEL_CLOCK_HZ, in bytes per microsecond */
+#define BENCH_SPI_BYTES_PER_US 5U
+
+/** LVGL task: longest sleep, and a FreeRTOS tick at CONFIG_FREERTOS_HZ 100 */
+#define BENCH_TASK_MAX_DELAY_MS 300U
+#define BENCH_FREERTOS_TICK_MS 10U
+
+typedef enum bench_screen
+{
+  BENCH_INDEX = 0,
+  BENCH_STREAM,
+  BENCH_DEMO,
+  BENCH_SCREENS
+} bench_screen_t;
+
+static const char *const bench_screen_names[BENCH_SCREENS] = {
+  [BENCH_INDEX] = "index window",
+  [BENCH_STREAM] = "stream window",
+  [BENCH_DEMO] = "lv_demo_benchmark",
+};
+
+/**
+ * @brief Display settings: LVGL_TICK_PERIOD_MS, LVGL_TASK_MIN_DELAY_MS, the LVGL task woken up by the updates, draw
+ *        buffers and coalescing
+ */
+typedef struct bench_config
+{
+  const char *name;
+  uint32_t tick_ms;
+  uint32_t min_delay_ms;
+  bool wake;
+  uint32_t buffer_lines;
+  bool bands;
+} bench_config_t;
+
+static const bench_config_t bench_configs[] = {
+  { "100 ms tick, 20 lines", 100U, 50U, false, 20U, false },
+  { "1 ms tick, woken up", 1U, 10U, true, 20U, false },
+  { "+ bands", 1U, 10U, true, 20U, true },
+  { "+ full frame buffers", 1U, 10U, true, BENCH_V_RES, true },
+};
+
+#define BENCH_CONFIGS (sizeof(bench_configs) / sizeof(bench_configs[0]))
+
+typedef struct bench_result
+{
+  uint32_t seconds;
+  double render_s;
+  uint64_t refreshes;
+  uint64_t joined;
+  uint64_t flushes;
+  uint64_t flushed_px;
+  uint64_t spi_bytes;
+  uint64_t bus_us;
+  uint64_t updates;       /**< Control task periods that changed the screen */
+  uint64_t latency_ms;    /**< Sum of the times from an update to its first flush */
+  uint32_t latency_max_ms;
+} bench_result_t;
+
+static bench_result_t bench_result;
+static const bench_config_t *bench_config;
+static uint32_t bench_noise = 12345U;
+static bool bench_demo_done;
+
+/** Simulated time, and the time of the update waiting for its flush, UINT32_MAX if none */
+static uint32_t bench_now_ms;
+static uint32_t bench_update_ms = UINT32_MAX;
+
+static void bench_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+  const uint32_t pixels = (uint32_t)lv_area_get_size(area);
+  const uint32_t bytes = pixels * sizeof(lv_color_t) + BENCH_FLUSH_OVERHEAD_BYTES;
+
+  bench_result.flushes++;
+  bench_result.flushed_px += pixels;
+  bench_result.spi_bytes += bytes;
+  bench_result.bus_us += (bytes + LCD_BANDS_FLUSH_COST_BYTES) / BENCH_SPI_BYTES_PER_US;
+
+  if (bench_update_ms != UINT32_MAX) {
+    const uint32_t latency_ms = bench_now_ms - bench_update_ms;
+    bench_result.updates++;
+    bench_result.latency_ms += latency_ms;
+    if (latency_ms > bench_result.latency_max_ms) {
+      bench_result.latency_max_ms = latency_ms;
+    }
+    bench_update_ms = UINT32_MAX;
+  }
+
+  lv_disp_flush_ready(drv);
+}
+
+static void bench_render_start(lv_disp_drv_t *drv)
+{
+  bench_result.refreshes++;
+  if (bench_config->bands) {
+    bench_result.joined += lcd_bands_coalesce(_lv_refr_get_disp_refreshing());
+  }
+}
+
+static void bench_demo_finished(void)
+{
+  bench_demo_done = true;
+}
+
+/**
+ * @brief Noise of a measurement, uniform
+ *
+ * @param amplitude Largest deviation, in milli-units
+ * @return int32_t Deviation
+ */
+static int32_t bench_jitter(int32_t amplitude)
+{
+  bench_noise = bench_noise * 1664525U + 1013904223U;
+  return (int32_t)((bench_noise >> 8U) % (uint32_t)(2 * amplitude + 1)) - amplitude;
+}
+
+/**
+ * @brief A measurement at a steady set point, 1.5 A from a 12 V source, with the noise of the ADC, a few LSB
+ *
+ * @param measurement Output measurement
+ * @return void
+ */
+static void bench_measure(load_measurement_t *measurement)
+{
+  measurement->cc_milli = (uint32_t)(1523 + bench_jitter(6));
+  measurement->cv_milli = (uint32_t)(12030 + bench_jitter(10));
+  measurement->cr_milli = measurement->cv_milli * 1000U / measurement->cc_milli;
+  measurement->cp_milli = measurement->cv_milli * measurement->cc_milli / 1000U;
+}
+
+/**
+ * @brief One period of the index window, as the load task applies it
+ *
+ * @param period Period number
+ * @return void
+ */
+static void bench_index(uint32_t period)
+{
+  static const char *const modes[] = { "CC", "CV", "CR", "CP" };
+  load_measurement_t measurement;
+
+  bench_measure(&measurement);
+
+  const ui_index_view_t view = {
+    .current = (int32_t)(measurement.cc_milli / 100U),
+    .voltage = (int32_t)(measurement.cv_milli / 100U),
+    .resistance = (int32_t)(measurement.cr_milli / 100U),
+    .power = (int32_t)(measurement.cp_milli / 100U),
+    .mode = modes[(period * BENCH_PERIOD_MS / 20000U) % 4U],
+  };
+  ui_index_view_apply(&view);
+}
+
+/**
+ * @brief One period of the stream window: a current step every point, the enable toggled every 4 points, a chart point
+ *        every second
+ *
+ * @param period Period number
+ * @return void
+ */
+static void bench_stream(uint32_t period)
+{
+  static ui_stream_view_t view = { 0 };
+  load_measurement_t measurement;
+  const uint32_t time_ms = period * BENCH_PERIOD_MS;
+  const uint32_t point = time_ms / BENCH_POINT_MS;
+
+  bench_measure(&measurement);
+
+  if ((time_ms % BENCH_POINT_MS) == 0U) {
+    view.mode = "CC";
+    view.desired = (int32_t)((1000U + (point % 4U) * 500U) / 100U);
+    view.enable = (point / 4U) % 2U == 0U;
+  }
+
+  view.measured = (int32_t)(measurement.cc_milli / 100U);
+  ui_stream_view_apply(&view);
+
+  if (time_ms % 1000U == 0U) {
+    add_chart_point(measurement.cc_milli, measurement.cv_milli);
+  }
+}
+
+static double bench_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Runs the LVGL task, the tick timer and the control task a millisecond at a time
+ *
+ * @param screen Screen
+ * @param seconds Simulated time, the longest for the demo
+ * @return uint32_t Simulated time, in seconds
+ */
+static uint32_t bench_simulate(bench_screen_t screen, uint32_t seconds)
+{
+  uint32_t task_wake_ms = 0U;
+  uint32_t now_ms;
+
+  for (now_ms = 0U; now_ms < seconds * 1000U && !bench_demo_done; now_ms++) {
+    bench_now_ms = now_ms;
+    if (now_ms > 0U && now_ms % bench_config->tick_ms == 0U) {
+      lv_tick_inc(bench_config->tick_ms);
+    }
+
+    if (screen != BENCH_DEMO && now_ms % BENCH_PERIOD_MS == BENCH_PERIOD_PHASE_MS) {
+      const uint32_t period = now_ms / BENCH_PERIOD_MS;
+      if (screen == BENCH_INDEX) {
+        bench_index(period);
+      } else {
+        bench_stream(period);
+      }
+
+      /** Updates that change nothing are never flushed, the next one that does is timed from its own period */
+      bench_update_ms = now_ms;
+
+      /** The control task unlocks the LVGL mutex */
+      if (bench_config->wake) {
+        task_wake_ms = now_ms;
+      }
+    }
+
+    if (now_ms >= task_wake_ms) {
+      const double start = bench_now();
+      uint32_t delay_ms = lv_timer_handler();
+      bench_result.render_s += bench_now() - start;
+
+      if (delay_ms > BENCH_TASK_MAX_DELAY_MS) {
+        delay_ms = BENCH_TASK_MAX_DELAY_MS;
+      } else if (delay_ms < bench_config->min_delay_ms) {
+        delay_ms = bench_config->min_delay_ms;
+      }
+      task_wake_ms = now_ms + delay_ms / BENCH_FREERTOS_TICK_MS * BENCH_FREERTOS_TICK_MS;
+    }
+  }
+
+  return (now_ms + 999U) / 1000U;
+}
+
+/**
+ * @brief Runs a screen with a configuration in a process of its own, LVGL starts from scratch
+ *
+ * @param screen Screen
+ * @param config Display settings
+ * @param seconds Simulated time of the panel windows
+ * @param result Output counters
+ * @return int 0 on success, -1 if the run failed
+ */
+static int bench_run(bench_screen_t screen, const bench_config_t *config, uint32_t seconds, bench_result_t *result)
+{
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) {
+    return -1;
+  }
+
+  const pid_t child = fork();
+  if (child < 0) {
+    return -1;
+  }
+
+  if (child == 0) {
+    static lv_color_t buffers[2][BENCH_H_RES * BENCH_V_RES];
+    static lv_disp_draw_buf_t draw_buffer;
+    static lv_disp_drv_t driver;
+
+    bench_config = config;
+    lv_init();
+    lv_disp_draw_buf_init(&draw_buffer, buffers[0], buffers[1], BENCH_H_RES * config->buffer_lines);
+    lv_disp_drv_init(&driver);
+    driver.hor_res = BENCH_H_RES;
+    driver.ver_res = BENCH_V_RES;
+    driver.flush_cb = bench_flush;
+    driver.render_start_cb = bench_render_start;
+    driver.draw_buf = &draw_buffer;
+    lv_disp_drv_register(&driver);
+
+    if (screen == BENCH_DEMO) {
+      lv_demo_benchmark_set_finished_cb(bench_demo_finished);
+      lv_demo_benchmark();
+      seconds = BENCH_DEMO_SECONDS_MAX;
+    } else {
+      ui_index_window();
+      ui_stream_window();
+      lv_disp_load_scr(screen == BENCH_INDEX ? h_scr_ui_index : h_scr_ui_stream);
+
+      /** The first refresh draws the whole window, the same for every configuration */
+      lv_refr_now(NULL);
+    }
+    memset(&bench_result, 0, sizeof(bench_result));
+    bench_update_ms = UINT32_MAX;
+
+    bench_result.seconds = bench_simulate(screen, seconds);
+
+    const ssize_t written = write(pipe_fds[1], &bench_result, sizeof(bench_result));
+    _exit(written == (ssize_t)sizeof(bench_result) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  close(pipe_fds[1]);
+  const ssize_t got = read(pipe_fds[0], result, sizeof(*result));
+  close(pipe_fds[0]);
+
+  int status = 0;
+  waitpid(child, &status, 0);
+  return (got == (ssize_t)sizeof(*result) && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+static void bench_print(const char *name, const bench_result_t *result)
+{
+  const double seconds = (double)result->seconds;
+
+  printf("  %-30s %5.1f FPS, %6.1f flushes/s, %8.0f B/s flushed, %5.1f%% of the bus, %5.1f joined/s, "
+         "%5.2f ms render/s",
+         name, (double)result->refreshes / seconds, (double)result->flushes / seconds,
+         (double)result->spi_bytes / seconds, (double)result->bus_us / seconds / 1e4,
+         (double)result->joined / seconds, result->render_s * 1e3 / seconds);
+
+  if (result->updates > 0U) {
+    printf(", update to flush %4.1f ms mean, %3u ms max", (double)result->latency_ms / (double)result->updates,
+           result->latency_max_ms);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  const uint32_t seconds = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : BENCH_SECONDS;
+  int failures = 0;
+
+  printf("%dx%d display, windows for %u s at a %u ms task period, the demo to its end\n", BENCH_H_RES, BENCH_V_RES,
+         seconds, BENCH_PERIOD_MS);
+  for (uint32_t screen = 0U; screen < BENCH_SCREENS; screen++) {
+    printf("%s:\n", bench_screen_names[screen]);
+
+    for (uint32_t config = 0U; config < BENCH_CONFIGS; config++) {
+      bench_result_t result;
+
+      if (bench_run((bench_screen_t)screen, &bench_configs[config], seconds, &result) != 0) {
+        fprintf(stderr, "%s, %s: run failed\n", bench_screen_names[screen], bench_configs[config].name);
+        failures++;
+        continue;
+      }
+
+      bench_print(bench_configs[config].name, &result);
+    }
+  }
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
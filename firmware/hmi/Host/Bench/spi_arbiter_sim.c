@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "bus/spi_arbiter.h"
+
+/**
+ * @brief Waits for the SPI bus of the LCD and the SD card, in simulated time
+ *
+ * Usage: spi_arbiter_sim [SECONDS]
+ *
+ * The jobs go through the arbiter of the panel, only the time is simulated: a job holds the bus for the time its
+ * transfer takes at the clock of its device, meanwhile LVGL renders and the stream task parses. LVGL redraws the
+ * whole screen every refresh period in bands of its draw buffer, rendering a band while the previous one is flushed.
+ * The stream task reads the stream file over and over.
+ *
+ * Three scenarios are run:
+ * - mutex: the file read and parsed in a single job, the bus held throughout as the SPI mutex did;
+ * - arbiter: the file read in chunks of SIM_SD_CHUNK_SIZE, one job each, parsed off the bus;
+ * - flood: the same with LVGL flushing back to back, the SD card must still get the bus.
+ *
+ * The waits for the bus, from queued to started, are given per device as histograms, with the frame and file load
+ * times.
+ */
+
+/** Default simulated time of each scenario */
+#define SIM_SECONDS 10.0
+
+/** LVGL: refresh period, draw buffer of 20 lines of 160 pixels rendered in about a millisecond */
+#define SIM_REFRESH_PERIOD_US 30000
+#define SIM_BAND_LINES 20U
+#define SIM_BANDS ((128U + SIM_BAND_LINES - 1U) / SIM_BAND_LINES)
+#define SIM_RENDER_US 1000
+
+/** Flush of a band at 40 MHz, 16 bits per pixel, and its commands */
+#define SIM_FLUSH_US ((int64_t)(160U * SIM_BAND_LINES * 2U + 11U) * 8 / 40)
+
+/** SD card at 20 MHz, each read costs its commands and the FAT lookups on top of the data */
+#define SIM_SD_CHUNK_SIZE 2048U
+#define SIM_SD_FILE_SIZE (64U * 1024U)
+#define SIM_SD_CHUNKS (SIM_SD_FILE_SIZE / SIM_SD_CHUNK_SIZE)
+#define SIM_SD_READ_OVERHEAD_US 400
+#define SIM_SD_READ_US ((int64_t)SIM_SD_CHUNK_SIZE * 8 / 20 + SIM_SD_READ_OVERHEAD_US)
+
+/** Parsing of a chunk by the stream task, and the wait before the file is read again */
+#define SIM_PARSE_US 300
+#define SIM_SD_IDLE_US 50000
+
+/** Rows of the histograms, latency buckets of server_latency_t */
+#define SIM_ROW_WIDTH 12
+
+typedef enum sim_scenario
+{
+  SIM_MUTEX = 0,
+  SIM_ARBITER,
+  SIM_FLOOD,
+  SIM_SCENARIOS
+} sim_scenario_t;
+
+static const char *const sim_scenario_names[SIM_SCENARIOS] = {
+  [SIM_MUTEX] = "mutex: whole file in one job",
+  [SIM_ARBITER] = "arbiter: file in chunks",
+  [SIM_FLOOD] = "arbiter: file in chunks, LCD flushing back to back",
+};
+
+/** Something due at a time, off the bus */
+typedef struct sim_event
+{
+  int64_t at_us;     /**< INT64_MAX when nothing is due */
+  void (*fire)(void);
+} sim_event_t;
+
+typedef struct sim_stats
+{
+  uint32_t count;
+  int64_t sum_us;
+  int64_t max_us;
+} sim_stats_t;
+
+static sim_scenario_t sim_scenario;
+static spi_arbiter_t sim_arbiter;
+static int64_t sim_now_us;
+
+/** Job on the bus, done at sim_bus_free_us */
+static int64_t sim_bus_free_us;
+static void (*sim_bus_done)(void);
+
+/** LVGL */
+static sim_event_t sim_lcd_event;
+static int64_t sim_frame_started_us;
+static uint32_t sim_bands_rendered;
+static uint32_t sim_bands_flushed;
+static bool sim_band_ready;          /**< A band rendered waits for the previous flush */
+static bool sim_flushing;
+static sim_stats_t sim_frames;
+
+/** Stream task */
+static sim_event_t sim_sd_event;
+static int64_t sim_load_started_us;
+static uint32_t sim_chunks_read;
+static sim_stats_t sim_loads;
+
+static void sim_stats_record(sim_stats_t *stats, int64_t us)
+{
+  stats->count++;
+  stats->sum_us += us;
+  if (us > stats->max_us) {
+    stats->max_us = us;
+  }
+}
+
+static void sim_set_time(int64_t now_us)
+{
+  sim_now_us = now_us;
+  host_timer_set(now_us);
+}
+
+static void sim_schedule(sim_event_t *event, int64_t at_us, void (*fire)(void))
+{
+  event->at_us = at_us;
+  event->fire = fire;
+}
+
+/**
+ * @brief Holds the bus, the job is done once the time reaches the end of its transfer
+ *
+ * @param duration_us Transfer
+ * @param done Called when done
+ */
+static void sim_bus_hold(int64_t duration_us, void (*done)(void))
+{
+  sim_bus_free_us = sim_now_us + duration_us;
+  sim_bus_done = done;
+}
+
+static void sim_submit(spi_client_t client, spi_job_fn_t run)
+{
+  if (spi_arbiter_submit(&sim_arbiter, client, run, NULL) != 0) {
+    fprintf(stderr, "queue of client %d full\n", (int)client);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/** LVGL */
+
+static void sim_lcd_rendered(void);
+static void sim_lcd_flush_done(void);
+
+static int64_t sim_render_us(void)
+{
+  return (sim_scenario == SIM_FLOOD) ? 0 : SIM_RENDER_US;
+}
+
+static void sim_lcd_flush_job(void *arg)
+{
+  sim_bus_hold(SIM_FLUSH_US, sim_lcd_flush_done);
+}
+
+static void sim_lcd_render(void)
+{
+  if (sim_bands_rendered < SIM_BANDS) {
+    sim_schedule(&sim_lcd_event, sim_now_us + sim_render_us(), sim_lcd_rendered);
+  }
+}
+
+/**
+ * @brief Hands the rendered band over to the flush once the previous one is done, then renders the next
+ */
+static void sim_lcd_try_flush(void)
+{
+  if (!sim_band_ready || sim_flushing) {
+    return;
+  }
+
+  sim_band_ready = false;
+  sim_flushing = true;
+  sim_submit(SPI_CLIENT_LCD, sim_lcd_flush_job);
+  sim_lcd_render();
+}
+
+static void sim_lcd_frame(void)
+{
+  sim_frame_started_us = sim_now_us;
+  sim_bands_rendered = 0U;
+  sim_bands_flushed = 0U;
+  sim_lcd_render();
+}
+
+static void sim_lcd_rendered(void)
+{
+  sim_bands_rendered++;
+  sim_band_ready = true;
+  sim_lcd_try_flush();
+}
+
+static void sim_lcd_flush_done(void)
+{
+  sim_flushing = false;
+  sim_bands_flushed++;
+
+  if (sim_bands_flushed < SIM_BANDS) {
+    sim_lcd_try_flush();
+    return;
+  }
+
+  sim_stats_record(&sim_frames, sim_now_us - sim_frame_started_us);
+
+  /** The next refresh starts on the period, or at once when this one overran it */
+  int64_t next_us = sim_frame_started_us + ((sim_scenario == SIM_FLOOD) ? 0 : SIM_REFRESH_PERIOD_US);
+  if (next_us < sim_now_us) {
+    next_us = sim_now_us;
+  }
+  sim_schedule(&sim_lcd_event, next_us, sim_lcd_frame);
+}
+
+/** Stream task */
+
+static void sim_sd_read_done(void);
+
+static void sim_sd_read_job(void *arg)
+{
+  /** The mutex held the bus for the whole file, parsing included */
+  const int64_t duration_us = (sim_scenario == SIM_MUTEX)
+                                ? SIM_SD_CHUNKS * (SIM_SD_READ_US + SIM_PARSE_US)
+                                : SIM_SD_READ_US;
+  sim_bus_hold(duration_us, sim_sd_read_done);
+}
+
+static void sim_sd_read(void)
+{
+  sim_submit(SPI_CLIENT_SD, sim_sd_read_job);
+}
+
+static void sim_sd_load(void)
+{
+  sim_load_started_us = sim_now_us;
+  sim_chunks_read = 0U;
+  sim_sd_read();
+}
+
+static void sim_sd_read_done(void)
+{
+  sim_chunks_read += (sim_scenario == SIM_MUTEX) ? SIM_SD_CHUNKS : 1U;
+
+  if (sim_chunks_read == SIM_SD_CHUNKS) {
+    const int64_t parse_us = (sim_scenario == SIM_MUTEX) ? 0 : SIM_PARSE_US;
+    sim_stats_record(&sim_loads, sim_now_us + parse_us - sim_load_started_us);
+    sim_schedule(&sim_sd_event, sim_now_us + parse_us + SIM_SD_IDLE_US, sim_sd_load);
+    return;
+  }
+
+  /** The chunk is parsed off the bus before the next one is read */
+  sim_schedule(&sim_sd_event, sim_now_us + SIM_PARSE_US, sim_sd_read);
+}
+
+/** Simulation */
+
+/**
+ * @brief Fires the events due before a time, in order
+ *
+ * @param until_us Time, excluded
+ * @return true An event was fired
+ */
+static bool sim_fire_before(int64_t until_us)
+{
+  sim_event_t *event = (sim_lcd_event.at_us <= sim_sd_event.at_us) ? &sim_lcd_event : &sim_sd_event;
+
+  if (event->at_us >= until_us) {
+    return false;
+  }
+
+  sim_set_time(event->at_us);
+  event->at_us = INT64_MAX;
+  event->fire();
+  return true;
+}
+
+static void sim_run(sim_scenario_t scenario, double seconds)
+{
+  const int64_t end_us = (int64_t)(seconds * 1e6);
+
+  sim_scenario = scenario;
+  memset(&sim_frames, 0, sizeof(sim_frames));
+  memset(&sim_loads, 0, sizeof(sim_loads));
+  sim_band_ready = false;
+  sim_flushing = false;
+
+  spi_arbiter_init(&sim_arbiter);
+  sim_arbiter.task = xTaskGetCurrentTaskHandle();
+
+  sim_set_time(0);
+  sim_schedule(&sim_lcd_event, 0, sim_lcd_frame);
+  sim_schedule(&sim_sd_event, SIM_REFRESH_PERIOD_US / 3, sim_sd_load);
+
+  while (sim_now_us < end_us) {
+    /** The arbiter picks the next job as soon as the bus is free */
+    if (spi_arbiter_run_next(&sim_arbiter)) {
+      while (sim_fire_before(sim_bus_free_us)) {
+      }
+      sim_set_time(sim_bus_free_us);
+      sim_bus_done();
+      continue;
+    }
+
+    if (!sim_fire_before(end_us)) {
+      break;
+    }
+  }
+}
+
+static void sim_print_latency(const char *name, const server_latency_t *latency)
+{
+  const double mean = (latency->count > 0U) ? (double)latency->sum_us / latency->count : 0.0;
+  printf("  %-4s %8u waits, min %6u us, mean %8.1f us, max %6u us\n", name, latency->count, latency->min_us, mean,
+         latency->max_us);
+}
+
+static void sim_print_stats(const char *name, const sim_stats_t *stats)
+{
+  const double mean = (stats->count > 0U) ? (double)stats->sum_us / stats->count / 1000.0 : 0.0;
+  printf("  %-11s %6u, mean %6.2f ms, max %6.2f ms\n", name, stats->count, mean, stats->max_us / 1000.0);
+}
+
+/**
+ * @brief Histograms of the waits side by side, bucket i holds the waits below 2^i us and from 2^(i-1) us
+ */
+static void sim_print_histograms(const server_latency_t *lcd, const server_latency_t *sd)
+{
+  printf("  %-*s %10s %10s\n", SIM_ROW_WIDTH + 4, "wait (us)", "LCD", "SD");
+  for (uint32_t bucket = 0U; bucket < SERVER_LATENCY_BUCKETS; bucket++) {
+    if (lcd->buckets[bucket] == 0U && sd->buckets[bucket] == 0U) {
+      continue;
+    }
+
+    char range[32];
+    if (bucket == 0U) {
+      snprintf(range, sizeof(range), "0");
+    } else if (bucket == SERVER_LATENCY_BUCKETS - 1U) {
+      snprintf(range, sizeof(range), ">= %u", 1U << (bucket - 1U));
+    } else {
+      snprintf(range, sizeof(range), "%u - %u", 1U << (bucket - 1U), (1U << bucket) - 1U);
+    }
+    printf("  %*s     %10u %10u\n", SIM_ROW_WIDTH, range, lcd->buckets[bucket], sd->buckets[bucket]);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const double seconds = (argc > 1) ? atof(argv[1]) : SIM_SECONDS;
+
+  printf("SPI bus: %u bands of %u lines per refresh, flush %lld us; SD file %u KiB, read %lld us per %u B chunk\n",
+         SIM_BANDS, SIM_BAND_LINES, (long long)SIM_FLUSH_US, SIM_SD_FILE_SIZE / 1024U, (long long)SIM_SD_READ_US,
+         SIM_SD_CHUNK_SIZE);
+  printf("Bounds with the arbiter, the job running included: LCD waits at most 2 SD jobs, %lld us; SD waits at most "
+         "%u flushes, %lld us\n\n", (long long)(2 * SIM_SD_READ_US), SPI_ARBITER_LCD_BURST + 1U,
+         (long long)((SPI_ARBITER_LCD_BURST + 1U) * SIM_FLUSH_US));
+
+  for (uint32_t scenario = 0U; scenario < SIM_SCENARIOS; scenario++) {
+    server_latency_t lcd;
+    server_latency_t sd;
+
+    sim_run((sim_scenario_t)scenario, seconds);
+    spi_arbiter_get_latency(&sim_arbiter, SPI_CLIENT_LCD, &lcd);
+    spi_arbiter_get_latency(&sim_arbiter, SPI_CLIENT_SD, &sd);
+
+    printf("%s, %.1f s\n", sim_scenario_names[scenario], seconds);
+    sim_print_latency("LCD", &lcd);
+    sim_print_latency("SD", &sd);
+    sim_print_stats("frames", &sim_frames);
+    sim_print_stats("file loads", &sim_loads);
+    sim_print_histograms(&lcd, &sd);
+    printf("\n");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lvgl.h"
+
+#include "server/server.h"
+#include "ui/index.h"
+#include "ui/stream.h"
+#include "ui/view.h"
+
+/**
+ * @brief Rendering cost of the periodic widget updates, LVGL on the host
+ *
+ * Usage: ui_refresh_bench [SECONDS]
+ *
+ * The windows of the panel are built by the firmware code and driven as the control tasks drive them, every
+ * BENCH_PERIOD_MS: the measurements of a load at a steady set point, with the noise of the ADC, on the index window,
+ * then a stream playing a point every BENCH_POINT_MS. Each window runs twice, in a process of its own: setting every
+ * widget each period as the tasks did, then through the view-model. The flush callback counts the pixels and the bytes
+ * that would go over SPI to the ST7735, the render time is the time spent in lv_timer_handler().
+ */
+
+/** Simulated time of each run */
+#define BENCH_SECONDS 60U
+
+/** Period of the control tasks */
+#define BENCH_PERIOD_MS 100U
+
+/** Points of the stream */
+#define BENCH_POINT_MS 500U
+
+/** Display of the panel */
+#define BENCH_H_RES 160
+#define BENCH_V_RES 128
+#define BENCH_BUFFER_LINES 20
+
+/** Bytes per flush besides the pixels, as LCD_FLUSH_OVERHEAD_BYTES */
+#define BENCH_FLUSH_OVERHEAD_BYTES 11U
+
+typedef struct bench_result
+{
+  double render_s;
+  uint64_t refreshes;
+  uint64_t invalidated_px;
+  uint64_t flushed_px;
+  uint64_t spi_bytes;
+} bench_result_t;
+
+typedef void (*bench_update_t)(uint32_t period, int viewed);
+
+static bench_result_t bench_result;
+static uint32_t bench_noise = 12345U;
+
+static void bench_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+  const uint32_t pixels = (uint32_t)lv_area_get_size(area);
+
+  bench_result.flushed_px += pixels;
+  bench_result.spi_bytes += pixels * sizeof(lv_color_t) + BENCH_FLUSH_OVERHEAD_BYTES;
+  lv_disp_flush_ready(drv);
+}
+
+static void bench_monitor(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+  bench_result.refreshes++;
+  bench_result.invalidated_px += px;
+}
+
+/**
+ * @brief Noise of a measurement, uniform
+ *
+ * @param amplitude Largest deviation, in milli-units
+ * @return int32_t Deviation
+ */
+static int32_t bench_jitter(int32_t amplitude)
+{
+  bench_noise = bench_noise * 1664525U + 1013904223U;
+  return (int32_t)((bench_noise >> 8U) % (uint32_t)(2 * amplitude + 1)) - amplitude;
+}
+
+/**
+ * @brief A measurement at a steady set point, 1.5 A from a 12 V source, with the noise of the ADC, a few LSB
+ *
+ * @param measurement Output measurement
+ * @return void
+ */
+static void bench_measure(load_measurement_t *measurement)
+{
+  measurement->cc_milli = (uint32_t)(1523 + bench_jitter(6));
+  measurement->cv_milli = (uint32_t)(12030 + bench_jitter(10));
+  measurement->cr_milli = measurement->cv_milli * 1000U / measurement->cc_milli;
+  measurement->cp_milli = measurement->cv_milli * measurement->cc_milli / 1000U;
+}
+
+static const char *const bench_modes[] = { "CC", "CV", "CR", "CP" };
+
+/**
+ * @brief One period of the index window, the mode changes every 20 s
+ *
+ * @param period Period number
+ * @param viewed 0 to set every widget, as the load task did, 1 to go through the view-model
+ * @return void
+ */
+static void bench_index(uint32_t period, int viewed)
+{
+  load_measurement_t measurement;
+  const char *mode = bench_modes[(period * BENCH_PERIOD_MS / 20000U) % 4U];
+
+  bench_measure(&measurement);
+
+  if (viewed) {
+    const ui_index_view_t view = {
+      .current = (int32_t)(measurement.cc_milli / 100U),
+      .voltage = (int32_t)(measurement.cv_milli / 100U),
+      .resistance = (int32_t)(measurement.cr_milli / 100U),
+      .power = (int32_t)(measurement.cp_milli / 100U),
+      .mode = mode,
+    };
+    ui_index_view_apply(&view);
+    return;
+  }
+
+  lv_spinbox_set_value(h_value_current_spinbox, measurement.cc_milli / 100U);
+  lv_spinbox_set_value(h_value_voltage_spinbox, measurement.cv_milli / 100U);
+  lv_spinbox_set_value(h_value_resistance_spinbox, measurement.cr_milli / 100U);
+  lv_spinbox_set_value(h_value_power_spinbox, measurement.cp_milli / 100U);
+  lv_label_set_text(h_value_mode_label, mode);
+}
+
+/**
+ * @brief One period of the stream window: a current step every point, the enable toggled every 4 points, a chart point
+ *        every second
+ *
+ * @param period Period number
+ * @param viewed 0 to set every widget, as the stream task did, 1 to go through the view-model
+ * @return void
+ */
+static void bench_stream(uint32_t period, int viewed)
+{
+  static ui_stream_view_t view = { 0 };
+  load_measurement_t measurement;
+  const uint32_t time_ms = period * BENCH_PERIOD_MS;
+  const uint32_t point = time_ms / BENCH_POINT_MS;
+  const int new_point = (time_ms % BENCH_POINT_MS) == 0U;
+
+  bench_measure(&measurement);
+
+  if (new_point) {
+    const uint32_t desired = 1000U + (point % 4U) * 500U;
+    const int enable = (point / 4U) % 2U == 0U;
+
+    if (viewed) {
+      view.mode = "CC";
+      view.desired = (int32_t)(desired / 100U);
+      view.enable = enable;
+    } else {
+      lv_label_set_text(h_stream_mode_label, "CC");
+      lv_spinbox_set_value(h_stream_desired_spinbox, desired / 100U);
+      if (enable) {
+        lv_led_on(h_stream_led_enable);
+      } else {
+        lv_led_off(h_stream_led_enable);
+      }
+    }
+  }
+
+  if (viewed) {
+    view.measured = (int32_t)(measurement.cc_milli / 100U);
+    ui_stream_view_apply(&view);
+  } else {
+    lv_spinbox_set_value(h_stream_measured_spinbox, measurement.cc_milli / 100U);
+  }
+
+  if (time_ms % 1000U == 0U) {
+    add_chart_point(measurement.cc_milli, measurement.cv_milli);
+  }
+}
+
+static double bench_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Runs a window in a process of its own, LVGL starts from scratch
+ *
+ * @param screen Window, 0 for the index one, 1 for the stream one
+ * @param viewed 0 to set every widget, 1 to go through the view-model
+ * @param seconds Simulated time
+ * @param result Output counters
+ * @return int 0 on success, -1 if the run failed
+ */
+static int bench_run(int screen, int viewed, uint32_t seconds, bench_result_t *result)
+{
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) {
+    return -1;
+  }
+
+  const pid_t child = fork();
+  if (child < 0) {
+    return -1;
+  }
+
+  if (child == 0) {
+    static lv_color_t buffer[BENCH_H_RES * BENCH_BUFFER_LINES];
+    static lv_disp_draw_buf_t draw_buffer;
+    static lv_disp_drv_t driver;
+
+    lv_init();
+    lv_disp_draw_buf_init(&draw_buffer, buffer, NULL, BENCH_H_RES * BENCH_BUFFER_LINES);
+    lv_disp_drv_init(&driver);
+    driver.hor_res = BENCH_H_RES;
+    driver.ver_res = BENCH_V_RES;
+    driver.flush_cb = bench_flush;
+    driver.monitor_cb = bench_monitor;
+    driver.draw_buf = &draw_buffer;
+    lv_disp_drv_register(&driver);
+
+    ui_index_window();
+    ui_stream_window();
+    lv_disp_load_scr(screen == 0 ? h_scr_ui_index : h_scr_ui_stream);
+
+    /** The first refresh draws the whole window, the same for both runs */
+    lv_refr_now(NULL);
+    memset(&bench_result, 0, sizeof(bench_result));
+
+    const bench_update_t update = (screen == 0) ? bench_index : bench_stream;
+    const uint32_t periods = seconds * 1000U / BENCH_PERIOD_MS;
+    for (uint32_t period = 0U; period < periods; period++) {
+      update(period, viewed);
+
+      /** The LVGL task runs between the updates */
+      for (uint32_t elapsed = 0U; elapsed < BENCH_PERIOD_MS; elapsed += LV_DISP_DEF_REFR_PERIOD) {
+        lv_tick_inc(LV_DISP_DEF_REFR_PERIOD);
+        const double start = bench_now();
+        lv_timer_handler();
+        bench_result.render_s += bench_now() - start;
+      }
+    }
+
+    const ssize_t written = write(pipe_fds[1], &bench_result, sizeof(bench_result));
+    _exit(written == (ssize_t)sizeof(bench_result) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  close(pipe_fds[1]);
+  const ssize_t got = read(pipe_fds[0], result, sizeof(*result));
+  close(pipe_fds[0]);
+
+  int status = 0;
+  waitpid(child, &status, 0);
+  return (got == (ssize_t)sizeof(*result) && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+static void bench_print(const char *name, const bench_result_t *result, uint32_t seconds)
+{
+  printf("  %-22s %7.3f ms render/s, %6.1f refreshes/s, %8.0f px invalidated/s, %8.0f px flushed/s, %8.0f SPI B/s\n",
+         name, result->render_s * 1e3 / seconds, (double)result->refreshes / seconds,
+         (double)result->invalidated_px / seconds, (double)result->flushed_px / seconds,
+         (double)result->spi_bytes / seconds);
+}
+
+int main(int argc, char **argv)
+{
+  const uint32_t seconds = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : BENCH_SECONDS;
+  static const char *const screens[] = { "index window", "stream window" };
+  int failures = 0;
+
+  printf("%u s at a %u ms task period, %dx%d display\n", seconds, BENCH_PERIOD_MS, BENCH_H_RES, BENCH_V_RES);
+  for (int screen = 0; screen < 2; screen++) {
+    bench_result_t before;
+    bench_result_t after;
+
+    if (bench_run(screen, 0, seconds, &before) != 0 || bench_run(screen, 1, seconds, &after) != 0) {
+      fprintf(stderr, "%s: run failed\n", screens[screen]);
+      failures++;
+      continue;
+    }
+
+    printf("%s:\n", screens[screen]);
+    bench_print("every widget set", &before, seconds);
+    bench_print("view-model", &after, seconds);
+    printf("  %.1fx fewer pixels flushed\n",
+           after.flushed_px == 0U ? 0.0 : (double)before.flushed_px / (double)after.flushed_px);
+
+    failures += after.flushed_px > before.flushed_px;
+  }
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
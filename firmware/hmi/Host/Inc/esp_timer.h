@@ -0,0 +1,28 @@
+#ifndef __HOST_ESP_TIMER_H__
+#define __HOST_ESP_TIMER_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Timer shim of the host builds
+ *
+ * The time since boot is the monotonic clock, unless a simulation drives it with host_timer_set(): the time then only
+ * moves when set again.
+ */
+
+/**
+ * @brief Time since boot
+ *
+ * @return int64_t Microseconds
+ */
+int64_t esp_timer_get_time(void);
+
+/**
+ * @brief Sets the time of a simulation, esp_timer_get_time() returns it from then on
+ *
+ * @param now_us Microseconds
+ * @return void
+ */
+void host_timer_set(int64_t now_us);
+
+#endif /** !__HOST_ESP_TIMER_H__ */
@@ -0,0 +1,29 @@
+#ifndef __HOST_FREERTOS_H__
+#define __HOST_FREERTOS_H__
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * @brief FreeRTOS shim of the host builds
+ *
+ * Only what the panel modules built on the host use, with the same names and semantics as the FreeRTOS of the
+ * ESP-IDF. Tasks are POSIX threads, a tick is a millisecond.
+ */
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFU)
+#define portTICK_PERIOD_MS 1U
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#define configASSERT(x) assert(x)
+
+#endif /** !__HOST_FREERTOS_H__ */
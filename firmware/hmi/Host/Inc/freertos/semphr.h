@@ -0,0 +1,20 @@
+#ifndef __HOST_FREERTOS_SEMPHR_H__
+#define __HOST_FREERTOS_SEMPHR_H__
+
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Semaphores of the FreeRTOS shim
+ *
+ * A mutex is a binary semaphore given at creation, without priority inheritance: the host threads have no priorities.
+ */
+
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#endif /** !__HOST_FREERTOS_SEMPHR_H__ */
@@ -0,0 +1,58 @@
+#ifndef __HOST_FREERTOS_TASK_H__
+#define __HOST_FREERTOS_TASK_H__
+
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Task notifications and scheduler control of the FreeRTOS shim
+ *
+ * Any thread is a task, its handle is created on its first use. The scheduler of the host can't be suspended, threads
+ * run on cores of their own: vTaskSuspendAll() and xTaskResumeAll() only count their nesting.
+ */
+
+typedef struct host_task *TaskHandle_t;
+
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef enum
+{
+  eNoAction = 0,
+  eSetBits,
+  eIncrement,
+  eSetValueWithOverwrite,
+  eSetValueWithoutOverwrite
+} eNotifyAction;
+
+/**
+ * @brief Starts a task on a detached thread, the stack size and priority are ignored
+ *
+ * @param code Task function
+ * @param name Name, unused
+ * @param stack_depth Unused
+ * @param arg Argument of the task
+ * @param priority Unused
+ * @param handle Where the handle is stored before the task runs, may be NULL
+ * @return BaseType_t pdPASS, pdFAIL if the thread can't be created
+ */
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle);
+
+/**
+ * @brief Handle of the calling thread
+ *
+ * @return TaskHandle_t Handle, valid as long as the process runs
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+void vTaskSuspendAll(void);
+BaseType_t xTaskResumeAll(void);
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks);
+
+#define xTaskNotifyGive(task) xTaskNotify((task), 0U, eIncrement)
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+
+void vTaskDelay(TickType_t ticks);
+
+#endif /** !__HOST_FREERTOS_TASK_H__ */
@@ -0,0 +1,16 @@
+#ifndef __HOST_DRIVER_PULSE_CNT_H__
+#define __HOST_DRIVER_PULSE_CNT_H__
+
+#include "esp_err.h"
+
+/**
+ * @brief ESP-IDF declarations of the compile check, nothing here is linked
+ */
+
+typedef struct pcnt_unit_t *pcnt_unit_handle_t;
+typedef struct pcnt_chan_t *pcnt_channel_handle_t;
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int *value);
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit);
+
+#endif /** !__HOST_DRIVER_PULSE_CNT_H__ */
@@ -0,0 +1,18 @@
+#ifndef __HOST_DRIVER_UART_H__
+#define __HOST_DRIVER_UART_H__
+
+#include "esp_err.h"
+
+/**
+ * @brief ESP-IDF declarations of the compile check, nothing here is linked
+ */
+
+typedef enum
+{
+  UART_NUM_0 = 0,
+  UART_NUM_1,
+  UART_NUM_2,
+  UART_NUM_MAX
+} uart_port_t;
+
+#endif /** !__HOST_DRIVER_UART_H__ */
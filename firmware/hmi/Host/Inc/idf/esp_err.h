@@ -0,0 +1,13 @@
+#ifndef __HOST_ESP_ERR_H__
+#define __HOST_ESP_ERR_H__
+
+/**
+ * @brief ESP-IDF declarations of the compile check, nothing here is linked
+ */
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#endif /** !__HOST_ESP_ERR_H__ */
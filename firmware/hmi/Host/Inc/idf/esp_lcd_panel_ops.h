@@ -0,0 +1,12 @@
+#ifndef __HOST_ESP_LCD_PANEL_OPS_H__
+#define __HOST_ESP_LCD_PANEL_OPS_H__
+
+#include "esp_err.h"
+
+/**
+ * @brief ESP-IDF declarations of the compile check, nothing here is linked
+ */
+
+typedef struct esp_lcd_panel_t *esp_lcd_panel_handle_t;
+
+#endif /** !__HOST_ESP_LCD_PANEL_OPS_H__ */
@@ -0,0 +1,11 @@
+#ifndef __HOST_ESP_LCD_PANEL_VENDOR_H__
+#define __HOST_ESP_LCD_PANEL_VENDOR_H__
+
+#include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_io.h"
+
+/**
+ * @brief ESP-IDF declarations of the compile check, nothing here is linked
+ */
+
+#endif /** !__HOST_ESP_LCD_PANEL_VENDOR_H__ */
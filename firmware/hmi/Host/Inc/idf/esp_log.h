@@ -0,0 +1,19 @@
+#ifndef __HOST_ESP_LOG_H__
+#define __HOST_ESP_LOG_H__
+
+#include <stdio.h>
+
+/**
+ * @brief ESP-IDF declarations of the compile check, nothing here is linked
+ *
+ * The log macros keep the printf format checks of the ESP-IDF ones.
+ */
+
+#define ESP_LOG_HOST(tag, format, ...) printf("%s: " format "\n", (tag), ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+
+#endif /** !__HOST_ESP_LOG_H__ */
@@ -0,0 +1,50 @@
+/** LVGL checks the guard to tell its configuration was found */
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+/**
+ * @brief LVGL configuration of the host builds
+ *
+ * The values of the panel sdkconfig that change what gets rendered and flushed, LVGL defaults for the rest.
+ */
+
+#define LV_COLOR_DEPTH 16
+#define LV_COLOR_16_SWAP 1
+
+#define LV_MEM_CUSTOM 0
+#define LV_MEM_SIZE (32U * 1024U)
+
+#define LV_DISP_DEF_REFR_PERIOD 30
+#define LV_INDEV_DEF_READ_PERIOD 30
+#define LV_DPI_DEF 130
+
+/** The simulation drives the tick, see lv_tick_inc() */
+#define LV_TICK_CUSTOM 0
+
+#define LV_DRAW_COMPLEX 1
+#define LV_SHADOW_CACHE_SIZE 0
+#define LV_CIRCLE_CACHE_SIZE 4
+#define LV_LAYER_SIMPLE_BUF_SIZE (24 * 1024)
+#define LV_IMG_CACHE_DEF_SIZE 0
+#define LV_GRADIENT_MAX_STOPS 2
+#define LV_GRAD_CACHE_DEF_SIZE 0
+
+#define LV_USE_LOG 0
+#define LV_USE_ASSERT_NULL 1
+#define LV_USE_ASSERT_MALLOC 1
+#define LV_USE_USER_DATA 1
+
+#define LV_FONT_MONTSERRAT_14 1
+#define LV_FONT_DEFAULT &lv_font_montserrat_14
+
+#define LV_USE_THEME_DEFAULT 1
+#define LV_THEME_DEFAULT_GROW 1
+#define LV_THEME_DEFAULT_TRANSITION_TIME 80
+
+#define LV_BUILD_EXAMPLES 0
+
+/** Scenes of lcd_refresh_bench, only built with it */
+#define LV_USE_DEMO_BENCHMARK 1
+#define LV_USE_FONT_COMPRESSED 1
+
+#endif /** !LV_CONF_H */
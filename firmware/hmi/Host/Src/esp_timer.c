@@ -0,0 +1,25 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "esp_timer.h"
+
+static atomic_bool host_timer_virtual = false;
+static _Atomic int64_t host_timer_now_us = 0;
+
+int64_t esp_timer_get_time(void)
+{
+  if (atomic_load(&host_timer_virtual)) {
+    return atomic_load(&host_timer_now_us);
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void host_timer_set(int64_t now_us)
+{
+  atomic_store(&host_timer_now_us, now_us);
+  atomic_store(&host_timer_virtual, true);
+}
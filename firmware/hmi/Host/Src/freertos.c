@@ -0,0 +1,303 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct host_task
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t notified;
+  uint32_t value;
+  int pending;
+};
+
+struct host_semaphore
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t given;
+  uint32_t count;
+};
+
+/** Start of a thread created by xTaskCreate() */
+struct host_start
+{
+  TaskFunction_t code;
+  void *arg;
+  struct host_task *task;
+};
+
+static _Thread_local struct host_task *host_current_task = NULL;
+static _Thread_local uint32_t host_suspended = 0U;
+
+static void host_cond_init(pthread_cond_t *cond)
+{
+  pthread_condattr_t attributes;
+
+  pthread_condattr_init(&attributes);
+  pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+  pthread_cond_init(cond, &attributes);
+  pthread_condattr_destroy(&attributes);
+}
+
+/**
+ * @brief Deadline of a wait on the monotonic clock
+ *
+ * @param ticks Wait, not portMAX_DELAY
+ * @return struct timespec Deadline
+ */
+static struct timespec host_deadline(TickType_t ticks)
+{
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += (time_t)(ticks / 1000U);
+  deadline.tv_nsec += (long)(ticks % 1000U) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  return deadline;
+}
+
+static struct host_task *host_task_create(void)
+{
+  struct host_task *task = calloc(1U, sizeof(*task));
+
+  pthread_mutex_init(&task->mutex, NULL);
+  host_cond_init(&task->notified);
+  return task;
+}
+
+static void *host_task_start(void *arg)
+{
+  struct host_start start = *(struct host_start *)arg;
+
+  free(arg);
+  host_current_task = start.task;
+  start.code(start.arg);
+  return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle)
+{
+  struct host_start *start = malloc(sizeof(*start));
+  pthread_t thread;
+
+  (void)name;
+  (void)stack_depth;
+  (void)priority;
+
+  *start = (struct host_start){ code, arg, host_task_create() };
+  if (handle != NULL) {
+    *handle = start->task;
+  }
+
+  if (pthread_create(&thread, NULL, host_task_start, start) != 0) {
+    free(start);
+    return pdFAIL;
+  }
+  pthread_detach(thread);
+
+  return pdPASS;
+}
+
+/**
+ * @brief Handle of the calling thread
+ *
+ * @return TaskHandle_t Handle, valid as long as the process runs
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+  if (host_current_task == NULL) {
+    host_current_task = host_task_create();
+  }
+
+  return host_current_task;
+}
+
+void vTaskSuspendAll(void)
+{
+  host_suspended++;
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+  host_suspended--;
+  return pdFALSE;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+  BaseType_t result = pdPASS;
+
+  pthread_mutex_lock(&task->mutex);
+  switch (action) {
+    case eSetBits:
+      task->value |= value;
+      break;
+    case eIncrement:
+      task->value++;
+      break;
+    case eSetValueWithOverwrite:
+      task->value = value;
+      break;
+    case eSetValueWithoutOverwrite:
+      if (task->pending) {
+        result = pdFAIL;
+      } else {
+        task->value = value;
+      }
+      break;
+    default:
+      break;
+  }
+  task->pending = 1;
+  pthread_cond_signal(&task->notified);
+  pthread_mutex_unlock(&task->mutex);
+
+  return result;
+}
+
+/**
+ * @brief Waits for the notification of the calling task
+ *
+ * @param task Calling task, its mutex held
+ * @param ticks Maximum wait, portMAX_DELAY to wait forever
+ * @return int 1 if notified, 0 on timeout
+ */
+static int host_wait(struct host_task *task, TickType_t ticks)
+{
+  const struct timespec deadline = host_deadline(ticks);
+
+  while (!task->pending) {
+    if (ticks == 0U) {
+      return 0;
+    }
+    if (ticks == portMAX_DELAY) {
+      pthread_cond_wait(&task->notified, &task->mutex);
+    } else if (pthread_cond_timedwait(&task->notified, &task->mutex, &deadline) == ETIMEDOUT) {
+      return task->pending;
+    }
+  }
+
+  return 1;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+  struct host_task *task = xTaskGetCurrentTaskHandle();
+  BaseType_t result = pdFALSE;
+
+  pthread_mutex_lock(&task->mutex);
+  if (!task->pending) {
+    task->value &= ~clear_on_entry;
+  }
+
+  if (host_wait(task, ticks)) {
+    task->pending = 0;
+    result = pdTRUE;
+  }
+
+  if (value != NULL) {
+    *value = task->value;
+  }
+  if (result == pdTRUE) {
+    task->value &= ~clear_on_exit;
+  }
+  pthread_mutex_unlock(&task->mutex);
+
+  return result;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+  struct host_task *task = xTaskGetCurrentTaskHandle();
+
+  pthread_mutex_lock(&task->mutex);
+  if (task->value == 0U) {
+    task->pending = 0;
+    host_wait(task, ticks);
+  }
+
+  const uint32_t value = task->value;
+  if (value != 0U) {
+    task->value = clear_on_exit ? 0U : value - 1U;
+  }
+  task->pending = 0;
+  pthread_mutex_unlock(&task->mutex);
+
+  return value;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  const struct timespec delay = { (time_t)(ticks / 1000U), (long)(ticks % 1000U) * 1000000L };
+  nanosleep(&delay, NULL);
+}
+
+static SemaphoreHandle_t host_semaphore_create(uint32_t count)
+{
+  struct host_semaphore *semaphore = calloc(1U, sizeof(*semaphore));
+
+  pthread_mutex_init(&semaphore->mutex, NULL);
+  host_cond_init(&semaphore->given);
+  semaphore->count = count;
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+  return host_semaphore_create(1U);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+  return host_semaphore_create(0U);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+  BaseType_t result = pdTRUE;
+
+  pthread_mutex_lock(&semaphore->mutex);
+  if (ticks == portMAX_DELAY) {
+    while (semaphore->count == 0U) {
+      pthread_cond_wait(&semaphore->given, &semaphore->mutex);
+    }
+  } else {
+    const struct timespec deadline = host_deadline(ticks);
+    while (semaphore->count == 0U && result == pdTRUE) {
+      if (ticks == 0U || pthread_cond_timedwait(&semaphore->given, &semaphore->mutex, &deadline) == ETIMEDOUT) {
+        result = (semaphore->count != 0U) ? pdTRUE : pdFALSE;
+        break;
+      }
+    }
+  }
+
+  if (result == pdTRUE) {
+    semaphore->count--;
+  }
+  pthread_mutex_unlock(&semaphore->mutex);
+
+  return result;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  BaseType_t result = pdFALSE;
+
+  pthread_mutex_lock(&semaphore->mutex);
+  if (semaphore->count == 0U) {
+    semaphore->count = 1U;
+    pthread_cond_signal(&semaphore->given);
+    result = pdTRUE;
+  }
+  pthread_mutex_unlock(&semaphore->mutex);
+
+  return result;
+}
@@ -0,0 +1,221 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bus/topic.h"
+
+/**
+ * @brief Publish/subscribe of the panel tasks, on the FreeRTOS shim
+ *
+ * Usage: topic_test
+ *
+ * Checks the versions and the notification bits from a single thread first. Then a publisher thread publishes
+ * TEST_PUBLICATIONS snapshots, every word of the k-th one set to k, while subscriber threads wait for them and readers
+ * copy them in a loop. No copy may mix two snapshots or go back in versions, and every subscriber must be woken up
+ * for the last one.
+ */
+
+/** Snapshots published by the publisher thread */
+#define TEST_PUBLICATIONS 200000U
+
+/** Threads waiting for the publications, and threads copying the snapshot in a loop */
+#define TEST_SUBSCRIBERS 3U
+#define TEST_READERS 2U
+
+/** Wait of a subscriber, long enough to tell a lost notification from a slow publisher */
+#define TEST_WAIT_MS 1000U
+
+typedef struct test_snapshot
+{
+  uint32_t words[12];
+} test_snapshot_t;
+
+typedef struct test_thread
+{
+  pthread_t thread;
+  uint32_t last_version;  /**< Version of the last copy */
+  uint32_t copies;        /**< Copies taken */
+  uint32_t wakeups;       /**< Notifications received */
+  uint32_t failures;      /**< Torn copies, versions going back, timeouts */
+} test_thread_t;
+
+static test_snapshot_t test_storage;
+static topic_t test_topic = TOPIC_INITIALIZER(test_storage, TOPIC_BIT_MEASUREMENT);
+
+static test_snapshot_t test_other_storage;
+static topic_t test_other_topic = TOPIC_INITIALIZER(test_other_storage, TOPIC_BIT_CONTROL);
+
+/** Subscriber threads ready, the publisher waits for them */
+static pthread_barrier_t test_start;
+
+static int test_expect(int condition, const char *what)
+{
+  if (!condition) {
+    fprintf(stderr, "failed: %s\n", what);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks a copy, every word is its version
+ *
+ * @param self Thread
+ * @param snapshot Copy
+ * @param version Version of the copy
+ * @return void
+ */
+static void test_check(test_thread_t *self, const test_snapshot_t *snapshot, uint32_t version)
+{
+  for (uint32_t i = 0U; i < sizeof(snapshot->words) / sizeof(snapshot->words[0]); i++) {
+    if (snapshot->words[i] != version) {
+      self->failures++;
+      break;
+    }
+  }
+
+  if (version < self->last_version) {
+    self->failures++;
+  }
+  self->last_version = version;
+  self->copies++;
+}
+
+static void *test_subscriber(void *argument)
+{
+  test_thread_t *self = argument;
+  test_snapshot_t snapshot;
+
+  topic_subscribe(&test_topic, xTaskGetCurrentTaskHandle());
+  pthread_barrier_wait(&test_start);
+
+  while (self->last_version < TEST_PUBLICATIONS) {
+    const uint32_t bits = topic_wait(TEST_WAIT_MS);
+    if (bits == 0U) {
+      self->failures++;
+      break;
+    }
+
+    self->wakeups++;
+    test_check(self, &snapshot, topic_read(&test_topic, &snapshot));
+  }
+
+  return NULL;
+}
+
+static void *test_reader(void *argument)
+{
+  test_thread_t *self = argument;
+  test_snapshot_t snapshot;
+
+  pthread_barrier_wait(&test_start);
+
+  while (self->last_version < TEST_PUBLICATIONS) {
+    test_check(self, &snapshot, topic_read(&test_topic, &snapshot));
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Versions, subscriptions and notification bits, from a single thread
+ *
+ * @return int Failures
+ */
+static int test_single(void)
+{
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  test_snapshot_t snapshot = { { 7U } };
+  int failures = 0;
+
+  test_other_storage.words[0] = 42U;
+  failures += test_expect(topic_version(&test_other_topic) == 0U, "no version before the first publication");
+  failures += test_expect(topic_read(&test_other_topic, &snapshot) == 0U && snapshot.words[0] == 42U,
+                          "initial value read as version 0");
+  failures += test_expect(topic_wait(0U) == 0U, "no notification before subscribing");
+
+  failures += test_expect(topic_subscribe(&test_other_topic, self) == 0, "subscription");
+  snapshot.words[0] = 1U;
+  failures += test_expect(topic_publish(&test_other_topic, &snapshot) == 1U, "first publication is version 1");
+  snapshot.words[0] = 2U;
+  failures += test_expect(topic_publish(&test_other_topic, &snapshot) == 2U, "second publication is version 2");
+  failures += test_expect(topic_wait(0U) == TOPIC_BIT_CONTROL, "publications notified once, by the topic bit");
+  failures += test_expect(topic_wait(10U) == 0U, "notification cleared by the wait");
+  failures += test_expect(topic_read(&test_other_topic, &snapshot) == 2U && snapshot.words[0] == 2U,
+                          "last snapshot read with its version");
+
+  /** A publication of a topic the task isn't subscribed to doesn't wake it up */
+  topic_publish(&test_topic, &snapshot);
+  failures += test_expect(topic_wait(0U) == 0U, "no notification from another topic");
+
+  failures += test_expect(topic_subscribe(&test_topic, self) == 0, "subscription to a second topic");
+  topic_publish(&test_topic, &snapshot);
+  topic_publish(&test_other_topic, &snapshot);
+  failures += test_expect(topic_wait(0U) == (TOPIC_BIT_MEASUREMENT | TOPIC_BIT_CONTROL), "bits of both topics");
+
+  for (uint32_t i = 1U; i < TOPIC_SUBSCRIBERS_MAX; i++) {
+    failures += test_expect(topic_subscribe(&test_other_topic, self) == 0, "subscriptions up to the maximum");
+  }
+  failures += test_expect(topic_subscribe(&test_other_topic, self) != 0, "subscription over the maximum refused");
+
+  return failures;
+}
+
+/**
+ * @brief Snapshots published while subscribers and readers copy them
+ *
+ * @return int Failures
+ */
+static int test_concurrent(void)
+{
+  static test_thread_t subscribers[TEST_SUBSCRIBERS];
+  static test_thread_t readers[TEST_READERS];
+  test_snapshot_t snapshot;
+  int failures = 0;
+
+  /** Starts from version 0 again, with no subscriber, the initial value is version 0 */
+  memset(&test_storage, 0, sizeof(test_storage));
+  test_topic = (topic_t)TOPIC_INITIALIZER(test_storage, TOPIC_BIT_MEASUREMENT);
+
+  pthread_barrier_init(&test_start, NULL, TEST_SUBSCRIBERS + TEST_READERS + 1U);
+  for (uint32_t i = 0U; i < TEST_SUBSCRIBERS; i++) {
+    pthread_create(&subscribers[i].thread, NULL, test_subscriber, &subscribers[i]);
+  }
+  for (uint32_t i = 0U; i < TEST_READERS; i++) {
+    pthread_create(&readers[i].thread, NULL, test_reader, &readers[i]);
+  }
+  pthread_barrier_wait(&test_start);
+
+  for (uint32_t version = 1U; version <= TEST_PUBLICATIONS; version++) {
+    for (uint32_t i = 0U; i < sizeof(snapshot.words) / sizeof(snapshot.words[0]); i++) {
+      snapshot.words[i] = version;
+    }
+    failures += test_expect(topic_publish(&test_topic, &snapshot) == version, "publication versions in order");
+  }
+
+  for (uint32_t i = 0U; i < TEST_SUBSCRIBERS; i++) {
+    pthread_join(subscribers[i].thread, NULL);
+    printf("subscriber %u: %u wakeups, last version %u, %u failures\n", i, subscribers[i].wakeups,
+           subscribers[i].last_version, subscribers[i].failures);
+    failures += (int)subscribers[i].failures;
+    failures += test_expect(subscribers[i].last_version == TEST_PUBLICATIONS, "subscriber woken for the last one");
+  }
+  for (uint32_t i = 0U; i < TEST_READERS; i++) {
+    pthread_join(readers[i].thread, NULL);
+    printf("reader %u: %u copies, %u failures\n", i, readers[i].copies, readers[i].failures);
+    failures += (int)readers[i].failures;
+  }
+  pthread_barrier_destroy(&test_start);
+
+  return failures;
+}
+
+int main(void)
+{
+  int failures = test_single();
+  failures += test_concurrent();
+
+  printf("%u publications: %s\n", TEST_PUBLICATIONS, failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
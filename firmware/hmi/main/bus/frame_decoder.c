@@ -0,0 +1,120 @@
+#include "bus/frame_decoder.h"
+
+/** Prototypes */
+static void frame_decoder_text(frame_decoder_t *decoder, uint32_t start, uint32_t length);
+
+/**
+ * @brief Initializes a decoder
+ *
+ * @param decoder Decoder
+ * @param on_frame Called on every complete frame
+ * @param on_text Called on every run of bytes outside the frames, may be NULL
+ * @param context Passed back to the callbacks
+ * @return void
+ */
+void frame_decoder_init(frame_decoder_t *decoder, frame_decoder_frame_cb_t on_frame, frame_decoder_text_cb_t on_text,
+                        void *context)
+{
+  decoder->on_frame = on_frame;
+  decoder->on_text = on_text;
+  decoder->context = context;
+  decoder->stats.bytes = 0U;
+  decoder->stats.frames = 0U;
+  decoder->stats.text = 0U;
+  frame_decoder_reset(decoder);
+}
+
+/**
+ * @brief Drops the bytes not decoded yet, after bytes were lost
+ *
+ * @param decoder Decoder
+ * @return void
+ */
+void frame_decoder_reset(frame_decoder_t *decoder)
+{
+  decoder->head = 0U;
+  decoder->tail = 0U;
+}
+
+/**
+ * @brief Contiguous free space of the ring, where the next bytes are to be read
+ *
+ * @param decoder Decoder
+ * @param size Where the size of the space is stored
+ * @return uint8_t* Start of the space
+ */
+uint8_t *frame_decoder_space(frame_decoder_t *decoder, uint32_t *size)
+{
+  /** A byte is kept free to tell a full ring from an empty one */
+  if (decoder->tail >= decoder->head) {
+    *size = FRAME_DECODER_RING_SIZE - decoder->tail - ((decoder->head == 0U) ? 1U : 0U);
+  } else {
+    *size = decoder->head - decoder->tail - 1U;
+  }
+
+  return &decoder->ring[decoder->tail];
+}
+
+/**
+ * @brief Decodes the bytes just read into the space, calling back for every complete frame and text run
+ *
+ * @param decoder Decoder
+ * @param size Bytes read, up to the size returned by frame_decoder_space()
+ * @return void
+ */
+void frame_decoder_commit(frame_decoder_t *decoder, uint32_t size)
+{
+  server_frame_t frame;
+  uint32_t text = decoder->head;
+
+  decoder->tail = (decoder->tail + size) % FRAME_DECODER_RING_SIZE;
+  decoder->stats.bytes += size;
+
+  /** Frames start with a non ASCII sync byte, the runs of bytes between them belong to text commands */
+  while (decoder->head != decoder->tail) {
+    const int found = server_frame_at(decoder->ring, FRAME_DECODER_RING_SIZE, decoder->head, decoder->tail, &frame);
+
+    if (found < 0) {
+      decoder->head = (decoder->head + 1U) % FRAME_DECODER_RING_SIZE;
+      decoder->stats.text++;
+      if (decoder->head == 0U) {
+        frame_decoder_text(decoder, text, FRAME_DECODER_RING_SIZE - text);
+        text = 0U;
+      }
+      continue;
+    }
+
+    frame_decoder_text(decoder, text, decoder->head - text);
+    text = decoder->head;
+
+    /** The rest of the frame comes with the next read */
+    if (found == 0) {
+      break;
+    }
+
+    decoder->on_frame(&frame, decoder->context);
+    decoder->stats.frames++;
+    decoder->head = (decoder->head + server_frame_size(&frame)) % FRAME_DECODER_RING_SIZE;
+    text = decoder->head;
+  }
+
+  /** The text stream keeps a command cut by the end of the read for the next one */
+  frame_decoder_text(decoder, text, decoder->head - text);
+}
+
+/** Implementations */
+
+/**
+ * @brief Hands over a run of bytes outside the frames, where it lies in the ring
+ *
+ * @param decoder Decoder
+ * @param start Offset of the first byte
+ * @param length Bytes in the run, it does not wrap
+ * @return void
+ */
+static void frame_decoder_text(frame_decoder_t *decoder, uint32_t start, uint32_t length)
+{
+  if (length > 0U && decoder->on_text != NULL) {
+    decoder->on_text(&decoder->ring[start], length, decoder->context);
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef __BUS_FRAME_DECODER_H__
+#define __BUS_FRAME_DECODER_H__
+
+#include <stdint.h>
+
+#include "server/server.h"
+
+/**
+ * @brief Streaming decoder of the bytes received from the load.
+ *
+ * The UART driver reads straight into a ring owned by the decoder, as many bytes at a time as it holds. Every frame
+ * complete in the ring is located in place with server_frame_at() and handed over, a frame cut by the end of a read
+ * waits in the ring for the rest. The runs of bytes between frames belong to text commands and are handed over where
+ * they lie, split where the ring wraps.
+ *
+ * It has no dependency on the ESP-IDF, so that it builds on the host as well.
+ */
+
+/** Received bytes waiting to be decoded, room for a few reads of the driver ring and a frame cut by them */
+#define FRAME_DECODER_RING_SIZE 1024U
+
+/**
+ * @brief Called on every complete frame
+ *
+ * @param frame Frame, valid until the callback returns
+ * @param context Pointer given to frame_decoder_init()
+ * @return void
+ */
+typedef void (*frame_decoder_frame_cb_t)(const server_frame_t *frame, void *context);
+
+/**
+ * @brief Called on every run of bytes outside the frames
+ *
+ * @param data First byte
+ * @param length Bytes in the run
+ * @param context Pointer given to frame_decoder_init()
+ * @return void
+ */
+typedef void (*frame_decoder_text_cb_t)(const uint8_t *data, uint32_t length, void *context);
+
+typedef struct frame_decoder_stats
+{
+  uint32_t bytes;   /**< Bytes committed */
+  uint32_t frames;  /**< Frames with a valid CRC */
+  uint32_t text;    /**< Bytes outside the frames, corrupted frames included */
+} frame_decoder_stats_t;
+
+typedef struct frame_decoder
+{
+  uint8_t ring[FRAME_DECODER_RING_SIZE];
+  uint32_t head;  /**< First byte not decoded yet */
+  uint32_t tail;  /**< Next byte to be written */
+  frame_decoder_frame_cb_t on_frame;
+  frame_decoder_text_cb_t on_text;
+  void *context;
+  frame_decoder_stats_t stats;
+} frame_decoder_t;
+
+/**
+ * @brief Initializes a decoder
+ *
+ * @param decoder Decoder
+ * @param on_frame Called on every complete frame
+ * @param on_text Called on every run of bytes outside the frames, may be NULL
+ * @param context Passed back to the callbacks
+ * @return void
+ */
+void frame_decoder_init(frame_decoder_t *decoder, frame_decoder_frame_cb_t on_frame, frame_decoder_text_cb_t on_text,
+                        void *context);
+
+/**
+ * @brief Drops the bytes not decoded yet, after bytes were lost
+ *
+ * @param decoder Decoder
+ * @return void
+ */
+void frame_decoder_reset(frame_decoder_t *decoder);
+
+/**
+ * @brief Contiguous free space of the ring, where the next bytes are to be read
+ *
+ * @param decoder Decoder
+ * @param size Where the size of the space is stored
+ * @return uint8_t* Start of the space
+ */
+uint8_t *frame_decoder_space(frame_decoder_t *decoder, uint32_t *size);
+
+/**
+ * @brief Decodes the bytes just read into the space, calling back for every complete frame and text run
+ *
+ * @param decoder Decoder
+ * @param size Bytes read, up to the size returned by frame_decoder_space()
+ * @return void
+ */
+void frame_decoder_commit(frame_decoder_t *decoder, uint32_t size);
+
+#endif /** !__BUS_FRAME_DECODER_H__ */
@@ -0,0 +1,66 @@
+#ifndef __BUS_SEQLOCK_H__
+#define __BUS_SEQLOCK_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Sequence lock, a single writer publishes a struct that any number of readers copy without blocking it.
+ *
+ * The sequence is odd while the writer updates the struct, a reader copies it again until it gets a copy taken with
+ * an even sequence that didn't change meanwhile. Readers spin while a write is in progress, so the writer must not be
+ * preempted by a reader on its own core: its task priority must be at least the one of the readers.
+ */
+
+typedef struct seqlock
+{
+  uint32_t sequence;
+} seqlock_t;
+
+/**
+ * @brief Copies a struct in, for the single writer
+ *
+ * @param lock Lock of the struct
+ * @param shared Published struct
+ * @param data New content
+ * @param size Struct size
+ * @return void
+ */
+static inline void seqlock_write(seqlock_t *lock, void *shared, const void *data, size_t size)
+{
+  const uint32_t sequence = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&lock->sequence, sequence + 1U, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(shared, data, size);
+  __atomic_store_n(&lock->sequence, sequence + 2U, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Copies a struct out, retrying while the writer updates it
+ *
+ * @param lock Lock of the struct
+ * @param shared Published struct
+ * @param data Where the copy is stored
+ * @param size Struct size
+ * @return uint32_t Number of writes so far
+ */
+static inline uint32_t seqlock_read(const seqlock_t *lock, const void *shared, void *data, size_t size)
+{
+  uint32_t sequence;
+
+  for (;;) {
+    sequence = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE);
+    if (sequence & 1U) {
+      continue;
+    }
+
+    memcpy(data, shared, size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&lock->sequence, __ATOMIC_RELAXED) == sequence) {
+      return sequence / 2U;
+    }
+  }
+}
+
+#endif /** !__BUS_SEQLOCK_H__ */
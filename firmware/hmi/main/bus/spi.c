@@ -9,11 +9,11 @@
 
 #define MODULE_NAME "bus.spi"
 
-/** Resource semaphores */
-SemaphoreHandle_t h_spi_bus_mutex;
+/** Handlers */
+spi_arbiter_t h_spi_arbiter;
 
 /**
- * @brief Init default board SPI bus using maximum transfer size needed by LVGL
+ * @brief Init default board SPI bus using maximum transfer size needed by LVGL, and starts its arbiter
  * @return void
  */
 void spi_init(void)
@@ -30,31 +30,49 @@ void spi_init(void)
   };
   ESP_ERROR_CHECK(spi_bus_initialize(SPI2_HOST, &buscfg, SPI_DMA_CH_AUTO));
 
-  h_spi_bus_mutex = xSemaphoreCreateRecursiveMutex();
-  assert(h_spi_bus_mutex);
+  spi_arbiter_init(&h_spi_arbiter);
+  xTaskCreate(
+    spi_arbiter_task, "spi", SPI_TASK_STACK_SIZE, &h_spi_arbiter, SPI_TASK_PRIORITY, &h_spi_arbiter.task
+  );
+  configASSERT(h_spi_arbiter.task);
 
   LOG_EPILOG
 }
 
 /**
- * @brief Tries to lock the SPI bus access mutex
+ * @brief Queues a job on the bus without waiting for it
  *
- * @param timeout_ms Timeout in milliseconds to wait for the mutex, if -1, wait indefinitely
- * @return true Lock acquired
- * @return false Lock not acquired
+ * @param client Device the job talks to
+ * @param run Job, run by the SPI task
+ * @param arg Argument of the job
+ * @return int 0 on success, -1 if the queue of the device is full
  */
-bool spi_mutex_lock(int timeout_ms)
+int spi_submit(spi_client_t client, spi_job_fn_t run, void *arg)
 {
-  const TickType_t timeout_ticks = (timeout_ms == -1) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-  return xSemaphoreTakeRecursive(h_spi_bus_mutex, timeout_ticks) == pdTRUE;
+  return spi_arbiter_submit(&h_spi_arbiter, client, run, arg);
 }
 
 /**
- * @brief Unlocks the SPI bus access mutex
+ * @brief Runs a job on the bus and waits until it is done
  *
+ * @param client Device the job talks to
+ * @param run Job, run by the SPI task
+ * @param arg Argument of the job
+ * @return int 0 once done, -1 if the queue of the device is full
+ */
+int spi_run(spi_client_t client, spi_job_fn_t run, void *arg)
+{
+  return spi_arbiter_run(&h_spi_arbiter, client, run, arg);
+}
+
+/**
+ * @brief Copies the histogram of the waits for the bus of a device
+ *
+ * @param client Device
+ * @param latency Output histogram, from queued to started
  * @return void
  */
-void spi_mutex_unlock(void)
+void spi_get_latency(spi_client_t client, server_latency_t *latency)
 {
-  xSemaphoreGiveRecursive(h_spi_bus_mutex);
+  spi_arbiter_get_latency(&h_spi_arbiter, client, latency);
 }
@@ -3,31 +3,52 @@
 
 #include <stdbool.h>
 
+#include "bus/spi_arbiter.h"
+
 /** General Config */
-#define MAX_SPI_TRANSFER_SIZE 160 * 80 * sizeof(uint16_t)
+
+/** A whole frame of the LCD, flushed in a single transfer with the full frame draw buffers */
+#define MAX_SPI_TRANSFER_SIZE (160 * 128 * sizeof(uint16_t))
+
+/** Task running the jobs of the bus, above the LVGL and UART tasks so that a queued flush starts at once */
+#define SPI_TASK_STACK_SIZE 4096U
+#define SPI_TASK_PRIORITY 3
 
 /** Prototypes */
 
 /**
- * @brief Init default board SPI bus using maximum transfer size needed by LVGL
+ * @brief Init default board SPI bus using maximum transfer size needed by LVGL, and starts its arbiter
  * @return void
  */
 void spi_init(void);
 
 /**
- * @brief Tries to lock the SPI bus access mutex
+ * @brief Queues a job on the bus without waiting for it
+ *
+ * @param client Device the job talks to
+ * @param run Job, run by the SPI task
+ * @param arg Argument of the job
+ * @return int 0 on success, -1 if the queue of the device is full
+ */
+int spi_submit(spi_client_t client, spi_job_fn_t run, void *arg);
+
+/**
+ * @brief Runs a job on the bus and waits until it is done
  *
- * @param timeout_ms Timeout in milliseconds to wait for the mutex, if -1, wait indefinitely
- * @return true Lock acquired
- * @return false Lock not acquired
+ * @param client Device the job talks to
+ * @param run Job, run by the SPI task
+ * @param arg Argument of the job
+ * @return int 0 once done, -1 if the queue of the device is full
  */
-bool spi_mutex_lock(int timeout_ms);
+int spi_run(spi_client_t client, spi_job_fn_t run, void *arg);
 
 /**
- * @brief Unlocks the SPI bus access mutex
+ * @brief Copies the histogram of the waits for the bus of a device
  *
+ * @param client Device
+ * @param latency Output histogram, from queued to started
  * @return void
  */
-void spi_mutex_unlock(void);
+void spi_get_latency(spi_client_t client, server_latency_t *latency);
 
 #endif /** !__BUS_SPI_H__ */
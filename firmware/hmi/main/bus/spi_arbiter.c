@@ -0,0 +1,206 @@
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "bus/spi_arbiter.h"
+
+/** Prototypes */
+static bool spi_arbiter_next(spi_arbiter_t *arbiter, spi_job_t *job, spi_client_t *client);
+static int spi_arbiter_queue(spi_arbiter_t *arbiter, spi_client_t client, spi_job_fn_t run, void *arg, bool signal);
+
+/**
+ * @brief Initializes an arbiter, the caller then starts its task on spi_arbiter_task(), the handle stored in task
+ *
+ * @param arbiter Arbiter
+ * @return void
+ */
+void spi_arbiter_init(spi_arbiter_t *arbiter)
+{
+  memset(arbiter, 0, sizeof(*arbiter));
+
+  arbiter->mutex = xSemaphoreCreateMutex();
+  assert(arbiter->mutex);
+
+  for (uint32_t client = 0U; client < SPI_CLIENT_COUNT; client++) {
+    arbiter->done[client] = xSemaphoreCreateBinary();
+    arbiter->caller[client] = xSemaphoreCreateMutex();
+    assert(arbiter->done[client] && arbiter->caller[client]);
+  }
+}
+
+/**
+ * @brief Runs the jobs as they are queued, never returns
+ *
+ * @param arg Arbiter
+ * @return void
+ */
+void spi_arbiter_task(void *arg)
+{
+  spi_arbiter_t *arbiter = (spi_arbiter_t *)arg;
+
+  while (1) {
+    while (spi_arbiter_run_next(arbiter)) {
+    }
+
+    /** Every queued job notifies the task, a notification taken here finds its job in the queues */
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+/**
+ * @brief Runs the next job, LCD first unless an SD job waited for SPI_ARBITER_LCD_BURST of them
+ *
+ * @param arbiter Arbiter
+ * @return true A job was run
+ * @return false No job waits
+ */
+bool spi_arbiter_run_next(spi_arbiter_t *arbiter)
+{
+  spi_job_t job;
+  spi_client_t client;
+
+  if (!spi_arbiter_next(arbiter, &job, &client)) {
+    return false;
+  }
+
+  const int64_t started_us = esp_timer_get_time();
+
+  xSemaphoreTake(arbiter->mutex, portMAX_DELAY);
+  server_latency_record(&arbiter->latency[client], (uint32_t)(started_us - job.queued_us));
+  xSemaphoreGive(arbiter->mutex);
+
+  job.run(job.arg);
+
+  if (job.signal) {
+    xSemaphoreGive(arbiter->done[client]);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Queues a job without waiting for it
+ *
+ * @param arbiter Arbiter
+ * @param client Device
+ * @param run Job
+ * @param arg Argument of the job
+ * @return int 0 on success, -1 if SPI_ARBITER_QUEUE_LENGTH jobs of the client are waiting already
+ */
+int spi_arbiter_submit(spi_arbiter_t *arbiter, spi_client_t client, spi_job_fn_t run, void *arg)
+{
+  return spi_arbiter_queue(arbiter, client, run, arg, false);
+}
+
+/**
+ * @brief Queues a job and waits until it is done
+ *
+ * @param arbiter Arbiter
+ * @param client Device
+ * @param run Job
+ * @param arg Argument of the job
+ * @return int 0 once done, -1 if the queue of the client stayed full
+ */
+int spi_arbiter_run(spi_arbiter_t *arbiter, spi_client_t client, spi_job_fn_t run, void *arg)
+{
+  xSemaphoreTake(arbiter->caller[client], portMAX_DELAY);
+
+  const int result = spi_arbiter_queue(arbiter, client, run, arg, true);
+  if (result == 0) {
+    xSemaphoreTake(arbiter->done[client], portMAX_DELAY);
+  }
+
+  xSemaphoreGive(arbiter->caller[client]);
+  return result;
+}
+
+/**
+ * @brief Copies the latency histogram of a client, from queued to started
+ *
+ * @param arbiter Arbiter
+ * @param client Device
+ * @param latency Output histogram
+ * @return void
+ */
+void spi_arbiter_get_latency(spi_arbiter_t *arbiter, spi_client_t client, server_latency_t *latency)
+{
+  xSemaphoreTake(arbiter->mutex, portMAX_DELAY);
+  *latency = arbiter->latency[client];
+  xSemaphoreGive(arbiter->mutex);
+}
+
+/** Implementations */
+
+/**
+ * @brief Takes the next job to run, LCD first unless an SD job waited for SPI_ARBITER_LCD_BURST of them
+ *
+ * @param arbiter Arbiter
+ * @param job Where the job is stored
+ * @param client Where the device of the job is stored
+ * @return true A job was taken
+ * @return false No job waits
+ */
+static bool spi_arbiter_next(spi_arbiter_t *arbiter, spi_job_t *job, spi_client_t *client)
+{
+  xSemaphoreTake(arbiter->mutex, portMAX_DELAY);
+
+  spi_client_t next = SPI_CLIENT_COUNT;
+  for (uint32_t i = 0U; i < SPI_CLIENT_COUNT && next == SPI_CLIENT_COUNT; i++) {
+    if (arbiter->count[i] > 0U) {
+      next = (spi_client_t)i;
+    }
+  }
+
+  /** An SD job that waited for a burst of LCD ones goes next */
+  if (next == SPI_CLIENT_LCD && arbiter->count[SPI_CLIENT_SD] > 0U) {
+    if (arbiter->lcd_burst >= SPI_ARBITER_LCD_BURST) {
+      next = SPI_CLIENT_SD;
+    }
+  }
+
+  if (next != SPI_CLIENT_COUNT) {
+    arbiter->lcd_burst = (next == SPI_CLIENT_LCD && arbiter->count[SPI_CLIENT_SD] > 0U) ? arbiter->lcd_burst + 1U : 0U;
+
+    *job = arbiter->jobs[next][arbiter->head[next]];
+    *client = next;
+    arbiter->head[next] = (arbiter->head[next] + 1U) % SPI_ARBITER_QUEUE_LENGTH;
+    arbiter->count[next]--;
+  }
+
+  xSemaphoreGive(arbiter->mutex);
+  return next != SPI_CLIENT_COUNT;
+}
+
+/**
+ * @brief Queues a job and wakes the arbiter task up
+ *
+ * @param arbiter Arbiter
+ * @param client Device
+ * @param run Job
+ * @param arg Argument of the job
+ * @param signal A caller waits for the job to be done
+ * @return int 0 on success, -1 if the queue of the client is full
+ */
+static int spi_arbiter_queue(spi_arbiter_t *arbiter, spi_client_t client, spi_job_fn_t run, void *arg, bool signal)
+{
+  xSemaphoreTake(arbiter->mutex, portMAX_DELAY);
+
+  if (arbiter->count[client] == SPI_ARBITER_QUEUE_LENGTH) {
+    xSemaphoreGive(arbiter->mutex);
+    return -1;
+  }
+
+  const uint32_t tail = (arbiter->head[client] + arbiter->count[client]) % SPI_ARBITER_QUEUE_LENGTH;
+  arbiter->jobs[client][tail] = (spi_job_t){
+    .run = run,
+    .arg = arg,
+    .queued_us = esp_timer_get_time(),
+    .signal = signal,
+  };
+  arbiter->count[client]++;
+
+  xSemaphoreGive(arbiter->mutex);
+
+  xTaskNotifyGive(arbiter->task);
+  return 0;
+}
@@ -0,0 +1,129 @@
+#ifndef __BUS_SPI_ARBITER_H__
+#define __BUS_SPI_ARBITER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "server/server.h"
+
+/**
+ * @brief Arbiter of the SPI bus shared by the LCD and the SD card.
+ *
+ * The devices don't lock the bus, they queue jobs that a single task runs one at a time: the bus is never held while a
+ * task waits for another lock. The LCD comes first: an LCD job waits for the job running when it is queued, and for
+ * one SD job at most. SD jobs wait for the LCD jobs, but for no more than SPI_ARBITER_LCD_BURST of them in a row, so
+ * that a busy display can't starve the SD card.
+ *
+ * The latencies are bounded by the jobs themselves: an LCD job only queues a DMA transfer, and an SD job reads a
+ * bounded chunk, so a long file is read by many jobs that the LCD jobs interleave with.
+ */
+
+/** Jobs waiting per client */
+#define SPI_ARBITER_QUEUE_LENGTH 4U
+
+/** LCD jobs run in a row at most while an SD job waits */
+#define SPI_ARBITER_LCD_BURST 4U
+
+/**
+ * @brief Devices of the bus, in priority order
+ */
+typedef enum spi_client
+{
+  SPI_CLIENT_LCD = 0U, /**< Display flushes, latency sensitive */
+  SPI_CLIENT_SD,       /**< SD card reads, in bounded chunks */
+  SPI_CLIENT_COUNT
+} spi_client_t;
+
+/**
+ * @brief Work on the bus, run by the arbiter task
+ *
+ * @param arg Argument given with the job
+ * @return void
+ */
+typedef void (*spi_job_fn_t)(void *arg);
+
+typedef struct spi_job
+{
+  spi_job_fn_t run;
+  void *arg;
+  int64_t queued_us; /**< Time the job was queued, for its latency */
+  bool signal;       /**< A caller waits for the job to be done */
+} spi_job_t;
+
+typedef struct spi_arbiter
+{
+  SemaphoreHandle_t mutex;                             /**< Protects the queues */
+  SemaphoreHandle_t done[SPI_CLIENT_COUNT];            /**< Given when a job a caller waits for is done */
+  SemaphoreHandle_t caller[SPI_CLIENT_COUNT];          /**< Serializes the callers waiting for their jobs */
+  TaskHandle_t task;                                   /**< Arbiter task, set by xTaskCreate() */
+  spi_job_t jobs[SPI_CLIENT_COUNT][SPI_ARBITER_QUEUE_LENGTH];
+  uint32_t head[SPI_CLIENT_COUNT];
+  uint32_t count[SPI_CLIENT_COUNT];
+  uint32_t lcd_burst;                                  /**< LCD jobs run in a row while an SD job waits */
+  server_latency_t latency[SPI_CLIENT_COUNT];          /**< Queued to started, per client */
+} spi_arbiter_t;
+
+/** Prototypes */
+
+/**
+ * @brief Initializes an arbiter, the caller then starts its task on spi_arbiter_task(), the handle stored in task
+ *
+ * @param arbiter Arbiter
+ * @return void
+ */
+void spi_arbiter_init(spi_arbiter_t *arbiter);
+
+/**
+ * @brief Runs the jobs as they are queued, never returns
+ *
+ * @param arg Arbiter
+ * @return void
+ */
+void spi_arbiter_task(void *arg);
+
+/**
+ * @brief Queues a job without waiting for it
+ *
+ * @param arbiter Arbiter
+ * @param client Device
+ * @param run Job
+ * @param arg Argument of the job
+ * @return int 0 on success, -1 if SPI_ARBITER_QUEUE_LENGTH jobs of the client are waiting already
+ */
+int spi_arbiter_submit(spi_arbiter_t *arbiter, spi_client_t client, spi_job_fn_t run, void *arg);
+
+/**
+ * @brief Queues a job and waits until it is done
+ *
+ * @param arbiter Arbiter
+ * @param client Device
+ * @param run Job
+ * @param arg Argument of the job
+ * @return int 0 once done, -1 if the queue of the client stayed full
+ */
+int spi_arbiter_run(spi_arbiter_t *arbiter, spi_client_t client, spi_job_fn_t run, void *arg);
+
+/**
+ * @brief Runs the next job, LCD first unless an SD job waited for SPI_ARBITER_LCD_BURST of them
+ *
+ * @param arbiter Arbiter
+ * @return true A job was run
+ * @return false No job waits
+ */
+bool spi_arbiter_run_next(spi_arbiter_t *arbiter);
+
+/**
+ * @brief Copies the latency histogram of a client, from queued to started
+ *
+ * @param arbiter Arbiter
+ * @param client Device
+ * @param latency Output histogram
+ * @return void
+ */
+void spi_arbiter_get_latency(spi_arbiter_t *arbiter, spi_client_t client, server_latency_t *latency);
+
+#endif /** !__BUS_SPI_ARBITER_H__ */
@@ -0,0 +1,85 @@
+#include "bus/topic.h"
+
+/**
+ * @brief Notifies a task of every publication from now on
+ *
+ * @param topic Topic
+ * @param task Task
+ * @return int 0 on success, -1 if TOPIC_SUBSCRIBERS_MAX tasks are subscribed already
+ */
+int topic_subscribe(topic_t *topic, TaskHandle_t task)
+{
+  /** Slots are claimed one at a time, the publisher never waits for a subscription */
+  for (uint32_t i = 0U; i < TOPIC_SUBSCRIBERS_MAX; i++) {
+    TaskHandle_t free_slot = NULL;
+    if (__atomic_compare_exchange_n(&topic->subscribers[i], &free_slot, task, false, __ATOMIC_RELEASE,
+                                    __ATOMIC_RELAXED)) {
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * @brief Publishes a new snapshot and notifies the subscribers
+ *
+ * @param topic Topic
+ * @param data Snapshot
+ * @return uint32_t Version of the snapshot
+ */
+uint32_t topic_publish(topic_t *topic, const void *data)
+{
+  vTaskSuspendAll();
+  seqlock_write(&topic->lock, topic->data, data, topic->size);
+  (void)xTaskResumeAll();
+
+  for (uint32_t i = 0U; i < TOPIC_SUBSCRIBERS_MAX; i++) {
+    TaskHandle_t task = __atomic_load_n(&topic->subscribers[i], __ATOMIC_ACQUIRE);
+    if (task != NULL) {
+      xTaskNotify(task, topic->bit, eSetBits);
+    }
+  }
+
+  return topic_version(topic);
+}
+
+/**
+ * @brief Copies the last snapshot
+ *
+ * @param topic Topic
+ * @param data Where the snapshot is stored
+ * @return uint32_t Version of the snapshot, 0 if never published
+ */
+uint32_t topic_read(const topic_t *topic, void *data)
+{
+  return seqlock_read(&topic->lock, topic->data, data, topic->size);
+}
+
+/**
+ * @brief Version of the last snapshot, to skip a copy when nothing changed
+ *
+ * @param topic Topic
+ * @return uint32_t Version, 0 if never published
+ */
+uint32_t topic_version(const topic_t *topic)
+{
+  return __atomic_load_n(&topic->lock.sequence, __ATOMIC_ACQUIRE) / 2U;
+}
+
+/**
+ * @brief Waits for a publication of the topics the calling task is subscribed to
+ *
+ * @param timeout_ms Maximum wait
+ * @return uint32_t Notification bits of the topics published since the last wait, 0 on timeout
+ */
+uint32_t topic_wait(uint32_t timeout_ms)
+{
+  uint32_t bits = 0U;
+
+  if (xTaskNotifyWait(0U, UINT32_MAX, &bits, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+    return 0U;
+  }
+
+  return bits;
+}
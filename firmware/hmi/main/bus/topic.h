@@ -0,0 +1,93 @@
+#ifndef __BUS_TOPIC_H__
+#define __BUS_TOPIC_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "bus/seqlock.h"
+
+/**
+ * @brief Publish/subscribe of the panel state between its tasks.
+ *
+ * A topic holds the last snapshot of a struct, published whole so that its fields always go together, and versioned:
+ * the version counts the publications, 0 before the first one. Readers copy it without taking any lock, through a
+ * seqlock. The tasks subscribed to a topic get its notification bit set in their notification value on every
+ * publication, and wait on several topics at once with topic_wait().
+ *
+ * Publications of one topic must be serialized by the caller. The scheduler of the publishing core is suspended for
+ * the copy, so that a reader of higher priority can't spin on a half written snapshot.
+ */
+
+/** Tasks notified by a topic */
+#define TOPIC_SUBSCRIBERS_MAX 4U
+
+/** Notification bits of the panel topics */
+#define TOPIC_BIT_MEASUREMENT (1U << 0U)
+#define TOPIC_BIT_CONTROL (1U << 1U)
+#define TOPIC_BIT_STREAM (1U << 2U)
+
+typedef struct topic
+{
+  seqlock_t lock;
+  void *data;                                     /**< Snapshot, owned by the topic */
+  uint32_t size;                                  /**< Snapshot size */
+  uint32_t bit;                                   /**< Notification bit, TOPIC_BIT_* */
+  TaskHandle_t subscribers[TOPIC_SUBSCRIBERS_MAX]; /**< Slots, NULL when free */
+} topic_t;
+
+/**
+ * @brief Static initializer of a topic, so that tasks can subscribe whatever the order modules start in
+ *
+ * @param storage Variable holding the snapshot, with its initial value
+ * @param topic_bit Notification bit, TOPIC_BIT_*
+ */
+#define TOPIC_INITIALIZER(storage, topic_bit) \
+  { .lock = { 0U }, .data = &(storage), .size = sizeof(storage), .bit = (topic_bit), .subscribers = { NULL } }
+
+/**
+ * @brief Notifies a task of every publication from now on
+ *
+ * @param topic Topic
+ * @param task Task
+ * @return int 0 on success, -1 if TOPIC_SUBSCRIBERS_MAX tasks are subscribed already
+ */
+int topic_subscribe(topic_t *topic, TaskHandle_t task);
+
+/**
+ * @brief Publishes a new snapshot and notifies the subscribers
+ *
+ * @param topic Topic
+ * @param data Snapshot
+ * @return uint32_t Version of the snapshot
+ */
+uint32_t topic_publish(topic_t *topic, const void *data);
+
+/**
+ * @brief Copies the last snapshot
+ *
+ * @param topic Topic
+ * @param data Where the snapshot is stored
+ * @return uint32_t Version of the snapshot, 0 if never published
+ */
+uint32_t topic_read(const topic_t *topic, void *data);
+
+/**
+ * @brief Version of the last snapshot, to skip a copy when nothing changed
+ *
+ * @param topic Topic
+ * @return uint32_t Version, 0 if never published
+ */
+uint32_t topic_version(const topic_t *topic);
+
+/**
+ * @brief Waits for a publication of the topics the calling task is subscribed to
+ *
+ * @param timeout_ms Maximum wait
+ * @return uint32_t Notification bits of the topics published since the last wait, 0 on timeout
+ */
+uint32_t topic_wait(uint32_t timeout_ms);
+
+#endif /** !__BUS_TOPIC_H__ */
@@ -6,8 +6,12 @@
 #include "freertos/task.h"
 
 #include "driver/gpio.h"
+#include "esp_timer.h"
 
 #include "bus/uart.h"
+#include "bus/frame_decoder.h"
+#include "bus/topic.h"
+#include "server/scpi.h"
 #include "common.h"
 #include "control/load.h"
 #include "utils.h"
@@ -17,15 +21,60 @@
 #define MODULE_NAME "bus.uart"
 
 /**  Handlers */
-uint8_t h_uart_tx_buffer[TX_MSG_SIZE];
-uint8_t h_uart_rx_buffer[RX_MSG_SIZE];
+uint8_t h_uart_tx_buffer[SERVER_FRAME_SIZE_MAX];
+
+/** Last measurement received from the load, the RX task is its only publisher */
+static load_measurement_t uart_measurement;
+topic_t h_topic_measurement = TOPIC_INITIALIZER(uart_measurement, TOPIC_BIT_MEASUREMENT);
 
 static QueueHandle_t uart_rx_event_queue;
+
+/** Received bytes, the driver ring is drained straight into it */
+static frame_decoder_t uart_decoder;
+
+/** Copy of the RX task, the reference of the deltas */
+static load_measurement_t uart_rx_measurement;
+
+/** Text commands, parsed in place in the decoder ring, outside of the frames */
+static scpi_stream_t uart_text_stream;
+static char uart_text_response[SCPI_RESPONSE_MAX];
 SemaphoreHandle_t h_uart_bus_mutex;
 
+/** Commands in flight, guarded by the bus mutex */
+typedef struct uart_command
+{
+  load_command_t command;
+  int64_t sent_us;
+  uint8_t retries;
+  bool pending;
+} uart_command_t;
+
+static uart_command_t uart_commands[UART_COMMANDS_PENDING];
+static uint16_t uart_command_id = 0U;
+static uint32_t uart_command_timeouts = 0U;
+static server_latency_t uart_round_trip_latency;
+static server_latency_t uart_apply_latency;
+
 /** Forward Decl */
 static void uart_rx_task(void *pvParameters);
 static void uart_tx_task(void *pvParameters);
+static void uart_handle_frame(const server_frame_t *frame, void *context);
+static void uart_handle_measurement(const server_frame_t *frame);
+static void uart_write_command(uart_command_t *entry);
+static void uart_handle_ack(const server_frame_t *frame);
+static void uart_retry_commands(void);
+static void uart_handle_text(const uint8_t *data, uint32_t length, void *context);
+static void uart_text_on_request(const scpi_request_t *request);
+static void uart_scpi_get_control(load_control_t *control);
+static void uart_scpi_get_measurement(load_measurement_t *measurement);
+
+/** The panel side of the text commands, settings go through the load screen */
+static const scpi_target_t uart_scpi_target = {
+  .identification = "Simple Electronic Load,Panel",
+  .get_control = uart_scpi_get_control,
+  .get_measurement = uart_scpi_get_measurement,
+  .set = load_apply_command,
+};
 
 /**
  * @brief Init default board UART settings
@@ -44,13 +93,17 @@ void uart_init(void)
     .source_clk = UART_SCLK_DEFAULT,
   };
 
-  ESP_ERROR_CHECK(uart_driver_install(UART_NUM, 256U, 256U, UART_MAX_RX_EVENT, &uart_rx_event_queue, 0));
+  ESP_ERROR_CHECK(uart_driver_install(UART_NUM, UART_RX_DRIVER_SIZE, 256U, UART_MAX_RX_EVENT, &uart_rx_event_queue, 0));
   ESP_ERROR_CHECK(uart_param_config(UART_NUM, &uart_config));
 
   ESP_ERROR_CHECK(uart_set_pin(UART_NUM, GPIO_UART_TX, GPIO_UART_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
-  ESP_ERROR_CHECK(uart_enable_pattern_det_baud_intr(UART_NUM, (char)(RX_MAGIC_WORD >> 24U), sizeof(RX_MAGIC_WORD), 9, 0, 0));
-  ESP_ERROR_CHECK(uart_pattern_queue_reset(UART_NUM, UART_MAX_RX_EVENT));
+  scpi_stream_init(&uart_text_stream, &uart_text_on_request);
+  frame_decoder_init(&uart_decoder, uart_handle_frame, uart_handle_text, NULL);
+
+  /** Serializes the frame encoder and the writes of the tasks sending to the load */
+  h_uart_bus_mutex = xSemaphoreCreateRecursiveMutex();
+  assert(h_uart_bus_mutex);
 
   xTaskCreate(uart_rx_task, "uart_rx_task", UART_TASK_STACK_SIZE, NULL, 2, NULL);
   xTaskCreate(uart_tx_task, "uart_tx_task", UART_TASK_STACK_SIZE, NULL, 2, NULL);
@@ -68,17 +121,27 @@ static void uart_rx_task(void *pvParameters)
         case UART_BUFFER_FULL:
           uart_flush_input(UART_NUM);
           xQueueReset(uart_rx_event_queue);
+          /** A frame or a command cut by the lost bytes must not run into the next one */
+          frame_decoder_reset(&uart_decoder);
+          scpi_stream_reset(&uart_text_stream);
           break;
-        case UART_PATTERN_DET:
-          int pos = uart_pattern_pop_pos(UART_NUM);
-          if (pos != -1) {
-            /** Break the checksum to avoid trash */
-            h_uart_rx_buffer[RX_MSG_SIZE - 1] = 0U;
-            uart_read_bytes(UART_NUM, h_uart_rx_buffer + pos, RX_MSG_SIZE, UART_TASK_DELAY / portTICK_PERIOD_MS);
-            rx_data(h_uart_rx_buffer, &(h_load_state.measurement));
+        case UART_DATA:
+        {
+          /** Everything buffered by the driver, the events that follow find it drained */
+          size_t buffered = 0U;
+          uart_get_buffered_data_len(UART_NUM, &buffered);
+          while (buffered > 0U) {
+            uint32_t room;
+            uint8_t *space = frame_decoder_space(&uart_decoder, &room);
+            const int read = uart_read_bytes(UART_NUM, space, buffered < room ? buffered : room, 0);
+            if (read <= 0) {
+              break;
+            }
+            frame_decoder_commit(&uart_decoder, (uint32_t)read);
+            buffered -= (size_t)read;
           }
-          uart_flush_input(UART_NUM);
           break;
+        }
         default:
             break;
         }
@@ -91,11 +154,256 @@ static void uart_tx_task(void *pvParameters)
 {
   while (1)
   {
-    tx_data(&(h_load_state.control), h_uart_tx_buffer);
-    uart_write_bytes(UART_NUM, h_uart_tx_buffer, TX_MSG_SIZE);
+    /** Unchanged settings go as an empty delta, the period can be short */
+    load_control_t control;
+    topic_read(&h_topic_control, &control);
+
+    uart_mutex_lock(-1);
+    const uint32_t size = tx_data(&control, h_uart_tx_buffer);
+    uart_write_bytes(UART_NUM, h_uart_tx_buffer, size);
+    uart_retry_commands();
+    uart_mutex_unlock();
+
+    vTaskDelay(UART_TX_PERIOD_MS / portTICK_PERIOD_MS);
+  }
+}
+
+/**
+ * @brief Sends a waveform player command to the load
+ *
+ * @param waveform Waveform command
+ * @return void
+ */
+void uart_send_waveform(load_waveform_t *waveform)
+{
+  /** Frames share the sequence counter and the buffer with the control ones */
+  uart_mutex_lock(-1);
+  const uint32_t size = tx_waveform(waveform, h_uart_tx_buffer);
+  uart_write_bytes(UART_NUM, h_uart_tx_buffer, size);
+  uart_mutex_unlock();
+}
+
+/**
+ * @brief Sends a setting change to the load right away, the load acknowledges it on its next control period
+ *
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @return void
+ */
+void uart_send_command(load_command_key_t key, uint32_t value)
+{
+  uart_mutex_lock(-1);
+
+  /** A newer change of the same setting supersedes the pending one */
+  uart_command_t *entry = NULL;
+  for (uint32_t i = 0U; i < UART_COMMANDS_PENDING && entry == NULL; i++) {
+    if (uart_commands[i].pending && uart_commands[i].command.key == key) {
+      entry = &uart_commands[i];
+    }
+  }
 
-    vTaskDelay(UART_TASK_DELAY / portTICK_PERIOD_MS);
+  /** Otherwise a free entry, or the oldest one gives way */
+  if (entry == NULL) {
+    entry = &uart_commands[0];
+    for (uint32_t i = 0U; i < UART_COMMANDS_PENDING && entry->pending; i++) {
+      if (!uart_commands[i].pending || uart_commands[i].sent_us < entry->sent_us) {
+        entry = &uart_commands[i];
+      }
+    }
+  }
+
+  entry->command.id = uart_command_id++;
+  entry->command.key = (uint8_t)key;
+  entry->command.flags = 0U;
+  entry->command.value = value;
+  entry->retries = 0U;
+  entry->pending = true;
+  uart_write_command(entry);
+
+  uart_mutex_unlock();
+}
+
+/**
+ * @brief Copies the command latency histograms
+ *
+ * @param round_trip Command sent to acknowledgement received, may be NULL
+ * @param apply Command received to applied, as reported by the load, may be NULL
+ * @return uint32_t Commands given up after UART_COMMAND_RETRIES retries
+ */
+uint32_t uart_get_command_latency(server_latency_t *round_trip, server_latency_t *apply)
+{
+  uart_mutex_lock(-1);
+  if (round_trip != NULL) {
+    *round_trip = uart_round_trip_latency;
   }
+  if (apply != NULL) {
+    *apply = uart_apply_latency;
+  }
+  const uint32_t timeouts = uart_command_timeouts;
+  uart_mutex_unlock();
+
+  return timeouts;
+}
+
+/**
+ * @brief Writes a pending command, must be called with the bus mutex held
+ *
+ * @param entry Command
+ * @return void
+ */
+static void uart_write_command(uart_command_t *entry)
+{
+  const uint32_t size = tx_command(&(entry->command), h_uart_tx_buffer);
+  uart_write_bytes(UART_NUM, h_uart_tx_buffer, size);
+  entry->sent_us = esp_timer_get_time();
+}
+
+/**
+ * @brief Dispatches a frame decoded by the RX task
+ *
+ * @param frame Frame located in the decoder ring
+ * @param context Unused
+ * @return void
+ */
+static void uart_handle_frame(const server_frame_t *frame, void *context)
+{
+  switch (server_frame_type(frame)) {
+    case SERVER_MSG_ACK:
+      uart_handle_ack(frame);
+      break;
+    case SERVER_MSG_MEASUREMENT:
+    case SERVER_MSG_MEASUREMENT_DELTA:
+      uart_handle_measurement(frame);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Applies a measurement frame on the last measurement and publishes it
+ *
+ * @param frame Measurement frame
+ * @return void
+ */
+static void uart_handle_measurement(const server_frame_t *frame)
+{
+  if (rx_data(frame, &uart_rx_measurement) < 0) {
+    return;
+  }
+
+  topic_publish(&h_topic_measurement, &uart_rx_measurement);
+}
+
+/**
+ * @brief Completes the pending command an acknowledgement answers
+ *
+ * @param frame Acknowledgement frame
+ * @return void
+ */
+static void uart_handle_ack(const server_frame_t *frame)
+{
+  load_ack_t ack;
+  if (rx_ack(frame, &ack) < 0) {
+    return;
+  }
+
+  uart_mutex_lock(-1);
+  for (uint32_t i = 0U; i < UART_COMMANDS_PENDING; i++) {
+    uart_command_t *entry = &uart_commands[i];
+    if (!entry->pending || entry->command.id != ack.id) {
+      continue;
+    }
+
+    entry->pending = false;
+    server_latency_record(&uart_round_trip_latency, (uint32_t)(esp_timer_get_time() - entry->sent_us));
+    server_latency_record(&uart_apply_latency, ack.latency_us);
+
+    if (ack.status == ACK_REJECTED) {
+      ESP_LOGW(MODULE_NAME, "Command %u rejected by the load", (unsigned)ack.key);
+    }
+    break;
+  }
+  uart_mutex_unlock();
+}
+
+/**
+ * @brief Sends again the commands left without acknowledgement, must be called with the bus mutex held
+ *
+ * @return void
+ */
+static void uart_retry_commands(void)
+{
+  const int64_t now = esp_timer_get_time();
+
+  for (uint32_t i = 0U; i < UART_COMMANDS_PENDING; i++) {
+    uart_command_t *entry = &uart_commands[i];
+    if (!entry->pending || now - entry->sent_us < (int64_t)UART_COMMAND_TIMEOUT_MS * 1000) {
+      continue;
+    }
+
+    /** The state frames still carry the setting, giving up only loses the acknowledgement */
+    if (entry->retries >= UART_COMMAND_RETRIES) {
+      entry->pending = false;
+      uart_command_timeouts++;
+      continue;
+    }
+
+    entry->retries++;
+    uart_write_command(entry);
+  }
+}
+
+/**
+ * @brief Parses a run of text bytes where they lie in the decoder ring
+ *
+ * @param data First byte
+ * @param length Bytes in the run
+ * @param context Unused
+ * @return void
+ */
+static void uart_handle_text(const uint8_t *data, uint32_t length, void *context)
+{
+  scpi_stream_feed(&uart_text_stream, (const char *)data, length);
+}
+
+/**
+ * @brief Executes a complete text command and answers queries, called by the stream
+ *
+ * @param request Command matched
+ * @return void
+ */
+static void uart_text_on_request(const scpi_request_t *request)
+{
+  /** Sets and rejected commands are not answered */
+  const int length = scpi_request_execute(&uart_scpi_target, request, uart_text_response, sizeof(uart_text_response));
+  if (length > 0) {
+    uart_mutex_lock(-1);
+    uart_write_bytes(UART_NUM, uart_text_response, (size_t)length);
+    uart_mutex_unlock();
+  }
+}
+
+/**
+ * @brief Settings of the panel, for the text commands
+ *
+ * @param control Output settings
+ * @return void
+ */
+static void uart_scpi_get_control(load_control_t *control)
+{
+  topic_read(&h_topic_control, control);
+}
+
+/**
+ * @brief Last measurement received from the load, for the text commands
+ *
+ * @param measurement Output measurement
+ * @return void
+ */
+static void uart_scpi_get_measurement(load_measurement_t *measurement)
+{
+  topic_read(&h_topic_measurement, measurement);
 }
 
 /**
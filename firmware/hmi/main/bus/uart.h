@@ -3,14 +3,29 @@
 
 #include "driver/uart.h"
 
+#include "bus/topic.h"
+#include "server/server.h"
+
 /** General Config */
 
-#define UART_BAUD_RATE 115200U
+#define UART_BAUD_RATE 1000000U
 #define UART_NUM UART_NUM_0
 #define UART_MAX_RX_EVENT 5U
 
 #define UART_TASK_STACK_SIZE 2048U
-#define UART_TASK_DELAY 200U
+#define UART_TX_PERIOD_MS 50U
+/** Driver RX ring, 20 ms of data at the baud rate so that a busy RX task loses nothing */
+#define UART_RX_DRIVER_SIZE 2048U
+
+/** Commands waiting for their acknowledgement, retried after the timeout */
+#define UART_COMMANDS_PENDING 8U
+#define UART_COMMAND_TIMEOUT_MS 50U
+#define UART_COMMAND_RETRIES 3U
+
+/** Handlers */
+
+/** Last measurement received from the load, load_measurement_t */
+extern topic_t h_topic_measurement;
 
 /** Prototypes */
 
@@ -20,6 +35,32 @@
  */
 void uart_init(void);
 
+/**
+ * @brief Sends a waveform player command to the load
+ *
+ * @param waveform Waveform command
+ * @return void
+ */
+void uart_send_waveform(load_waveform_t *waveform);
+
+/**
+ * @brief Sends a setting change to the load right away, the load acknowledges it on its next control period
+ *
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @return void
+ */
+void uart_send_command(load_command_key_t key, uint32_t value);
+
+/**
+ * @brief Copies the command latency histograms
+ *
+ * @param round_trip Command sent to acknowledgement received, may be NULL
+ * @param apply Command received to applied, as reported by the load, may be NULL
+ * @return uint32_t Commands given up after UART_COMMAND_RETRIES retries
+ */
+uint32_t uart_get_command_latency(server_latency_t *round_trip, server_latency_t *apply);
+
 /**
  * @brief Tries to lock the UART bus access mutex
  *
@@ -4,6 +4,7 @@
 #include "utils.h"
 
 #include "bus/spi.h"
+#include "bus/uart.h"
 
 #include "control/load.h"
 #include "control/menu.h"
@@ -22,21 +23,23 @@
 
 #define MODULE_NAME "control.load"
 
-/** Control state handler */
-load_state_t h_load_state = {0};
+/** Settings of the panel, edited by the tasks holding the LVGL mutex and published after every change */
+static load_control_t load_control = {0};
+static load_control_t load_control_snapshot = {0};
+topic_t h_topic_control = TOPIC_INITIALIZER(load_control_snapshot, TOPIC_BIT_CONTROL);
 
 /** Globals */
 bool h_control_load_active = true;
-bool h_control_enable_active = true;
 
 static int pulse_counter = 0;
-uint32_t *actual_set_point = &(h_load_state.control.cc.value_milli);
+uint32_t *actual_set_point = &(load_control.cc.value_milli);
 
 /** Prototypes */
 
 static void reload_setpoint_to_encoder(void);
 static void update_enabled_status(void);
 static void update_setpoint_multiplier(void);
+static void publish_control(void);
 static void apply_pending_irq(void);
 static void update_led_ui_status(void);
 static void update_encoder_steps(void);
@@ -85,8 +88,81 @@ void load_prepare(void)
   h_control_load_active = true;
 }
 
+/**
+ * @brief Applies a setting as the front panel controls do, and sends it to the load
+ *
+ * @param command Setting
+ * @return int 0 on success, -1 if the setting is invalid
+ */
+int load_apply_command(const load_command_t *command)
+{
+  if (command->key >= COMMAND_KEY_COUNT ||
+      (command->key == COMMAND_ENABLE && command->value > 1U) ||
+      (command->key == COMMAND_MODE && command->value > (uint32_t)CP)) {
+    return -1;
+  }
+
+  set_point_t *set_points = &(load_control.cc);
+
+  lvgl_mutex_lock(-1);
+  switch (command->key) {
+    case COMMAND_ENABLE:
+      load_control.enable = command->value;
+      update_led_ui_status();
+      break;
+    case COMMAND_MODE:
+      load_control.mode = (load_mode_t)command->value;
+      actual_set_point = &(set_points[command->value].value_milli);
+      reload_setpoint_to_encoder();
+      break;
+    default:
+      set_points[command->key - COMMAND_CC].value_milli = command->value;
+      /** The spinbox edits the set point of the mode in use */
+      if ((uint32_t)(command->key - COMMAND_CC) == (uint32_t)load_control.mode) {
+        reload_setpoint_to_encoder();
+      }
+      break;
+  }
+  publish_control();
+  lvgl_mutex_unlock();
+
+  uart_send_command((load_command_key_t)command->key, command->value);
+  return 0;
+}
+
+/**
+ * @brief Name of an operating mode, as the screens show it
+ *
+ * @param mode Operating mode
+ * @return const char* Static text, NULL for no mode
+ */
+const char *load_mode_text(load_mode_t mode)
+{
+  switch (mode) {
+    case CC:
+      return "CC";
+    case CV:
+      return "CV";
+    case CR:
+      return "CR";
+    case CP:
+      return "CP";
+    default:
+      return NULL;
+  }
+}
+
 /** Implementations */
 
+/**
+ * @brief Publishes the settings after a change, the caller holds the LVGL mutex
+ * @return void
+ */
+static void publish_control(void)
+{
+  topic_publish(&h_topic_control, &load_control);
+}
+
 static void reload_setpoint_to_encoder(void)
 {
   pulse_counter = 0;
@@ -95,17 +171,19 @@ static void reload_setpoint_to_encoder(void)
 
 static void update_led_ui_status(void)
 {
-  if (h_load_state.control.enable) {
+  if (load_control.enable) {
     lv_led_on(h_led_enable);
   } else {
     lv_led_off(h_led_enable);
   }
-  set_led_enable(h_load_state.control.enable);
+  set_led_enable(load_control.enable);
 }
 
 static void update_enabled_status(void)
 {
-  h_load_state.control.enable = !h_load_state.control.enable;
+  load_control.enable = !load_control.enable;
+  publish_control();
+  uart_send_command(COMMAND_ENABLE, load_control.enable);
   update_led_ui_status();
 }
 
@@ -120,31 +198,33 @@ static void update_setpoint_multiplier(void)
 
 static void apply_pending_irq(void)
 {
-  const load_mode_t current_mode = h_load_state.control.mode;
+  const load_mode_t current_mode = load_control.mode;
 
   if (h_pending_button_cc) {
-    h_load_state.control.mode = CC;
-    actual_set_point = &(h_load_state.control.cc.value_milli);
+    load_control.mode = CC;
+    actual_set_point = &(load_control.cc.value_milli);
     h_pending_button_cc = false;
   }
   if (h_pending_button_cv) {
-    h_load_state.control.mode = CV;
-    actual_set_point = &(h_load_state.control.cv.value_milli);
+    load_control.mode = CV;
+    actual_set_point = &(load_control.cv.value_milli);
     h_pending_button_cv = false;
   }
   if (h_pending_button_cp) {
-    h_load_state.control.mode = CP;
-    actual_set_point = &(h_load_state.control.cp.value_milli);
+    load_control.mode = CP;
+    actual_set_point = &(load_control.cp.value_milli);
     h_pending_button_cp = false;
   }
   if (h_pending_button_cr) {
-    h_load_state.control.mode = CR;
-    actual_set_point = &(h_load_state.control.cr.value_milli);
+    load_control.mode = CR;
+    actual_set_point = &(load_control.cr.value_milli);
     h_pending_button_cr = false;
   }
 
   /** Case of change reload set point to encoder */
-  if (current_mode != h_load_state.control.mode) {
+  if (current_mode != load_control.mode) {
+    publish_control();
+    uart_send_command(COMMAND_MODE, (uint32_t)load_control.mode);
     reload_setpoint_to_encoder();
   }
 
@@ -169,36 +249,18 @@ static void update_encoder_steps(void)
 
 static void update_load_state(void)
 {
-  lv_spinbox_set_value(
-    h_value_current_spinbox, h_load_state.measurement.cc_milli / 100U
-  );
-  lv_spinbox_set_value(
-    h_value_voltage_spinbox, h_load_state.measurement.cv_milli / 100U
-  );
-  lv_spinbox_set_value(
-    h_value_resistance_spinbox, h_load_state.measurement.cr_milli / 100U
-  );
-  lv_spinbox_set_value(
-    h_value_power_spinbox, h_load_state.measurement.cp_milli / 100U
-  );
-
-  switch (h_load_state.control.mode)
-  {
-  case CC:
-    lv_label_set_text(h_value_mode_label, "CC");
-    break;
-  case CV:
-    lv_label_set_text(h_value_mode_label, "CV");
-    break;
-  case CR:
-    lv_label_set_text(h_value_mode_label, "CR");
-    break;
-  case CP:
-    lv_label_set_text(h_value_mode_label, "CP");
-    break;
-  default:
-    break;
-  }
+  load_measurement_t measurement;
+  topic_read(&h_topic_measurement, &measurement);
+
+  /** Only the widgets whose text changes get redrawn */
+  const ui_index_view_t view = {
+    .current = (int32_t)(measurement.cc_milli / 100U),
+    .voltage = (int32_t)(measurement.cv_milli / 100U),
+    .resistance = (int32_t)(measurement.cr_milli / 100U),
+    .power = (int32_t)(measurement.cp_milli / 100U),
+    .mode = load_mode_text(load_control.mode),
+  };
+  ui_index_view_apply(&view);
 }
 
 static void control_load_loop()
@@ -214,8 +276,13 @@ static void control_load_loop()
 
   update_load_state();
 
-  /** Updates the control point */
-  *actual_set_point = (uint32_t)lv_spinbox_get_value(h_value_spinbox);
+  /** Updates the control point, a change goes to the load right away */
+  const uint32_t set_point = (uint32_t)lv_spinbox_get_value(h_value_spinbox);
+  if (set_point != *actual_set_point) {
+    *actual_set_point = set_point;
+    publish_control();
+    uart_send_command((load_command_key_t)(COMMAND_CC + load_control.mode), set_point);
+  }
 }
 
 static void check_screen_switch(void)
@@ -236,9 +303,13 @@ static void check_screen_switch(void)
 
 static void enable_task(void *pvParameters)
 {
+  stream_state_t stream;
+
   while (1)
   {
-    if (h_control_enable_active)
+    /** The enable button belongs to the stream screen while it plays */
+    topic_read(&h_topic_stream, &stream);
+    if (!stream.active)
     {
       /** For enable trick detection */
       button_en_update();
@@ -255,6 +326,9 @@ static void enable_task(void *pvParameters)
 
 static void load_task(void *pvParameters)
 {
+  /** New measurements show up at once, the period bounds the wait for the encoder */
+  topic_subscribe(&h_topic_measurement, xTaskGetCurrentTaskHandle());
+
   while (1)
   {
     /** Only run this task if activated */
@@ -270,6 +344,6 @@ static void load_task(void *pvParameters)
         lvgl_mutex_unlock();
       }
     }
-    vTaskDelay(pdMS_TO_TICKS(LOAD_TASK_DELAY));
+    topic_wait(LOAD_TASK_DELAY);
   }
 }
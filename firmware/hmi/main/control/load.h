@@ -1,6 +1,7 @@
 #ifndef __CONTROL_LOAD_H__
 #define __CONTROL_LOAD_H__
 
+#include "bus/topic.h"
 #include "server/server.h"
 
 /** General Config */
@@ -8,10 +9,9 @@
 #define LOAD_TASK_DELAY 100U
 
 /** Handlers */
-extern load_state_t h_load_state;
 
-/** Use with caution to block enable check loop */
-extern bool h_control_enable_active;
+/** Settings of the panel, load_control_t */
+extern topic_t h_topic_control;
 
 /** Prototypes */
 
@@ -27,4 +27,20 @@ void load_init(void);
  */
 void load_prepare(void);
 
+/**
+ * @brief Applies a setting as the front panel controls do, and sends it to the load
+ *
+ * @param command Setting
+ * @return int 0 on success, -1 if the setting is invalid
+ */
+int load_apply_command(const load_command_t *command);
+
+/**
+ * @brief Name of an operating mode, as the screens show it
+ *
+ * @param mode Operating mode
+ * @return const char* Static text, NULL for no mode
+ */
+const char *load_mode_text(load_mode_t mode);
+
 #endif /** !__CONTROL_LOAD_H__ */
@@ -1,9 +1,11 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "common.h"
 #include "utils.h"
 
 #include "bus/spi.h"
+#include "bus/uart.h"
 
 #include "control/load.h"
 #include "control/menu.h"
@@ -26,21 +28,41 @@
 /** Handlers */
 bool h_control_stream_active = false;
 
+/** Playback, published by the task holding the LVGL mutex */
+static stream_state_t stream_state_snapshot = {0};
+topic_t h_topic_stream = TOPIC_INITIALIZER(stream_state_snapshot, TOPIC_BIT_STREAM);
+
 /** Globals */
 bool msg_opened = false;
 unsigned long opened_msg_time = 0;
 
-load_mode_t h_target_mode = NONE;
-uint32_t h_target_point = 0;
 uint32_t h_target_delay = 0;
 
-uint32_t h_stream_mode = 0;
+load_mode_t h_stream_mode = NONE;
 
 uint32_t h_target_chart_point = 0;
 
-bool h_stream_complete = false;
 FILE *h_stream_file = NULL;
 
+/** Points uploaded to the load, kept to follow the playback on screen */
+static waveform_point_t stream_points[WAVEFORM_TABLE_POINTS];
+static uint32_t stream_points_size = 0;
+static uint32_t stream_point_index = 0;
+
+/** What the stream window shows, edited by the points and the measurements and applied once per period */
+static ui_stream_view_t stream_view = { 0 };
+
+/** Lines only change the mode, set point or enable, the rest carries over */
+static waveform_point_t stream_parse_state;
+
+/** Set by stream_prepare(), the stream task then loads the file without holding the LVGL mutex */
+static bool stream_loading = false;
+
+/** Chunk of the file, starting with the end of the last line cut by the previous chunk */
+static char stream_read_buffer[STREAM_READ_CHUNK_SIZE + 1U];
+static uint32_t stream_read_carry = 0;
+static uint32_t stream_read_length = 0;
+
 /** Prototypes */
 static void control_stream_loop();
 static void check_screen_switch(void);
@@ -48,7 +70,17 @@ static void navigate_to_load(void);
 static void stream_task(void *pvParameters);
 static void open_stream_file();
 static void close_stream_file();
-static void update_enabled_status(void);
+static void update_enabled_status(bool enable);
+static bool parse_line(const char *line);
+static void read_stream_file(void);
+static void start_stream(void);
+static void stream_open_job(void *arg);
+static void stream_read_job(void *arg);
+static void stream_close_job(void *arg);
+static void stream_unmount_job(void *arg);
+static void upload_stream(void);
+static void show_next_point(void);
+static void publish_stream(void);
 
 /**
  * @brief Initialize menu control module
@@ -79,25 +111,34 @@ void stream_prepare(void)
   /** Set the UI src to the display */
   lcd_load_ui(h_scr_ui_stream);
 
-  spi_mutex_lock(-1);
-  sd_mount();
-  open_stream_file();
-  spi_mutex_unlock();
+  /** The file is read by the stream task, the screen keeps refreshing meanwhile */
+  stream_loading = true;
+}
 
-  if (h_stream_file == NULL) {
+/** Implementations */
+
+/**
+ * @brief Uploads the points read and starts the playback, the caller holds the LVGL mutex
+ * @return void
+ */
+static void start_stream(void)
+{
+  stream_loading = false;
+
+  if (stream_points_size == 0) {
     navigate_to_load();
     return;
   }
 
-  /** Disables enable task */
-  h_control_enable_active = false;
+  /** The load plays the points, the screen only follows them */
+  upload_stream();
+  h_target_delay = (unsigned long)(esp_timer_get_time() / 1000ULL);
 
-  /** Activate control loops */
+  /** Activate control loops, the enable task leaves the button to this screen */
   h_control_stream_active = true;
+  publish_stream();
 }
 
-/** Implementations */
-
 static void navigate_to_load(void)
 {
   /** Deactivate load loop to avoid conflicts */
@@ -107,17 +148,18 @@ static void navigate_to_load(void)
   h_button_enc_long_press = false;
   h_button_enc_last = 0;
 
-  /** Reactivate enable tracking */
-  h_control_enable_active = true;
+  /** Give the enable button back to the enable task */
+  publish_stream();
 
   /** Reset message tracker */
   msg_opened = false;
   opened_msg_time = 0;
 
-  spi_mutex_lock(-1);
-  close_stream_file();
-  sd_unmount();
-  spi_mutex_unlock();
+  /** Return the load to the panel settings */
+  load_waveform_t waveform = { .command = WAVEFORM_STOP };
+  uart_send_waveform(&waveform);
+
+  spi_run(SPI_CLIENT_SD, stream_unmount_job, NULL);
 
   lvgl_mutex_lock(-1);
   for (uint16_t i = 0; i < STREAM_CHART_POINTS; i++)
@@ -133,10 +175,9 @@ static void navigate_to_load(void)
 
 static void open_stream_file()
 {
-  h_stream_complete = false;
-  h_target_mode = NONE;
-  h_target_point = 0;
   h_target_delay = 0;
+  stream_points_size = 0;
+  stream_point_index = 0;
 
   h_stream_file = fopen(STREAM_DATA_FILE, "r");
 }
@@ -151,115 +192,269 @@ static void close_stream_file()
   h_stream_file = NULL;
 }
 
-static void update_enabled_status(void)
+/** Jobs on the SPI bus, each one short so that the LCD flushes go in between */
+
+static void stream_open_job(void *arg)
 {
-  if (h_load_state.control.enable) {
-    lv_led_on(h_stream_led_enable);
-  } else {
-    lv_led_off(h_stream_led_enable);
-  }
-  set_led_enable(h_load_state.control.enable);
+  sd_mount();
+  open_stream_file();
+}
+
+static void stream_read_job(void *arg)
+{
+  stream_read_length = (uint32_t)fread(
+    &stream_read_buffer[stream_read_carry], 1U, STREAM_READ_CHUNK_SIZE - stream_read_carry, h_stream_file
+  );
+}
+
+static void stream_close_job(void *arg)
+{
+  close_stream_file();
 }
 
-static void parse_line()
+static void stream_unmount_job(void *arg)
+{
+  close_stream_file();
+  sd_unmount();
+}
+
+static void update_enabled_status(bool enable)
+{
+  stream_view.enable = enable;
+  set_led_enable(enable);
+}
+
+static bool parse_line(const char *line)
 {
   /** Two letter plus null terminator */
   char code[3];
   /** Storage for point and delay */
   uint32_t point, delay;
 
-  if (h_stream_file == NULL)
-    return;
+  if (sscanf(line, "%2s,%lu,%lu", code, &point, &delay) != 3)
+  {
+    return false;
+  }
 
-  if (fscanf(h_stream_file, "%2s,%lu,%lu", code, &point, &delay) == 3)
+  if (strcmp(code, "CC") == 0)
   {
-    if (strcmp(code, "CC") == 0)
-    {
-      h_load_state.control.mode = CC;
-      h_load_state.control.cc.value_milli = point;
-      lv_label_set_text(h_stream_mode_label, "CC");
-    }
-    else if (strcmp(code, "CV") == 0)
+    stream_parse_state.mode = CC;
+    stream_parse_state.value_milli = point;
+  }
+  else if (strcmp(code, "CV") == 0)
+  {
+    stream_parse_state.mode = CV;
+    stream_parse_state.value_milli = point;
+  }
+  else if (strcmp(code, "CP") == 0)
+  {
+    stream_parse_state.mode = CP;
+    stream_parse_state.value_milli = point;
+  }
+  else if (strcmp(code, "CR") == 0)
+  {
+    stream_parse_state.mode = CR;
+    stream_parse_state.value_milli = point;
+  }
+  else if (strcmp(code, "EN") == 0)
+  {
+    stream_parse_state.enable = point ? 1U : 0U;
+  }
+
+  /** A point holds for up to UINT16_MAX ms, longer delays take several */
+  do
+  {
+    if (stream_points_size == WAVEFORM_TABLE_POINTS)
     {
-      h_load_state.control.mode = CV;
-      h_load_state.control.cv.value_milli = point;
-      lv_label_set_text(h_stream_mode_label, "CV");
+      ESP_LOGW(MODULE_NAME, "Stream truncated to %u points", WAVEFORM_TABLE_POINTS);
+      return false;
     }
-    else if (strcmp(code, "CP") == 0)
+
+    waveform_point_t *target = &stream_points[stream_points_size++];
+    *target = stream_parse_state;
+    target->duration_ms = (uint16_t)(delay > UINT16_MAX ? UINT16_MAX : delay);
+    delay -= target->duration_ms;
+  } while (delay > 0U);
+
+  return true;
+}
+
+/**
+ * @brief Reads the stream file in chunks, one SPI job each, and parses them off the bus
+ * @return void
+ */
+static void read_stream_file(void)
+{
+  spi_run(SPI_CLIENT_SD, stream_open_job, NULL);
+
+  if (h_stream_file == NULL)
+    return;
+
+  /** Lines before the first mode or enable one keep the panel settings */
+  load_control_t panel;
+  topic_read(&h_topic_control, &panel);
+  const load_control_t *control = &panel;
+  stream_parse_state.mode = (uint8_t)control->mode;
+  stream_parse_state.enable = control->enable ? 1U : 0U;
+  switch (control->mode)
+  {
+    case CC:
+      stream_parse_state.value_milli = control->cc.value_milli;
+      break;
+    case CV:
+      stream_parse_state.value_milli = control->cv.value_milli;
+      break;
+    case CR:
+      stream_parse_state.value_milli = control->cr.value_milli;
+      break;
+    case CP:
+      stream_parse_state.value_milli = control->cp.value_milli;
+      break;
+    default:
+      stream_parse_state.value_milli = 0U;
+      break;
+  }
+
+  bool parsing = true;
+  stream_read_carry = 0;
+
+  while (parsing)
+  {
+    spi_run(SPI_CLIENT_SD, stream_read_job, NULL);
+
+    const uint32_t length = stream_read_carry + stream_read_length;
+    const bool end = (stream_read_length == 0U);
+    stream_read_buffer[length] = '\0';
+
+    /** Complete lines only, the last one is complete at the end of the file */
+    char *line = stream_read_buffer;
+    char *newline;
+    while (parsing && (newline = strchr(line, '\n')) != NULL)
     {
-      h_load_state.control.mode = CP;
-      h_load_state.control.cp.value_milli = point;
-      lv_label_set_text(h_stream_mode_label, "CP");
+      *newline = '\0';
+      parsing = (line[strspn(line, " \t\r")] == '\0') || parse_line(line);
+      line = newline + 1;
     }
-    else if (strcmp(code, "CR") == 0)
+
+    if (end)
     {
-      h_load_state.control.mode = CR;
-      h_load_state.control.cr.value_milli = point;
-      lv_label_set_text(h_stream_mode_label, "CR");
+      if (parsing && line[strspn(line, " \t\r")] != '\0')
+      {
+        parse_line(line);
+      }
+      break;
     }
 
-    if (strcmp(code, "EN") == 0)
+    /** A line longer than a chunk is no point */
+    stream_read_carry = (uint32_t)(&stream_read_buffer[length] - line);
+    if (stream_read_carry == STREAM_READ_CHUNK_SIZE)
     {
-      h_load_state.control.enable = point;
-      update_enabled_status();
-    } else {
-      lv_spinbox_set_value(
-        h_stream_desired_spinbox, point / 100U
-      );
+      break;
     }
+    memmove(stream_read_buffer, line, stream_read_carry);
+  }
+
+  spi_run(SPI_CLIENT_SD, stream_close_job, NULL);
+}
+
+static void upload_stream(void)
+{
+  load_waveform_t waveform = { 0 };
+
+  /** The load rejects a new table while playing */
+  waveform.command = WAVEFORM_STOP;
+  uart_send_waveform(&waveform);
+
+  waveform.command = WAVEFORM_LOAD;
+  for (uint32_t offset = 0; offset < stream_points_size; offset += WAVEFORM_CHUNK_POINTS)
+  {
+    const uint32_t left = stream_points_size - offset;
 
-    h_target_delay = (unsigned long)(esp_timer_get_time() / 1000ULL) + delay;
+    waveform.offset = offset;
+    waveform.count = left > WAVEFORM_CHUNK_POINTS ? WAVEFORM_CHUNK_POINTS : left;
+    memcpy(waveform.points, &stream_points[offset], waveform.count * sizeof(waveform_point_t));
+    uart_send_waveform(&waveform);
   }
-  else
+
+  memset(&waveform, 0, sizeof(waveform));
+  waveform.command = WAVEFORM_START;
+  waveform.count = stream_points_size;
+  waveform.loops = 1U;
+  waveform.trigger = WAVEFORM_TRIGGER_NOW;
+  uart_send_waveform(&waveform);
+}
+
+static void show_next_point(void)
+{
+  if (stream_point_index == stream_points_size)
   {
     navigate_to_load();
+    return;
   }
+
+  const waveform_point_t *point = &stream_points[stream_point_index++];
+
+  h_stream_mode = (load_mode_t)point->mode;
+  stream_view.mode = load_mode_text(h_stream_mode);
+  stream_view.desired = (int32_t)(point->value_milli / 100U);
+  update_enabled_status(point->enable);
+
+  /** Following the load clock rather than the task one avoids drifting */
+  h_target_delay += point->duration_ms;
+  publish_stream();
+}
+
+/**
+ * @brief Publishes the playback after a change, the caller holds the LVGL mutex
+ * @return void
+ */
+static void publish_stream(void)
+{
+  stream_state_t state = {
+    .active = h_control_stream_active ? 1U : 0U,
+    .point = stream_point_index,
+    .points = stream_points_size,
+  };
+
+  if (stream_point_index > 0U) {
+    state.current = stream_points[stream_point_index - 1U];
+  }
+
+  topic_publish(&h_topic_stream, &state);
 }
 
 static void control_stream_loop()
 {
   const unsigned long current_time = (unsigned long)(esp_timer_get_time() / 1000ULL);
+  load_measurement_t measurement;
+  topic_read(&h_topic_measurement, &measurement);
 
   lvgl_mutex_lock(-1);
 
-  if (current_time >= h_target_delay)
+  /** Catch up on the points shorter than the task period */
+  while (h_control_stream_active && current_time >= h_target_delay)
   {
-    spi_mutex_lock(-1);
-    parse_line();
-    spi_mutex_unlock();
+    show_next_point();
   }
 
-  switch (h_load_state.control.mode)
-  {
-    case CC:
-      lv_spinbox_set_value(
-        h_stream_measured_spinbox, h_load_state.measurement.cc_milli / 100U
-      );
-      break;
-    case CV:
-      lv_spinbox_set_value(
-        h_stream_measured_spinbox, h_load_state.measurement.cv_milli / 100U
-      );
-      break;
-    case CR:
-      lv_spinbox_set_value(
-        h_stream_measured_spinbox, h_load_state.measurement.cr_milli / 100U
-      );
-      break;
-    case CP:
-      lv_spinbox_set_value(
-        h_stream_measured_spinbox, h_load_state.measurement.cp_milli / 100U
-      );
-      break;
-    default:
-      break;
+  const uint32_t measured[] = {
+    [CC] = measurement.cc_milli,
+    [CV] = measurement.cv_milli,
+    [CR] = measurement.cr_milli,
+    [CP] = measurement.cp_milli,
+  };
+  if (h_stream_mode < NONE) {
+    stream_view.measured = (int32_t)(measured[h_stream_mode] / 100U);
   }
 
+  /** Points played since the last period are shown at once, only the widgets whose text changes get redrawn */
+  ui_stream_view_apply(&stream_view);
+
   if (current_time >= h_target_chart_point)
   {
     add_chart_point(
-      h_load_state.measurement.cc_milli,
-      h_load_state.measurement.cv_milli
+      measurement.cc_milli,
+      measurement.cv_milli
     );
 
     h_target_chart_point = current_time + STREAM_CHART_INTERVAL_S * 1000U;
@@ -295,8 +490,20 @@ static void check_screen_switch(void)
 
 static void stream_task(void *pvParameters)
 {
+  /** New measurements show up at once, the period bounds the wait for the points */
+  topic_subscribe(&h_topic_measurement, xTaskGetCurrentTaskHandle());
+
   while (1)
   {
+    if (stream_loading)
+    {
+      read_stream_file();
+
+      lvgl_mutex_lock(-1);
+      start_stream();
+      lvgl_mutex_unlock();
+    }
+
     if (h_control_stream_active)
     {
       button_en_update();
@@ -308,6 +515,6 @@ static void stream_task(void *pvParameters)
         lvgl_mutex_unlock();
       }
     }
-    vTaskDelay(pdMS_TO_TICKS(STREAM_TASK_DELAY));
+    topic_wait(STREAM_TASK_DELAY);
   }
 }
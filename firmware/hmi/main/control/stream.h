@@ -1,7 +1,9 @@
 #ifndef __CONTROL_STREAM_H__
 #define __CONTROL_STREAM_H__
 
+#include "bus/topic.h"
 #include "peripherals/sd.h"
+#include "server/server.h"
 
 /** General Config */
 #define STREAM_TASK_STACK_SIZE 5096U
@@ -10,6 +12,25 @@
 
 #define STREAM_DATA_FILE SD_MOUNT_POINT "/stream.csv"
 
+/** Bytes read from the file per SPI job, bounds the time the SD card holds the bus */
+#define STREAM_READ_CHUNK_SIZE 2048U
+
+/**
+ * @brief Playback of a stream, as shown on the stream screen
+ */
+typedef struct stream_state
+{
+  uint32_t active;         /**< The load plays the stream, the stream screen owns the enable button */
+  uint32_t point;          /**< Points shown so far */
+  uint32_t points;         /**< Points of the stream */
+  waveform_point_t current; /**< Point played by the load */
+} stream_state_t;
+
+/** Handlers */
+
+/** Playback of the stream, stream_state_t */
+extern topic_t h_topic_stream;
+
 /** Prototypes */
 
 /**
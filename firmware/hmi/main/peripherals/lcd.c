@@ -5,11 +5,13 @@
 #include "esp_timer.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
+#include "esp_heap_caps.h"
 #include "esp_lcd_st7735.h"
 
 #include "bus/spi.h"
 #include "common.h"
 #include "peripherals/lcd.h"
+#include "peripherals/lcd_bands.h"
 #include "utils.h"
 
 /** Definitions */
@@ -29,13 +31,30 @@ esp_timer_handle_t h_lvgl_tick_timer;
 esp_lcd_panel_io_handle_t h_io_handle;
 esp_lcd_panel_handle_t h_panel_handle;
 
+/** Globals */
+
+/** Updated by the LVGL task under the LVGL mutex */
+static lcd_stats_t lcd_stats = {0};
+static lcd_stats_t lcd_stats_window = {0};
+static lcd_stats_t lcd_stats_per_second = {0};
+static int64_t lcd_stats_window_us = 0;
+
+/**
+ * Flushes waiting for the SPI task. LVGL has a single flush in flight, the next buffer is rendered meanwhile and
+ * flushed once it is ready: two entries never wrap onto a flush not started yet.
+ */
+static lcd_flush_t lcd_flushes[LCD_FLUSH_QUEUE_LENGTH];
+static uint32_t lcd_flush_next = 0U;
+
 /** Forward Decl */
 
 static void lcd_init_spi(void);
-static void lcd_init_panel(void);
+static void lcd_init_panel(void *arg);
+static void lcd_flush_job(void *arg);
 static void lcd_timer_init(void);
 
 static void lvgl_init(void);
+static uint32_t lvgl_alloc_draw_buffers(lv_color_t **buf1, lv_color_t **buf2);
 static void lvgl_increase_tick(void *arg);
 static void lvgl_task_impl(void *arg);
 
@@ -46,6 +65,8 @@ static bool on_lvgl_flush_ready(
 );
 static void on_lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
 static void on_lvgl_port_update_callback(lv_disp_drv_t *drv);
+static void on_lvgl_monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px);
+static void lcd_stats_roll(void);
 
 /**
  * @brief Set up the LCD basic configuration
@@ -54,14 +75,10 @@ void lcd_init(void)
 {
   LOG_PROLOG
 
-  spi_mutex_lock(-1);
-
   lcd_init_spi();
-  lcd_init_panel();
+  spi_run(SPI_CLIENT_LCD, lcd_init_panel, NULL);
   lvgl_init();
 
-  spi_mutex_unlock();
-
   xTaskCreate(
     lvgl_task_impl, "LVGL", LVGL_TASK_STACK_SIZE, NULL, LVGL_TASK_PRIORITY, &h_lvgl_task
   );
@@ -81,6 +98,25 @@ void lcd_load_ui(lv_obj_t *ui_screen)
   lvgl_mutex_unlock();
 }
 
+/**
+ * @brief Copies the counters of the LCD refreshes
+ *
+ * @param total Counters since boot, may be NULL
+ * @param per_second Counters over the last LCD_STATS_PERIOD_MS window, may be NULL
+ * @return void
+ */
+void lcd_get_stats(lcd_stats_t *total, lcd_stats_t *per_second)
+{
+  lvgl_mutex_lock(-1);
+  if (total != NULL) {
+    *total = lcd_stats;
+  }
+  if (per_second != NULL) {
+    *per_second = lcd_stats_per_second;
+  }
+  lvgl_mutex_unlock();
+}
+
 /**
  * @brief Locks the LVGL mutex due to the LVGL APIs are not thread-safe
  * @param timeout_ms Timeout in milliseconds to wait for the mutex, if -1, wait indefinitely
@@ -93,12 +129,17 @@ bool lvgl_mutex_lock(int timeout_ms)
 }
 
 /**
- * @brief Unlocks the LVGL mutex
+ * @brief Unlocks the LVGL mutex, waking the LVGL task up when another task unlocks it to refresh its changes
  * @return void
  */
 void lvgl_mutex_unlock(void)
 {
   xSemaphoreGiveRecursive(h_lvgl_mutex);
+
+  /** Otherwise the changes wait for the LVGL task to wake up on its own, up to LVGL_TASK_MAX_DELAY_MS */
+  if (h_lvgl_task != NULL && xTaskGetCurrentTaskHandle() != h_lvgl_task) {
+    xTaskNotifyGive(h_lvgl_task);
+  }
 }
 
 /** Implementations */
@@ -123,7 +164,13 @@ static void lcd_init_spi(void)
   LOG_EPILOG
 }
 
-void lcd_init_panel(void)
+/**
+ * @brief Resets and sets the panel up, run on the SPI bus
+ *
+ * @param arg Unused
+ * @return void
+ */
+static void lcd_init_panel(void *arg)
 {
   LOG_PROLOG
 
@@ -147,17 +194,20 @@ void lvgl_init(void)
   LOG_PROLOG
 
   lv_init();
-  lv_color_t *buf1 = heap_caps_malloc(LCD_H_RES * 20 * sizeof(lv_color_t), MALLOC_CAP_DMA);
-  assert(buf1);
-  lv_color_t *buf2 = heap_caps_malloc(LCD_H_RES * 20 * sizeof(lv_color_t), MALLOC_CAP_DMA);
-  assert(buf2);
+  lv_color_t *buf1;
+  lv_color_t *buf2;
+  const uint32_t buffer_px = lvgl_alloc_draw_buffers(&buf1, &buf2);
 
-  lv_disp_draw_buf_init(&h_disp_buf, buf1, buf2, LCD_H_RES * 20);
+  lv_disp_draw_buf_init(&h_disp_buf, buf1, buf2, buffer_px);
   lv_disp_drv_init(&h_disp_drv);
   h_disp_drv.hor_res = LCD_H_RES;
   h_disp_drv.ver_res = LCD_V_RES;
   h_disp_drv.flush_cb = on_lvgl_flush_cb;
   h_disp_drv.drv_update_cb = on_lvgl_port_update_callback;
+  h_disp_drv.monitor_cb = on_lvgl_monitor_cb;
+#if LCD_COALESCE_BANDS
+  h_disp_drv.render_start_cb = lcd_bands_on_render_start;
+#endif
   h_disp_drv.draw_buf = &h_disp_buf;
   h_disp_drv.user_data = h_panel_handle;
   h_disp = lv_disp_drv_register(&h_disp_drv);
@@ -170,6 +220,44 @@ void lvgl_init(void)
   LOG_EPILOG
 }
 
+/**
+ * @brief Allocates the LVGL draw buffers in DMA capable memory
+ *
+ * A whole frame each when LCD_FULL_FRAME_BUFFERS and the memory allow, LCD_DRAW_BUFFER_LINES otherwise. The SPI DMA
+ * of the ESP32 can't reach the PSRAM, the buffers are always internal.
+ *
+ * @param buf1 Where the first buffer is stored
+ * @param buf2 Where the second buffer is stored
+ * @return uint32_t Pixels of each buffer
+ */
+static uint32_t lvgl_alloc_draw_buffers(lv_color_t **buf1, lv_color_t **buf2)
+{
+  const uint32_t lines[] = { LCD_FULL_FRAME_BUFFERS ? LCD_V_RES : LCD_DRAW_BUFFER_LINES, LCD_DRAW_BUFFER_LINES };
+
+  for (uint32_t i = 0U; i < sizeof(lines) / sizeof(lines[0]); i++) {
+    const uint32_t buffer_px = LCD_H_RES * lines[i];
+    const size_t size = buffer_px * sizeof(lv_color_t);
+
+    if (lines[i] != LCD_DRAW_BUFFER_LINES &&
+        heap_caps_get_free_size(MALLOC_CAP_DMA) < 2U * size + LCD_DRAW_BUFFER_RESERVE_BYTES) {
+      continue;
+    }
+
+    *buf1 = heap_caps_malloc(size, MALLOC_CAP_DMA);
+    *buf2 = heap_caps_malloc(size, MALLOC_CAP_DMA);
+    if (*buf1 != NULL && *buf2 != NULL) {
+      ESP_LOGI(MODULE_NAME, "Draw buffers of %lu lines", (unsigned long)lines[i]);
+      return buffer_px;
+    }
+
+    heap_caps_free(*buf1);
+    heap_caps_free(*buf2);
+  }
+
+  assert(false);
+  return 0U;
+}
+
 void lcd_timer_init(void)
 {
   LOG_PROLOG
@@ -196,18 +284,45 @@ static bool on_lvgl_flush_ready(
   return false;
 }
 
+/**
+ * @brief Queues the flush of an area on the SPI bus, LVGL renders the next area meanwhile
+ *
+ * The buffer stays LVGL's until lv_disp_flush_ready(), called once the DMA transfer is done. A flush that can't be
+ * queued is dropped and handed back at once, rather than holding the LVGL task.
+ */
 static void on_lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
 {
-  spi_mutex_lock(-1);
+  lcd_flush_t *flush = &lcd_flushes[lcd_flush_next];
+  lcd_flush_next = (lcd_flush_next + 1U) % LCD_FLUSH_QUEUE_LENGTH;
 
-  esp_lcd_panel_handle_t panel_handle = (esp_lcd_panel_handle_t)drv->user_data;
-  int offsetx1 = area->x1;
-  int offsetx2 = area->x2;
-  int offsety1 = area->y1;
-  int offsety2 = area->y2;
-  esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, color_map);
+  flush->panel = (esp_lcd_panel_handle_t)drv->user_data;
+  flush->area = *area;
+  flush->color_map = color_map;
+
+  if (spi_submit(SPI_CLIENT_LCD, lcd_flush_job, flush) != 0) {
+    lcd_stats.dropped_flushes++;
+    lv_disp_flush_ready(drv);
+    return;
+  }
+
+  const uint32_t pixels = (uint32_t)lv_area_get_size(area);
+  lcd_stats.flushes++;
+  lcd_stats.flushed_px += pixels;
+  lcd_stats.spi_bytes += pixels * sizeof(lv_color_t) + LCD_FLUSH_OVERHEAD_BYTES;
+}
+
+/**
+ * @brief Starts the DMA transfer of a flush, run on the SPI bus
+ *
+ * @param arg Flush
+ * @return void
+ */
+static void lcd_flush_job(void *arg)
+{
+  const lcd_flush_t *flush = (const lcd_flush_t *)arg;
+  const lv_area_t *area = &flush->area;
 
-  spi_mutex_unlock();
+  esp_lcd_panel_draw_bitmap(flush->panel, area->x1, area->y1, area->x2 + 1, area->y2 + 1, flush->color_map);
 }
 
 static void on_lvgl_port_update_callback(lv_disp_drv_t *drv)
@@ -239,6 +354,45 @@ static void on_lvgl_port_update_callback(lv_disp_drv_t *drv)
   }
 }
 
+/**
+ * @brief Called by LVGL after every refresh that rendered something
+ *
+ * @param drv Display driver
+ * @param time Time spent rendering and flushing, in milliseconds
+ * @param px Pixels rendered
+ * @return void
+ */
+static void on_lvgl_monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+  lcd_stats.refreshes++;
+  lcd_stats.render_ms += time;
+  lcd_stats.invalidated_px += px;
+}
+
+/**
+ * @brief Takes the rates over the window once it has elapsed, the caller holds the LVGL mutex
+ *
+ * @return void
+ */
+static void lcd_stats_roll(void)
+{
+  const int64_t now_us = esp_timer_get_time();
+  if (now_us - lcd_stats_window_us < (int64_t)LCD_STATS_PERIOD_MS * 1000) {
+    return;
+  }
+
+  lcd_stats_per_second.refreshes = lcd_stats.refreshes - lcd_stats_window.refreshes;
+  lcd_stats_per_second.render_ms = lcd_stats.render_ms - lcd_stats_window.render_ms;
+  lcd_stats_per_second.invalidated_px = lcd_stats.invalidated_px - lcd_stats_window.invalidated_px;
+  lcd_stats_per_second.flushed_px = lcd_stats.flushed_px - lcd_stats_window.flushed_px;
+  lcd_stats_per_second.spi_bytes = lcd_stats.spi_bytes - lcd_stats_window.spi_bytes;
+  lcd_stats_per_second.flushes = lcd_stats.flushes - lcd_stats_window.flushes;
+  lcd_stats_per_second.dropped_flushes = lcd_stats.dropped_flushes - lcd_stats_window.dropped_flushes;
+
+  lcd_stats_window = lcd_stats;
+  lcd_stats_window_us = now_us;
+}
+
 static void lvgl_increase_tick(void *arg)
 {
   lv_tick_inc(LVGL_TICK_PERIOD_MS);
@@ -250,6 +404,7 @@ static void lvgl_task_impl(void *arg)
   while (1) {
     if (lvgl_mutex_lock(-1)) {
       task_delay_ms = lv_timer_handler();
+      lcd_stats_roll();
       lvgl_mutex_unlock();
     }
     if (task_delay_ms > LVGL_TASK_MAX_DELAY_MS) {
@@ -257,6 +412,6 @@ static void lvgl_task_impl(void *arg)
     } else if (task_delay_ms < LVGL_TASK_MIN_DELAY_MS) {
       task_delay_ms = LVGL_TASK_MIN_DELAY_MS;
     }
-    vTaskDelay(pdMS_TO_TICKS(task_delay_ms));
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(task_delay_ms));
   }
 }
@@ -15,15 +15,55 @@
 #define LCD_H_RES 160
 #define LCD_V_RES 128
 
-#define LVGL_TICK_PERIOD_MS 100
+#define LVGL_TICK_PERIOD_MS 1
 #define LVGL_TASK_MAX_DELAY_MS 300
-#define LVGL_TASK_MIN_DELAY_MS 50
+/** A FreeRTOS tick, shorter delays round down to none */
+#define LVGL_TASK_MIN_DELAY_MS 10
 #define LVGL_TASK_STACK_SIZE (25 * 1024)
 #define LVGL_TASK_PRIORITY 1
 
+/** Bytes sent to the ST7735 per flush besides the pixels: CASET, RASET and RAMWR with their parameters */
+#define LCD_FLUSH_OVERHEAD_BYTES 11U
+/** Window of the rates */
+#define LCD_STATS_PERIOD_MS 1000U
+/** Flushes waiting for the SPI bus, LVGL has one in flight and renders the next */
+#define LCD_FLUSH_QUEUE_LENGTH 2U
+
+/** Draw buffers of LCD_DRAW_BUFFER_LINES, or of a whole frame when LCD_FULL_FRAME_BUFFERS and the DMA memory allow */
+#define LCD_DRAW_BUFFER_LINES 20U
+#define LCD_FULL_FRAME_BUFFERS 1
+/** DMA capable memory left to the tasks and the SD card once the full frame buffers are allocated */
+#define LCD_DRAW_BUFFER_RESERVE_BYTES (64U * 1024U)
+/** Invalidated areas joined into bands before they are rendered, see lcd_bands.h */
+#define LCD_COALESCE_BANDS 1
+
 /** Typedefs */
 typedef void (*ui_fn_t)(lv_disp_t *disp);
 
+/**
+ * @brief Counters of the LCD refreshes
+ */
+typedef struct lcd_stats
+{
+  uint32_t refreshes;       /**< Refreshes that rendered something */
+  uint32_t render_ms;       /**< Time spent rendering and flushing, as measured by LVGL */
+  uint32_t invalidated_px;  /**< Pixels of the invalidated areas, rendered again */
+  uint32_t flushed_px;      /**< Pixels sent to the LCD */
+  uint32_t spi_bytes;       /**< Bytes sent to the LCD, pixels and commands */
+  uint32_t flushes;         /**< Transfers to the LCD, one per rendered part of an area */
+  uint32_t dropped_flushes; /**< Flushes dropped as the SPI queue of the LCD was full */
+} lcd_stats_t;
+
+/**
+ * @brief Area flushed to the LCD, queued on the SPI bus
+ */
+typedef struct lcd_flush
+{
+  esp_lcd_panel_handle_t panel;
+  lv_area_t area;
+  lv_color_t *color_map;    /**< LVGL draw buffer, given back by lv_disp_flush_ready() */
+} lcd_flush_t;
+
 /** Handlers */
 extern lv_disp_draw_buf_t h_disp_buf;
 extern lv_disp_drv_t h_disp_drv;
@@ -45,6 +85,15 @@ void lcd_init(void);
  */
 void lcd_load_ui(lv_obj_t *ui_screen);
 
+/**
+ * @brief Copies the counters of the LCD refreshes
+ *
+ * @param total Counters since boot, may be NULL
+ * @param per_second Counters over the last LCD_STATS_PERIOD_MS window, may be NULL
+ * @return void
+ */
+void lcd_get_stats(lcd_stats_t *total, lcd_stats_t *per_second);
+
 /**
  * @brief Locks the LVGL mutex due to the LVGL APIs are not thread-safe
  * @param timeout_ms Timeout in milliseconds to wait for the mutex, if -1, wait indefinitely
@@ -53,7 +102,7 @@ void lcd_load_ui(lv_obj_t *ui_screen);
 bool lvgl_mutex_lock(int timeout_ms);
 
 /**
- * @brief Unlocks the LVGL mutex
+ * @brief Unlocks the LVGL mutex, waking the LVGL task up when another task unlocks it to refresh its changes
  * @return void
  */
 void lvgl_mutex_unlock(void);
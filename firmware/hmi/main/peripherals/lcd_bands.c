@@ -0,0 +1,91 @@
+#include "peripherals/lcd_bands.h"
+
+/** Prototypes */
+static uint32_t lcd_bands_cost(const lv_area_t *area, uint32_t buffer_px);
+
+/**
+ * @brief Joins the invalid areas of a display into bands, once LVGL has joined them
+ *
+ * The band keeps the last index of the areas it joins, as LVGL marks the last area flushed before the areas are
+ * joined here.
+ *
+ * @param disp Display being refreshed
+ * @return uint32_t Areas joined
+ */
+uint32_t lcd_bands_coalesce(lv_disp_t *disp)
+{
+  const uint32_t buffer_px = disp->driver->draw_buf->size;
+  uint32_t joined = 0U;
+  bool changed = true;
+
+  /** A band may join areas it couldn't before it grew, the areas are few, LV_INV_BUF_SIZE at most */
+  while (changed) {
+    changed = false;
+
+    for (uint32_t from = 0U; from < disp->inv_p; from++) {
+      if (disp->inv_area_joined[from] != 0U) {
+        continue;
+      }
+
+      const lv_area_t *area = &disp->inv_areas[from];
+      for (uint32_t into = from + 1U; into < disp->inv_p; into++) {
+        lv_area_t *band = &disp->inv_areas[into];
+        if (disp->inv_area_joined[into] != 0U) {
+          continue;
+        }
+
+        if (area->y1 > band->y2 + LCD_BANDS_GAP_ROWS || band->y1 > area->y2 + LCD_BANDS_GAP_ROWS) {
+          continue;
+        }
+
+        lv_area_t joined_area;
+        _lv_area_join(&joined_area, area, band);
+        if (lcd_bands_cost(&joined_area, buffer_px) > lcd_bands_cost(area, buffer_px) + lcd_bands_cost(band, buffer_px)) {
+          continue;
+        }
+
+        *band = joined_area;
+        disp->inv_area_joined[from] = 1U;
+        joined++;
+        changed = true;
+        break;
+      }
+    }
+  }
+
+  return joined;
+}
+
+/**
+ * @brief LVGL render start callback, coalesces the areas of the display being refreshed
+ *
+ * @param drv Display driver
+ * @return void
+ */
+void lcd_bands_on_render_start(lv_disp_drv_t *drv)
+{
+  lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+
+  if (disp != NULL && disp->driver == drv) {
+    lcd_bands_coalesce(disp);
+  }
+}
+
+/** Implementations */
+
+/**
+ * @brief Bytes an area costs on the bus, a flush per draw buffer its rows take
+ *
+ * @param area Area
+ * @param buffer_px Pixels of a draw buffer
+ * @return uint32_t Cost
+ */
+static uint32_t lcd_bands_cost(const lv_area_t *area, uint32_t buffer_px)
+{
+  const uint32_t width = (uint32_t)lv_area_get_width(area);
+  const uint32_t height = (uint32_t)lv_area_get_height(area);
+  const uint32_t rows = (buffer_px / width > 0U) ? buffer_px / width : 1U;
+  const uint32_t flushes = (height + rows - 1U) / rows;
+
+  return (uint32_t)lv_area_get_size(area) * (uint32_t)sizeof(lv_color_t) + flushes * LCD_BANDS_FLUSH_COST_BYTES;
+}
@@ -0,0 +1,43 @@
+#ifndef __PERIPHERALS_LCD_BANDS_H__
+#define __PERIPHERALS_LCD_BANDS_H__
+
+#include "lvgl.h"
+
+/**
+ * @brief Coalescing of the areas LVGL refreshes into bands flushed as single transfers
+ *
+ * LVGL joins the invalidated areas that overlap, and only when the joined area is smaller than the two. On the
+ * ST7735 a flush costs more than its pixels: the address window commands, the SPI transactions set up by esp_lcd and a
+ * render pass over the objects of the area. Two labels on the same rows are cheaper flushed as one band holding both,
+ * the pixels between them included. The areas sharing rows, or a few rows apart, are joined whenever the band costs
+ * less than the areas, the cost counting each flush of an area, as many as its rows need draw buffers.
+ */
+
+/** Bytes the pixels could take in the time a flush costs besides them */
+#define LCD_BANDS_FLUSH_COST_BYTES 256U
+
+/** Rows between two areas still joined into a band */
+#define LCD_BANDS_GAP_ROWS 8
+
+/** Prototypes */
+
+/**
+ * @brief Joins the invalid areas of a display into bands, once LVGL has joined them
+ *
+ * The band keeps the last index of the areas it joins, as LVGL marks the last area flushed before the areas are
+ * joined here.
+ *
+ * @param disp Display being refreshed
+ * @return uint32_t Areas joined
+ */
+uint32_t lcd_bands_coalesce(lv_disp_t *disp);
+
+/**
+ * @brief LVGL render start callback, coalesces the areas of the display being refreshed
+ *
+ * @param drv Display driver
+ * @return void
+ */
+void lcd_bands_on_render_start(lv_disp_drv_t *drv);
+
+#endif /** !__PERIPHERALS_LCD_BANDS_H__ */
@@ -0,0 +1,410 @@
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "scpi.h"
+#include "parser.h"
+
+/** Globals */
+
+/** Values of the tree nodes, indexed by themselves */
+static const uint8_t scpi_fields[] = { 0x0U, 0x1U, 0x2U, 0x3U, 0x4U };
+
+/** Answers to the MD query, in load_mode_t order */
+static const char *const scpi_modes[] = { "CC", "CV", "CR", "CP" };
+
+/** Prototypes */
+static parser_consumer_data_t scpi_consume(buffer_t *buffer);
+static parser_match_t scpi_match_number(void *data, const void *match_value);
+static int scpi_key_number(void *data);
+static void scpi_on_field(buffer_t *buffer, const void *value);
+static void scpi_on_value(buffer_t *buffer, const void *value);
+static void scpi_on_end(parser_stream_t *parser);
+static int scpi_complete(const scpi_request_t *request, uint32_t tokens);
+static int scpi_is_end(char c);
+static int scpi_number(const char *token, uint32_t *value);
+static int scpi_answer(uint32_t size, int length);
+
+/** Command tree, leaves have no next level. Fields are numbers, so each level is indexed by the field value */
+
+MAKE_NODES(scpi_value, &scpi_match_number, {
+  MAKE_WILDCARD_NODE(&scpi_on_value, NULL),
+});
+
+MAKE_KEYED_NODES(scpi_general, &scpi_match_number, &scpi_key_number, {
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_GENERAL, &scpi_fields[SCPI_SUBREGISTER_GENERAL], &scpi_on_field, NULL),
+});
+
+MAKE_KEYED_NODES(scpi_modes_leaf, &scpi_match_number, &scpi_key_number, {
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CC, &scpi_fields[SCPI_SUBREGISTER_CC], &scpi_on_field, NULL),
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CV, &scpi_fields[SCPI_SUBREGISTER_CV], &scpi_on_field, NULL),
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CR, &scpi_fields[SCPI_SUBREGISTER_CR], &scpi_on_field, NULL),
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CP, &scpi_fields[SCPI_SUBREGISTER_CP], &scpi_on_field, NULL),
+});
+
+MAKE_KEYED_NODES(scpi_general_value, &scpi_match_number, &scpi_key_number, {
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_GENERAL, &scpi_fields[SCPI_SUBREGISTER_GENERAL], &scpi_on_field, &scpi_value),
+});
+
+MAKE_KEYED_NODES(scpi_modes_value, &scpi_match_number, &scpi_key_number, {
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CC, &scpi_fields[SCPI_SUBREGISTER_CC], &scpi_on_field, &scpi_value),
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CV, &scpi_fields[SCPI_SUBREGISTER_CV], &scpi_on_field, &scpi_value),
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CR, &scpi_fields[SCPI_SUBREGISTER_CR], &scpi_on_field, &scpi_value),
+  MAKE_KEYED_NODE(SCPI_SUBREGISTER_CP, &scpi_fields[SCPI_SUBREGISTER_CP], &scpi_on_field, &scpi_value),
+});
+
+MAKE_KEYED_NODES(scpi_query, &scpi_match_number, &scpi_key_number, {
+  MAKE_KEYED_NODE(SCPI_REGISTER_ID, &scpi_fields[SCPI_REGISTER_ID], &scpi_on_field, &scpi_general),
+  MAKE_KEYED_NODE(SCPI_REGISTER_IN, &scpi_fields[SCPI_REGISTER_IN], &scpi_on_field, &scpi_general),
+  MAKE_KEYED_NODE(SCPI_REGISTER_MD, &scpi_fields[SCPI_REGISTER_MD], &scpi_on_field, &scpi_general),
+  MAKE_KEYED_NODE(SCPI_REGISTER_LV, &scpi_fields[SCPI_REGISTER_LV], &scpi_on_field, &scpi_modes_leaf),
+  MAKE_KEYED_NODE(SCPI_REGISTER_ST, &scpi_fields[SCPI_REGISTER_ST], &scpi_on_field, &scpi_general),
+});
+
+MAKE_KEYED_NODES(scpi_set, &scpi_match_number, &scpi_key_number, {
+  MAKE_KEYED_NODE(SCPI_REGISTER_IN, &scpi_fields[SCPI_REGISTER_IN], &scpi_on_field, &scpi_general_value),
+  MAKE_KEYED_NODE(SCPI_REGISTER_MD, &scpi_fields[SCPI_REGISTER_MD], &scpi_on_field, &scpi_modes_leaf),
+  MAKE_KEYED_NODE(SCPI_REGISTER_LV, &scpi_fields[SCPI_REGISTER_LV], &scpi_on_field, &scpi_modes_value),
+});
+
+MAKE_KEYED_NODES(scpi_root, &scpi_match_number, &scpi_key_number, {
+  MAKE_KEYED_NODE(SCPI_QUERY, &scpi_fields[SCPI_QUERY], &scpi_on_field, &scpi_query),
+  MAKE_KEYED_NODE(SCPI_SET, &scpi_fields[SCPI_SET], &scpi_on_field, &scpi_set),
+});
+
+/**
+ * @brief Parses and executes a command line.
+ *
+ * @param target Side executing the command
+ * @param line Command, without the line ending, need not be NUL terminated
+ * @param length Command length
+ * @param response Buffer for the answer, SCPI_RESPONSE_MAX bytes are enough
+ * @param size Size of the buffer
+ * @return int Answer length, line feed included, 0 for an applied set, -1 on an unrecognized or rejected command
+ */
+int scpi_execute(const scpi_target_t *target, const char *line, uint32_t length, char *response, uint32_t size)
+{
+  char text[SCPI_LINE_MAX + 1U];
+
+  if (length == 0U || length > SCPI_LINE_MAX) {
+    return -1;
+  }
+
+  /** The match function reads tokens up to the next colon or the NUL */
+  memcpy(text, line, length);
+  text[length] = '\0';
+
+  uint32_t tokens = 1U;
+  for (uint32_t i = 0U; i < length; i++) {
+    tokens += (text[i] == ':') ? 1U : 0U;
+  }
+
+  scpi_request_t request = { .valid = 1U };
+
+  buffer_t buffer = {
+    .begin = text,
+    .actual = text,
+    .end = &text[length],
+    .consumer = &scpi_consume,
+    .context = &request,
+  };
+  parser(&buffer, &scpi_root);
+
+  if (!scpi_complete(&request, tokens)) {
+    return -1;
+  }
+
+  return scpi_request_execute(target, &request, response, size);
+}
+
+/**
+ * @brief Sets up a stream of command lines.
+ *
+ * @param stream Stream
+ * @param on_request Receives every complete command, from scpi_stream_feed()
+ */
+void scpi_stream_init(scpi_stream_t *stream, void (*on_request)(const scpi_request_t *request))
+{
+  stream->on_request = on_request;
+  stream->request = (scpi_request_t){ .valid = 1U };
+  parser_stream_init(&stream->parser, &scpi_root, ':', &scpi_on_end, &stream->request);
+}
+
+/**
+ * @brief Drops the command in progress, after bytes were lost.
+ *
+ * @param stream Stream
+ */
+void scpi_stream_reset(scpi_stream_t *stream)
+{
+  stream->request = (scpi_request_t){ .valid = 1U };
+  parser_stream_reset(&stream->parser);
+}
+
+/**
+ * @brief Parses the next bytes of the line stream, in place.
+ *
+ * @param stream Stream
+ * @param data Bytes received, in any chunks, lines ended by a line feed or a carriage return
+ * @param length Bytes in data
+ */
+void scpi_stream_feed(scpi_stream_t *stream, const char *data, uint32_t length)
+{
+  parser_stream_feed(&stream->parser, data, length);
+}
+
+/**
+ * @brief Executes a complete command.
+ *
+ * @param target Side executing the command
+ * @param request Command handed by a stream
+ * @param response Buffer for the answer, SCPI_RESPONSE_MAX bytes are enough
+ * @param size Size of the buffer
+ * @return int Answer length, line feed included, 0 for an applied set, -1 on a rejected command
+ */
+int scpi_request_execute(const scpi_target_t *target, const scpi_request_t *request, char *response, uint32_t size)
+{
+  const uint8_t command = request->fields[0];
+  const uint8_t reg = request->fields[1];
+  const uint8_t sub = request->fields[2];
+
+  if (command == SCPI_SET) {
+    load_command_t set = { 0 };
+
+    if (reg == SCPI_REGISTER_IN) {
+      set.key = COMMAND_ENABLE;
+      set.value = request->value;
+    } else if (reg == SCPI_REGISTER_MD) {
+      set.key = COMMAND_MODE;
+      set.value = (uint32_t)(sub - SCPI_SUBREGISTER_CC);
+    } else {
+      set.key = (uint8_t)(COMMAND_CC + (sub - SCPI_SUBREGISTER_CC));
+      set.value = request->value;
+    }
+
+    return (target->set(&set) == 0) ? 0 : -1;
+  }
+
+  load_control_t control;
+  target->get_control(&control);
+  const char *mode = (control.mode <= CP) ? scpi_modes[control.mode] : "--";
+  const set_point_t *set_points = &control.cc;
+
+  switch (reg) {
+    case SCPI_REGISTER_ID:
+      return scpi_answer(size, snprintf(response, size, "%s\n", target->identification));
+    case SCPI_REGISTER_IN:
+      return scpi_answer(size, snprintf(response, size, "%lu\n", (unsigned long)control.enable));
+    case SCPI_REGISTER_MD:
+      return scpi_answer(size, snprintf(response, size, "%s\n", mode));
+    case SCPI_REGISTER_LV:
+      return scpi_answer(size, snprintf(response, size, "%lu\n",
+                                        (unsigned long)set_points[sub - SCPI_SUBREGISTER_CC].value_milli));
+    case SCPI_REGISTER_ST: {
+      load_measurement_t measurement;
+      target->get_measurement(&measurement);
+      return scpi_answer(size, snprintf(response, size, "%lu,%s,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                                        (unsigned long)control.enable, mode,
+                                        (unsigned long)control.cc.value_milli, (unsigned long)control.cv.value_milli,
+                                        (unsigned long)control.cr.value_milli, (unsigned long)control.cp.value_milli,
+                                        (unsigned long)measurement.cc_milli, (unsigned long)measurement.cv_milli));
+    }
+    default:
+      return -1;
+  }
+}
+
+/** Implementations */
+
+/**
+ * @brief Moves to the next colon separated field.
+ *
+ * @param buffer Command buffer
+ * @return parser_consumer_data_t PARSER_CONSUMER_END_OF_BUFFER after the last field
+ */
+static parser_consumer_data_t scpi_consume(buffer_t *buffer)
+{
+  char *token = buffer->actual;
+  const char *end = buffer->end;
+
+  while (token < end && *token != ':') {
+    token++;
+  }
+
+  if (token >= end) {
+    return PARSER_CONSUMER_END_OF_BUFFER;
+  }
+
+  buffer->actual = token + 1;
+  return PARSER_CONSUMER_OK;
+}
+
+/**
+ * @brief Compares the field at the buffer position with the value of a node.
+ *
+ * @param data Field, ended by a colon, a line ending or the NUL
+ * @param match_value Pointer to the uint8_t value of the node
+ * @return parser_match_t PARSER_MATCH_EQUAL if the field is a number equal to the node value
+ */
+static parser_match_t scpi_match_number(void *data, const void *match_value)
+{
+  uint32_t value;
+
+  if (scpi_number(data, &value) != 0) {
+    return PARSER_MATCH_NOT_EQUAL;
+  }
+
+  return (value == *(const uint8_t *)match_value) ? PARSER_MATCH_EQUAL : PARSER_MATCH_NOT_EQUAL;
+}
+
+/**
+ * @brief Index of the node a field can match in a keyed level of the tree.
+ *
+ * @param data Field, ended by a colon, a line ending or the NUL
+ * @return int Value of the field, -1 if it is not a number or does not fit an index
+ */
+static int scpi_key_number(void *data)
+{
+  uint32_t value;
+
+  if (scpi_number(data, &value) != 0 || value > (uint32_t)INT16_MAX) {
+    return -1;
+  }
+
+  return (int)value;
+}
+
+/**
+ * @brief Records a C, R or S field matched by the tree.
+ *
+ * @param buffer Command buffer
+ * @param value Pointer to the uint8_t value of the node
+ */
+static void scpi_on_field(buffer_t *buffer, const void *value)
+{
+  scpi_request_t *request = buffer->context;
+
+  if (request->depth < SCPI_FIELDS - 1U) {
+    request->fields[request->depth] = *(const uint8_t *)value;
+  }
+  request->depth++;
+}
+
+/**
+ * @brief Records the VV field, matched by a wildcard.
+ *
+ * @param buffer Command buffer, at the field
+ * @param value NULL
+ */
+static void scpi_on_value(buffer_t *buffer, const void *value)
+{
+  scpi_request_t *request = buffer->context;
+  (void)value;
+
+  if (scpi_number(buffer->actual, &request->value) != 0) {
+    request->valid = 0U;
+  }
+  request->depth++;
+}
+
+/**
+ * @brief Hands a complete command of a stream to its owner, at the end of every line.
+ *
+ * @param parser Stream position, at the line ending
+ */
+static void scpi_on_end(parser_stream_t *parser)
+{
+  scpi_stream_t *stream = (scpi_stream_t *)((char *)parser - offsetof(scpi_stream_t, parser));
+
+  if (!parser->spoiled && scpi_complete(&stream->request, parser->tokens) && stream->on_request != NULL) {
+    stream->on_request(&stream->request);
+  }
+
+  stream->request = (scpi_request_t){ .valid = 1U };
+}
+
+/**
+ * @brief Checks that a line matched a whole command.
+ *
+ * @param request Fields matched
+ * @param tokens Fields in the line
+ * @return int 1 if the path ends on a leaf with no field left over
+ */
+static int scpi_complete(const scpi_request_t *request, uint32_t tokens)
+{
+  const uint8_t command = request->fields[0];
+  const uint8_t reg = request->fields[1];
+  const uint32_t expected = (command == SCPI_SET && reg != SCPI_REGISTER_MD) ? SCPI_FIELDS : SCPI_FIELDS - 1U;
+
+  return request->valid && request->depth == expected && tokens == expected;
+}
+
+/**
+ * @brief Reads a decimal or 0x prefixed hexadecimal field.
+ *
+ * @param token Field, ended by a colon, a line ending or the NUL
+ * @param value Where the value is stored
+ * @return int 0 on success, -1 on an empty, malformed or out of range field
+ */
+static int scpi_number(const char *token, uint32_t *value)
+{
+  uint32_t base = 10U;
+  uint64_t result = 0U;
+
+  if (token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+    base = 16U;
+    token += 2;
+  }
+
+  if (scpi_is_end(*token)) {
+    return -1;
+  }
+
+  for (; !scpi_is_end(*token); token++) {
+    const char c = *token;
+    uint32_t digit;
+
+    if (c >= '0' && c <= '9') {
+      digit = (uint32_t)(c - '0');
+    } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+      digit = (uint32_t)((c | 0x20) - 'a') + 10U;
+    } else {
+      return -1;
+    }
+
+    if (digit >= base) {
+      return -1;
+    }
+
+    result = result * base + digit;
+    if (result > UINT32_MAX) {
+      return -1;
+    }
+  }
+
+  *value = (uint32_t)result;
+  return 0;
+}
+
+/**
+ * @brief Checks the length returned by snprintf.
+ *
+ * @param size Size of the buffer
+ * @param length Length returned by snprintf
+ * @return int Length, -1 if the answer did not fit
+ */
+static int scpi_answer(uint32_t size, int length)
+{
+  return (length > 0 && (uint32_t)length < size) ? length : -1;
+}
+
+/**
+ * @brief Checks for the end of a field, streams match the fields in place, before their separator or line ending.
+ *
+ * @param c Character
+ * @return int 1 at the end of a field
+ */
+static int scpi_is_end(char c)
+{
+  return c == ':' || c == '\0' || c == '\r' || c == '\n';
+}
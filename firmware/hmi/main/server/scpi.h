@@ -0,0 +1,149 @@
+#ifndef __SCPI_H__
+#define __SCPI_H__
+
+#include <stdint.h>
+
+#include "server.h"
+#include "parser.h"
+
+/**
+ * SCPI-like text commands of docs/protocol.md, parsed with the Lib/Parser tree engine.
+ *
+ * A command is a line of colon separated numbers, `C:R:S[:VV]`, decimal or 0x prefixed hexadecimal, ended by a line
+ * feed or a carriage return. Values are in milli-units, as in `load_control_t`. The lines share the UART with the
+ * binary frames, which always start with the non ASCII SERVER_SYNC_BYTE.
+ *
+ * Queries are answered with a text line, sets and unrecognized commands are not, so the answers of one side can
+ * never be taken as commands by the other.
+ *
+ * Lines are either executed whole with scpi_execute(), or parsed as they arrive with a scpi_stream_t, which hands
+ * every complete command to its owner for scpi_request_execute().
+ */
+
+/** Longest command line, longer ones are dropped */
+#define SCPI_LINE_MAX 32U
+
+/** Room needed for the longest answer */
+#define SCPI_RESPONSE_MAX 96U
+
+/**
+ * @enum scpi_command
+ * @brief First field, C.
+ */
+typedef enum scpi_command
+{
+  SCPI_QUERY = 0x0U, /**< Query the value of a register */
+  SCPI_SET = 0x1U,   /**< Set the value of a register */
+} scpi_command_t;
+
+/**
+ * @enum scpi_register
+ * @brief Second field, R.
+ */
+typedef enum scpi_register
+{
+  SCPI_REGISTER_ID = 0x0U, /**< Identification */
+  SCPI_REGISTER_IN = 0x1U, /**< Input enable */
+  SCPI_REGISTER_MD = 0x2U, /**< Operating mode */
+  SCPI_REGISTER_LV = 0x3U, /**< Set point levels */
+  SCPI_REGISTER_ST = 0x4U, /**< Status */
+} scpi_register_t;
+
+/**
+ * @enum scpi_subregister
+ * @brief Third field, S. The modes follow the order of load_mode_t, one up.
+ */
+typedef enum scpi_subregister
+{
+  SCPI_SUBREGISTER_GENERAL = 0x0U, /**< Whole register */
+  SCPI_SUBREGISTER_CC = 0x1U,      /**< Constant Current */
+  SCPI_SUBREGISTER_CV = 0x2U,      /**< Constant Voltage */
+  SCPI_SUBREGISTER_CR = 0x3U,      /**< Constant Resistance */
+  SCPI_SUBREGISTER_CP = 0x4U,      /**< Constant Power */
+} scpi_subregister_t;
+
+/**
+ * @brief Side executing the commands, the load or the panel.
+ */
+typedef struct scpi_target
+{
+  const char *identification;                                /**< Answer to the ID query */
+  void (*get_control)(load_control_t *control);              /**< Copies the settings in effect */
+  void (*get_measurement)(load_measurement_t *measurement);  /**< Copies the last measurement */
+  int (*set)(const load_command_t *command);                 /**< Applies a setting, 0 on success, -1 if rejected */
+} scpi_target_t;
+
+/** Fields of the longest command, C:R:S:VV */
+#define SCPI_FIELDS 4U
+
+/**
+ * @brief Command matched by the tree
+ */
+typedef struct scpi_request
+{
+  uint8_t fields[SCPI_FIELDS - 1U]; /**< C, R and S */
+  uint32_t depth;                   /**< Fields matched, the value included */
+  uint32_t value;                   /**< VV */
+  uint8_t valid;                    /**< Cleared by a malformed value */
+} scpi_request_t;
+
+/**
+ * @brief Commands parsed as their bytes arrive
+ */
+typedef struct scpi_stream
+{
+  parser_stream_t parser;                             /**< Position in the tree */
+  scpi_request_t request;                             /**< Command being parsed */
+  void (*on_request)(const scpi_request_t *request);  /**< Receives every complete command */
+} scpi_stream_t;
+
+/** Prototypes */
+
+/**
+ * @brief Parses and executes a command line.
+ *
+ * @param target Side executing the command
+ * @param line Command, without the line ending, need not be NUL terminated
+ * @param length Command length
+ * @param response Buffer for the answer, SCPI_RESPONSE_MAX bytes are enough
+ * @param size Size of the buffer
+ * @return int Answer length, line feed included, 0 for an applied set, -1 on an unrecognized or rejected command
+ */
+int scpi_execute(const scpi_target_t *target, const char *line, uint32_t length, char *response, uint32_t size);
+
+/**
+ * @brief Sets up a stream of command lines.
+ *
+ * @param stream Stream
+ * @param on_request Receives every complete command, from scpi_stream_feed()
+ */
+void scpi_stream_init(scpi_stream_t *stream, void (*on_request)(const scpi_request_t *request));
+
+/**
+ * @brief Drops the command in progress, after bytes were lost.
+ *
+ * @param stream Stream
+ */
+void scpi_stream_reset(scpi_stream_t *stream);
+
+/**
+ * @brief Parses the next bytes of the line stream, in place.
+ *
+ * @param stream Stream
+ * @param data Bytes received, in any chunks, lines ended by a line feed or a carriage return
+ * @param length Bytes in data
+ */
+void scpi_stream_feed(scpi_stream_t *stream, const char *data, uint32_t length);
+
+/**
+ * @brief Executes a complete command.
+ *
+ * @param target Side executing the command
+ * @param request Command handed by a stream
+ * @param response Buffer for the answer, SCPI_RESPONSE_MAX bytes are enough
+ * @param size Size of the buffer
+ * @return int Answer length, line feed included, 0 for an applied set, -1 on a rejected command
+ */
+int scpi_request_execute(const scpi_target_t *target, const scpi_request_t *request, char *response, uint32_t size);
+
+#endif /** !__SCPI_H__ */
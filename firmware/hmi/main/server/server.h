@@ -1,6 +1,7 @@
 #ifndef __SERVER_H__
 #define __SERVER_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 /** Comment this line to use in the Panel module */
@@ -13,8 +14,27 @@
  *        - CR: Constant Resistance
  *        - CP: Constant Power
  *
- * The panel always transfers a whole `load_control_t` struct, and the load module transfers back a whole `load_state_t`
- * struct.
+ * The panel transfers its `load_control_t` struct, and the load module transfers back its `load_measurement_t` struct.
+ * Both go in v2 frames:
+ *
+ *   | sync | length | type | seq | payload (length bytes) | crc16 (LE) |
+ *
+ * The CRC-16/CCITT-FALSE covers length, type, seq and payload. State frames carry either the whole struct or a delta
+ * against the last state sent: a bit mask of the changed 32-bit words followed by those words. The receiver drops
+ * deltas after a sequence gap until the next whole struct, which is sent every SERVER_KEYFRAME_INTERVAL frames.
+ *
+ * Single settings also go as `load_command_t` commands as soon as they change. The load applies them on its next
+ * control period and answers each with a `load_ack_t` holding the value in effect, so the panel learns when and how
+ * a change was applied without waiting for the state frames.
+ *
+ * Several loads may share one link with a controller. Frames to and from a given load are addressed, they have
+ * SERVER_MSG_ADDRESSED set in their type and an address byte after the sequence, covered by the CRC:
+ *
+ *   | sync | length | type | seq | address | payload (length bytes) | crc16 (LE) |
+ *
+ * Plain frames are taken by every load, they are the broadcasts of a bus and all the frames of a point to point
+ * link. A load with an address only transmits when polled and then always sends whole state structs, as the
+ * controller can't keep delta references for all the loads of the bus.
  */
 
 /**
@@ -23,11 +43,35 @@
  */
 typedef enum load_parser_state
 {
-  PARSER_WAIT_START = 0U,
+  PARSER_WAIT_SYNC = 0U,
+  PARSER_WAIT_LENGTH,
+  PARSER_WAIT_TYPE,
+  PARSER_WAIT_SEQ,
+  PARSER_WAIT_ADDRESS,
   PARSER_WAIT_DATA,
-  PARSER_WAIT_CS,
+  PARSER_WAIT_CRC_LOW,
+  PARSER_WAIT_CRC_HIGH,
 } load_parser_state_t;
 
+/**
+ * @enum server_msg_type
+ * @brief Frame types.
+ */
+typedef enum server_msg_type
+{
+  SERVER_MSG_CONTROL = 0x01U,           /**< Whole `load_control_t`, panel to load */
+  SERVER_MSG_CONTROL_DELTA = 0x02U,     /**< Changed `load_control_t` words, panel to load */
+  SERVER_MSG_COMMAND = 0x03U,           /**< `load_command_t`, panel to load */
+  SERVER_MSG_POLL = 0x04U,              /**< No payload, the addressed load answers with its pending frames */
+  SERVER_MSG_SYNC = 0x05U,              /**< No payload, every load applies its staged commands at once */
+  SERVER_MSG_MEASUREMENT = 0x11U,       /**< Whole `load_measurement_t`, load to panel */
+  SERVER_MSG_MEASUREMENT_DELTA = 0x12U, /**< Changed `load_measurement_t` words, load to panel */
+  SERVER_MSG_TELEMETRY = 0x13U,         /**< `load_telemetry_t` batch, load to panel */
+  SERVER_MSG_ACK = 0x14U,               /**< `load_ack_t`, load to panel */
+  SERVER_MSG_WAVEFORM = 0x21U,          /**< `load_waveform_t`, panel to load */
+  SERVER_MSG_TELEMETRY_CONFIG = 0x22U,  /**< `load_telemetry_config_t`, panel to load */
+} server_msg_type_t;
+
 /**
  * @enum load_mode
  * @brief Load operating modes.
@@ -89,24 +133,182 @@ typedef struct load_state
 } load_state_t;
 
 /**
- * @brief Structure representing the control settings sent from the panel to the load.
+ * @enum load_command_key
+ * @brief Settings a command changes.
+ */
+typedef enum load_command_key
+{
+  COMMAND_ENABLE = 0U, /**< Enable flag */
+  COMMAND_MODE,        /**< Operating mode, load_mode_t */
+  COMMAND_CC,          /**< Constant Current set point value */
+  COMMAND_CV,          /**< Constant Voltage set point value */
+  COMMAND_CR,          /**< Constant Resistance set point value */
+  COMMAND_CP,          /**< Constant Power set point value */
+  COMMAND_KEY_COUNT
+} load_command_key_t;
+
+/**
+ * @enum load_ack_status
+ * @brief Outcome of a command.
+ */
+typedef enum load_ack_status
+{
+  ACK_APPLIED = 0U, /**< The control loop runs with the new setting */
+  ACK_OVERRIDDEN,   /**< Stored, but the waveform player owns the set points while it runs */
+  ACK_REJECTED      /**< Unknown setting or invalid value, nothing changed */
+} load_ack_status_t;
+
+/**
+ * @brief Structure representing a single setting change sent from the panel to the load.
+ */
+/** Command flag, the command is held until the next SERVER_MSG_SYNC, then applied and acknowledged */
+#define COMMAND_FLAG_STAGED 0x01U
+
+typedef struct load_command
+{
+  uint16_t id;    /**< Identifier chosen by the panel, echoed by the acknowledgement */
+  uint8_t key;    /**< Setting, load_command_key_t */
+  uint8_t flags;  /**< COMMAND_FLAG_* */
+  uint32_t value; /**< Enable flag, load_mode_t or set point value in milli-units */
+} load_command_t;
+
+/**
+ * @brief Structure representing the acknowledgement of a command, sent from the load to the panel.
+ */
+typedef struct load_ack
+{
+  uint16_t id;           /**< Identifier of the command */
+  uint8_t key;           /**< Setting, load_command_key_t */
+  uint8_t status;        /**< Outcome, load_ack_status_t */
+  uint32_t value;        /**< Value in effect after the command, in the units of the command */
+  uint32_t timestamp_us; /**< Time the control loop took the command, on the telemetry time base */
+  uint32_t latency_us;   /**< Time from the reception of the command to the control loop taking it */
+} load_ack_t;
+
+/** Points carried by a single waveform message */
+#define WAVEFORM_CHUNK_POINTS 8U
+
+/** Points the load waveform table can hold */
+#define WAVEFORM_TABLE_POINTS 256U
+
+/**
+ * @enum waveform_command
+ * @brief Waveform player commands, sent from the panel to the load.
  */
-typedef struct panel_to_load
+typedef enum waveform_command
 {
-  uint32_t magic_word;  /**< Magic word to verify the struct */
-  load_control_t data;  /**< Control settings */
-  uint32_t checksum;    /**< Checksum of the struct */
-} panel_to_load_t;
+  WAVEFORM_LOAD = 0U,   /**< Store `count` points at `offset` of the table */
+  WAVEFORM_LOAD_SAMPLES, /**< Store `count` uniformly sampled values at `offset`, all in `mode` every `period_ms` */
+  WAVEFORM_START,       /**< Play the first `count` points `loops` times (0: forever) on `trigger` */
+  WAVEFORM_STOP         /**< Stop playing */
+} waveform_command_t;
 
 /**
- * @brief Structure representing the load state sent from the load to the panel.
+ * @enum waveform_trigger
+ * @brief Waveform player start conditions.
  */
-typedef struct load_to_panel
+typedef enum waveform_trigger
 {
-  uint32_t magic_word;      /**< Magic word to verify the struct */
-  load_measurement_t data;  /**< Load state */
-  uint32_t checksum;        /**< Checksum of the struct */
-} load_to_panel_t;
+  WAVEFORM_TRIGGER_NOW = 0U, /**< Start right away */
+  WAVEFORM_TRIGGER_ENABLE    /**< Start when the panel enables the load */
+} waveform_trigger_t;
+
+/**
+ * @brief Structure representing a single waveform step.
+ */
+typedef struct waveform_point
+{
+  uint32_t value_milli; /**< Set point value in milli-units */
+  uint16_t duration_ms; /**< Time the set point is held, in milliseconds */
+  uint8_t mode;         /**< Operating mode, load_mode_t */
+  uint8_t enable;       /**< Enable flag (1: enabled, 0: disabled) */
+} waveform_point_t;
+
+/**
+ * @brief Structure representing a waveform player command sent from the panel to the load.
+ */
+typedef struct load_waveform
+{
+  uint32_t command;   /**< Command, waveform_command_t */
+  uint32_t offset;    /**< First table index of the points or samples */
+  uint32_t count;     /**< Number of points or samples */
+  uint32_t mode;      /**< Operating mode of the samples, load_mode_t */
+  uint32_t period_ms; /**< Sample period in milliseconds */
+  uint32_t loops;     /**< Number of repetitions, 0 loops forever */
+  uint32_t trigger;   /**< Start condition, waveform_trigger_t */
+  union {
+    waveform_point_t points[WAVEFORM_CHUNK_POINTS];             /**< Points for WAVEFORM_LOAD */
+    uint32_t samples_milli[WAVEFORM_CHUNK_POINTS * 2U];         /**< Values for WAVEFORM_LOAD_SAMPLES */
+  };
+} load_waveform_t;
+
+/** Samples carried by a single telemetry frame */
+#define TELEMETRY_BATCH_MAX 12U
+
+/**
+ * @enum telemetry_mode
+ * @brief Telemetry streaming modes.
+ */
+typedef enum telemetry_mode
+{
+  TELEMETRY_OFF = 0U,  /**< No streaming */
+  TELEMETRY_FILTERED,  /**< Samples averaged over the decimation window */
+  TELEMETRY_RAW        /**< Every voltage and current conversion pair, at the time of the conversion */
+} telemetry_mode_t;
+
+/**
+ * @brief Structure representing the telemetry settings sent from the panel to the load.
+ */
+typedef struct load_telemetry_config
+{
+  uint8_t mode;        /**< Streaming mode, telemetry_mode_t */
+  uint8_t batch;       /**< Samples per frame, 1 to TELEMETRY_BATCH_MAX */
+  uint16_t decimation; /**< Control periods per sample, conversion pairs in raw mode, at least 1 */
+} load_telemetry_config_t;
+
+/**
+ * @brief Structure representing a single telemetry sample.
+ */
+typedef struct telemetry_sample
+{
+  uint32_t timestamp_us;      /**< Sample time in microseconds since boot, wraps */
+  uint32_t voltage_milli;     /**< Input voltage in milli-volts */
+  uint32_t current_milli;     /**< Input current in milli-amperes */
+  int16_t temperature_centi;  /**< Temperature in centi-degrees Celsius */
+  uint16_t dac_code;          /**< Code on the DAC */
+} telemetry_sample_t;
+
+/**
+ * @brief Structure representing a batch of telemetry samples sent from the load to the panel.
+ *        Only the first `count` samples are transferred.
+ */
+typedef struct load_telemetry
+{
+  uint8_t mode;        /**< Streaming mode of the samples, telemetry_mode_t */
+  uint8_t count;       /**< Number of samples */
+  uint16_t decimation; /**< Control periods, or conversion pairs in raw mode, per sample */
+  uint32_t dropped;    /**< Samples dropped since the stream was configured, the link was too slow */
+  telemetry_sample_t samples[TELEMETRY_BATCH_MAX]; /**< Samples, oldest first */
+} load_telemetry_t;
+
+/** Telemetry batch header, before the samples */
+#define TELEMETRY_HEADER_SIZE offsetof(load_telemetry_t, samples)
+
+/** Buckets of a latency histogram, bucket i counts latencies below 2^i microseconds, the last one the rest */
+#define SERVER_LATENCY_BUCKETS 20U
+
+/**
+ * @brief Latency histogram of the commands, kept by the load from reception to application and by the panel for
+ *        the round trips.
+ */
+typedef struct server_latency
+{
+  uint32_t count;                            /**< Number of latencies recorded */
+  uint32_t min_us;                           /**< Lowest latency */
+  uint32_t max_us;                           /**< Highest latency */
+  uint64_t sum_us;                           /**< Sum of the latencies, for the mean */
+  uint32_t buckets[SERVER_LATENCY_BUCKETS];  /**< Counts by power of two of microseconds */
+} server_latency_t;
 
 /** Definitions */
 
@@ -114,50 +316,269 @@ typedef struct load_to_panel
   #define TX_DATA_TYPE load_measurement_t
   #define RX_DATA_TYPE load_control_t
 
-  #define TX_MSG_TYPE load_to_panel_t
-  #define RX_MSG_TYPE panel_to_load_t
-
-  #define TX_MAGIC_WORD 0x2B2B2B2B
-  #define RX_MAGIC_WORD 0x2D2D2D2D
+  #define TX_MSG_FULL SERVER_MSG_MEASUREMENT
+  #define TX_MSG_DELTA SERVER_MSG_MEASUREMENT_DELTA
+  #define RX_MSG_FULL SERVER_MSG_CONTROL
+  #define RX_MSG_DELTA SERVER_MSG_CONTROL_DELTA
 #else
   #define TX_DATA_TYPE load_control_t
   #define RX_DATA_TYPE load_measurement_t
 
-  #define TX_MSG_TYPE panel_to_load_t
-  #define RX_MSG_TYPE load_to_panel_t
-
-  #define TX_MAGIC_WORD 0x2D2D2D2D
-  #define RX_MAGIC_WORD 0x2B2B2B2B
+  #define TX_MSG_FULL SERVER_MSG_CONTROL
+  #define TX_MSG_DELTA SERVER_MSG_CONTROL_DELTA
+  #define RX_MSG_FULL SERVER_MSG_MEASUREMENT
+  #define RX_MSG_DELTA SERVER_MSG_MEASUREMENT_DELTA
 #endif
 
 #define TX_DATA_SIZE sizeof(TX_DATA_TYPE)
 #define RX_DATA_SIZE sizeof(RX_DATA_TYPE)
 
-#define TX_MSG_SIZE sizeof(TX_MSG_TYPE)
-#define RX_MSG_SIZE sizeof(RX_MSG_TYPE)
+#define SERVER_SYNC_BYTE 0xA5U
+/** Sync, length, type and seq */
+#define SERVER_HEADER_SIZE 4U
+/** Address byte of the addressed frames, between the header and the payload */
+#define SERVER_ADDRESS_SIZE 1U
+#define SERVER_CRC_SIZE 2U
+/** Full telemetry batches are the largest payload */
+#define SERVER_PAYLOAD_MAX sizeof(load_telemetry_t)
+#define SERVER_FRAME_SIZE_MAX (SERVER_HEADER_SIZE + SERVER_ADDRESS_SIZE + SERVER_PAYLOAD_MAX + SERVER_CRC_SIZE)
+
+/** Set on the type of addressed frames */
+#define SERVER_MSG_ADDRESSED 0x80U
+/** Address of the plain frames, every load takes them */
+#define SERVER_ADDRESS_BROADCAST 0x00U
+
+/** Frames between two whole state structs */
+#define SERVER_KEYFRAME_INTERVAL 8U
+
+/**
+ * @brief View of a complete frame, in place in the buffer it was received in.
+ *        Frames found in a ring buffer may wrap around its end.
+ */
+typedef struct server_frame
+{
+  const uint8_t *buffer; /**< Buffer holding the frame */
+  uint32_t size;         /**< Buffer size, offsets wrap around it */
+  uint32_t start;        /**< Offset of the sync byte */
+  uint8_t length;        /**< Payload length */
+  uint8_t type;          /**< Frame type, server_msg_type_t, without SERVER_MSG_ADDRESSED */
+  uint8_t seq;           /**< Sequence number */
+  uint8_t address;       /**< Load the frame goes to or comes from, SERVER_ADDRESS_BROADCAST for plain frames */
+  uint8_t payload;       /**< Offset of the payload from the sync byte */
+} server_frame_t;
 
 /**
- * @brief Parses a single byte of data from the expected message.
+ * @brief Parses a single byte of a v2 frame, copying it to an internal buffer.
  *
  * @param byte Byte to be parsed
- * @return uint8_t* NULL if message is not complete, pointer to the message if complete
+ * @return const server_frame_t* NULL if the frame is not complete or its CRC is wrong, the frame if complete.
+ *         It is valid until the next call.
+ */
+const server_frame_t *parse_byte(uint8_t byte);
+
+/**
+ * @brief Locates the next valid frame in place among the received bytes of a ring buffer.
+ *        Bytes that can't start a valid frame are skipped, an incomplete frame is left for the next call.
+ *
+ * @param ring Ring buffer
+ * @param size Ring buffer size
+ * @param head Offset of the first byte not consumed yet, moved past the frame or the skipped bytes
+ * @param tail Offset of the next byte to be received
+ * @param frame View of the frame found, valid until the ring overwrites it
+ * @return int 1 if a frame was found, 0 otherwise
+ */
+int server_frame_find(const uint8_t *ring, uint32_t size, uint32_t *head, uint32_t tail, server_frame_t *frame);
+
+/**
+ * @brief Checks whether a valid frame starts at a given offset of a ring buffer.
+ *        Lets a receiver tell frames from other traffic sharing the link, such as text commands.
+ *
+ * @param ring Ring buffer
+ * @param size Ring buffer size
+ * @param start Offset of the candidate sync byte
+ * @param tail Offset of the next byte to be received
+ * @param frame View of the frame found, valid until the ring overwrites it
+ * @return int 1 if a frame starts there, 0 if more bytes are needed to tell, -1 if no frame starts there
+ */
+int server_frame_at(const uint8_t *ring, uint32_t size, uint32_t start, uint32_t tail, server_frame_t *frame);
+
+/**
+ * @brief Checks whether a valid frame starts at a given offset of a ring buffer, as server_frame_at() does.
+ *        The frame is not taken: the sequence of the received frames is left as it was, so a receiver can look
+ *        ahead for a frame without making the one it consumes next look out of sequence.
+ *
+ * @param ring Ring buffer
+ * @param size Ring buffer size
+ * @param start Offset of the candidate sync byte
+ * @param tail Offset of the next byte to be received
+ * @return int 1 if a frame starts there, 0 if more bytes are needed to tell, -1 if no frame starts there
+ */
+int server_frame_check(const uint8_t *ring, uint32_t size, uint32_t start, uint32_t tail);
+
+/**
+ * @brief Whether parse_byte() is waiting for a sync byte, the other bytes it gets then belong to no frame.
+ *
+ * @return int 1 between frames, 0 inside one
+ */
+int parse_idle(void);
+
+/**
+ * @brief Size of a complete frame, from the sync byte to the CRC.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @return uint32_t Frame size
+ */
+uint32_t server_frame_size(const server_frame_t *frame);
+
+/**
+ * @brief Sets the address of the frames built next.
+ *
+ * @param address Own address on the load, destination on the controller, SERVER_ADDRESS_BROADCAST for plain frames
+ */
+void server_set_address(uint8_t address);
+
+/**
+ * @brief Type of a complete frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @return server_msg_type_t Frame type
  */
-uint8_t *parse_byte(uint8_t byte);
+server_msg_type_t server_frame_type(const server_frame_t *frame);
 
 /**
- * @brief Prepares a data struct to be transmitted.
+ * @brief Prepares a state frame to be transmitted, a delta against the last one when possible.
+ *        Addressed frames are always whole.
  *
  * @param data Data struct to be transmitted
- * @param tx_buffer Buffer to store the data ready to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_data(const TX_DATA_TYPE *data, uint8_t *tx_buffer);
+
+/**
+ * @brief Applies a received state frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param data Pointer to the struct the frame is applied to
+ * @return int 0 on success, -1 on a wrong type or a delta while out of sync
+ */
+int rx_data(const server_frame_t *frame, RX_DATA_TYPE *data);
+
+/**
+ * @brief Records a latency in a histogram.
+ *
+ * @param latency Histogram
+ * @param latency_us Latency in microseconds
+ */
+void server_latency_record(server_latency_t *latency, uint32_t latency_us);
+
+#ifdef LOAD_MODULE
+/**
+ * @brief Prepares a telemetry batch frame to be transmitted.
+ *
+ * @param telemetry Batch to be transmitted, only its first `count` samples are sent
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_telemetry(const load_telemetry_t *telemetry, uint8_t *tx_buffer);
+
+/**
+ * @brief Prepares a command acknowledgement frame to be transmitted.
+ *
+ * @param ack Acknowledgement to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
  */
-void tx_data(TX_DATA_TYPE *data, uint8_t *tx_buffer);
+uint32_t tx_ack(const load_ack_t *ack, uint8_t *tx_buffer);
 
 /**
- * @brief Extracts the data from a received buffer.
+ * @brief Extracts a command from a received frame.
  *
- * @param rx_buffer Buffer containing the received data
- * @param data Pointer to the struct where the data will be stored
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param command Pointer to the struct where the command will be stored
+ * @return int 0 on success, -1 on a wrong type or size
  */
-int rx_data(uint8_t *rx_buffer, RX_DATA_TYPE *data);
+int rx_command(const server_frame_t *frame, load_command_t *command);
+
+/**
+ * @brief Extracts the telemetry settings from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param config Pointer to the struct where the settings will be stored
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_telemetry_config(const server_frame_t *frame, load_telemetry_config_t *config);
+
+/**
+ * @brief Extracts a waveform command from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param waveform Pointer to the struct where the command will be stored
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_waveform(const server_frame_t *frame, load_waveform_t *waveform);
+#else
+/**
+ * @brief Prepares a waveform command frame to be transmitted.
+ *
+ * @param waveform Waveform command to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_waveform(const load_waveform_t *waveform, uint8_t *tx_buffer);
+
+/**
+ * @brief Prepares a command frame to be transmitted.
+ *
+ * @param command Command to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_command(const load_command_t *command, uint8_t *tx_buffer);
+
+/**
+ * @brief Prepares a poll frame, the addressed load answers with its pending acknowledgements and telemetry and ends
+ *        with a whole measurement.
+ *
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_poll(uint8_t *tx_buffer);
+
+/**
+ * @brief Prepares a sync frame, always plain so that every load applies its staged commands on the same frame.
+ *
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_sync(uint8_t *tx_buffer);
+
+/**
+ * @brief Extracts a command acknowledgement from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param ack Pointer to the struct where the acknowledgement will be stored
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_ack(const server_frame_t *frame, load_ack_t *ack);
+
+/**
+ * @brief Prepares a telemetry settings frame to be transmitted.
+ *
+ * @param config Settings to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_telemetry_config(const load_telemetry_config_t *config, uint8_t *tx_buffer);
+
+/**
+ * @brief Extracts a telemetry batch from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param telemetry Pointer to the struct where the batch will be stored, samples past `count` are left untouched
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_telemetry(const server_frame_t *frame, load_telemetry_t *telemetry);
+#endif
 
 #endif /** !__SERVER_H__ */
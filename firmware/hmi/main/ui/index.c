@@ -14,6 +14,15 @@ lv_obj_t *h_value_voltage_spinbox;
 lv_obj_t *h_value_resistance_spinbox;
 lv_obj_t *h_value_power_spinbox;
 
+/** Globals */
+
+/** What the widgets show, the spinboxes start at 0 */
+static view_cell_t index_current_cell = { 0, true };
+static view_cell_t index_voltage_cell = { 0, true };
+static view_cell_t index_resistance_cell = { 0, true };
+static view_cell_t index_power_cell = { 0, true };
+static view_text_t index_mode_text = { "CC" };
+
 /** Forward Decl */
 
 static void init_enable_led(lv_obj_t *scr);
@@ -46,6 +55,23 @@ void ui_index_window()
   init_value_power_spinbox(h_scr_ui_index);
 }
 
+/**
+ * @brief Shows a new view of the load, the caller holds the LVGL mutex
+ *
+ * @param view View
+ * @return void
+ */
+void ui_index_view_apply(const ui_index_view_t *view)
+{
+  view_spinbox_set(h_value_current_spinbox, &index_current_cell, view->current);
+  view_spinbox_set(h_value_voltage_spinbox, &index_voltage_cell, view->voltage);
+  view_spinbox_set(h_value_resistance_spinbox, &index_resistance_cell, view->resistance);
+  view_spinbox_set(h_value_power_spinbox, &index_power_cell, view->power);
+  if (view->mode != NULL) {
+    view_label_set(h_value_mode_label, &index_mode_text, view->mode);
+  }
+}
+
 void init_display_label_spinbox(
     lv_obj_t *scr,
     lv_obj_t **spinbox,
@@ -88,7 +114,7 @@ static void init_enable_led(lv_obj_t *scr)
 static void init_value_mode_label(lv_obj_t *scr)
 {
   h_value_mode_label = lv_label_create(scr);
-  lv_label_set_text(h_value_mode_label, "CC");
+  lv_label_set_text_static(h_value_mode_label, index_mode_text.shown);
   lv_obj_align(h_value_mode_label, LV_ALIGN_TOP_LEFT, 15, 15);
 }
 
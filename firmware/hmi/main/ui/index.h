@@ -3,6 +3,22 @@
 
 #include "lvgl.h"
 
+#include "ui/view.h"
+
+/** Typedefs */
+
+/**
+ * @brief What the index window shows of the load, widgets are only touched for the fields that changed
+ */
+typedef struct ui_index_view
+{
+  int32_t current;     /**< Measured current in tenths of amperes */
+  int32_t voltage;     /**< Measured voltage in tenths of volts */
+  int32_t resistance;  /**< Measured resistance in tenths of ohms */
+  int32_t power;       /**< Measured power in tenths of watts */
+  const char *mode;    /**< Operating mode, static text, NULL keeps the one shown */
+} ui_index_view_t;
+
 /** Handlers */
 
 extern lv_obj_t *h_scr_ui_index;
@@ -25,6 +41,14 @@ extern lv_obj_t *h_value_power_spinbox;
  */
 void ui_index_window();
 
+/**
+ * @brief Shows a new view of the load, the caller holds the LVGL mutex
+ *
+ * @param view View
+ * @return void
+ */
+void ui_index_view_apply(const ui_index_view_t *view);
+
 void init_display_label_spinbox(
   lv_obj_t *scr,
   lv_obj_t **spinbox,
@@ -20,6 +20,12 @@ lv_chart_series_t *h_stream_series_voltage;
 
 /** Globals */
 
+/** What the widgets show, the spinboxes start at 0 and the LED off */
+static view_cell_t stream_desired_cell = { 0, true };
+static view_cell_t stream_measured_cell = { 0, true };
+static view_cell_t stream_enable_cell = { 0, true };
+static view_text_t stream_mode_text = { "CC" };
+
 /** Prototypes */
 static void ui_stream_window_en_led(lv_obj_t *scr);
 static void ui_stream_window_mode_label(lv_obj_t *scr);
@@ -44,6 +50,22 @@ void ui_stream_window()
   ui_stream_window_msg_box(h_scr_ui_stream);
 }
 
+/**
+ * @brief Shows a new view of the playback, the caller holds the LVGL mutex
+ *
+ * @param view View
+ * @return void
+ */
+void ui_stream_view_apply(const ui_stream_view_t *view)
+{
+  view_spinbox_set(h_stream_desired_spinbox, &stream_desired_cell, view->desired);
+  view_spinbox_set(h_stream_measured_spinbox, &stream_measured_cell, view->measured);
+  view_led_set(h_stream_led_enable, &stream_enable_cell, view->enable);
+  if (view->mode != NULL) {
+    view_label_set(h_stream_mode_label, &stream_mode_text, view->mode);
+  }
+}
+
 void ui_stream_window_open_msg()
 {
   lv_obj_clear_flag(h_stream_msg_box, LV_OBJ_FLAG_HIDDEN);
@@ -81,7 +103,7 @@ static void ui_stream_window_en_led(lv_obj_t *scr)
 static void ui_stream_window_mode_label(lv_obj_t *scr)
 {
   h_stream_mode_label = lv_label_create(scr);
-  lv_label_set_text(h_stream_mode_label, "CC");
+  lv_label_set_text_static(h_stream_mode_label, stream_mode_text.shown);
   lv_obj_align(h_stream_mode_label, LV_ALIGN_TOP_LEFT, 5, 15);
 }
 
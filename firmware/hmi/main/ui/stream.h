@@ -3,6 +3,8 @@
 
 #include "lvgl.h"
 
+#include "ui/view.h"
+
 /** General Config */
 
 /** Chart is 5 min */
@@ -10,6 +12,19 @@
 /** 300 points */
 #define STREAM_CHART_POINTS 300
 
+/** Typedefs */
+
+/**
+ * @brief What the stream window shows of the playback, widgets are only touched for the fields that changed
+ */
+typedef struct ui_stream_view
+{
+  int32_t desired;   /**< Set point of the point played, in tenths */
+  int32_t measured;  /**< Measured value in the mode of the point, in tenths */
+  const char *mode;  /**< Operating mode of the point, static text, NULL keeps the one shown */
+  bool enable;       /**< Enable flag of the point */
+} ui_stream_view_t;
+
 /** Handlers */
 
 extern lv_obj_t *h_scr_ui_stream;
@@ -32,6 +47,14 @@ extern lv_chart_series_t *h_stream_series_voltage;
  */
 void ui_stream_window();
 
+/**
+ * @brief Shows a new view of the playback, the caller holds the LVGL mutex
+ *
+ * @param view View
+ * @return void
+ */
+void ui_stream_view_apply(const ui_stream_view_t *view);
+
 void ui_stream_window_open_msg();
 
 void ui_stream_window_close_msg();
@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "ui/view.h"
+
+/** Globals */
+
+/** Updated under the LVGL mutex, as the widgets */
+static view_stats_t view_stats = {0};
+
+/** Prototypes */
+static bool view_cell_update(view_cell_t *cell, int32_t value);
+
+/**
+ * @brief Sets the value of a spinbox if it shows another one, once clamped to its range
+ *
+ * @param spinbox Spinbox
+ * @param cell Value shown by the spinbox
+ * @param value New value
+ * @return true The spinbox was updated
+ * @return false The spinbox already showed the value
+ */
+bool view_spinbox_set(lv_obj_t *spinbox, view_cell_t *cell, int32_t value)
+{
+  /** Values out of range show as the bound */
+  const lv_spinbox_t *range = (const lv_spinbox_t *)spinbox;
+  if (value > range->range_max) {
+    value = range->range_max;
+  } else if (value < range->range_min) {
+    value = range->range_min;
+  }
+
+  if (!view_cell_update(cell, value)) {
+    return false;
+  }
+
+  lv_spinbox_set_value(spinbox, value);
+  return true;
+}
+
+/**
+ * @brief Sets the text of a label if it shows another one
+ *
+ * @param label Label
+ * @param view Text shown by the label
+ * @param text New text, with static storage as the cell keeps a pointer to it
+ * @return true The label was updated
+ * @return false The label already showed the text
+ */
+bool view_label_set(lv_obj_t *label, view_text_t *view, const char *text)
+{
+  if (view->shown != NULL && strcmp(view->shown, text) == 0) {
+    view_stats.skipped++;
+    return false;
+  }
+
+  view->shown = text;
+  view_stats.applied++;
+  lv_label_set_text_static(label, text);
+  return true;
+}
+
+/**
+ * @brief Turns a LED on or off if it isn't already
+ *
+ * @param led LED
+ * @param cell State shown by the LED
+ * @param on New state
+ * @return true The LED was updated
+ * @return false The LED already showed the state
+ */
+bool view_led_set(lv_obj_t *led, view_cell_t *cell, bool on)
+{
+  if (!view_cell_update(cell, on ? 1 : 0)) {
+    return false;
+  }
+
+  if (on) {
+    lv_led_on(led);
+  } else {
+    lv_led_off(led);
+  }
+  return true;
+}
+
+/**
+ * @brief Copies the counters of the widget updates
+ *
+ * @param stats Output counters
+ * @return void
+ */
+void view_get_stats(view_stats_t *stats)
+{
+  *stats = view_stats;
+}
+
+/** Implementations */
+
+/**
+ * @brief Records the new value of a cell
+ *
+ * @param cell Cell
+ * @param value New value
+ * @return true The value changed, the widget is to be updated
+ * @return false The widget already shows the value
+ */
+static bool view_cell_update(view_cell_t *cell, int32_t value)
+{
+  if (cell->valid && cell->shown == value) {
+    view_stats.skipped++;
+    return false;
+  }
+
+  cell->shown = value;
+  cell->valid = true;
+  view_stats.applied++;
+  return true;
+}
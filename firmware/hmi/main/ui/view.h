@@ -0,0 +1,82 @@
+#ifndef __UI_VIEW_H__
+#define __UI_VIEW_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lvgl.h"
+
+/**
+ * @brief View-model of the widgets refreshed by the control tasks.
+ *
+ * Every setter of LVGL invalidates the widget, even when the text stays the same, and an invalidated area is rendered
+ * again and sent over SPI to the LCD. A cell keeps the value a widget shows, and the widget is only touched when the
+ * value, as the widget would show it, changes.
+ */
+
+/** Value shown by a spinbox or a LED */
+typedef struct view_cell
+{
+  int32_t shown; /**< Value shown, valid once set */
+  bool valid;    /**< The widget shows a value set through the cell */
+} view_cell_t;
+
+/** Text shown by a label */
+typedef struct view_text
+{
+  const char *shown; /**< Text shown, NULL until set */
+} view_text_t;
+
+/**
+ * @brief Counters of the widget updates
+ */
+typedef struct view_stats
+{
+  uint32_t applied; /**< Widgets touched, the value they show changed */
+  uint32_t skipped; /**< Updates dropped, the widget already showed the value */
+} view_stats_t;
+
+/** Prototypes */
+
+/**
+ * @brief Sets the value of a spinbox if it shows another one, once clamped to its range
+ *
+ * @param spinbox Spinbox
+ * @param cell Value shown by the spinbox
+ * @param value New value
+ * @return true The spinbox was updated
+ * @return false The spinbox already showed the value
+ */
+bool view_spinbox_set(lv_obj_t *spinbox, view_cell_t *cell, int32_t value);
+
+/**
+ * @brief Sets the text of a label if it shows another one
+ *
+ * @param label Label
+ * @param view Text shown by the label
+ * @param text New text, with static storage as the cell keeps a pointer to it
+ * @return true The label was updated
+ * @return false The label already showed the text
+ */
+bool view_label_set(lv_obj_t *label, view_text_t *view, const char *text);
+
+/**
+ * @brief Turns a LED on or off if it isn't already
+ *
+ * @param led LED
+ * @param cell State shown by the LED
+ * @param on New state
+ * @return true The LED was updated
+ * @return false The LED already showed the state
+ */
+bool view_led_set(lv_obj_t *led, view_cell_t *cell, bool on);
+
+/**
+ * @brief Copies the counters of the widget updates
+ *
+ * @param stats Output counters
+ * @return void
+ */
+void view_get_stats(view_stats_t *stats);
+
+#endif /** !__UI_VIEW_H__ */
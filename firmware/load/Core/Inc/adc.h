@@ -3,6 +3,12 @@
 
 /* ADS111x Driver*/
 #include "ads111x.h"
+/* Sample ring */
+#include "sample_ring.h"
+/* Digital filters */
+#include "filter.h"
+/* Fixed point */
+#include "fixed.h"
 
 /**
  * @brief ADC channels in order of the ADC multiplexer
@@ -17,33 +23,46 @@ typedef enum {
 } adc_channels_t;
 
 /**
- * @brief ADC average structure
- * 
+ * @brief ADC acquisition engine states
+ *
  */
-typedef struct
-{
-	/* Sum of samples */
-	float sum;
-	/* Number of samples */
-	uint32_t samples;
-	/* Average value */
-	float avg;
-
-} adc_average_t;
+typedef enum {
+	/* No I2C transaction in flight, waiting for ALERT */
+	ADC_STATE_IDLE,
+	/* Reading the conversion register */
+	ADC_STATE_READ_RESULT,
+	/* Writing next channel configuration and starting the conversion */
+	ADC_STATE_WRITE_CONFIG,
+} adc_state_t;
 
 /**
  * @brief ADC channel structure
- * 	Contains gain and value
+ * 	Contains gain and the ring of samples written by the acquisition engine
  */
 typedef struct
 {
 	/* Channel gain */
 	ads111x_gain_t gain;
-	/* Channel value */
-	adc_average_t value;
+	/* Channel samples */
+	sample_ring_t ring;
 
 } adc_channel_t;
 
+/**
+ * @brief ADC reader structure
+ * 	Each consumer (control, telemetry, fan) owns one and reads the channels at its own rate
+ */
+typedef struct
+{
+	/* Cursor on each channel ring */
+	sample_reader_t channels[ADC_CHANNELS_SIZE];
+	/* Filter of each channel, without stages the samples of an update are averaged */
+	filter_t filters[ADC_CHANNELS_SIZE];
+	/* Value of the channel on the last update, in microvolts */
+	int32_t value[ADC_CHANNELS_SIZE];
+
+} adc_reader_t;
+
 /**
  * @brief ADC structure
  * 	Contains I2C handler and channels
@@ -57,7 +76,23 @@ typedef struct
 	/* Last channel read */
 	uint8_t last_channel_index;
 	/* ADC all channels measured */
-	uint8_t all_channels_measured;
+	volatile uint8_t all_channels_measured;
+
+	/* Acquisition engine state */
+	volatile adc_state_t state;
+	/* Conversion ready arrived while the bus was busy */
+	volatile uint8_t conversion_pending;
+	/* Bus borrowed by another device on the same I2C */
+	volatile uint8_t bus_locked;
+	/* I2C transfer buffers, must live until the transfer completes */
+	uint8_t rx_buffer[2];
+	uint8_t tx_buffer[2];
+	/* Tick of the last engine activity, used by the watchdog */
+	volatile uint32_t last_activity_tick;
+	/* Number of completed conversions */
+	volatile uint32_t conversions;
+	/* Number of failed I2C transactions */
+	volatile uint32_t errors;
 } adc_t;
 
 /**
@@ -69,24 +104,95 @@ typedef struct
 HAL_StatusTypeDef adc_init(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *hadc);
 
 /**
- * @brief Measure a channel
- * 
- * @return HAL_StatusTypeDef HAL status
+ * @brief Conversion ready handler, must be called from the ALERT EXTI interrupt
+ * 	Starts the non blocking chain read result -> write next config -> start conversion
+ *
  */
-HAL_StatusTypeDef adc_measure(void);
+void adc_conversion_ready_callback(void);
 
-/** 
- * @brief Calculate average of all channels
-*/
-void adc_calculate_average(void);
+/**
+ * @brief Restart the acquisition chain if it stalled (I2C error or lost ALERT edge)
+ *
+ */
+void adc_watchdog(void);
 
 /**
- * @brief Get channel value
- * 
+ * @brief Borrow the I2C bus from the acquisition engine
+ * 	Waits the transaction in flight to finish and holds new ones until adc_bus_release()
+ *
+ * @return HAL_StatusTypeDef HAL_OK when the bus is free, HAL_TIMEOUT otherwise
+ */
+HAL_StatusTypeDef adc_bus_acquire(void);
+
+/**
+ * @brief Borrow the I2C bus from the acquisition engine without waiting, for the interrupts
+ * 	Fails while a transaction is in flight or the bus is borrowed, adc_bus_release() only after a success
+ *
+ * @return HAL_StatusTypeDef HAL_OK when the bus is borrowed, HAL_BUSY otherwise
+ */
+HAL_StatusTypeDef adc_bus_try_acquire(void);
+
+/**
+ * @brief Give the I2C bus back to the acquisition engine
+ *
+ */
+void adc_bus_release(void);
+
+/**
+ * @brief Number of conversions completed since initialization
+ *
+ */
+uint32_t adc_get_conversion_count(void);
+
+/**
+ * @brief Attach a reader to all channels, starting from the newest samples
+ * 	Filters start without stages, add them with filter_add_* on reader->filters[channel]
+ *
+ * @param reader Reader handler
+ */
+void adc_reader_init(adc_reader_t *reader);
+
+/**
+ * @brief Consume the samples acquired since the last update of this reader
+ * 	Each sample runs through the channel filter and the last output is kept, channels
+ * 	without filter stages average the new samples. Channels without new samples keep
+ * 	their previous value
+ *
+ * @param reader Reader handler
+ */
+void adc_reader_update(adc_reader_t *reader);
+
+/**
+ * @brief Consume the samples acquired since the last update of this reader, keeping the newest
+ * 	Skips the filters, channels without new samples keep their previous value
+ *
+ * @param reader Reader handler
+ */
+void adc_reader_update_latest(adc_reader_t *reader);
+
+/**
+ * @brief Get channel value with correction coefficients applied
+ *
+ * @param reader Reader handler
  * @param channel Channel
  * @return float Value
  */
-float adc_get_value(adc_channels_t channel);
+float adc_reader_get_value(const adc_reader_t *reader, adc_channels_t channel);
+
+/**
+ * @brief Get channel value with correction coefficients applied, without floating point
+ *
+ * @param reader Reader handler
+ * @param channel Channel
+ * @return q16_t Value in Q16.16
+ */
+q16_t adc_reader_get_value_q16(const adc_reader_t *reader, adc_channels_t channel);
+
+/**
+ * @brief Update the measurement reported to the panel
+ *
+ */
+void adc_update_measurement(void);
 
 /**
  * @brief ADC all channels measured
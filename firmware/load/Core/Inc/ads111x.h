@@ -42,6 +42,11 @@ typedef enum
  */
 extern const float ads111x_gain_values[];
 
+/**
+ * @brief Gain amplifier full scale in microvolts
+ */
+extern const int32_t ads111x_gain_microvolts[];
+
 /**
  * @brief Input multiplexer configuration (ADS1115 only)
  */
@@ -119,9 +124,25 @@ typedef enum
 	ADS111X_COMP_QUEUE_DISABLED //!< Disable comparator (default)
 } ads111x_comp_queue_t;
 
+/**
+ * @brief Configuration bits that rarely change, written in one transaction by ads111x_set_config
+ */
+typedef struct
+{
+	ads111x_mode_t mode;                   //!< Operational mode
+	ads111x_data_rate_t data_rate;         //!< Data rate
+	ads111x_comp_mode_t comp_mode;         //!< Comparator mode
+	ads111x_comp_polarity_t comp_polarity; //!< Comparator polarity
+	ads111x_comp_latch_t comp_latch;       //!< Comparator latch
+	ads111x_comp_queue_t comp_queue;       //!< Comparator queue
+} ads111x_config_t;
+
 
 /**
  * @brief Initialize the ADS111X device descriptor.
+ *        Loads the shadow configuration register used by every other configuration access.
+ *        The driver serves a single device: once initialized, configuration calls on another bus
+ *        fail with HAL_ERROR, and so does a second initialization on another bus.
  * @param hi2c Pointer to an I2C_HandleTypeDef structure.
  * @param addr I2C address of the ADS111X device.
  * @return HAL status indicating the result of the operation.
@@ -328,4 +349,66 @@ HAL_StatusTypeDef ads111x_set_comp_high_thresh(I2C_HandleTypeDef *hi2c, int16_t
  */
 HAL_StatusTypeDef ads111x_enable_conv_ready(I2C_HandleTypeDef *dev, uint32_t state);
 
+/**
+ * @brief Read mode, data rate and comparator settings.
+ *        Served from the shadow configuration register, no I2C transaction.
+ * @param hi2c Pointer to an I2C_HandleTypeDef structure.
+ * @param config Pointer to store the configuration.
+ * @return HAL status indicating the result of the operation.
+ */
+HAL_StatusTypeDef ads111x_get_config(I2C_HandleTypeDef *hi2c, ads111x_config_t *config);
+
+/**
+ * @brief Write mode, data rate and comparator settings in a single I2C transaction.
+ * @param hi2c Pointer to an I2C_HandleTypeDef structure.
+ * @param config Configuration to be written.
+ * @return HAL status indicating the result of the operation.
+ */
+HAL_StatusTypeDef ads111x_set_config(I2C_HandleTypeDef *hi2c, const ads111x_config_t *config);
+
+/**
+ * @brief Select the input and the gain and start a conversion in a single I2C transaction.
+ * @param hi2c Pointer to an I2C_HandleTypeDef structure.
+ * @param mux The multiplexer setting to be set (ads111x_mux_t).
+ * @param gain The gain setting to be set (ads111x_gain_t).
+ * @return HAL status indicating the result of the operation.
+ */
+HAL_StatusTypeDef ads111x_configure(I2C_HandleTypeDef *hi2c, ads111x_mux_t mux, ads111x_gain_t gain);
+
+/**
+ * @brief Select the input and the gain and start a conversion without blocking.
+ *        Mode, data rate and comparator bits are kept from the shadow configuration register.
+ *        Completion is reported by HAL_I2C_MemTxCpltCallback, which must call ads111x_configure_cplt.
+ * @param hi2c Pointer to an I2C_HandleTypeDef structure.
+ * @param mux The multiplexer setting to be set (ads111x_mux_t).
+ * @param gain The gain setting to be set (ads111x_gain_t).
+ * @param buf Buffer of 2 bytes used for the transfer, must stay valid until completion.
+ * @return HAL status indicating the result of the operation.
+ */
+HAL_StatusTypeDef ads111x_configure_it(I2C_HandleTypeDef *hi2c, ads111x_mux_t mux, ads111x_gain_t gain, uint8_t *buf);
+
+/**
+ * @brief Commit a configuration written by ads111x_configure_it to the shadow register.
+ *        Called once the transfer completed, a failed write leaves the shadow untouched.
+ * @param hi2c Pointer to an I2C_HandleTypeDef structure.
+ * @param buf Buffer passed to ads111x_configure_it.
+ */
+void ads111x_configure_cplt(I2C_HandleTypeDef *hi2c, const uint8_t *buf);
+
+/**
+ * @brief Start a non blocking read of the conversion register.
+ *        Completion is reported by HAL_I2C_MemRxCpltCallback.
+ * @param hi2c Pointer to an I2C_HandleTypeDef structure.
+ * @param buf Buffer of 2 bytes that receives the raw register, must stay valid until completion.
+ * @return HAL status indicating the result of the operation.
+ */
+HAL_StatusTypeDef ads111x_read_value_it(I2C_HandleTypeDef *hi2c, uint8_t *buf);
+
+/**
+ * @brief Decode the raw conversion register read by ads111x_read_value_it.
+ * @param buf Buffer of 2 bytes filled by ads111x_read_value_it.
+ * @return Conversion result.
+ */
+int16_t ads111x_decode_value(const uint8_t *buf);
+
 #endif /* __ADS111X_H__ */
\ No newline at end of file
@@ -3,8 +3,89 @@
 
 #include "stm32f1xx_hal.h"
 #include "mcp4725.h"
+#include "adc.h"
 
 #include "uart.h"
+#include "timestamp.h"
+
+/**
+ * @brief Control loop frequency, the loop runs from a timer interrupt
+ *
+ */
+#define CONTROL_FREQUENCY_HZ 200U
+#define CONTROL_FREQUENCY_MIN_HZ 16U
+#define CONTROL_FREQUENCY_MAX_HZ 10000U
+
+/**
+ * @brief Limits of the current command for the modes running on the analog constant current loop
+ *
+ */
+#define CONTROL_CURRENT_MAX 10.0f
+#define CONTROL_VOLTAGE_MIN 0.5f
+#define CONTROL_RESISTANCE_MIN 0.1f
+
+/**
+ * @brief Measured resistance reported below the minimum current
+ *
+ */
+#define CONTROL_CURRENT_MIN 0.001f
+#define CONTROL_RESISTANCE_MAX 30000.0f
+
+/**
+ * @brief Entries of the constant power gain schedule
+ *
+ */
+#define CONTROL_CP_SCHEDULE_SIZE 5U
+
+/**
+ * @brief Numeric backend of the control path, selected at build time
+ * 	- CONTROL_FIXED_POINT: Q16.16 values, Q1.31 gains, Q4.28 actions; no soft float on the control path
+ * 	- otherwise: float, kept as the reference implementation
+ *
+ */
+#ifdef CONTROL_FIXED_POINT
+typedef q16_t control_value_t;
+typedef q31_t control_gain_t;
+typedef q28_t control_action_t;
+
+#define CONTROL_VALUE(x) Q16(x)
+#define CONTROL_GAIN(x) Q31(x)
+#define CONTROL_ACTION(x) Q28(x)
+#define CONTROL_VALUE_FROM_MILLI(x) q16_from_milli(x)
+#define CONTROL_VALUE_TO_MILLI(x) ((int32_t)(((int64_t)(x) * 1000 + 32768) >> 16))
+#define CONTROL_VALUE_MUL(a, b) q16_mul((a), (b))
+#define CONTROL_VALUE_DIV(a, b) q16_div((a), (b))
+#define CONTROL_GAIN_MUL(gain, value) q31_mul_q16((gain), (value))
+#define CONTROL_GAIN_SCALE(gain, x) q31_mul((gain), (x))
+#define CONTROL_ADD(a, b) fixed_saturate((int64_t)(a) + (b))
+#define CONTROL_SUB(a, b) fixed_saturate((int64_t)(a) - (b))
+#define CONTROL_RATIO(num, den) ((q16_t)(((uint64_t)(num) << 16) / (den)))
+#define CONTROL_SCALE(x, ratio) q16_mul((x), (ratio))
+#define CONTROL_UNSCALE(x, ratio) q16_div((x), (ratio))
+#define CONTROL_ADC_VALUE(reader, channel) adc_reader_get_value_q16((reader), (channel))
+#define CONTROL_DAC_SET(dac, action) mcp4725_set_voltage_q16((dac), Q16(3.3f), q28_to_q16(action), false)
+#else
+typedef float control_value_t;
+typedef float control_gain_t;
+typedef float control_action_t;
+
+#define CONTROL_VALUE(x) (x)
+#define CONTROL_GAIN(x) (x)
+#define CONTROL_ACTION(x) (x)
+#define CONTROL_VALUE_FROM_MILLI(x) ((x) / 1000.0f)
+#define CONTROL_VALUE_TO_MILLI(x) ((int32_t)((x) * 1000.0f + 0.5f))
+#define CONTROL_VALUE_MUL(a, b) ((a) * (b))
+#define CONTROL_VALUE_DIV(a, b) ((a) / (b))
+#define CONTROL_GAIN_MUL(gain, value) ((gain) * (value))
+#define CONTROL_GAIN_SCALE(gain, x) ((gain) * (x))
+#define CONTROL_ADD(a, b) ((a) + (b))
+#define CONTROL_SUB(a, b) ((a) - (b))
+#define CONTROL_RATIO(num, den) ((float)(num) / (float)(den))
+#define CONTROL_SCALE(x, ratio) ((x) * (ratio))
+#define CONTROL_UNSCALE(x, ratio) ((x) / (ratio))
+#define CONTROL_ADC_VALUE(reader, channel) adc_reader_get_value((reader), (channel))
+#define CONTROL_DAC_SET(dac, action) mcp4725_set_voltage((dac), 3.3f, (action), false)
+#endif
 
 
 typedef enum control_mode {
@@ -17,38 +98,83 @@ typedef enum control_mode {
 
 typedef struct
 {
-	float max;
-	float min;
+	control_action_t max;
+	control_action_t min;
 } boundary_t;
 
+/**
+ * @brief Gain schedule entry, used from its voltage up to the next entry's
+ *
+ */
 typedef struct
 {
-	float kp; // Proportional gain
-	float ki; // Integral gain
-	float kd; // Derivative gain
+	control_value_t voltage;
+	float kp;
+	float ki;
+} control_schedule_t;
+
+/**
+ * @brief Gain schedule entry converted for the control frequency, switching entries in the loop is a copy
+ *
+ */
+typedef struct
+{
+	control_gain_t kp;
+	control_gain_t ki_dt;
+} control_schedule_gains_t;
+
+/**
+ * @brief Velocity form PID, the output itself is the integrator
+ * 	u[k] = u[k-1] + kp * (e[k] - e[k-1]) + ki * dt * e[k] + kd / dt * (e[k] - 2 * e[k-1] + e[k-2])
+ * 	The unsaturated output tracks the applied one with gain kt (back-calculation),
+ * 	and the applied output is rate limited and clamped to the output boundary.
+ *
+ */
+typedef struct
+{
+	control_gain_t kp; // Proportional gain
+	control_gain_t ki_dt; // Integral gain divided by the control frequency
+	control_gain_t kd; // Derivative gain
+	control_gain_t kt; // Back-calculation gain, per sample
 
-	float control_frequency; // Control frequency
+	float ki; // Integral gain as configured, ki_dt is derived from it
+	float rate_limit; // Output rate limit per second as configured, 0 disables it
+	float control_frequency; // Nominal control frequency
 
-	boundary_t integral_boundary; // Integral boundary
 	boundary_t output_boundary;   // Output boundary
+	control_action_t rate_step; // Output rate limit per sample
 
-	float error_history[3];  // Store last error values for derivative calculation
-	float output_history[3]; // Store last output values for derivative calculation
-	float integral;		  // Integral term
-	uint32_t history_index;		  // Index for storing error history
-
-	float control_action;
+	control_value_t error_history[2];  // Last error values
+	control_action_t output; // Unsaturated output
+	control_action_t applied; // Output after rate limit and boundary
 
 } pid_controller_t;
 
 typedef struct
 {
-	float setpoint;
-	float measured_value;
-	float control_action;
+	control_value_t setpoint;
+	control_value_t measured_value;
+	control_action_t control_action;
 } control_io_t;
 
+/**
+ * @brief Control loop timing, in core clock cycles
+ * 	Mean values are sum / count
+ *
+ */
 typedef struct
+{
+	uint32_t period_min;
+	uint32_t period_max;
+	uint64_t period_sum;
+	uint32_t execution_min;
+	uint32_t execution_max;
+	uint64_t execution_sum;
+	uint32_t count;
+	uint32_t skipped; // Updates and setpoint steps dropped because the ADC engine held the I2C bus
+} control_stats_t;
+
+typedef struct control
 {
 	pid_controller_t pid[CONTROL_MODE_SIZE];
 
@@ -57,17 +183,34 @@ typedef struct
 	control_mode_t mode;
 
 	mcp4725_t *dac;
+
+	adc_reader_t adc_reader;
+
+	control_action_t dac_output; // Last output written to the DAC, seeds mode transfers
+	uint32_t cp_schedule_index; // Gain schedule entry in use by constant power
+	control_schedule_gains_t cp_schedule_gains[CONTROL_CP_SCHEDULE_SIZE]; // Constant power schedule, converted
+
+	TIM_HandleTypeDef *htim;
+	uint32_t period_cycles; // Nominal loop period
+	uint32_t last_start;	// Timestamp of the last loop start
+	control_stats_t stats;
 } control_t;
 
 
 
 HAL_StatusTypeDef control_init(control_t *control_handler, mcp4725_t *dac);
 
+HAL_StatusTypeDef control_start(control_t *control_handler, TIM_HandleTypeDef *htim, uint32_t frequency);
+
 void control_update(control_t *control_handler);
 
-void control_set_setpoint(control_t *control_handler, control_mode_t mode, float setpoint);
+void control_get_stats(control_t *control_handler, control_stats_t *stats);
+
+void control_reset_stats(control_t *control_handler);
+
+void control_set_setpoint(control_t *control_handler, control_mode_t mode, control_value_t setpoint);
 
-float control_get_setpoint(control_t *control_handler, control_mode_t mode);
+control_value_t control_get_setpoint(control_t *control_handler, control_mode_t mode);
 
 void control_set_mode(control_t *control_handler, control_mode_t mode);
 
@@ -76,6 +219,13 @@ void control_set_constants(control_t *control_handler, control_mode_t mode, floa
 void control_set_kp(control_t *control_handler, control_mode_t mode, float kp);
 void control_set_ki(control_t *control_handler, control_mode_t mode, float ki);
 void control_set_kd(control_t *control_handler, control_mode_t mode, float kd);
+void control_set_rate_limit(control_t *control_handler, control_mode_t mode, float rate_limit);
+
+void control_step_setpoint(control_t *control_handler, control_mode_t mode, control_value_t setpoint);
+
+control_mode_t control_mode_from_server(load_mode_t mode);
+
+void control_set_enable(control_t *control_handler, uint8_t enable);
 
 void control_set_from_server(control_t *control_handler, load_control_t *server_control);
 
@@ -0,0 +1,166 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * @brief Fixed point digital filters for ADC samples
+ * 	Samples are integers (microvolts), coefficients are Q15. No floating point is used so
+ * 	filters are cheap on the Cortex-M3 without FPU.
+ *
+ */
+
+/**
+ * @brief Maximum number of cascaded stages in a filter
+ *
+ */
+#define FILTER_STAGES_SIZE 3U
+
+/**
+ * @brief Maximum boxcar length
+ *
+ */
+#define FILTER_BOXCAR_MAX_SIZE 16U
+
+/**
+ * @brief Maximum median length
+ *
+ */
+#define FILTER_MEDIAN_MAX_SIZE 5U
+
+/**
+ * @brief Fractional bits kept in the IIR state to avoid dead band on small steps
+ *
+ */
+#define FILTER_IIR_STATE_SHIFT 8U
+
+/**
+ * @brief Convert a constant in [0, 1) to Q15
+ *
+ */
+#define FILTER_Q15(x) ((int16_t)((x) * 32768.0f))
+
+/**
+ * @brief Filter stage types
+ *
+ */
+typedef enum {
+	FILTER_BOXCAR,
+	FILTER_IIR,
+	FILTER_MEDIAN,
+} filter_type_t;
+
+/**
+ * @brief Moving average of the last N samples
+ *
+ */
+typedef struct
+{
+	int32_t buffer[FILTER_BOXCAR_MAX_SIZE];
+	int32_t sum;
+	uint8_t size;
+	uint8_t index;
+	uint8_t count;
+} filter_boxcar_t;
+
+/**
+ * @brief First order IIR, y += alpha * (x - y)
+ *
+ */
+typedef struct
+{
+	/* Q15 smoothing factor, higher is faster */
+	int16_t alpha;
+	/* Output with FILTER_IIR_STATE_SHIFT fractional bits */
+	int32_t state;
+	uint8_t primed;
+} filter_iir_t;
+
+/**
+ * @brief Median of the last 3 or 5 samples, rejects isolated spikes
+ *
+ */
+typedef struct
+{
+	int32_t buffer[FILTER_MEDIAN_MAX_SIZE];
+	uint8_t size;
+	uint8_t index;
+	uint8_t count;
+} filter_median_t;
+
+/**
+ * @brief Filter stage
+ *
+ */
+typedef struct
+{
+	filter_type_t type;
+	union
+	{
+		filter_boxcar_t boxcar;
+		filter_iir_t iir;
+		filter_median_t median;
+	};
+} filter_stage_t;
+
+/**
+ * @brief Filter pipeline, stages are applied in the order they were added
+ *
+ */
+typedef struct
+{
+	filter_stage_t stages[FILTER_STAGES_SIZE];
+	uint8_t size;
+} filter_t;
+
+/**
+ * @brief Initialize a filter without stages (output follows the input)
+ *
+ * @param filter Filter handler
+ */
+void filter_init(filter_t *filter);
+
+/**
+ * @brief Clear the history of all stages, keeping their configuration
+ *
+ * @param filter Filter handler
+ */
+void filter_reset(filter_t *filter);
+
+/**
+ * @brief Append a moving average stage
+ *
+ * @param filter Filter handler
+ * @param size Number of averaged samples, 1 to FILTER_BOXCAR_MAX_SIZE
+ * @return HAL_StatusTypeDef HAL status
+ */
+HAL_StatusTypeDef filter_add_boxcar(filter_t *filter, uint8_t size);
+
+/**
+ * @brief Append a first order IIR stage
+ *
+ * @param filter Filter handler
+ * @param alpha Q15 smoothing factor, see FILTER_Q15
+ * @return HAL_StatusTypeDef HAL status
+ */
+HAL_StatusTypeDef filter_add_iir(filter_t *filter, int16_t alpha);
+
+/**
+ * @brief Append a median stage
+ *
+ * @param filter Filter handler
+ * @param size Median length, 3 or 5
+ * @return HAL_StatusTypeDef HAL status
+ */
+HAL_StatusTypeDef filter_add_median(filter_t *filter, uint8_t size);
+
+/**
+ * @brief Run a sample through all stages
+ *
+ * @param filter Filter handler
+ * @param value Input sample
+ * @return int32_t Filtered sample
+ */
+int32_t filter_process(filter_t *filter, int32_t value);
+
+#endif // FILTER_H
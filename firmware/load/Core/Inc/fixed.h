@@ -0,0 +1,128 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+/**
+ * @brief Fixed point helpers for the STM32F103, which has no FPU
+ * 	- q16_t: Q16.16, physical values (volts, amperes, watts, ohms)
+ * 	- q28_t: Q4.28, small values that need resolution (DAC volts, controller outputs)
+ * 	- q31_t: Q1.31, gains in (-1, 1)
+ * 	Products use a 64 bit intermediate (single SMULL on Cortex-M3) and saturate.
+ *
+ */
+typedef int32_t q16_t;
+typedef int32_t q28_t;
+typedef int32_t q31_t;
+
+/**
+ * @brief Convert constants, meant for compile time literals
+ *
+ */
+#define Q16(x) ((q16_t)((x) * 65536.0f))
+#define Q28(x) ((q28_t)((x) * 268435456.0f))
+#define Q31(x) ((q31_t)((x) * 2147483648.0f))
+
+/**
+ * @brief Saturate a 64 bit intermediate to 32 bit
+ *
+ */
+static inline int32_t fixed_saturate(int64_t value)
+{
+	if (value > INT32_MAX)
+	{
+		return INT32_MAX;
+	}
+	if (value < INT32_MIN)
+	{
+		return INT32_MIN;
+	}
+	return (int32_t)value;
+}
+
+/**
+ * @brief Q16.16 multiplication
+ *
+ */
+static inline q16_t q16_mul(q16_t a, q16_t b)
+{
+	return fixed_saturate(((int64_t)a * b) >> 16);
+}
+
+/**
+ * @brief Q16.16 division, saturates on division by zero
+ *
+ */
+static inline q16_t q16_div(q16_t a, q16_t b)
+{
+	if (b == 0)
+	{
+		return a < 0 ? INT32_MIN : INT32_MAX;
+	}
+	return fixed_saturate(((int64_t)a * 65536) / b);
+}
+
+/**
+ * @brief Q1.31 gain times Q16.16 value, result in Q4.28
+ *
+ */
+static inline q28_t q31_mul_q16(q31_t gain, q16_t value)
+{
+	return fixed_saturate(((int64_t)gain * value) >> 19);
+}
+
+/**
+ * @brief Q1.31 gain times a value in any format, result in the same format
+ *
+ */
+static inline int32_t q31_mul(q31_t gain, int32_t value)
+{
+	return (int32_t)(((int64_t)gain * value) >> 31);
+}
+
+/**
+ * @brief Q4.28 to Q16.16
+ *
+ */
+static inline q16_t q28_to_q16(q28_t value)
+{
+	return value >> 12;
+}
+
+/**
+ * @brief Q16.16 to Q4.28, saturates outside of +-8
+ *
+ */
+static inline q28_t q16_to_q28(q16_t value)
+{
+	return fixed_saturate((int64_t)value * 4096);
+}
+
+/**
+ * @brief Micro units to Q16.16, multiplies by 2^32 * 65536 / 10^6
+ *
+ */
+static inline q16_t q16_from_micro(int32_t micro)
+{
+	return (q16_t)(((int64_t)micro * 281474977) >> 32);
+}
+
+/**
+ * @brief Milli units to Q16.16, multiplies by 65536 * 65536 / 10^3
+ *
+ */
+static inline q16_t q16_from_milli(int32_t milli)
+{
+	return fixed_saturate(((int64_t)milli * 4294967) >> 16);
+}
+
+/**
+ * @brief Q16.16 to milli units
+ *
+ */
+static inline int32_t q16_to_milli(q16_t value)
+{
+	return (int32_t)(((int64_t)value * 1000) >> 16);
+}
+
+#endif // FIXED_H
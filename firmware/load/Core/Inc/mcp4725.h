@@ -4,6 +4,7 @@
 #include "stm32f1xx_hal.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include "fixed.h"
 
 #define MCP4725_I2C_ADDR         0x60  // Default I2C address for MCP4725
 #define MCP4725_MAX_VALUE        4095  // 12-bit DAC maximum value
@@ -11,6 +12,7 @@
 typedef struct {
     I2C_HandleTypeDef *i2c_handle;  // Pointer to the I2C handle
     uint16_t addr;                  // MCP4725 device address
+    uint16_t output;                // Last code written to the DAC register
 } mcp4725_t;
 
 /**
@@ -94,4 +96,33 @@ HAL_StatusTypeDef mcp4725_get_voltage(mcp4725_t *dev, float vdd, bool eeprom, fl
  */
 HAL_StatusTypeDef mcp4725_set_voltage(mcp4725_t *dev, float vdd, float value, bool eeprom);
 
+/**
+ * @brief Set output voltage of MCP4725 without floating point
+ *
+ * @param dev Pointer to MCP4725 descriptor
+ * @param vdd Reference voltage in Q16.16 volts
+ * @param value Output voltage in Q16.16 volts
+ * @param eeprom If true, writes to EEPROM; otherwise writes to DAC register
+ * @return HAL status code
+ */
+HAL_StatusTypeDef mcp4725_set_voltage_q16(mcp4725_t *dev, q16_t vdd, q16_t value, bool eeprom);
+
+/**
+ * @brief Output code of a voltage, as mcp4725_set_voltage() writes it
+ *
+ * @param vdd Reference voltage in volts
+ * @param value Output voltage in volts, clamped to 0 and vdd
+ * @return uint16_t Output code
+ */
+uint16_t mcp4725_voltage_to_raw(float vdd, float value);
+
+/**
+ * @brief Output code of a voltage, as mcp4725_set_voltage_q16() writes it
+ *
+ * @param vdd Reference voltage in Q16.16 volts
+ * @param value Output voltage in Q16.16 volts, clamped to 0 and vdd
+ * @return uint16_t Output code
+ */
+uint16_t mcp4725_voltage_to_raw_q16(q16_t vdd, q16_t value);
+
 #endif /* MCP4725_H */
@@ -0,0 +1,102 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+
+/**
+ * @brief Number of samples kept by a ring, must be a power of two
+ *
+ */
+#define SAMPLE_RING_SIZE 64U
+#define SAMPLE_RING_MASK (SAMPLE_RING_SIZE - 1U)
+
+/**
+ * @brief Number of samples a reader can get, the slot the producer writes next is never read
+ *
+ */
+#define SAMPLE_RING_READABLE (SAMPLE_RING_SIZE - 1U)
+
+/**
+ * @brief Timestamped sample
+ *
+ */
+typedef struct
+{
+	/* Timestamp in core clock cycles */
+	uint32_t timestamp;
+	/* Sample value in microvolts */
+	int32_t value;
+} sample_t;
+
+/**
+ * @brief Sample ring
+ * 	Written by a single producer (interrupt) that never blocks: when full, the oldest
+ * 	sample is overwritten. Any number of readers consume it through their own cursor.
+ *
+ */
+typedef struct
+{
+	/* Samples storage */
+	sample_t samples[SAMPLE_RING_SIZE];
+	/* Number of samples written since initialization */
+	volatile uint32_t head;
+} sample_ring_t;
+
+/**
+ * @brief Sample ring reader
+ * 	Owned by a single consumer, readers never modify the ring
+ *
+ */
+typedef struct
+{
+	/* Ring being read */
+	const sample_ring_t *ring;
+	/* Number of samples consumed */
+	uint32_t tail;
+	/* Number of samples lost because the reader was too slow */
+	uint32_t overruns;
+} sample_reader_t;
+
+/**
+ * @brief Initialize an empty ring
+ *
+ * @param ring Ring handler
+ */
+void sample_ring_init(sample_ring_t *ring);
+
+/**
+ * @brief Push a sample, must only be called from the producer context
+ *
+ * @param ring Ring handler
+ * @param timestamp Sample timestamp
+ * @param value Sample value
+ */
+void sample_ring_push(sample_ring_t *ring, uint32_t timestamp, int32_t value);
+
+/**
+ * @brief Attach a reader to a ring, starting from the newest sample
+ *
+ * @param reader Reader handler
+ * @param ring Ring to be read
+ */
+void sample_reader_init(sample_reader_t *reader, const sample_ring_t *ring);
+
+/**
+ * @brief Number of samples available to the reader
+ *
+ * @param reader Reader handler
+ * @return uint32_t Available samples, at most SAMPLE_RING_READABLE
+ */
+uint32_t sample_reader_available(const sample_reader_t *reader);
+
+/**
+ * @brief Consume samples in order from oldest to newest
+ *
+ * @param reader Reader handler
+ * @param samples Buffer to store the samples
+ * @param size Buffer size
+ * @return uint32_t Number of samples read
+ */
+uint32_t sample_reader_read(sample_reader_t *reader, sample_t *samples, uint32_t size);
+
+#endif // SAMPLE_RING_H
@@ -0,0 +1,96 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "stm32f1xx_hal.h"
+#include "server.h"
+#include "control.h"
+#include "adc.h"
+
+/**
+ * @brief Telemetry streaming
+ * 	The control loop takes a sample every `decimation` periods and packs `batch` of them in a frame. In raw mode it
+ * 	drains the ADC rings instead and samples every `decimation` voltage and current conversion pair.
+ * 	Complete frames wait in a queue until the superloop sends them, samples are dropped when it is full.
+ *
+ */
+
+/**
+ * @brief Number of batches waiting to be sent, must be a power of two
+ *
+ */
+#define TELEMETRY_QUEUE_SIZE 4U
+#define TELEMETRY_QUEUE_MASK (TELEMETRY_QUEUE_SIZE - 1U)
+
+typedef struct
+{
+	/* Samples source, only used from the control loop */
+	adc_reader_t reader;
+	/* Settings in use */
+	load_telemetry_config_t config;
+	/* Settings received, applied by the control loop */
+	load_telemetry_config_t pending;
+	volatile uint8_t reconfigure;
+	/* Control periods, or conversion pairs in raw mode, since the last sample */
+	uint32_t periods;
+	/* Microseconds since boot, built from the cycle counter */
+	uint32_t time_us;
+	uint32_t last_cycles;
+	uint32_t cycles_remainder;
+	/* Samples in the batch being filled */
+	uint32_t filling;
+	/* Samples dropped since the last configuration */
+	uint32_t dropped;
+	/* Batches, filled by the control loop and sent by the superloop */
+	load_telemetry_t queue[TELEMETRY_QUEUE_SIZE];
+	/* Number of batches completed */
+	volatile uint32_t head;
+	/* Number of batches sent */
+	volatile uint32_t tail;
+} telemetry_t;
+
+/**
+ * @brief Telemetry fed by the control loop
+ *
+ */
+extern telemetry_t h_telemetry;
+
+/**
+ * @brief Initialize the telemetry, streaming off
+ *
+ * @param telemetry Telemetry handler
+ */
+void telemetry_init(telemetry_t *telemetry);
+
+/**
+ * @brief Change the streaming settings, applied on the next control period
+ *
+ * @param telemetry Telemetry handler
+ * @param config Settings
+ * @return HAL_StatusTypeDef HAL_ERROR on invalid settings
+ */
+HAL_StatusTypeDef telemetry_configure(telemetry_t *telemetry, const load_telemetry_config_t *config);
+
+/**
+ * @brief Take a sample if due, must be called from the control loop after control_update()
+ *
+ * @param telemetry Telemetry handler
+ * @param control_handler Control the DAC code is read from
+ */
+void telemetry_tick(telemetry_t *telemetry, const control_t *control_handler);
+
+/**
+ * @brief Oldest complete batch, must only be called from the superloop
+ *
+ * @param telemetry Telemetry handler
+ * @return const load_telemetry_t* NULL if none
+ */
+const load_telemetry_t *telemetry_peek(telemetry_t *telemetry);
+
+/**
+ * @brief Release the batch returned by telemetry_peek() once it is sent
+ *
+ * @param telemetry Telemetry handler
+ */
+void telemetry_release(telemetry_t *telemetry);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,41 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * @brief High resolution timestamps from the DWT cycle counter
+ * 	Counts core clock cycles and wraps every ~59 s at 72 MHz, compare with unsigned subtraction
+ *
+ */
+
+/**
+ * @brief Enable the DWT cycle counter
+ *
+ */
+static inline void timestamp_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Current timestamp in core clock cycles
+ *
+ */
+static inline uint32_t timestamp_get(void)
+{
+	return DWT->CYCCNT;
+}
+
+/**
+ * @brief Convert a timestamp difference to microseconds
+ *
+ */
+static inline uint32_t timestamp_to_us(uint32_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000U);
+}
+
+#endif // TIMESTAMP_H
@@ -4,10 +4,26 @@
 #include "server.h"
 #include "stm32f1xx_hal.h"
 
+/** Control loop, declared in control.h which includes this header */
+struct control;
+
+/** Address of the load on a bus, SERVER_ADDRESS_BROADCAST for a point to point link */
+#ifndef LOAD_BUS_ADDRESS
+#define LOAD_BUS_ADDRESS SERVER_ADDRESS_BROADCAST
+#endif
+
 extern load_state_t h_load_state;
 
+void uart_set_address(uint8_t address);
+
 void uart_init(UART_HandleTypeDef *huart_rx);
 
 void uart_transmit(void);
 
+void uart_get_control(load_control_t *control);
+
+void uart_acknowledge_commands(struct control *control_handler, const load_control_t *settings, uint8_t overridden);
+
+void uart_get_command_latency(server_latency_t *latency);
+
 #endif
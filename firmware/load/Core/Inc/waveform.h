@@ -0,0 +1,115 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include "stm32f1xx_hal.h"
+#include "server.h"
+#include "control.h"
+
+/**
+ * @brief Waveform player
+ * 	The panel uploads a table of (mode, setpoint, duration) points, or uniformly sampled values that
+ * 	are expanded to points, and the player steps through it from a timer interrupt.
+ *
+ */
+
+/**
+ * @brief Maximum number of points in the table
+ *
+ */
+#define WAVEFORM_POINTS_SIZE WAVEFORM_TABLE_POINTS
+
+/**
+ * @brief Player tick frequency, point durations are counted in ticks
+ *
+ */
+#define WAVEFORM_TICK_HZ 1000U
+
+/**
+ * @brief Player states
+ *
+ */
+typedef enum {
+	WAVEFORM_IDLE = 0,
+	WAVEFORM_ARMED,
+	WAVEFORM_RUNNING,
+} waveform_state_t;
+
+/**
+ * @brief Requests of the panel, the player takes them on its next tick
+ *
+ */
+typedef enum {
+	WAVEFORM_REQUEST_NONE = 0,
+	WAVEFORM_REQUEST_START,
+	WAVEFORM_REQUEST_STOP,
+} waveform_request_t;
+
+typedef struct
+{
+	waveform_point_t points[WAVEFORM_POINTS_SIZE];
+	/* Number of points loaded */
+	uint32_t size;
+	/* Number of points played */
+	uint32_t length;
+	/* Next point to play */
+	uint32_t index;
+	/* Ticks left on the current point */
+	uint32_t remaining;
+	/* Repetitions to play, 0 loops forever */
+	uint32_t loops;
+	/* Repetitions played */
+	uint32_t loop;
+	waveform_trigger_t trigger;
+	volatile waveform_state_t state;
+	/* Panel enable on the last tick, to detect edges */
+	uint8_t last_enable;
+	/* Last request of the panel and its parameters, until the next tick takes them */
+	volatile waveform_request_t request;
+	uint32_t request_length;
+	uint32_t request_loops;
+	waveform_trigger_t request_trigger;
+} waveform_t;
+
+/**
+ * @brief Player fed by the panel messages
+ *
+ */
+extern waveform_t h_waveform;
+
+/**
+ * @brief Initialize the player
+ *
+ * @param waveform Player handler
+ */
+void waveform_init(waveform_t *waveform);
+
+/**
+ * @brief Handle a waveform command from the panel
+ * 	The table can't be changed while the player is armed or running, unless a stop is pending. Start and stop are
+ * 	only checked here and taken by the next tick, so the panel never preempts the player in the middle of a step.
+ *
+ * @param waveform Player handler
+ * @param command Command
+ * @return HAL_StatusTypeDef HAL_BUSY while playing, HAL_ERROR on an invalid command
+ */
+HAL_StatusTypeDef waveform_handle(waveform_t *waveform, const load_waveform_t *command);
+
+/**
+ * @brief Step the player, called at WAVEFORM_TICK_HZ from the timer interrupt
+ * 	Must not preempt nor be preempted by control_update(). A falling panel enable stops the player.
+ *
+ * @param waveform Player handler
+ * @param control_handler Control the points are stepped into
+ * @param enable Panel enable
+ */
+void waveform_tick(waveform_t *waveform, control_t *control_handler, uint8_t enable);
+
+/**
+ * @brief Check if the player owns the control setpoints
+ *
+ * @param waveform Player handler
+ * @return uint8_t 1 if running
+ */
+uint8_t waveform_is_running(const waveform_t *waveform);
+
+#endif // WAVEFORM_H
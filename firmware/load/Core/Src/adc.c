@@ -7,6 +7,8 @@
 /* ADC header */
 #include "adc.h"
 #include "uart.h"
+/* Timestamps */
+#include "timestamp.h"
 
 /**
  * @brief ADC correction coefficients
@@ -20,6 +22,15 @@ static const float ADC_CORRECTION_COEFFICIENTS[ADC_CHANNELS_SIZE][2] = {
 	{0.0f, 1.0f},
 	{192.02738f, -72.69488f}};
 
+/**
+ * @brief ADC correction coefficients in Q16.16, same equation as the float ones
+ *
+ */
+static const q16_t ADC_CORRECTION_COEFFICIENTS_Q16[ADC_CHANNELS_SIZE][2] = {
+	{Q16(0.20919486f), Q16(31.65715446f)},
+	{Q16(-0.08353555f), Q16(11.22826758f)},
+	{Q16(0.0f), Q16(1.0f)}};
+
 static const uint8_t ADC_CHANNELS[] = {
 	ADS111X_MUX_0_GND,
 	ADS111X_MUX_1_GND,
@@ -27,6 +38,31 @@ static const uint8_t ADC_CHANNELS[] = {
 	ADS111X_MUX_3_GND,
 };
 
+/**
+ * @brief Number of channels read from the ADS111x, temperature is read by the internal ADC
+ *
+ */
+#define ADC_EXTERNAL_CHANNELS_SIZE (ADC_CHANNELS_SIZE - 1)
+
+/**
+ * @brief Maximum time without engine activity before the watchdog restarts a conversion
+ *  A conversion at 860 SPS takes ~1.2 ms
+ *
+ */
+#define ADC_WATCHDOG_TIMEOUT_MS 10U
+
+/**
+ * @brief Maximum time waiting for the transaction in flight when borrowing the bus
+ *
+ */
+#define ADC_BUS_TIMEOUT_MS 5U
+
+/**
+ * @brief Samples drained from a ring at once by a reader
+ *
+ */
+#define ADC_READER_CHUNK_SIZE 16U
+
 volatile uint16_t dma_adc_buffer[6];
 
 /**
@@ -35,6 +71,20 @@ volatile uint16_t dma_adc_buffer[6];
  */
 adc_t adc;
 
+/**
+ * @brief Reader used to report measurements to the panel
+ *
+ */
+static adc_reader_t telemetry_reader;
+
+/* Prototypes */
+static uint32_t adc_enter_critical(void);
+static void adc_exit_critical(uint32_t primask);
+static void adc_start_read(void);
+static void adc_start_conversion(void);
+static void adc_sample_temperature(void);
+static void adc_process_sample(int16_t value);
+
 /**
  * @brief Initialize ADC
  *
@@ -60,10 +110,22 @@ HAL_StatusTypeDef adc_init(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *hadc)
 	/* Save I2C handler */
 	adc.hi2c = hi2c;
 
-	/* Set adc ready queue to 1 sample */
-	if (ads111x_set_comp_queue(hi2c, ADS111X_COMP_QUEUE_1) != HAL_OK)
+	/* Samples are timestamped with the cycle counter */
+	timestamp_init();
+
+	/* Single shot at 860 SPS with ALERT asserted after each conversion */
+	const ads111x_config_t config = {
+		.mode = ADS111X_MODE_SINGLE_SHOT,
+		.data_rate = ADS111X_DATA_RATE_860,
+		.comp_mode = ADS111X_COMP_MODE_NORMAL,
+		.comp_polarity = ADS111X_COMP_POLARITY_LOW,
+		.comp_latch = ADS111X_COMP_LATCH_DISABLED,
+		.comp_queue = ADS111X_COMP_QUEUE_1,
+	};
+
+	if (ads111x_set_config(hi2c, &config) != HAL_OK)
 	{
-		LOG_ERROR("ads111x_set_comp_queue");
+		LOG_ERROR("ads111x_set_config");
 	}
 
 	/* Enable conversion ready */
@@ -72,35 +134,13 @@ HAL_StatusTypeDef adc_init(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *hadc)
 		LOG_ERROR("ads111x_enable_conv_ready");
 	}
 
-	/* Initialize in single mode */
-	if (ads111x_set_mode(hi2c, ADS111X_MODE_SINGLE_SHOT) != HAL_OK)
-	{
-		LOG_ERROR("ads111x_set_mode");
-	}
-
-	/* Initialize data rate */
-	if (ads111x_set_data_rate(hi2c, ADS111X_DATA_RATE_860) != HAL_OK)
-	{
-		LOG_ERROR("ads111x_set_data_rate");
-	}
-
 	/* Initialize on channel 0 */
-	if (ads111x_set_input_mux(hi2c, ADS111X_MUX_0_GND) != HAL_OK)
-	{
-		LOG_ERROR("ads111x_set_input_mux");
-	}
-	/* Save last channel */
 	adc.last_channel_index = 0;
 
-	/* Initialize gain */
-	if (ads111x_set_gain(hi2c, ADS111X_GAIN_4V096) != HAL_OK)
-	{
-		LOG_ERROR("ads111x_set_gain");
-	}
-	/* Start conversion */
-	if (ads111x_start_conversion(hi2c) != HAL_OK)
+	/* Select channel and gain and start conversion */
+	if (ads111x_configure(hi2c, ADS111X_MUX_0_GND, ADS111X_GAIN_4V096) != HAL_OK)
 	{
-		LOG_ERROR("ads111x_start_conversion");
+		LOG_ERROR("ads111x_configure");
 	}
 
 	/* Calibrate temperature sensor */
@@ -119,11 +159,19 @@ HAL_StatusTypeDef adc_init(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *hadc)
 	for (uint8_t i = 0; i < ADC_CHANNELS_SIZE; i++)
 	{
 		adc.channels[i].gain = ADS111X_GAIN_4V096;
-		adc.channels[i].value.samples = 0;
-		adc.channels[i].value.sum = 0;
-		adc.channels[i].value.avg = 0;
+		sample_ring_init(&adc.channels[i].ring);
 	}
 
+	adc_reader_init(&telemetry_reader);
+
+	/* Arm acquisition engine, ALERT of the conversion started above drives it from now on */
+	adc.conversion_pending = 0;
+	adc.bus_locked = 0;
+	adc.conversions = 0;
+	adc.errors = 0;
+	adc.last_activity_tick = HAL_GetTick();
+	adc.state = ADC_STATE_IDLE;
+
 	LOG_INFO(" OK.\n");
 	/* Adc initialized correctly */
 	return HAL_OK;
@@ -164,131 +212,347 @@ HAL_StatusTypeDef adc_set_gain(adc_channels_t channel, uint16_t value)
 }
 
 /**
- * @brief Measure a channel
+ * @brief Disable interrupts saving the previous state
  *
- * @return HAL_StatusTypeDef HAL status
  */
-HAL_StatusTypeDef adc_measure(void)
+static uint32_t adc_enter_critical(void)
 {
-	/* Temperature sensor uses ADC DMA */
-	if (adc.last_channel_index == ADC_TEMPERATURE)
-	{
-		for (uint8_t i = 0; i < sizeof(dma_adc_buffer) / sizeof(dma_adc_buffer[0]); i++)
-		{
-			float voltage = (float)dma_adc_buffer[i] * (3.778742f / 4095.0f);
-			adc.channels[adc.last_channel_index].value.sum += voltage;
-			adc.channels[adc.last_channel_index].value.samples++;
-		}
-		adc.last_channel_index = (adc.last_channel_index + 1) % (ADC_CHANNELS_SIZE - 1);
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	return primask;
+}
 
-		/* If all channels are measured set flag */
-		if (adc.last_channel_index == 0)
-		{
-			adc.all_channels_measured = 1;
-		}
-	}
+/**
+ * @brief Restore interrupts state saved by adc_enter_critical
+ *
+ */
+static void adc_exit_critical(uint32_t primask)
+{
+	__set_PRIMASK(primask);
+}
 
-	/* If conversion available */
-	uint8_t busy;
+/**
+ * @brief Start reading the conversion result
+ *
+ */
+static void adc_start_read(void)
+{
+	adc.state = ADC_STATE_READ_RESULT;
+	adc.last_activity_tick = HAL_GetTick();
 
-	if (ads111x_is_busy(adc.hi2c, &busy) != HAL_OK)
+	if (ads111x_read_value_it(adc.hi2c, adc.rx_buffer) != HAL_OK)
 	{
-		LOG_ERROR("ads111x_failed reading busy flag");
-		return HAL_ERROR;
+		adc.state = ADC_STATE_IDLE;
+		adc.errors++;
 	}
+}
+
+/**
+ * @brief Select the current channel and its gain and start the conversion in one write
+ *
+ */
+static void adc_start_conversion(void)
+{
+	adc.state = ADC_STATE_WRITE_CONFIG;
+	adc.last_activity_tick = HAL_GetTick();
 
-	if (busy)
+	if (ads111x_configure_it(adc.hi2c,
+							 ADC_CHANNELS[adc.last_channel_index],
+							 adc.channels[adc.last_channel_index].gain,
+							 adc.tx_buffer) != HAL_OK)
 	{
-		LOG_WARN("Aborting adc measurement because adc is busy\n");
-		return HAL_OK;
+		adc.state = ADC_STATE_IDLE;
+		adc.errors++;
 	}
+}
 
-	/* Read conversion result */
-	int16_t value;
-	if (ads111x_get_value(adc.hi2c, &value) != HAL_OK)
+/**
+ * @brief Sum the internal ADC samples of the temperature sensor
+ *
+ */
+static void adc_sample_temperature(void)
+{
+	const uint32_t size = sizeof(dma_adc_buffer) / sizeof(dma_adc_buffer[0]);
+	uint32_t sum = 0;
+
+	for (uint8_t i = 0; i < size; i++)
 	{
-		LOG_ERROR("ads111x_get_value");
-		return HAL_ERROR;
+		sum += dma_adc_buffer[i];
 	}
 
-	/* Convert to voltage */
-	float voltage = (float)value * (ads111x_gain_values[adc.channels[adc.last_channel_index].gain] / ADS111X_MAX_VALUE);
+	/* Average of the DMA buffer converted to microvolts */
+	int32_t microvolts = (int32_t)(((int64_t)sum * 3778742) / (4095 * size));
+	sample_ring_push(&adc.channels[ADC_TEMPERATURE].ring, timestamp_get(), microvolts);
+}
 
-	/* Sum the sample */
-	adc.channels[adc.last_channel_index].value.sum += voltage;
-	adc.channels[adc.last_channel_index].value.samples++;
+/**
+ * @brief Store a conversion result and select the next channel
+ *
+ */
+static void adc_process_sample(int16_t value)
+{
+	/* Convert to microvolts */
+	int32_t microvolts = (int32_t)(((int64_t)value * ads111x_gain_microvolts[adc.channels[adc.last_channel_index].gain]) / ADS111X_MAX_VALUE);
+
+	/* Store the sample */
+	sample_ring_push(&adc.channels[adc.last_channel_index].ring, timestamp_get(), microvolts);
 
 	adc_set_gain(adc.last_channel_index, value);
 
 	/* Read next channel */
-	adc.last_channel_index = (adc.last_channel_index + 1) % (ADC_CHANNELS_SIZE - 1);
+	adc.last_channel_index = (adc.last_channel_index + 1) % ADC_EXTERNAL_CHANNELS_SIZE;
 
 	/* If all channels are measured set flag */
 	if (adc.last_channel_index == 0)
 	{
+		adc_sample_temperature();
 		adc.all_channels_measured = 1;
 	}
+}
 
-	/* Select next channel */
-	if (ads111x_set_input_mux(adc.hi2c, ADC_CHANNELS[adc.last_channel_index]) != HAL_OK)
+/**
+ * @brief Conversion ready handler, called from the ALERT EXTI interrupt
+ *
+ */
+void adc_conversion_ready_callback(void)
+{
+	/* Bus is borrowed or a transaction is in flight, retry when it is released */
+	if (adc.bus_locked || adc.state != ADC_STATE_IDLE)
 	{
-		LOG_ERROR("ads111x_set_input_mux");
-		return HAL_ERROR;
+		adc.conversion_pending = 1;
+		return;
 	}
 
-	/* Select gain of the channel */
-	if (ads111x_set_gain(adc.hi2c, adc.channels[adc.last_channel_index].gain) != HAL_OK)
+	adc_start_read();
+}
+
+/**
+ * @brief Conversion register read complete, process it and start the next conversion
+ *
+ */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	/** We only care about our transactions */
+	if (hi2c != adc.hi2c || adc.state != ADC_STATE_READ_RESULT)
 	{
-		LOG_ERROR("ads111x_set_gain");
-		return HAL_ERROR;
+		return;
+	}
+
+	adc_process_sample(ads111x_decode_value(adc.rx_buffer));
+	adc_start_conversion();
+}
+
+/**
+ * @brief Configuration write complete, conversion is running
+ *
+ */
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	/** We only care about our transactions */
+	if (hi2c != adc.hi2c || adc.state != ADC_STATE_WRITE_CONFIG)
+	{
+		return;
 	}
 
-	/* Start conversion */
-	if (ads111x_start_conversion(adc.hi2c) != HAL_OK)
+	ads111x_configure_cplt(hi2c, adc.tx_buffer);
+
+	adc.conversions++;
+	adc.last_activity_tick = HAL_GetTick();
+	adc.state = ADC_STATE_IDLE;
+	adc.conversion_pending = 0;
+}
+
+/**
+ * @brief I2C error, drop the chain and let the watchdog restart it
+ *
+ */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	/** We only care about our transactions */
+	if (hi2c != adc.hi2c || adc.state == ADC_STATE_IDLE)
 	{
-		LOG_ERROR("ads111x_start_conversion");
-		return HAL_ERROR;
+		return;
+	}
+
+	adc.errors++;
+	adc.state = ADC_STATE_IDLE;
+}
+
+/**
+ * @brief Restart the acquisition chain if it stalled
+ *
+ */
+void adc_watchdog(void)
+{
+	uint32_t primask = adc_enter_critical();
+
+	if (!adc.bus_locked && adc.state == ADC_STATE_IDLE &&
+		(HAL_GetTick() - adc.last_activity_tick) > ADC_WATCHDOG_TIMEOUT_MS)
+	{
+		adc.conversion_pending = 0;
+		adc_start_conversion();
+	}
+
+	adc_exit_critical(primask);
+}
+
+/**
+ * @brief Borrow the I2C bus from the acquisition engine
+ *
+ */
+HAL_StatusTypeDef adc_bus_acquire(void)
+{
+	adc.bus_locked = 1;
+
+	/* Wait the chain in flight, it is short compared to a conversion */
+	uint32_t start = HAL_GetTick();
+	while (adc.state != ADC_STATE_IDLE)
+	{
+		if ((HAL_GetTick() - start) > ADC_BUS_TIMEOUT_MS)
+		{
+			return HAL_TIMEOUT;
+		}
 	}
 
 	return HAL_OK;
 }
 
 /**
- * @brief Calculate average of all channels
+ * @brief Borrow the I2C bus from the acquisition engine if it is free now
+ *
  */
-void adc_calculate_average(void)
+HAL_StatusTypeDef adc_bus_try_acquire(void)
 {
+	HAL_StatusTypeDef status = HAL_BUSY;
+	uint32_t primask = adc_enter_critical();
+
+	/* Not over a borrower either, its release would end this one */
+	if (adc.state == ADC_STATE_IDLE && !adc.bus_locked)
+	{
+		adc.bus_locked = 1;
+		status = HAL_OK;
+	}
+
+	adc_exit_critical(primask);
+
+	return status;
+}
+
+/**
+ * @brief Give the I2C bus back to the acquisition engine
+ *
+ */
+void adc_bus_release(void)
+{
+	uint32_t primask = adc_enter_critical();
+
+	adc.bus_locked = 0;
+
+	/* Serve the ALERT that arrived while the bus was borrowed */
+	if (adc.conversion_pending && adc.state == ADC_STATE_IDLE)
+	{
+		adc.conversion_pending = 0;
+		adc_start_read();
+	}
+
+	adc_exit_critical(primask);
+}
+
+/**
+ * @brief Number of conversions completed since initialization
+ *
+ */
+uint32_t adc_get_conversion_count(void)
+{
+	return adc.conversions;
+}
+
+/**
+ * @brief Attach a reader to all channels, starting from the newest samples
+ *
+ */
+void adc_reader_init(adc_reader_t *reader)
+{
+	for (uint8_t i = 0; i < ADC_CHANNELS_SIZE; i++)
+	{
+		sample_reader_init(&reader->channels[i], &adc.channels[i].ring);
+		filter_init(&reader->filters[i]);
+		reader->value[i] = 0;
+	}
+}
+
+/**
+ * @brief Consume the samples acquired since the last update of this reader
+ *
+ */
+void adc_reader_update(adc_reader_t *reader)
+{
+	sample_t samples[ADC_READER_CHUNK_SIZE];
+
 	/* Iterate over channels */
 	for (uint8_t i = 0; i < ADC_CHANNELS_SIZE; i++)
 	{
+		filter_t *filter = &reader->filters[i];
+		int64_t sum = 0;
+		int32_t filtered = 0;
+		uint32_t count = 0;
+		uint32_t read;
+
+		while ((read = sample_reader_read(&reader->channels[i], samples, ADC_READER_CHUNK_SIZE)) > 0)
+		{
+			for (uint32_t j = 0; j < read; j++)
+			{
+				filtered = filter_process(filter, samples[j].value);
+				sum += samples[j].value;
+			}
+			count += read;
+		}
+
 		/* Division by zero protection */
-		if (adc.channels[i].value.samples == 0)
+		if (count == 0)
 		{
 			continue;
 		}
 
-		/* Calculate average */
-		adc.channels[i].value.avg = adc.channels[i].value.sum / adc.channels[i].value.samples;
-
-		/* Reset sum and samples */
-		adc.channels[i].value.sum = 0;
-		adc.channels[i].value.samples = 0;
+		if (filter->size > 0)
+		{
+			reader->value[i] = filtered;
+		}
+		else
+		{
+			/* Calculate average */
+			reader->value[i] = (int32_t)(sum / (int32_t)count);
+		}
 	}
-	h_load_state.measurement.cc_milli = (uint32_t)(adc_get_value(ADC_INPUT_CURRENT) * 1000);
-	h_load_state.measurement.cv_milli = (uint32_t)(adc_get_value(ADC_INPUT_VOLTAGE) * 1000);
-	h_load_state.measurement.cr_milli = (uint32_t)(adc_get_value(ADC_INPUT_VOLTAGE) / adc_get_value(ADC_INPUT_CURRENT) * 1000);
-	h_load_state.measurement.cp_milli = (uint32_t)(adc_get_value(ADC_INPUT_VOLTAGE) * adc_get_value(ADC_INPUT_CURRENT) * 1000);
-	h_load_state.measurement.temp_milli = (uint32_t)(adc_get_value(ADC_TEMPERATURE) * 1000);
+}
+
+/**
+ * @brief Consume the samples acquired since the last update of this reader, keeping the newest
+ *
+ */
+void adc_reader_update_latest(adc_reader_t *reader)
+{
+	sample_t samples[ADC_READER_CHUNK_SIZE];
+
+	for (uint8_t i = 0; i < ADC_CHANNELS_SIZE; i++)
+	{
+		uint32_t read;
 
+		while ((read = sample_reader_read(&reader->channels[i], samples, ADC_READER_CHUNK_SIZE)) > 0)
+		{
+			reader->value[i] = samples[read - 1].value;
+		}
+	}
 }
 
 /**
  * @brief Get channel value
  *
+ * @param reader Reader handler
  * @param channel Channel
  * @return float Value
  */
-float adc_get_value(adc_channels_t channel)
+float adc_reader_get_value(const adc_reader_t *reader, adc_channels_t channel)
 {
 	/* Check if channel is valid */
 	if (channel >= ADC_CHANNELS_SIZE)
@@ -297,7 +561,7 @@ float adc_get_value(adc_channels_t channel)
 		return 0;
 	}
 
-	float value = adc.channels[channel].value.avg;
+	float value = (float)reader->value[channel] / 1000000.0f;
 
 	/* Apply correction coefficients */
 	value = ADC_CORRECTION_COEFFICIENTS[channel][1] * value + ADC_CORRECTION_COEFFICIENTS[channel][0];
@@ -306,13 +570,54 @@ float adc_get_value(adc_channels_t channel)
 	return value;
 }
 
+/**
+ * @brief Get channel value in Q16.16
+ *
+ * @param reader Reader handler
+ * @param channel Channel
+ * @return q16_t Value
+ */
+q16_t adc_reader_get_value_q16(const adc_reader_t *reader, adc_channels_t channel)
+{
+	/* Check if channel is valid */
+	if (channel >= ADC_CHANNELS_SIZE)
+	{
+		LOG_ERROR("Invalid channel");
+		return 0;
+	}
+
+	q16_t value = q16_from_micro(reader->value[channel]);
+
+	/* Apply correction coefficients */
+	return q16_mul(ADC_CORRECTION_COEFFICIENTS_Q16[channel][1], value) + ADC_CORRECTION_COEFFICIENTS_Q16[channel][0];
+}
+
+/**
+ * @brief Update the measurement reported to the panel
+ */
+void adc_update_measurement(void)
+{
+	adc_reader_update(&telemetry_reader);
+
+	float voltage = adc_reader_get_value(&telemetry_reader, ADC_INPUT_VOLTAGE);
+	float current = adc_reader_get_value(&telemetry_reader, ADC_INPUT_CURRENT);
+
+	h_load_state.measurement.cc_milli = (uint32_t)(current * 1000);
+	h_load_state.measurement.cv_milli = (uint32_t)(voltage * 1000);
+	h_load_state.measurement.cr_milli = (uint32_t)(voltage / current * 1000);
+	h_load_state.measurement.cp_milli = (uint32_t)(voltage * current * 1000);
+	h_load_state.measurement.temp_milli = (uint32_t)(adc_reader_get_value(&telemetry_reader, ADC_TEMPERATURE) * 1000);
+}
+
 /**
  * @brief ADC all channels measured
  *
  */
 uint8_t adc_all_channels_measured(void)
 {
+	uint32_t primask = adc_enter_critical();
 	uint8_t all_channels_measured = adc.all_channels_measured;
 	adc.all_channels_measured = 0;
+	adc_exit_critical(primask);
 	return all_channels_measured;
 }
\ No newline at end of file
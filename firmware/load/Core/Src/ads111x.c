@@ -48,6 +48,8 @@
 		if (!(VAL))           \
 			return HAL_ERROR; \
 	} while (0)
+/* The shadow register belongs to the bus given to ads111x_init_desc */
+#define CHECK_DEVICE(HI2C) CHECK_ARG((HI2C) && (HI2C) == shadow_hi2c)
 
 const float ads111x_gain_values[] = {
 	[ADS111X_GAIN_6V144] = 6.144,
@@ -59,6 +61,28 @@ const float ads111x_gain_values[] = {
 	[ADS111X_GAIN_0V256_2] = 0.256,
 	[ADS111X_GAIN_0V256_3] = 0.256};
 
+const int32_t ads111x_gain_microvolts[] = {
+	[ADS111X_GAIN_6V144] = 6144000,
+	[ADS111X_GAIN_4V096] = 4096000,
+	[ADS111X_GAIN_2V048] = 2048000,
+	[ADS111X_GAIN_1V024] = 1024000,
+	[ADS111X_GAIN_0V512] = 512000,
+	[ADS111X_GAIN_0V256] = 256000,
+	[ADS111X_GAIN_0V256_2] = 256000,
+	[ADS111X_GAIN_0V256_3] = 256000};
+
+/**
+ * @brief Shadow copy of the configuration register
+ *  Kept with the OS bit cleared, the start of a conversion is requested explicitly
+ */
+static uint16_t config_shadow;
+
+/**
+ * @brief Bus of the device the shadow register belongs to
+ *  The driver serves a single ADS111x, calls touching the configuration on another bus are rejected
+ */
+static I2C_HandleTypeDef *shadow_hi2c;
+
 /**
  * Private functions
  */
@@ -122,6 +146,14 @@ static HAL_StatusTypeDef read_conf_bits(I2C_HandleTypeDef *hi2c, uint8_t offs, u
  */
 static HAL_StatusTypeDef write_conf_bits(I2C_HandleTypeDef *hi2c, uint16_t val, uint8_t offs, uint16_t mask);
 
+/**
+ * @brief Build a configuration word from the shadow register selecting an input and a gain.
+ * @param mux The multiplexer setting.
+ * @param gain The gain setting.
+ * @return Configuration word with the start bit set.
+ */
+static uint16_t conversion_config(ads111x_mux_t mux, ads111x_gain_t gain);
+
 /**
  * @brief read_reg for STM32
  *
@@ -164,13 +196,9 @@ static HAL_StatusTypeDef write_reg(I2C_HandleTypeDef *hi2c, uint8_t reg, uint16_
 static HAL_StatusTypeDef read_conf_bits(I2C_HandleTypeDef *hi2c, uint8_t offs, uint16_t mask,
 										uint16_t *bits)
 {
-	CHECK_ARG(hi2c);
+	CHECK_DEVICE(hi2c);
 
-	uint16_t val;
-
-	CHECK(read_reg(hi2c, REG_CONFIG, &val));
-
-	*bits = (val >> offs) & mask;
+	*bits = (config_shadow >> offs) & mask;
 
 	return HAL_OK;
 }
@@ -182,16 +210,27 @@ static HAL_StatusTypeDef read_conf_bits(I2C_HandleTypeDef *hi2c, uint8_t offs, u
 static HAL_StatusTypeDef write_conf_bits(I2C_HandleTypeDef *hi2c, uint16_t val, uint8_t offs,
 										 uint16_t mask)
 {
-	CHECK_ARG(hi2c);
+	CHECK_DEVICE(hi2c);
 
-	uint16_t old;
+	uint16_t config = (config_shadow & ~(mask << offs)) | ((val & mask) << offs);
 
-	CHECK(read_reg(hi2c, REG_CONFIG, &old));
-	CHECK(write_reg(hi2c, REG_CONFIG, (old & ~(mask << offs)) | (val << offs)));
+	CHECK(write_reg(hi2c, REG_CONFIG, config));
+	config_shadow = config & ~(OS_MASK << OS_OFFSET);
 
 	return HAL_OK;
 }
 
+/**
+ * @brief Build the configuration word selecting mux and gain with the start bit set
+ *
+ */
+static uint16_t conversion_config(ads111x_mux_t mux, ads111x_gain_t gain)
+{
+	uint16_t config = config_shadow & ~((MUX_MASK << MUX_OFFSET) | (PGA_MASK << PGA_OFFSET));
+
+	return config | ((mux & MUX_MASK) << MUX_OFFSET) | ((gain & PGA_MASK) << PGA_OFFSET) | (OS_MASK << OS_OFFSET);
+}
+
 #define READ_CONFIG(OFFS, MASK, VAR)                    \
 	do                                                  \
 	{                                                   \
@@ -217,6 +256,18 @@ HAL_StatusTypeDef ads111x_init_desc(I2C_HandleTypeDef *hi2c, uint8_t addr)
 		return HAL_ERROR;
 	}
 
+	/* A single device, a second one would overwrite the shadow of the first */
+	if (shadow_hi2c != NULL && shadow_hi2c != hi2c)
+	{
+		LOG_ERROR("ADS111x already initialized on another bus");
+		return HAL_ERROR;
+	}
+
+	/* Load the shadow configuration, every other access is served from it */
+	CHECK(read_reg(hi2c, REG_CONFIG, &config_shadow));
+	config_shadow &= ~(OS_MASK << OS_OFFSET);
+	shadow_hi2c = hi2c;
+
 	return HAL_OK;
 }
 
@@ -228,9 +279,10 @@ HAL_StatusTypeDef ads111x_is_busy(I2C_HandleTypeDef *hi2c, uint8_t *busy)
 {
 	CHECK_ARG(hi2c && busy);
 
+	/* Operational status is the only bit that must come from the device */
 	uint16_t r;
-	CHECK(read_conf_bits(hi2c, OS_OFFSET, OS_MASK, &r));
-	*busy = !r;
+	CHECK(read_reg(hi2c, REG_CONFIG, &r));
+	*busy = !((r >> OS_OFFSET) & OS_MASK);
 
 	return HAL_OK;
 }
@@ -241,7 +293,9 @@ HAL_StatusTypeDef ads111x_is_busy(I2C_HandleTypeDef *hi2c, uint8_t *busy)
  */
 HAL_StatusTypeDef ads111x_start_conversion(I2C_HandleTypeDef *hi2c)
 {
-	return write_conf_bits(hi2c, 1, OS_OFFSET, OS_MASK);
+	CHECK_DEVICE(hi2c);
+
+	return write_reg(hi2c, REG_CONFIG, config_shadow | (OS_MASK << OS_OFFSET));
 }
 
 /**
@@ -483,4 +537,112 @@ HAL_StatusTypeDef ads111x_enable_conv_ready(I2C_HandleTypeDef *dev, uint32_t sta
 	CHECK(write_reg(dev, REG_THRESH_L, state ? 0x0000 : 0x0000));
 
 	return HAL_OK;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Read the shadow configuration register
+ *
+ */
+HAL_StatusTypeDef ads111x_get_config(I2C_HandleTypeDef *hi2c, ads111x_config_t *config)
+{
+	CHECK_DEVICE(hi2c);
+	CHECK_ARG(config);
+
+	config->mode = (config_shadow >> MODE_OFFSET) & MODE_MASK;
+	config->data_rate = (config_shadow >> DR_OFFSET) & DR_MASK;
+	config->comp_mode = (config_shadow >> COMP_MODE_OFFSET) & COMP_MODE_MASK;
+	config->comp_polarity = (config_shadow >> COMP_POL_OFFSET) & COMP_POL_MASK;
+	config->comp_latch = (config_shadow >> COMP_LAT_OFFSET) & COMP_LAT_MASK;
+	config->comp_queue = (config_shadow >> COMP_QUE_OFFSET) & COMP_QUE_MASK;
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Write mode, data rate and comparator settings in one transaction
+ *
+ */
+HAL_StatusTypeDef ads111x_set_config(I2C_HandleTypeDef *hi2c, const ads111x_config_t *config)
+{
+	CHECK_ARG(hi2c && config);
+
+	uint16_t mask = (MODE_MASK << MODE_OFFSET) | (DR_MASK << DR_OFFSET) |
+					(COMP_MODE_MASK << COMP_MODE_OFFSET) | (COMP_POL_MASK << COMP_POL_OFFSET) |
+					(COMP_LAT_MASK << COMP_LAT_OFFSET) | (COMP_QUE_MASK << COMP_QUE_OFFSET);
+
+	uint16_t bits = ((config->mode & MODE_MASK) << MODE_OFFSET) |
+					((config->data_rate & DR_MASK) << DR_OFFSET) |
+					((config->comp_mode & COMP_MODE_MASK) << COMP_MODE_OFFSET) |
+					((config->comp_polarity & COMP_POL_MASK) << COMP_POL_OFFSET) |
+					((config->comp_latch & COMP_LAT_MASK) << COMP_LAT_OFFSET) |
+					((config->comp_queue & COMP_QUE_MASK) << COMP_QUE_OFFSET);
+
+	return write_conf_bits(hi2c, bits, 0, mask);
+}
+
+/**
+ * @brief Select input and gain and start a conversion in one transaction
+ *
+ */
+HAL_StatusTypeDef ads111x_configure(I2C_HandleTypeDef *hi2c, ads111x_mux_t mux, ads111x_gain_t gain)
+{
+	CHECK_DEVICE(hi2c);
+
+	uint16_t config = conversion_config(mux, gain);
+
+	CHECK(write_reg(hi2c, REG_CONFIG, config));
+	config_shadow = config & ~(OS_MASK << OS_OFFSET);
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Non blocking configuration of input and gain with the start of a conversion
+ *
+ */
+HAL_StatusTypeDef ads111x_configure_it(I2C_HandleTypeDef *hi2c, ads111x_mux_t mux, ads111x_gain_t gain, uint8_t *buf)
+{
+	CHECK_DEVICE(hi2c);
+	CHECK_ARG(buf);
+
+	uint16_t config = conversion_config(mux, gain);
+
+	buf[0] = config >> 8;
+	buf[1] = config;
+
+	return HAL_I2C_Mem_Write_IT(hi2c, (uint16_t)(ADS111X_ADDR_GND << 1), REG_CONFIG, 1, buf, 2);
+}
+
+/**
+ * @brief Commit the configuration written by ads111x_configure_it
+ *
+ */
+void ads111x_configure_cplt(I2C_HandleTypeDef *hi2c, const uint8_t *buf)
+{
+	if (hi2c != shadow_hi2c || !buf)
+	{
+		return;
+	}
+
+	config_shadow = ((buf[0] << 8) | buf[1]) & ~(OS_MASK << OS_OFFSET);
+}
+
+/**
+ * @brief Start a non blocking read of the conversion register
+ *
+ */
+HAL_StatusTypeDef ads111x_read_value_it(I2C_HandleTypeDef *hi2c, uint8_t *buf)
+{
+	CHECK_ARG(hi2c && buf);
+
+	return HAL_I2C_Mem_Read_IT(hi2c, (uint16_t)(ADS111X_ADDR_GND << 1), REG_CONVERSION, 1, buf, 2);
+}
+
+/**
+ * @brief Decode a conversion register read by ads111x_read_value_it
+ *
+ */
+int16_t ads111x_decode_value(const uint8_t *buf)
+{
+	return (int16_t)((buf[0] << 8) | buf[1]);
+}
@@ -6,77 +6,309 @@
 
 
 /* Prototypes */
-static void pid_init(pid_controller_t *pid, float kp, float ki, float kd, float control_frequency, boundary_t integral_boundary, boundary_t output_boundary);
-static float pid_update(pid_controller_t *pid, control_io_t *io);
+static control_gain_t control_gain(float gain);
+static void pid_init(pid_controller_t *pid, float kp, float ki, float kd, float kt, float rate_limit, float control_frequency, boundary_t output_boundary);
+static void pid_reset(pid_controller_t *pid, control_io_t *io, control_action_t output);
+static control_action_t pid_update(pid_controller_t *pid, control_io_t *io, control_value_t period_ratio);
+static void pid_set_frequency(pid_controller_t *pid, float control_frequency);
+static control_action_t control_cc_feedforward(control_value_t current);
+static uint8_t control_uses_current_loop(control_mode_t mode);
+static control_value_t control_current_setpoint(control_t *control_handler, control_mode_t mode);
+static control_io_t control_loop_io(control_t *control_handler, control_mode_t mode);
+static void control_convert_cp_schedule(control_t *control_handler);
+static void control_schedule_cp(control_t *control_handler, control_value_t voltage);
+static uint32_t control_timer_clock(void);
+static void control_step(control_t *control_handler, control_value_t voltage, control_value_t current, control_value_t period_ratio);
+static control_action_t control_output(control_t *control_handler);
+static void control_write_output(control_t *control_handler);
 static void control_enable_load(uint8_t enable);
 
-static void pid_init(pid_controller_t *pid, float kp, float ki, float kd, float control_frequency, boundary_t integral_boundary, boundary_t output_boundary)
+/**
+ * @brief Constant power gains by operating voltage
+ * 	The trim acts on power error, which maps to current error divided by the voltage,
+ * 	so gains are the constant current ones over the geometric center of each band.
+ */
+static const control_schedule_t control_cp_schedule[CONTROL_CP_SCHEDULE_SIZE] = {
+	{CONTROL_VALUE(0.0f), 0.0f, 0.75f},
+	{CONTROL_VALUE(2.0f), 0.0f, 0.34f},
+	{CONTROL_VALUE(5.0f), 0.0f, 0.15f},
+	{CONTROL_VALUE(10.0f), 0.0f, 0.075f},
+	{CONTROL_VALUE(20.0f), 0.0f, 0.034f},
+};
+
+/**
+ * @brief Convert a gain given at runtime, only done when gains change
+ * @param gain Gain
+ * @return control_gain_t Gain in the control backend format
+ */
+static control_gain_t control_gain(float gain)
 {
-	pid->kp = kp;
+#ifdef CONTROL_FIXED_POINT
+	/* Q1.31 only covers (-1, 1) */
+	if (gain >= 1.0f)
+	{
+		return INT32_MAX;
+	}
+	if (gain <= -1.0f)
+	{
+		return INT32_MIN;
+	}
+	return Q31(gain);
+#else
+	return gain;
+#endif
+}
+
+static void pid_init(pid_controller_t *pid, float kp, float ki, float kd, float kt, float rate_limit, float control_frequency, boundary_t output_boundary)
+{
+	pid->kp = control_gain(kp);
 	pid->ki = ki;
-	pid->kd = kd;
-	pid->control_frequency = control_frequency;
+	pid->kd = control_gain(kd);
+	pid->kt = control_gain(kt);
+	pid->rate_limit = rate_limit;
+	pid->output_boundary = output_boundary;
+	pid_set_frequency(pid, control_frequency);
 
 	/* Initialize internal variables */
-	pid->integral = 0.0;
+	pid->error_history[0] = 0;
+	pid->error_history[1] = 0;
+	pid->output = 0;
+	pid->applied = 0;
+}
 
-	for (int i = 0; i < 3; ++i)
+/**
+ * @brief Restart the PID from a given output without a bump
+ * @param pid PID controller instance
+ * @param io Control input/output structure, its current error seeds the history
+ * @param output Output to start from
+ */
+static void pid_reset(pid_controller_t *pid, control_io_t *io, control_action_t output)
+{
+	if (output > pid->output_boundary.max)
 	{
-		pid->error_history[i] = 0.0;
-		pid->output_history[i] = 0.0;
+		output = pid->output_boundary.max;
+	}
+	else if (output < pid->output_boundary.min)
+	{
+		output = pid->output_boundary.min;
 	}
 
-	pid->history_index = 0;
-
-	pid->integral_boundary = integral_boundary;
+	/* Same error in the history, so no proportional or derivative kick on the first update */
+	const control_value_t error = CONTROL_SUB(io->setpoint, io->measured_value);
+	pid->error_history[0] = error;
+	pid->error_history[1] = error;
 
-	pid->output_boundary = output_boundary;
+	pid->output = output;
+	pid->applied = output;
+	io->control_action = output;
 }
 
 /**
  * @brief PID controller update function
  * @param pid PID controller instance
  * @param io Control input/output structure
- * @return float controller output
+ * @param period_ratio Measured period over the nominal one
+ * @return control_action_t controller output
  */
-static float pid_update(pid_controller_t *pid, control_io_t *io)
+static control_action_t pid_update(pid_controller_t *pid, control_io_t *io, control_value_t period_ratio)
 {
-	const float error = io->setpoint - io->measured_value;
-	const float proportional = pid->kp * error;
+	const control_value_t error = CONTROL_SUB(io->setpoint, io->measured_value);
+
+	/* Proportional increment */
+	const control_action_t proportional = CONTROL_GAIN_MUL(pid->kp, CONTROL_SUB(error, pid->error_history[0]));
+
+	/* Integral increment */
+	const control_action_t integral = CONTROL_SCALE(CONTROL_GAIN_MUL(pid->ki_dt, error), period_ratio);
+
+	/* Derivative increment */
+	const control_action_t derivative = CONTROL_UNSCALE(CONTROL_GAIN_MUL(pid->kd, CONTROL_ADD(CONTROL_SUB(error, CONTROL_ADD(pid->error_history[0], pid->error_history[0])), pid->error_history[1])), period_ratio);
+
+	/* Store error history */
+	pid->error_history[1] = pid->error_history[0];
+	pid->error_history[0] = error;
 
-	/* If kistory[0] and error have different signs, reset integral term */
-	if (pid->error_history[0] * error < 0)
+	/* Back-calculation, pull the unsaturated output towards the applied one */
+	pid->output = CONTROL_ADD(pid->output, CONTROL_GAIN_SCALE(pid->kt, CONTROL_SUB(pid->applied, pid->output)));
+	pid->output = CONTROL_ADD(pid->output, CONTROL_ADD(CONTROL_ADD(proportional, integral), derivative));
+
+	/* Output rate limit */
+	control_action_t applied = pid->output;
+	if (pid->rate_step > 0)
 	{
-		pid->integral = 0.0;
+		if (applied > CONTROL_ADD(pid->applied, pid->rate_step))
+		{
+			applied = CONTROL_ADD(pid->applied, pid->rate_step);
+		}
+		else if (applied < CONTROL_SUB(pid->applied, pid->rate_step))
+		{
+			applied = CONTROL_SUB(pid->applied, pid->rate_step);
+		}
+	}
 
-		for (int i = 0; i < 3; ++i)
+	/* Output boundary */
+	if (applied > pid->output_boundary.max)
+	{
+		applied = pid->output_boundary.max;
+	}
+	else if (applied < pid->output_boundary.min)
+	{
+		applied = pid->output_boundary.min;
+	}
+
+	pid->applied = applied;
+
+	return applied;
+}
+
+/**
+ * @brief Set the nominal frequency the integral gain is discretized for
+ * @param pid PID controller instance
+ * @param control_frequency Control frequency
+ */
+static void pid_set_frequency(pid_controller_t *pid, float control_frequency)
+{
+	pid->control_frequency = control_frequency;
+	pid->ki_dt = control_gain(pid->ki / control_frequency);
+	pid->rate_step = CONTROL_ACTION(pid->rate_limit / control_frequency);
+}
+
+/**
+ * @brief Analog setpoint of the constant current path, the digital loop trims around it
+ * @param current Current command
+ * @return control_action_t DAC voltage
+ */
+static control_action_t control_cc_feedforward(control_value_t current)
+{
+	return CONTROL_ADD(CONTROL_GAIN_MUL(CONTROL_GAIN(0.08906093f), current), CONTROL_ACTION(0.00743f));
+}
+
+/**
+ * @brief Modes whose digital loop only trims the analog constant current loop
+ */
+static uint8_t control_uses_current_loop(control_mode_t mode)
+{
+	return mode == CONTROL_MODE_CC || mode == CONTROL_MODE_CP || mode == CONTROL_MODE_CR;
+}
+
+/**
+ * @brief Current command of the modes running on the analog constant current loop
+ * @param mode Control mode
+ * @return control_value_t Current command, within 0 and CONTROL_CURRENT_MAX
+ */
+static control_value_t control_current_setpoint(control_t *control_handler, control_mode_t mode)
+{
+	control_value_t current = control_handler->io[CONTROL_MODE_CC].setpoint;
+
+	if (mode == CONTROL_MODE_CP)
+	{
+		/* Cascade, the power setpoint over the operating voltage */
+		control_value_t voltage = control_handler->io[CONTROL_MODE_CV].measured_value;
+		if (voltage < CONTROL_VALUE(CONTROL_VOLTAGE_MIN))
 		{
-			pid->error_history[i] = 0.0;
-			pid->output_history[i] = 0.0;
+			voltage = CONTROL_VALUE(CONTROL_VOLTAGE_MIN);
 		}
+		current = CONTROL_VALUE_DIV(control_handler->io[CONTROL_MODE_CP].setpoint, voltage);
+	}
+	else if (mode == CONTROL_MODE_CR)
+	{
+		/* Feed-forward, the operating voltage over the resistance setpoint */
+		control_value_t resistance = control_handler->io[CONTROL_MODE_CR].setpoint;
+		if (resistance < CONTROL_VALUE(CONTROL_RESISTANCE_MIN))
+		{
+			resistance = CONTROL_VALUE(CONTROL_RESISTANCE_MIN);
+		}
+		current = CONTROL_VALUE_DIV(control_handler->io[CONTROL_MODE_CV].measured_value, resistance);
 	}
 
-	/* Integral term */
-	pid->integral += pid->ki * ((pid->error_history[0] + error) / 2.0) * (1.0 / pid->control_frequency);
+	if (current > CONTROL_VALUE(CONTROL_CURRENT_MAX))
+	{
+		current = CONTROL_VALUE(CONTROL_CURRENT_MAX);
+	}
+	else if (current < 0)
+	{
+		current = 0;
+	}
 
-	/* Integral boundary */
-	if (pid->integral > pid->integral_boundary.max)
-		pid->integral = pid->integral_boundary.max;
-	else if (pid->integral < pid->integral_boundary.min)
-		pid->integral = pid->integral_boundary.min;
+	return current;
+}
 
-	/* Derivative term */
-	const float derivative = pid->kd * (2.0 * error - pid->error_history[0] - pid->error_history[1]);
+/**
+ * @brief Setpoint and measurement the PID of a mode acts on
+ * 	Constant resistance trims on current error, so it never divides by the measured current
+ * @param mode Control mode
+ * @return control_io_t Copy of the loop input/output
+ */
+static control_io_t control_loop_io(control_t *control_handler, control_mode_t mode)
+{
+	if (mode == CONTROL_MODE_CR)
+	{
+		return (control_io_t){
+			.setpoint = control_current_setpoint(control_handler, CONTROL_MODE_CR),
+			.measured_value = control_handler->io[CONTROL_MODE_CC].measured_value,
+			.control_action = control_handler->io[CONTROL_MODE_CR].control_action,
+		};
+	}
 
-	/* Store error history */
-	pid->error_history[2] = pid->error_history[1];
-	pid->error_history[1] = pid->error_history[0];
-	pid->error_history[0] = error;
+	return control_handler->io[mode];
+}
 
-	/* Control action */
-	float output = proportional + pid->integral + derivative;
+/**
+ * @brief Convert the constant power gain schedule for the control frequency of its PID
+ * 	Done at init and when the frequency changes, so the control loop never converts a gain
+ */
+static void control_convert_cp_schedule(control_t *control_handler)
+{
+	const float control_frequency = control_handler->pid[CONTROL_MODE_CP].control_frequency;
+
+	for (uint32_t i = 0; i < CONTROL_CP_SCHEDULE_SIZE; ++i)
+	{
+		control_handler->cp_schedule_gains[i].kp = control_gain(control_cp_schedule[i].kp);
+		control_handler->cp_schedule_gains[i].ki_dt = control_gain(control_cp_schedule[i].ki / control_frequency);
+	}
+}
+
+/**
+ * @brief Select the constant power gains for the operating voltage
+ * 	The entries are converted beforehand, a change of entry only copies them, with some hysteresis on the way down
+ * @param voltage Operating voltage
+ */
+static void control_schedule_cp(control_t *control_handler, control_value_t voltage)
+{
+	uint32_t index = control_handler->cp_schedule_index;
+
+	while (index + 1U < CONTROL_CP_SCHEDULE_SIZE && voltage >= control_cp_schedule[index + 1U].voltage)
+	{
+		index++;
+	}
+	while (index > 0U && voltage < CONTROL_SUB(control_cp_schedule[index].voltage, CONTROL_VALUE(0.2f)))
+	{
+		index--;
+	}
 
-	return output;
+	if (index != control_handler->cp_schedule_index)
+	{
+		pid_controller_t *pid = &control_handler->pid[CONTROL_MODE_CP];
+
+		control_handler->cp_schedule_index = index;
+		pid->kp = control_handler->cp_schedule_gains[index].kp;
+		pid->ki_dt = control_handler->cp_schedule_gains[index].ki_dt;
+		pid->ki = control_cp_schedule[index].ki;
+		pid->kd = 0;
+	}
+}
+
+/**
+ * @brief Clock of the APB1 timers
+ * @return uint32_t Frequency in Hz
+ */
+static uint32_t control_timer_clock(void)
+{
+	/* APB1 timers run at twice PCLK1 when the APB1 prescaler is not 1 */
+	if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+	{
+		return HAL_RCC_GetPCLK1Freq() * 2U;
+	}
+	return HAL_RCC_GetPCLK1Freq();
 }
 
 /**
@@ -87,241 +319,441 @@ static float pid_update(pid_controller_t *pid, control_io_t *io)
 HAL_StatusTypeDef control_init(control_t *control_handler, mcp4725_t *dac)
 {
 	control_handler->dac = dac;
-	const boundary_t integral_boundary = {
-		.max = 0.03f,
-		.min = -0.03f,
-	};
+	adc_reader_init(&control_handler->adc_reader);
+
+	/* Reject isolated spikes at the cost of one sample of lag */
+	filter_add_median(&control_handler->adc_reader.filters[ADC_INPUT_VOLTAGE], 3);
+	filter_add_median(&control_handler->adc_reader.filters[ADC_INPUT_CURRENT], 3);
 
-	const float control_frequency = 133.0f;
+	const float control_frequency = (float)CONTROL_FREQUENCY_HZ;
+
+	/* Back-calculation gain, shared by all modes */
+	const float tracking_gain = 0.5f;
+
+	/*
+	 * Gains are per second. The previous incremental tuning at 133 Hz maps to
+	 * ki = kp_old * 133 and, for CV, kp = 3 * kd_old.
+	 */
 
 	/* Initialize constant voltage PID controller */
 	pid_init(
 		&control_handler->pid[CONTROL_MODE_CV],
-		-0.00001f,
-		-0.00004f,
-		-0.00023f,
+		-0.00069f,
+		-0.00133f,
+		0.0f,
+		tracking_gain,
+		330.0f,
 		control_frequency,
 		(boundary_t){
-			.min = -3.00f,
-			.max = 3.01f
-		},
-		(boundary_t){
-			.min = 0.0f,
-			.max = 3.3f
+			.min = CONTROL_ACTION(0.0f),
+			.max = CONTROL_ACTION(3.3f)
 		}
 	);
 
 	/* Initialize constant current PID controller */
 	pid_init(
 		&control_handler->pid[CONTROL_MODE_CC],
-		0.008f,
-		0.00f,
 		0.0f,
+		1.064f,
+		0.0f,
+		tracking_gain,
+		60.0f,
 		control_frequency,
-		integral_boundary,
 		(boundary_t){
-			.min = -0.3f,
-			.max = 0.3f
+			.min = CONTROL_ACTION(-0.3f),
+			.max = CONTROL_ACTION(0.3f)
 		}
 	);
 
-	/* Initialize constant power PID controller */
+	/* Initialize constant power PID controller, trims the constant current path with scheduled gains */
+	control_handler->cp_schedule_index = 0;
 	pid_init(
 		&control_handler->pid[CONTROL_MODE_CP],
+		control_cp_schedule[0].kp,
+		control_cp_schedule[0].ki,
 		0.0f,
-		0.0f,
-		0.0f,
+		tracking_gain,
+		60.0f,
 		control_frequency,
-		integral_boundary,
 		(boundary_t){
-			.min = 0.0f,
-			.max = 3.3f
+			.min = CONTROL_ACTION(-0.3f),
+			.max = CONTROL_ACTION(0.3f)
 		}
 	);
+	control_convert_cp_schedule(control_handler);
 
-	/* Initialize constant resistance PID controller */
+	/* Initialize constant resistance PID controller, trims the constant current path on current error */
 	pid_init(
 		&control_handler->pid[CONTROL_MODE_CR],
-		-0.1f,
 		0.0f,
+		1.064f,
 		0.0f,
+		tracking_gain,
+		60.0f,
 		control_frequency,
-		integral_boundary,
 		(boundary_t){
-			.min = 0.0f,
-			.max = 3.3f
+			.min = CONTROL_ACTION(-0.3f),
+			.max = CONTROL_ACTION(0.3f)
 		}
 	);
 
 	control_handler->mode = CONTROL_MODE_CP;
+	control_handler->dac_output = 0;
+
+	control_handler->htim = NULL;
+	control_handler->period_cycles = SystemCoreClock / CONTROL_FREQUENCY_HZ;
+	control_reset_stats(control_handler);
 
 	/* Initialize control IO */
 	for (uint32_t i = 0; i < CONTROL_MODE_SIZE; ++i)
 	{
-		control_set_setpoint(control_handler, i, 0.0f);
-		control_handler->io[i].measured_value = 0.0f;
-		control_handler->io[i].control_action = 0.0f;
+		control_set_setpoint(control_handler, i, 0);
+		control_handler->io[i].measured_value = 0;
+		control_handler->io[i].control_action = 0;
 	}
 	return HAL_OK;
 }
 
 /**
- * @brief Update control module
+ * @brief Start the control loop from a timer update interrupt
+ * 	The timer counts at 1 MHz and its update interrupt must call control_update()
+ * @param htim Timer handler, on APB1
+ * @param frequency Control frequency in Hz
+ * @return HAL status
  */
-void control_update(control_t *control_handler)
+HAL_StatusTypeDef control_start(control_t *control_handler, TIM_HandleTypeDef *htim, uint32_t frequency)
 {
-	control_handler->io[CONTROL_MODE_CC].measured_value = adc_get_value(ADC_INPUT_CURRENT);
-	control_handler->io[CONTROL_MODE_CV].measured_value = adc_get_value(ADC_INPUT_VOLTAGE);
-	control_handler->io[CONTROL_MODE_CP].measured_value = adc_get_value(ADC_INPUT_VOLTAGE) * adc_get_value(ADC_INPUT_CURRENT);
-	control_handler->io[CONTROL_MODE_CR].measured_value = adc_get_value(ADC_INPUT_VOLTAGE) / adc_get_value(ADC_INPUT_CURRENT);
+	if (frequency < CONTROL_FREQUENCY_MIN_HZ || frequency > CONTROL_FREQUENCY_MAX_HZ)
+	{
+		return HAL_ERROR;
+	}
 
-	if (control_handler->mode == CONTROL_MODE_CP)
+	if (control_handler->htim != NULL)
+	{
+		HAL_TIM_Base_Stop_IT(control_handler->htim);
+	}
+
+	control_handler->htim = htim;
+	control_handler->period_cycles = SystemCoreClock / frequency;
+
+	for (uint32_t i = 0; i < CONTROL_MODE_SIZE; ++i)
 	{
+		pid_set_frequency(&control_handler->pid[i], (float)frequency);
+	}
+	control_convert_cp_schedule(control_handler);
+
+	__HAL_TIM_SET_PRESCALER(htim, (control_timer_clock() / 1000000U) - 1U);
+	__HAL_TIM_SET_AUTORELOAD(htim, (1000000U / frequency) - 1U);
+	__HAL_TIM_SET_COUNTER(htim, 0);
+
+	/* Load the prescaler now and drop the update flag it raises */
+	HAL_TIM_GenerateEvent(htim, TIM_EVENTSOURCE_UPDATE);
+	__HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+
+	control_reset_stats(control_handler);
+
+	return HAL_TIM_Base_Start_IT(htim);
+}
+
+/**
+ * @brief Update control module, called at the control frequency
+ */
+void control_update(control_t *control_handler)
+{
+	/*
+	 * The DAC shares the I2C bus with the ADC acquisition engine, and a transfer in flight is not
+	 * waited for from the interrupt. The next update measures the longer period and scales its terms.
+	 */
+	if (adc_bus_try_acquire() != HAL_OK)
+	{
+		control_handler->stats.skipped++;
+		return;
+	}
+
+	const uint32_t start = timestamp_get();
 
-		static float last_current_voltage = 0.0f;
+	/* Integral and derivative terms follow the real period */
+	control_value_t period_ratio = CONTROL_VALUE(1.0f);
+	if (control_handler->stats.count > 0)
+	{
+		uint32_t period = start - control_handler->last_start;
 
-		float current_power_error = control_handler->io[CONTROL_MODE_CP].setpoint - control_handler->io[CONTROL_MODE_CP].measured_value;
-		float current_voltage_derivative = control_handler->io[CONTROL_MODE_CV].measured_value - last_current_voltage;
-		last_current_voltage = control_handler->io[CONTROL_MODE_CV].measured_value;
+		if (period < control_handler->stats.period_min)
+		{
+			control_handler->stats.period_min = period;
+		}
+		if (period > control_handler->stats.period_max)
+		{
+			control_handler->stats.period_max = period;
+		}
+		control_handler->stats.period_sum += period;
 
-		if (current_power_error > 0.0f)
+		/* A late loop is not allowed to more than double the terms */
+		if (period > control_handler->period_cycles * 2U)
 		{
-			if (current_voltage_derivative <= 0.0f)
-			{
-				control_handler->pid[CONTROL_MODE_CP].kp = -0.005f;
-				control_handler->pid[CONTROL_MODE_CP].ki = 0.0f;
-				control_handler->pid[CONTROL_MODE_CP].kd = 0.0f;
-			} else 
-			{
-				control_handler->pid[CONTROL_MODE_CP].kp = 0.005f;
-				control_handler->pid[CONTROL_MODE_CP].ki = 0.0f;
-				control_handler->pid[CONTROL_MODE_CP].kd = 0.0f;
-			}
-		} else
+			period = control_handler->period_cycles * 2U;
+		}
+		else if (period < control_handler->period_cycles / 2U)
 		{
-			control_handler->pid[CONTROL_MODE_CP].kp = 0.005f;
-			control_handler->pid[CONTROL_MODE_CP].ki = 0.0f;
-			control_handler->pid[CONTROL_MODE_CP].kd = 0.0f;
+			period = control_handler->period_cycles / 2U;
 		}
+		period_ratio = CONTROL_RATIO(period, control_handler->period_cycles);
 	}
-	
-	control_handler->io[control_handler->mode].control_action += 
-		pid_update(&control_handler->pid[control_handler->mode], &control_handler->io[control_handler->mode]);
-	
+	control_handler->last_start = start;
+
+	adc_reader_update(&control_handler->adc_reader);
+
+	control_step(control_handler,
+				 CONTROL_ADC_VALUE(&control_handler->adc_reader, ADC_INPUT_VOLTAGE),
+				 CONTROL_ADC_VALUE(&control_handler->adc_reader, ADC_INPUT_CURRENT),
+				 period_ratio);
 
-	
-	/* Check if control action is not out of bounds */
-	if (control_handler->io[control_handler->mode].control_action > control_handler->pid[control_handler->mode].output_boundary.max)
+	control_write_output(control_handler);
+	adc_bus_release();
+
+	const uint32_t execution = timestamp_get() - start;
+	if (execution < control_handler->stats.execution_min)
 	{
-		control_handler->io[control_handler->mode].control_action = control_handler->pid[control_handler->mode].output_boundary.max;
+		control_handler->stats.execution_min = execution;
 	}
-	else if (control_handler->io[control_handler->mode].control_action < control_handler->pid[control_handler->mode].output_boundary.min)
+	if (execution > control_handler->stats.execution_max)
 	{
-		control_handler->io[control_handler->mode].control_action = control_handler->pid[control_handler->mode].output_boundary.min;
+		control_handler->stats.execution_max = execution;
 	}
+	control_handler->stats.execution_sum += execution;
+	control_handler->stats.count++;
 
-	float analog_setpoint = 0.0f;
+}
 
-	/* Calculate analog setpoint */
-	analog_setpoint = control_handler->io[control_handler->mode].control_action;
 
-	/* Analog controller setpoint is controlled for the calculated setpoint + digital control action */
-	if (control_handler->mode == CONTROL_MODE_CC)
+/**
+ * @brief Run the control law of the current mode on calibrated measurements
+ * @param voltage Operating voltage
+ * @param current Operating current
+ * @param period_ratio Measured period over the nominal one
+ */
+static void control_step(control_t *control_handler, control_value_t voltage, control_value_t current, control_value_t period_ratio)
+{
+	control_handler->io[CONTROL_MODE_CC].measured_value = current;
+	control_handler->io[CONTROL_MODE_CV].measured_value = voltage;
+	control_handler->io[CONTROL_MODE_CP].measured_value = CONTROL_VALUE_MUL(voltage, current);
+	control_handler->io[CONTROL_MODE_CR].measured_value = current > CONTROL_VALUE(CONTROL_CURRENT_MIN) ?
+		CONTROL_VALUE_DIV(voltage, current) : CONTROL_VALUE(CONTROL_RESISTANCE_MAX);
+
+	if (control_handler->mode == CONTROL_MODE_CP)
 	{
-		float calculated_analog_setpoint = control_handler->io[CONTROL_MODE_CC].setpoint * 0.08906093f + 0.00743f;
-		analog_setpoint = calculated_analog_setpoint + control_handler->io[CONTROL_MODE_CC].control_action;
+		control_schedule_cp(control_handler, voltage);
 	}
 
-	mcp4725_set_voltage(control_handler->dac, 3.3f, analog_setpoint, false);
+	control_io_t loop_io = control_loop_io(control_handler, control_handler->mode);
+	control_handler->io[control_handler->mode].control_action =
+		pid_update(&control_handler->pid[control_handler->mode], &loop_io, period_ratio);
+}
+
+/**
+ * @brief Analog setpoint of the current mode
+ * @return control_action_t DAC voltage, the calculated setpoint plus the digital control action
+ */
+static control_action_t control_output(control_t *control_handler)
+{
+	control_action_t analog_setpoint = control_handler->io[control_handler->mode].control_action;
+
+	if (control_uses_current_loop(control_handler->mode))
+	{
+		const control_value_t current_setpoint = control_current_setpoint(control_handler, control_handler->mode);
+		analog_setpoint = CONTROL_ADD(control_cc_feedforward(current_setpoint), analog_setpoint);
+	}
 
+	return analog_setpoint;
 }
 
+/**
+ * @brief Write the current mode's output to the DAC, the caller holds the I2C bus
+ */
+static void control_write_output(control_t *control_handler)
+{
+	const control_action_t analog_setpoint = control_output(control_handler);
+
+	CONTROL_DAC_SET(control_handler->dac, analog_setpoint);
+	control_handler->dac_output = analog_setpoint;
+}
+
+/**
+ * @brief Step a setpoint from outside the control loop
+ * 	Modes on the constant current loop get their new feed-forward on the DAC right away, unless the ADC
+ * 	engine holds the I2C bus, the digital trim follows on the next control update. Must not preempt control_update().
+ * @param mode Control mode, becomes the active one
+ * @param setpoint Setpoint
+ */
+void control_step_setpoint(control_t *control_handler, control_mode_t mode, control_value_t setpoint)
+{
+	if (mode >= CONTROL_MODE_SIZE)
+	{
+		return;
+	}
+
+	control_set_setpoint(control_handler, mode, setpoint);
+	control_set_mode(control_handler, mode);
+
+	/* The waveform player steps from an interrupt too, when the bus is busy the next update writes the output */
+	if (control_uses_current_loop(mode))
+	{
+		if (adc_bus_try_acquire() == HAL_OK)
+		{
+			control_write_output(control_handler);
+			adc_bus_release();
+		}
+		else
+		{
+			control_handler->stats.skipped++;
+		}
+	}
+}
+
+/**
+ * @brief Control mode of a server mode, both enums are ordered differently
+ * @param mode Server mode
+ * @return control_mode_t Control mode, CONTROL_MODE_SIZE if unknown
+ */
+control_mode_t control_mode_from_server(load_mode_t mode)
+{
+	switch (mode)
+	{
+	case CC:
+		return CONTROL_MODE_CC;
+	case CV:
+		return CONTROL_MODE_CV;
+	case CR:
+		return CONTROL_MODE_CR;
+	case CP:
+		return CONTROL_MODE_CP;
+	default:
+		return CONTROL_MODE_SIZE;
+	}
+}
+
+/**
+ * @brief Copy of the loop timing statistics
+ * @param stats Output statistics, periods are counted from the second loop
+ */
+void control_get_stats(control_t *control_handler, control_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*stats = control_handler->stats;
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Restart the loop timing statistics
+ */
+void control_reset_stats(control_t *control_handler)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	control_handler->stats.period_min = UINT32_MAX;
+	control_handler->stats.period_max = 0;
+	control_handler->stats.period_sum = 0;
+	control_handler->stats.execution_min = UINT32_MAX;
+	control_handler->stats.execution_max = 0;
+	control_handler->stats.execution_sum = 0;
+	control_handler->stats.count = 0;
+	control_handler->stats.skipped = 0;
+	__set_PRIMASK(primask);
+}
 
 static void control_enable_load(uint8_t enable)
 {
 	HAL_GPIO_WritePin(ENABLE_LOAD_GPIO_Port, ENABLE_LOAD_Pin, enable);
 }
 
+void control_set_enable(control_t *control_handler, uint8_t enable)
+{
+	control_enable_load(enable);
+}
+
 void control_set_from_server(control_t *control_handler, load_control_t *server_control)
 {
 	control_enable_load(server_control->enable);
 
-	control_set_mode(control_handler, server_control->mode);
-	
-	control_set_setpoint(control_handler, CONTROL_MODE_CC, server_control->cc.value_milli / 1000.0f);
-	control_set_setpoint(control_handler, CONTROL_MODE_CV, server_control->cv.value_milli / 1000.0f);
-	control_set_setpoint(control_handler, CONTROL_MODE_CR, server_control->cr.value_milli / 1000.0f);
-	control_set_setpoint(control_handler, CONTROL_MODE_CP, server_control->cp.value_milli / 1000.0f);
+	control_set_setpoint(control_handler, CONTROL_MODE_CC, CONTROL_VALUE_FROM_MILLI(server_control->cc.value_milli));
+	control_set_setpoint(control_handler, CONTROL_MODE_CV, CONTROL_VALUE_FROM_MILLI(server_control->cv.value_milli));
+	control_set_setpoint(control_handler, CONTROL_MODE_CR, CONTROL_VALUE_FROM_MILLI(server_control->cr.value_milli));
+	control_set_setpoint(control_handler, CONTROL_MODE_CP, CONTROL_VALUE_FROM_MILLI(server_control->cp.value_milli));
+
+	/* After the setpoints, so the transfer seeds the history with the new error */
+	control_set_mode(control_handler, control_mode_from_server(server_control->mode));
 }
 
-void control_set_setpoint(control_t *control_handler, control_mode_t mode, float setpoint)
+void control_set_setpoint(control_t *control_handler, control_mode_t mode, control_value_t setpoint)
 {
 	if (mode == CONTROL_MODE_CV) {
-		if (setpoint < 0.6f) {
-			setpoint = 0.6f;
-		} else if (setpoint > 50.0f) {
-			setpoint = 50.0f;
+		if (setpoint < CONTROL_VALUE(0.6f)) {
+			setpoint = CONTROL_VALUE(0.6f);
+		} else if (setpoint > CONTROL_VALUE(50.0f)) {
+			setpoint = CONTROL_VALUE(50.0f);
 		}
 	}
 	control_handler->io[mode].setpoint = setpoint;
 }
 
-float control_get_setpoint(control_t *control_handler, control_mode_t mode)
+control_value_t control_get_setpoint(control_t *control_handler, control_mode_t mode)
 {
 	return control_handler->io[mode].setpoint;
 }
 
+/**
+ * @brief Change the control mode without a bump on the DAC
+ * 	The new mode starts from the output the DAC holds
+ */
 void control_set_mode(control_t *control_handler, control_mode_t mode)
 {
+	if (mode >= CONTROL_MODE_SIZE || mode == control_handler->mode)
+	{
+		return;
+	}
+
+	control_action_t output = control_handler->dac_output;
+
+	/* Modes on the constant current loop trim around its feed-forward */
+	if (control_uses_current_loop(mode))
+	{
+		output = CONTROL_SUB(output, control_cc_feedforward(control_current_setpoint(control_handler, mode)));
+	}
+
+	control_io_t loop_io = control_loop_io(control_handler, mode);
+	pid_reset(&control_handler->pid[mode], &loop_io, output);
+	control_handler->io[mode].control_action = loop_io.control_action;
 	control_handler->mode = mode;
 }
 
+/* Velocity form PID, changing gains does not need a reset */
 void control_set_constants(control_t *control_handler, control_mode_t mode, float kp, float ki, float kd)
 {
-	control_handler->pid[mode].kp = kp;
+	control_handler->pid[mode].kp = control_gain(kp);
 	control_handler->pid[mode].ki = ki;
-	control_handler->pid[mode].kd = kd;
-	control_handler->io[mode].control_action = 0.0f;
+	pid_set_frequency(&control_handler->pid[mode], control_handler->pid[mode].control_frequency);
+	control_handler->pid[mode].kd = control_gain(kd);
 }
 
 void control_set_kp(control_t *control_handler, control_mode_t mode, float kp)
 {
-	control_handler->pid[mode].kp = kp;
-
-	/* Reset integral term */
-	control_handler->pid[mode].integral = 0.0;
-
-	for (int i = 0; i < 3; ++i)
-	{
-		control_handler->pid[mode].error_history[i] = 0.0;
-		control_handler->pid[mode].output_history[i] = 0.0;
-	}
+	control_handler->pid[mode].kp = control_gain(kp);
 }
 
 void control_set_ki(control_t *control_handler, control_mode_t mode, float ki)
 {
 	control_handler->pid[mode].ki = ki;
-
-	/* Reset integral term */
-	control_handler->pid[mode].integral = 0.0;
-
-	for (int i = 0; i < 3; ++i)
-	{
-		control_handler->pid[mode].error_history[i] = 0.0;
-		control_handler->pid[mode].output_history[i] = 0.0;
-	}
+	pid_set_frequency(&control_handler->pid[mode], control_handler->pid[mode].control_frequency);
 }
 
 void control_set_kd(control_t *control_handler, control_mode_t mode, float kd)
 {
-	control_handler->pid[mode].kd = kd;
-
-	/* Reset integral term */
-	control_handler->pid[mode].integral = 0.0;
+	control_handler->pid[mode].kd = control_gain(kd);
+}
 
-	for (int i = 0; i < 3; ++i)
-	{
-		control_handler->pid[mode].error_history[i] = 0.0;
-		control_handler->pid[mode].output_history[i] = 0.0;
-	}
+void control_set_rate_limit(control_t *control_handler, control_mode_t mode, float rate_limit)
+{
+	control_handler->pid[mode].rate_limit = rate_limit;
+	pid_set_frequency(&control_handler->pid[mode], control_handler->pid[mode].control_frequency);
 }
\ No newline at end of file
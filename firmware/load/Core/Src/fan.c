@@ -2,18 +2,25 @@
 #include "fan.h"
 
 static TIM_HandleTypeDef *htim1;
+static adc_reader_t adc_reader;
 
 void fan_init(TIM_HandleTypeDef *htim)
 {
 	htim1 = htim;
+	adc_reader_init(&adc_reader);
+
+	/* Temperature changes slowly, smooth it so the fan does not hunt */
+	filter_add_iir(&adc_reader.filters[ADC_TEMPERATURE], FILTER_Q15(0.125f));
 	HAL_TIM_PWM_Start(htim, TIM_CHANNEL_1);
 }
 
 void fan_update()
 {
 	uint32_t timer_top = __HAL_TIM_GET_AUTORELOAD(htim1);
-	float temperature = adc_get_value(ADC_TEMPERATURE);
-	float power = adc_get_value(ADC_INPUT_VOLTAGE) * adc_get_value(ADC_INPUT_CURRENT);
+	adc_reader_update(&adc_reader);
+
+	float temperature = adc_reader_get_value(&adc_reader, ADC_TEMPERATURE);
+	float power = adc_reader_get_value(&adc_reader, ADC_INPUT_VOLTAGE) * adc_reader_get_value(&adc_reader, ADC_INPUT_CURRENT);
 
 	/* If temperature is above 80C force fan to 100% */
 	if (temperature > FAN_MAX_TEMPERATURE)
@@ -0,0 +1,242 @@
+/* Filter header */
+#include "filter.h"
+
+/* Prototypes */
+static filter_stage_t *filter_add_stage(filter_t *filter, filter_type_t type);
+static void filter_stage_reset(filter_stage_t *stage);
+static int32_t filter_boxcar_process(filter_boxcar_t *boxcar, int32_t value);
+static int32_t filter_iir_process(filter_iir_t *iir, int32_t value);
+static int32_t filter_median_process(filter_median_t *median, int32_t value);
+
+/**
+ * @brief Reserve the next stage of the pipeline
+ *
+ */
+static filter_stage_t *filter_add_stage(filter_t *filter, filter_type_t type)
+{
+	if (filter->size >= FILTER_STAGES_SIZE)
+	{
+		return NULL;
+	}
+
+	filter_stage_t *stage = &filter->stages[filter->size++];
+	stage->type = type;
+
+	return stage;
+}
+
+/**
+ * @brief Clear the history of a stage
+ *
+ */
+static void filter_stage_reset(filter_stage_t *stage)
+{
+	switch (stage->type)
+	{
+	case FILTER_BOXCAR:
+		stage->boxcar.sum = 0;
+		stage->boxcar.index = 0;
+		stage->boxcar.count = 0;
+		break;
+	case FILTER_IIR:
+		stage->iir.state = 0;
+		stage->iir.primed = 0;
+		break;
+	case FILTER_MEDIAN:
+		stage->median.index = 0;
+		stage->median.count = 0;
+		break;
+	}
+}
+
+/**
+ * @brief Moving average, the sum is updated incrementally
+ *
+ */
+static int32_t filter_boxcar_process(filter_boxcar_t *boxcar, int32_t value)
+{
+	if (boxcar->count == boxcar->size)
+	{
+		boxcar->sum -= boxcar->buffer[boxcar->index];
+	}
+	else
+	{
+		boxcar->count++;
+	}
+
+	boxcar->buffer[boxcar->index] = value;
+	boxcar->sum += value;
+	boxcar->index = (boxcar->index + 1) % boxcar->size;
+
+	return boxcar->sum / boxcar->count;
+}
+
+/**
+ * @brief First order IIR, starts from the first sample to avoid a ramp from zero
+ *
+ */
+static int32_t filter_iir_process(filter_iir_t *iir, int32_t value)
+{
+	int32_t input = value * (1 << FILTER_IIR_STATE_SHIFT);
+
+	if (!iir->primed)
+	{
+		iir->state = input;
+		iir->primed = 1;
+	}
+	else
+	{
+		iir->state += (int32_t)((((int64_t)input - iir->state) * iir->alpha) >> 15);
+	}
+
+	return iir->state / (1 << FILTER_IIR_STATE_SHIFT);
+}
+
+/**
+ * @brief Median of the stored window, sorted on a copy by insertion
+ *
+ */
+static int32_t filter_median_process(filter_median_t *median, int32_t value)
+{
+	int32_t sorted[FILTER_MEDIAN_MAX_SIZE];
+
+	median->buffer[median->index] = value;
+	median->index = (median->index + 1) % median->size;
+
+	if (median->count < median->size)
+	{
+		median->count++;
+	}
+
+	for (uint8_t i = 0; i < median->count; i++)
+	{
+		int32_t current = median->buffer[i];
+		int8_t j = i - 1;
+
+		while (j >= 0 && sorted[j] > current)
+		{
+			sorted[j + 1] = sorted[j];
+			j--;
+		}
+		sorted[j + 1] = current;
+	}
+
+	return sorted[median->count / 2];
+}
+
+/**
+ * @brief Initialize a filter without stages
+ *
+ */
+void filter_init(filter_t *filter)
+{
+	filter->size = 0;
+}
+
+/**
+ * @brief Clear the history of all stages
+ *
+ */
+void filter_reset(filter_t *filter)
+{
+	for (uint8_t i = 0; i < filter->size; i++)
+	{
+		filter_stage_reset(&filter->stages[i]);
+	}
+}
+
+/**
+ * @brief Append a moving average stage
+ *
+ */
+HAL_StatusTypeDef filter_add_boxcar(filter_t *filter, uint8_t size)
+{
+	if (size == 0 || size > FILTER_BOXCAR_MAX_SIZE)
+	{
+		return HAL_ERROR;
+	}
+
+	filter_stage_t *stage = filter_add_stage(filter, FILTER_BOXCAR);
+	if (stage == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	stage->boxcar.size = size;
+	filter_stage_reset(stage);
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Append a first order IIR stage
+ *
+ */
+HAL_StatusTypeDef filter_add_iir(filter_t *filter, int16_t alpha)
+{
+	if (alpha <= 0)
+	{
+		return HAL_ERROR;
+	}
+
+	filter_stage_t *stage = filter_add_stage(filter, FILTER_IIR);
+	if (stage == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	stage->iir.alpha = alpha;
+	filter_stage_reset(stage);
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Append a median stage
+ *
+ */
+HAL_StatusTypeDef filter_add_median(filter_t *filter, uint8_t size)
+{
+	if (size != 3 && size != 5)
+	{
+		return HAL_ERROR;
+	}
+
+	filter_stage_t *stage = filter_add_stage(filter, FILTER_MEDIAN);
+	if (stage == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	stage->median.size = size;
+	filter_stage_reset(stage);
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Run a sample through all stages
+ *
+ */
+int32_t filter_process(filter_t *filter, int32_t value)
+{
+	for (uint8_t i = 0; i < filter->size; i++)
+	{
+		filter_stage_t *stage = &filter->stages[i];
+
+		switch (stage->type)
+		{
+		case FILTER_BOXCAR:
+			value = filter_boxcar_process(&stage->boxcar, value);
+			break;
+		case FILTER_IIR:
+			value = filter_iir_process(&stage->iir, value);
+			break;
+		case FILTER_MEDIAN:
+			value = filter_median_process(&stage->median, value);
+			break;
+		}
+	}
+
+	return value;
+}
@@ -28,6 +28,8 @@
 #include <uart.h>
 #include <fan.h>
 #include <control.h>
+#include <waveform.h>
+#include <telemetry.h>
 #include <utils.h>
 /* USER CODE END Includes */
 
@@ -54,6 +56,7 @@ I2C_HandleTypeDef hi2c2;
 RTC_HandleTypeDef hrtc;
 
 TIM_HandleTypeDef htim1;
+TIM_HandleTypeDef htim2;
 TIM_HandleTypeDef htim3;
 
 UART_HandleTypeDef huart1;
@@ -61,6 +64,11 @@ DMA_HandleTypeDef hdma_usart1_rx;
 DMA_HandleTypeDef hdma_usart1_tx;
 
 /* USER CODE BEGIN PV */
+// MCP4725 device descriptor
+static mcp4725_t dac;
+// Control loop, run from TIM3
+static control_t control;
+
 extern float dac_voltage;
 extern uint8_t enable;
 
@@ -82,6 +90,7 @@ static void MX_RTC_Init(void);
 static void MX_TIM1_Init(void);
 static void MX_USART1_UART_Init(void);
 static void MX_TIM3_Init(void);
+static void MX_TIM2_Init(void);
 /* USER CODE BEGIN PFP */
 uint8_t data[6] = {0};
 extern uint32_t trigger_test;
@@ -98,12 +107,11 @@ void error_handler(void)
   }
 }
 
-volatile uint32_t adc_ready = 0;
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 {
   if (GPIO_Pin == ADC_ALERT_Pin)
   {
-    adc_ready = 1;
+    adc_conversion_ready_callback();
   }
 }
 
@@ -145,11 +153,8 @@ int main(void)
   MX_TIM1_Init();
   MX_USART1_UART_Init();
   MX_TIM3_Init();
+  MX_TIM2_Init();
   /* USER CODE BEGIN 2 */
-  // MCP4725 device descriptor
-  mcp4725_t dac;
-  control_t control;
-
   // Initialize MCP4725 device
   if (mcp4725_init(&dac, &hi2c2, MCP4725_I2C_ADDR) != HAL_OK)
   {
@@ -157,11 +162,21 @@ int main(void)
   }
 
   adc_init(&hi2c2, &hadc1);
+  uart_set_address(LOAD_BUS_ADDRESS);
   uart_init(&huart1);
   fan_init(&htim1);
   control_init(&control, &dac);
 
-  HAL_TIM_Base_Start_IT(&htim3);
+  waveform_init(&h_waveform);
+  telemetry_init(&h_telemetry);
+
+  if (control_start(&control, &htim3, CONTROL_FREQUENCY_HZ) != HAL_OK)
+  {
+    error_handler();
+  }
+
+  /* Waveform player ticks at WAVEFORM_TICK_HZ */
+  HAL_TIM_Base_Start_IT(&htim2);
 
   HAL_GPIO_WritePin(ENABLE_LOAD_GPIO_Port, ENABLE_LOAD_Pin, GPIO_PIN_RESET);
   /* USER CODE END 2 */
@@ -171,29 +186,22 @@ int main(void)
   while (1)
   {
 
-    /* Measure adc */
-    if (adc_ready)
-    {
-      if (adc_measure() != HAL_OK)
-      {
-        LOG_ERROR("Error reading ADC\n");
-      }
-
-      adc_ready = 0;
-    }
+    /* ADC is acquired from the ALERT and I2C interrupts */
+    adc_watchdog();
 
+    /* Control loop runs from TIM3, the superloop only handles telemetry */
     if (adc_all_channels_measured())
     {
-      adc_calculate_average();
-      control_set_from_server(&control, &(h_load_state.control));
-      control_update(&control);
+      adc_update_measurement();
     }
 
-    static uint32_t next_uart_update = 0;
-    if (HAL_GetTick() >= next_uart_update)
+    /* Telemetry batches leave as soon as the link is free */
+    uart_transmit();
+
+    static uint32_t next_fan_update = 0;
+    if (HAL_GetTick() >= next_fan_update)
     {
-      adc_measure();
-      next_uart_update = HAL_GetTick() + 200;
+      next_fan_update = HAL_GetTick() + 200;
       fan_update();
     }
     /* USER CODE END WHILE */
@@ -437,6 +445,51 @@ static void MX_TIM1_Init(void)
 
 }
 
+/**
+  * @brief TIM2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM2_Init(void)
+{
+
+  /* USER CODE BEGIN TIM2_Init 0 */
+
+  /* USER CODE END TIM2_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM2_Init 1 */
+
+  /* USER CODE END TIM2_Init 1 */
+  htim2.Instance = TIM2;
+  htim2.Init.Prescaler = 71;
+  htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim2.Init.Period = 999;
+  htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_Base_Init(&htim2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim2, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim2, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM2_Init 2 */
+
+  /* USER CODE END TIM2_Init 2 */
+
+}
+
 /**
   * @brief TIM3 Initialization Function
   * @param None
@@ -456,9 +509,9 @@ static void MX_TIM3_Init(void)
 
   /* USER CODE END TIM3_Init 1 */
   htim3.Instance = TIM3;
-  htim3.Init.Prescaler = 256;
+  htim3.Init.Prescaler = 71;
   htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
-  htim3.Init.Period = 56250;
+  htim3.Init.Period = 4999;
   htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
   htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
   if (HAL_TIM_Base_Init(&htim3) != HAL_OK)
@@ -498,7 +551,7 @@ static void MX_USART1_UART_Init(void)
 
   /* USER CODE END USART1_Init 1 */
   huart1.Instance = USART1;
-  huart1.Init.BaudRate = 115200;
+  huart1.Init.BaudRate = 1000000;
   huart1.Init.WordLength = UART_WORDLENGTH_8B;
   huart1.Init.StopBits = UART_STOPBITS_1;
   huart1.Init.Parity = UART_PARITY_NONE;
@@ -609,9 +662,27 @@ static void MX_GPIO_Init(void)
 /* USER CODE BEGIN 4 */
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
+  /* Both run at the same priority, so they never preempt each other */
+  load_control_t server_control;
+
   if (htim == &htim3)
   {
-    uart_transmit();
+    /* The waveform player owns the setpoints while it runs */
+    const uint8_t overridden = waveform_is_running(&h_waveform);
+    uart_get_control(&server_control);
+    if (!overridden)
+    {
+      control_set_from_server(&control, &server_control);
+    }
+    control_update(&control);
+    telemetry_tick(&h_telemetry, &control);
+    /* Commands are acknowledged once the loop runs with them */
+    uart_acknowledge_commands(&control, &server_control, overridden);
+  }
+  else if (htim == &htim2)
+  {
+    uart_get_control(&server_control);
+    waveform_tick(&h_waveform, &control, (uint8_t)server_control.enable);
   }
 }
 /* USER CODE END 4 */
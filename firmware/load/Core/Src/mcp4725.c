@@ -19,6 +19,7 @@ HAL_StatusTypeDef read_data(mcp4725_t *dev, uint8_t *data, uint8_t size) {
 HAL_StatusTypeDef mcp4725_init(mcp4725_t *dev, I2C_HandleTypeDef *i2c_handle, uint8_t addr) {
 	dev->i2c_handle = i2c_handle;
 	dev->addr = addr;
+	dev->output = 0;
 	return HAL_OK;
 }
 
@@ -72,7 +73,11 @@ HAL_StatusTypeDef mcp4725_set_raw_output(mcp4725_t *dev, uint16_t value, bool ee
 		(uint8_t)(value >> 4),
 		(uint8_t)(value << 4)
 	};
-	return HAL_I2C_Master_Transmit(dev->i2c_handle, (dev->addr << 1), data, 3, I2C_TIMEOUT_MS);
+	HAL_StatusTypeDef status = HAL_I2C_Master_Transmit(dev->i2c_handle, (dev->addr << 1), data, 3, I2C_TIMEOUT_MS);
+	if (status == HAL_OK) {
+		dev->output = value;
+	}
+	return status;
 }
 
 // Get voltage output
@@ -87,11 +92,32 @@ HAL_StatusTypeDef mcp4725_get_voltage(mcp4725_t *dev, float vdd, bool eeprom, fl
 
 // Set voltage output
 HAL_StatusTypeDef mcp4725_set_voltage(mcp4725_t *dev, float vdd, float value, bool eeprom) {
+	return mcp4725_set_raw_output(dev, mcp4725_voltage_to_raw(vdd, value), eeprom);
+}
+
+// Set voltage output in Q16.16
+HAL_StatusTypeDef mcp4725_set_voltage_q16(mcp4725_t *dev, q16_t vdd, q16_t value, bool eeprom) {
+	return mcp4725_set_raw_output(dev, mcp4725_voltage_to_raw_q16(vdd, value), eeprom);
+}
+
+// Output code of a voltage, clamped to 0 and vdd
+uint16_t mcp4725_voltage_to_raw(float vdd, float value) {
+	if (value < 0) {
+		value = 0;
+	} else if (value > vdd) {
+		value = vdd;
+	}
+
+	return (uint16_t)(MCP4725_MAX_VALUE / vdd * value);
+}
+
+// Output code of a voltage in Q16.16, value * 4095 fits in 32 bits up to vdd = 16 V
+uint16_t mcp4725_voltage_to_raw_q16(q16_t vdd, q16_t value) {
 	if (value < 0) {
 		value = 0;
 	} else if (value > vdd) {
 		value = vdd;
 	}
 
-	return mcp4725_set_raw_output(dev, (uint16_t)(MCP4725_MAX_VALUE / vdd * value), eeprom);
+	return (uint16_t)(((uint32_t)value * MCP4725_MAX_VALUE) / (uint32_t)vdd);
 }
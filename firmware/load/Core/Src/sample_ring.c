@@ -0,0 +1,93 @@
+/* Stm32 HAL */
+#include "stm32f1xx_hal.h"
+/* Sample ring header */
+#include "sample_ring.h"
+
+/**
+ * @brief Initialize an empty ring
+ *
+ */
+void sample_ring_init(sample_ring_t *ring)
+{
+	ring->head = 0;
+}
+
+/**
+ * @brief Push a sample, must only be called from the producer context
+ *
+ */
+void sample_ring_push(sample_ring_t *ring, uint32_t timestamp, int32_t value)
+{
+	uint32_t head = ring->head;
+
+	ring->samples[head & SAMPLE_RING_MASK].timestamp = timestamp;
+	ring->samples[head & SAMPLE_RING_MASK].value = value;
+
+	/* Publish the sample only after it is stored */
+	__DMB();
+	ring->head = head + 1U;
+}
+
+/**
+ * @brief Attach a reader to a ring, starting from the newest sample
+ *
+ */
+void sample_reader_init(sample_reader_t *reader, const sample_ring_t *ring)
+{
+	reader->ring = ring;
+	reader->tail = ring->head;
+	reader->overruns = 0;
+}
+
+/**
+ * @brief Number of samples available to the reader
+ *
+ */
+uint32_t sample_reader_available(const sample_reader_t *reader)
+{
+	uint32_t available = reader->ring->head - reader->tail;
+
+	return available > SAMPLE_RING_READABLE ? SAMPLE_RING_READABLE : available;
+}
+
+/**
+ * @brief Consume samples in order from oldest to newest
+ *
+ */
+uint32_t sample_reader_read(sample_reader_t *reader, sample_t *samples, uint32_t size)
+{
+	const sample_ring_t *ring = reader->ring;
+	uint32_t count = 0;
+
+	while (count < size)
+	{
+		uint32_t head = ring->head;
+		__DMB();
+
+		if (head == reader->tail)
+		{
+			break;
+		}
+
+		/* Producer lapped the reader, skip to the oldest sample it is not about to overwrite */
+		if ((head - reader->tail) > SAMPLE_RING_READABLE)
+		{
+			reader->overruns += (head - reader->tail) - SAMPLE_RING_READABLE;
+			reader->tail = head - SAMPLE_RING_READABLE;
+		}
+
+		sample_t sample = ring->samples[reader->tail & SAMPLE_RING_MASK];
+
+		/* Slot was being overwritten while it was copied, retry from the new oldest sample */
+		__DMB();
+		if ((ring->head - reader->tail) > SAMPLE_RING_READABLE)
+		{
+			continue;
+		}
+
+		samples[count++] = sample;
+		reader->tail++;
+	}
+
+	return count;
+}
@@ -3,58 +3,138 @@
 
 #include "server.h"
 
+/** Definitions */
+
+/** Words of the state structs, the delta mask has a bit per word */
+#define TX_DATA_WORDS (TX_DATA_SIZE / sizeof(uint32_t))
+#define RX_DATA_WORDS (RX_DATA_SIZE / sizeof(uint32_t))
+#define DELTA_MASK_SIZE sizeof(uint16_t)
+
+_Static_assert(TX_DATA_SIZE % sizeof(uint32_t) == 0U && TX_DATA_WORDS <= 16U, "TX data must fit a 16 word delta");
+_Static_assert(RX_DATA_SIZE % sizeof(uint32_t) == 0U && RX_DATA_WORDS <= 16U, "RX data must fit a 16 word delta");
+_Static_assert(SERVER_PAYLOAD_MAX <= UINT8_MAX, "Payload length must fit a byte");
+_Static_assert(sizeof(load_waveform_t) <= SERVER_PAYLOAD_MAX, "Waveform commands must fit a frame");
+_Static_assert(DELTA_MASK_SIZE + RX_DATA_SIZE <= SERVER_PAYLOAD_MAX, "RX delta must fit a frame");
+_Static_assert(sizeof(load_command_t) == 8U && sizeof(load_ack_t) == 16U, "Commands must have no padding");
+
 /** Globals */
 
 /** Byte counter for parsing */
 static uint8_t current_byte = 0U;
 
-/** Buffer to store generated message */
-static uint8_t parser_msg_buffer[RX_MSG_SIZE];
+/** Buffer to store the frame being parsed */
+static uint8_t parser_msg_buffer[SERVER_FRAME_SIZE_MAX];
 
 /** Current parser state */
-static load_parser_state_t parser_state = PARSER_WAIT_START;
+static load_parser_state_t parser_state = PARSER_WAIT_SYNC;
+
+/** Running CRC of the frame being parsed */
+static uint16_t parser_crc = 0U;
+
+/** View of the last frame parsed */
+static server_frame_t parser_frame;
+
+/** Sequence expected on the next received frame */
+static uint8_t rx_seq = 0U;
+
+/** Deltas are applied only while no frame has been lost since the last whole struct */
+static uint8_t rx_synced = 0U;
+
+/** Sequence of the next transmitted frame */
+static uint8_t tx_seq = 0U;
+
+/** Frames sent since the last whole struct, starts with a whole one */
+static uint8_t tx_frames_since_key = SERVER_KEYFRAME_INTERVAL;
+
+/** Last state struct sent, the reference of the deltas */
+static TX_DATA_TYPE tx_reference;
+
+/** Address put on the transmitted frames, SERVER_ADDRESS_BROADCAST for plain frames */
+static uint8_t tx_address = SERVER_ADDRESS_BROADCAST;
+
+/** CRC-16/CCITT-FALSE nibble table */
+static const uint16_t crc16_table[16] = {
+  0x0000U, 0x1021U, 0x2042U, 0x3063U, 0x4084U, 0x50A5U, 0x60C6U, 0x70E7U,
+  0x8108U, 0x9129U, 0xA14AU, 0xB16BU, 0xC18CU, 0xD1ADU, 0xE1CEU, 0xF1EFU,
+};
 
 /** Prototypes */
-static uint32_t calculate_checksum(void *data, uint32_t size);
+static uint16_t crc16_update(uint16_t crc, uint8_t byte);
+static uint32_t frame_finish(uint8_t *tx_buffer, server_msg_type_t type, uint32_t length);
+static uint32_t frame_header_size(uint8_t type);
+static void frame_accept(server_frame_t *frame, const uint8_t *buffer, uint32_t size, uint32_t start);
+static uint8_t frame_byte(const server_frame_t *frame, uint32_t offset);
+static void frame_read(const server_frame_t *frame, uint32_t offset, void *data, uint32_t size);
 
 /**
- * @brief Parses a single byte of data from the expected message.
+ * @brief Parses a single byte of a v2 frame, copying it to an internal buffer.
  *
  * @param byte Byte to be parsed
- * @return uint8_t* NULL if message is not complete, pointer to the message if complete
+ * @return const server_frame_t* NULL if the frame is not complete or its CRC is wrong, the frame if complete
  */
-uint8_t *parse_byte(uint8_t byte)
+const server_frame_t *parse_byte(uint8_t byte)
 {
-  static uint8_t magic_byte = (uint8_t)(RX_MAGIC_WORD >> 24U);
-
   switch (parser_state) {
-    case PARSER_WAIT_START:
-      if (byte == magic_byte) {
-        parser_msg_buffer[current_byte++] = byte;
-        if (current_byte == sizeof(RX_MAGIC_WORD)) {
-          parser_state = PARSER_WAIT_DATA;
-        }
+    case PARSER_WAIT_SYNC:
+      if (byte == SERVER_SYNC_BYTE) {
+        parser_msg_buffer[0] = byte;
+        current_byte = 1U;
+        parser_crc = 0xFFFFU;
+        parser_state = PARSER_WAIT_LENGTH;
+      }
+      break;
+    case PARSER_WAIT_LENGTH:
+      /** A length that can't fit is a false sync */
+      if (byte > SERVER_PAYLOAD_MAX) {
+        parser_state = PARSER_WAIT_SYNC;
+        break;
+      }
+      parser_msg_buffer[current_byte++] = byte;
+      parser_crc = crc16_update(parser_crc, byte);
+      parser_state = PARSER_WAIT_TYPE;
+      break;
+    case PARSER_WAIT_TYPE:
+      parser_msg_buffer[current_byte++] = byte;
+      parser_crc = crc16_update(parser_crc, byte);
+      parser_state = PARSER_WAIT_SEQ;
+      break;
+    case PARSER_WAIT_SEQ:
+      parser_msg_buffer[current_byte++] = byte;
+      parser_crc = crc16_update(parser_crc, byte);
+      if (parser_msg_buffer[2] & SERVER_MSG_ADDRESSED) {
+        parser_state = PARSER_WAIT_ADDRESS;
       } else {
-        current_byte = 0U;
+        parser_state = (parser_msg_buffer[1] > 0U) ? PARSER_WAIT_DATA : PARSER_WAIT_CRC_LOW;
       }
       break;
+    case PARSER_WAIT_ADDRESS:
+      parser_msg_buffer[current_byte++] = byte;
+      parser_crc = crc16_update(parser_crc, byte);
+      parser_state = (parser_msg_buffer[1] > 0U) ? PARSER_WAIT_DATA : PARSER_WAIT_CRC_LOW;
+      break;
     case PARSER_WAIT_DATA:
       parser_msg_buffer[current_byte++] = byte;
-      if (current_byte == sizeof(RX_MAGIC_WORD) + RX_DATA_SIZE) {
-        parser_state = PARSER_WAIT_CS;
+      parser_crc = crc16_update(parser_crc, byte);
+      if (current_byte == frame_header_size(parser_msg_buffer[2]) + parser_msg_buffer[1]) {
+        parser_state = PARSER_WAIT_CRC_LOW;
       }
       break;
-    case PARSER_WAIT_CS:
+    case PARSER_WAIT_CRC_LOW:
       parser_msg_buffer[current_byte++] = byte;
-      if (current_byte == RX_MSG_SIZE) {
-        current_byte = 0U;
-        parser_state = PARSER_WAIT_START;
-        return parser_msg_buffer;
-      }
+      parser_state = PARSER_WAIT_CRC_HIGH;
       break;
+    case PARSER_WAIT_CRC_HIGH:
+      parser_msg_buffer[current_byte++] = byte;
+      parser_state = PARSER_WAIT_SYNC;
+
+      if ((uint16_t)(parser_msg_buffer[current_byte - 2U] | (byte << 8U)) != parser_crc) {
+        break;
+      }
+
+      frame_accept(&parser_frame, parser_msg_buffer, SERVER_FRAME_SIZE_MAX, 0U);
+      return &parser_frame;
     default:
-      current_byte = 0U;
-      parser_state = PARSER_WAIT_START;
+      parser_state = PARSER_WAIT_SYNC;
       break;
   }
 
@@ -62,63 +142,583 @@ uint8_t *parse_byte(uint8_t byte)
 }
 
 /**
- * @brief Prepares a data struct to be transmitted.
+ * @brief Locates the next valid frame in place among the received bytes of a ring buffer.
+ *
+ * @param ring Ring buffer
+ * @param size Ring buffer size
+ * @param head Offset of the first byte not consumed yet, moved past the frame or the skipped bytes
+ * @param tail Offset of the next byte to be received
+ * @param frame View of the frame found, valid until the ring overwrites it
+ * @return int 1 if a frame was found, 0 otherwise
+ */
+int server_frame_find(const uint8_t *ring, uint32_t size, uint32_t *head, uint32_t tail, server_frame_t *frame)
+{
+  while (*head != tail) {
+    const int found = server_frame_at(ring, size, *head, tail, frame);
+
+    if (found > 0) {
+      *head = (*head + server_frame_size(frame)) % size;
+      return 1;
+    }
+
+    if (found == 0) {
+      return 0;
+    }
+
+    /** Only the sync byte is skipped, a frame may start inside a corrupted one */
+    *head = (*head + 1U) % size;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Checks whether a valid frame starts at a given offset of a ring buffer.
+ *
+ * @param ring Ring buffer
+ * @param size Ring buffer size
+ * @param start Offset of the candidate sync byte
+ * @param tail Offset of the next byte to be received
+ * @param frame View of the frame found, valid until the ring overwrites it
+ * @return int 1 if a frame starts there, 0 if more bytes are needed to tell, -1 if no frame starts there
+ */
+int server_frame_at(const uint8_t *ring, uint32_t size, uint32_t start, uint32_t tail, server_frame_t *frame)
+{
+  const int found = server_frame_check(ring, size, start, tail);
+
+  if (found > 0) {
+    frame_accept(frame, ring, size, start);
+  }
+
+  return found;
+}
+
+/**
+ * @brief Checks the length and the CRC of a candidate frame, leaving the sequence tracking alone.
+ *
+ * @param ring Ring buffer
+ * @param size Ring buffer size
+ * @param start Offset of the candidate sync byte
+ * @param tail Offset of the next byte to be received
+ * @return int 1 if a frame starts there, 0 if more bytes are needed to tell, -1 if no frame starts there
+ */
+int server_frame_check(const uint8_t *ring, uint32_t size, uint32_t start, uint32_t tail)
+{
+  const uint32_t available = (tail + size - start) % size;
+
+  if (available == 0U || ring[start] != SERVER_SYNC_BYTE) {
+    return (available == 0U) ? 0 : -1;
+  }
+
+  if (available < SERVER_HEADER_SIZE) {
+    return 0;
+  }
+
+  /** A length that can't fit is a false sync */
+  const uint8_t length = ring[(start + 1U) % size];
+  if (length > SERVER_PAYLOAD_MAX) {
+    return -1;
+  }
+
+  const uint32_t header = frame_header_size(ring[(start + 2U) % size]);
+  if (available < header + length + SERVER_CRC_SIZE) {
+    return 0;
+  }
+
+  uint16_t crc = 0xFFFFU;
+  for (uint32_t i = 1U; i < header + length; i++) {
+    crc = crc16_update(crc, ring[(start + i) % size]);
+  }
+
+  const uint32_t crc_offset = start + header + length;
+  const uint16_t received = (uint16_t)(ring[crc_offset % size] | (ring[(crc_offset + 1U) % size] << 8U));
+  return (received == crc) ? 1 : -1;
+}
+
+/**
+ * @brief Whether parse_byte() is waiting for a sync byte, the other bytes it gets then belong to no frame.
+ *
+ * @return int 1 between frames, 0 inside one
+ */
+int parse_idle(void)
+{
+  return parser_state == PARSER_WAIT_SYNC;
+}
+
+/**
+ * @brief Size of a complete frame, from the sync byte to the CRC.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @return uint32_t Frame size
+ */
+uint32_t server_frame_size(const server_frame_t *frame)
+{
+  return frame->payload + frame->length + SERVER_CRC_SIZE;
+}
+
+/**
+ * @brief Sets the address of the frames built next.
+ *
+ * @param address Own address on the load, destination on the controller, SERVER_ADDRESS_BROADCAST for plain frames
+ */
+void server_set_address(uint8_t address)
+{
+  tx_address = address;
+}
+
+/**
+ * @brief Type of a complete frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @return server_msg_type_t Frame type
+ */
+server_msg_type_t server_frame_type(const server_frame_t *frame)
+{
+  return (server_msg_type_t)frame->type;
+}
+
+/**
+ * @brief Prepares a state frame to be transmitted, a delta against the last one when possible.
+ *        Addressed frames are always whole.
  *
  * @param data Data struct to be transmitted
- * @param tx_buffer Buffer to store the data ready to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_data(const TX_DATA_TYPE *data, uint8_t *tx_buffer)
+{
+  uint8_t *payload = &tx_buffer[SERVER_HEADER_SIZE];
+
+  /** The other end of a bus keeps no delta reference per load */
+  if (tx_frames_since_key >= SERVER_KEYFRAME_INTERVAL || tx_address != SERVER_ADDRESS_BROADCAST) {
+    tx_frames_since_key = 1U;
+    memcpy(&tx_reference, data, TX_DATA_SIZE);
+    memcpy(payload, data, TX_DATA_SIZE);
+    return frame_finish(tx_buffer, TX_MSG_FULL, TX_DATA_SIZE);
+  }
+
+  tx_frames_since_key++;
+
+  const uint8_t *words = (const uint8_t *)data;
+  uint8_t *reference = (uint8_t *)&tx_reference;
+  uint32_t length = DELTA_MASK_SIZE;
+  uint16_t mask = 0U;
+
+  for (uint32_t i = 0; i < TX_DATA_WORDS; i++) {
+    const uint32_t offset = i * sizeof(uint32_t);
+    if (memcmp(&words[offset], &reference[offset], sizeof(uint32_t)) != 0) {
+      mask |= (uint16_t)(1U << i);
+      memcpy(&reference[offset], &words[offset], sizeof(uint32_t));
+      memcpy(&payload[length], &words[offset], sizeof(uint32_t));
+      length += sizeof(uint32_t);
+    }
+  }
+
+  payload[0] = (uint8_t)mask;
+  payload[1] = (uint8_t)(mask >> 8U);
+
+  return frame_finish(tx_buffer, TX_MSG_DELTA, length);
+}
+
+/**
+ * @brief Applies a received state frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param data Pointer to the struct the frame is applied to
+ * @return int 0 on success, -1 on a wrong type or a delta while out of sync
+ */
+int rx_data(const server_frame_t *frame, RX_DATA_TYPE *data)
+{
+  if (server_frame_type(frame) == RX_MSG_FULL)
+  {
+    if (frame->length != RX_DATA_SIZE)
+    {
+      return -1;
+    }
+
+    frame_read(frame, frame->payload, data, RX_DATA_SIZE);
+    rx_synced = 1U;
+    return 0;
+  }
+
+  if (server_frame_type(frame) != RX_MSG_DELTA || !rx_synced || frame->length < DELTA_MASK_SIZE)
+  {
+    return -1;
+  }
+
+  const uint16_t mask = (uint16_t)(frame_byte(frame, frame->payload) | (frame_byte(frame, frame->payload + 1U) << 8U));
+  uint8_t *words = (uint8_t *)data;
+  uint32_t offset = frame->payload + DELTA_MASK_SIZE;
+
+  /** Check the size before touching the struct, it's applied whole or not at all */
+  uint32_t expected = DELTA_MASK_SIZE;
+  for (uint32_t i = 0; i < RX_DATA_WORDS; i++) {
+    if (mask & (1U << i)) {
+      expected += sizeof(uint32_t);
+    }
+  }
+  if (frame->length != expected || (mask >> RX_DATA_WORDS) != 0U)
+  {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < RX_DATA_WORDS; i++) {
+    if (mask & (1U << i)) {
+      frame_read(frame, offset, &words[i * sizeof(uint32_t)], sizeof(uint32_t));
+      offset += sizeof(uint32_t);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Records a latency in a histogram.
+ *
+ * @param latency Histogram
+ * @param latency_us Latency in microseconds
+ */
+void server_latency_record(server_latency_t *latency, uint32_t latency_us)
+{
+  uint32_t bucket = 0U;
+  while (bucket < SERVER_LATENCY_BUCKETS - 1U && (latency_us >> bucket) != 0U) {
+    bucket++;
+  }
+
+  if (latency->count == 0U || latency_us < latency->min_us) {
+    latency->min_us = latency_us;
+  }
+  if (latency_us > latency->max_us) {
+    latency->max_us = latency_us;
+  }
+
+  latency->count++;
+  latency->sum_us += latency_us;
+  latency->buckets[bucket]++;
+}
+
+#ifdef LOAD_MODULE
+/**
+ * @brief Prepares a telemetry batch frame to be transmitted.
+ *
+ * @param telemetry Batch to be transmitted, only its first `count` samples are sent
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
  */
-void tx_data(TX_DATA_TYPE *data, uint8_t *tx_buffer)
+uint32_t tx_telemetry(const load_telemetry_t *telemetry, uint8_t *tx_buffer)
 {
-  TX_MSG_TYPE *tx_wrap = (TX_MSG_TYPE*)tx_buffer;
+  const uint32_t count = telemetry->count > TELEMETRY_BATCH_MAX ? TELEMETRY_BATCH_MAX : telemetry->count;
+  const uint32_t length = TELEMETRY_HEADER_SIZE + count * sizeof(telemetry_sample_t);
+
+  memcpy(&tx_buffer[SERVER_HEADER_SIZE], telemetry, length);
+  tx_buffer[SERVER_HEADER_SIZE + offsetof(load_telemetry_t, count)] = (uint8_t)count;
 
-  tx_wrap->magic_word = TX_MAGIC_WORD;
-  memcpy(&(tx_wrap->data), data, sizeof(TX_DATA_TYPE));
-  tx_wrap->checksum = calculate_checksum(tx_buffer, sizeof(TX_MAGIC_WORD) + sizeof(TX_DATA_TYPE));;
+  return frame_finish(tx_buffer, SERVER_MSG_TELEMETRY, length);
 }
 
 /**
- * @brief Extracts the data from a received buffer.
+ * @brief Prepares a command acknowledgement frame to be transmitted.
  *
- * @param rx_buffer Buffer containing the received data
- * @param data Pointer to the struct where the data will be stored
+ * @param ack Acknowledgement to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
  */
-int rx_data(uint8_t *rx_buffer, RX_DATA_TYPE *data)
+uint32_t tx_ack(const load_ack_t *ack, uint8_t *tx_buffer)
 {
-  RX_MSG_TYPE *rx_wrap = (RX_MSG_TYPE*)rx_buffer;
+  memcpy(&tx_buffer[SERVER_HEADER_SIZE], ack, sizeof(load_ack_t));
+  return frame_finish(tx_buffer, SERVER_MSG_ACK, sizeof(load_ack_t));
+}
 
-  if (rx_wrap->magic_word != RX_MAGIC_WORD)
+/**
+ * @brief Extracts a command from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param command Pointer to the struct where the command will be stored
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_command(const server_frame_t *frame, load_command_t *command)
+{
+  if (server_frame_type(frame) != SERVER_MSG_COMMAND || frame->length != sizeof(load_command_t))
   {
     return -1;
   }
 
-  uint32_t calculated_checksum = calculate_checksum(rx_buffer, sizeof(RX_MAGIC_WORD) + sizeof(RX_DATA_TYPE));
-  if (rx_wrap->checksum != calculated_checksum)
+  frame_read(frame, frame->payload, command, sizeof(load_command_t));
+
+  return 0;
+}
+
+/**
+ * @brief Extracts the telemetry settings from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param config Pointer to the struct where the settings will be stored
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_telemetry_config(const server_frame_t *frame, load_telemetry_config_t *config)
+{
+  if (server_frame_type(frame) != SERVER_MSG_TELEMETRY_CONFIG || frame->length != sizeof(load_telemetry_config_t))
+  {
+    return -1;
+  }
+
+  frame_read(frame, frame->payload, config, sizeof(load_telemetry_config_t));
+
+  return 0;
+}
+
+/**
+ * @brief Extracts a waveform command from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param waveform Pointer to the struct where the command will be stored
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_waveform(const server_frame_t *frame, load_waveform_t *waveform)
+{
+  if (server_frame_type(frame) != SERVER_MSG_WAVEFORM || frame->length != sizeof(load_waveform_t))
   {
     return -1;
   }
 
-  memcpy(data, &(rx_wrap->data), sizeof(RX_DATA_TYPE));
+  frame_read(frame, frame->payload, waveform, sizeof(load_waveform_t));
 
   return 0;
 }
+#else
+/**
+ * @brief Prepares a waveform command frame to be transmitted.
+ *
+ * @param waveform Waveform command to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_waveform(const load_waveform_t *waveform, uint8_t *tx_buffer)
+{
+  memcpy(&tx_buffer[SERVER_HEADER_SIZE], waveform, sizeof(load_waveform_t));
+  return frame_finish(tx_buffer, SERVER_MSG_WAVEFORM, sizeof(load_waveform_t));
+}
+
+/**
+ * @brief Prepares a command frame to be transmitted.
+ *
+ * @param command Command to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_command(const load_command_t *command, uint8_t *tx_buffer)
+{
+  memcpy(&tx_buffer[SERVER_HEADER_SIZE], command, sizeof(load_command_t));
+  return frame_finish(tx_buffer, SERVER_MSG_COMMAND, sizeof(load_command_t));
+}
+
+/**
+ * @brief Prepares a poll frame, the addressed load answers with its pending acknowledgements and telemetry and ends
+ *        with a whole measurement.
+ *
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_poll(uint8_t *tx_buffer)
+{
+  return frame_finish(tx_buffer, SERVER_MSG_POLL, 0U);
+}
+
+/**
+ * @brief Prepares a sync frame, always plain so that every load applies its staged commands on the same frame.
+ *
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_sync(uint8_t *tx_buffer)
+{
+  const uint8_t address = tx_address;
+
+  tx_address = SERVER_ADDRESS_BROADCAST;
+  const uint32_t size = frame_finish(tx_buffer, SERVER_MSG_SYNC, 0U);
+  tx_address = address;
+
+  return size;
+}
+
+/**
+ * @brief Extracts a command acknowledgement from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param ack Pointer to the struct where the acknowledgement will be stored
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_ack(const server_frame_t *frame, load_ack_t *ack)
+{
+  if (server_frame_type(frame) != SERVER_MSG_ACK || frame->length != sizeof(load_ack_t))
+  {
+    return -1;
+  }
+
+  frame_read(frame, frame->payload, ack, sizeof(load_ack_t));
+
+  return 0;
+}
+
+/**
+ * @brief Prepares a telemetry settings frame to be transmitted.
+ *
+ * @param config Settings to be transmitted
+ * @param tx_buffer Buffer of SERVER_FRAME_SIZE_MAX bytes to store the frame
+ * @return uint32_t Frame size
+ */
+uint32_t tx_telemetry_config(const load_telemetry_config_t *config, uint8_t *tx_buffer)
+{
+  memcpy(&tx_buffer[SERVER_HEADER_SIZE], config, sizeof(load_telemetry_config_t));
+  return frame_finish(tx_buffer, SERVER_MSG_TELEMETRY_CONFIG, sizeof(load_telemetry_config_t));
+}
+
+/**
+ * @brief Extracts a telemetry batch from a received frame.
+ *
+ * @param frame Frame returned by parse_byte() or server_frame_find()
+ * @param telemetry Pointer to the struct where the batch will be stored, samples past `count` are left untouched
+ * @return int 0 on success, -1 on a wrong type or size
+ */
+int rx_telemetry(const server_frame_t *frame, load_telemetry_t *telemetry)
+{
+  if (server_frame_type(frame) != SERVER_MSG_TELEMETRY || frame->length < TELEMETRY_HEADER_SIZE)
+  {
+    return -1;
+  }
+
+  const uint8_t count = frame_byte(frame, frame->payload + offsetof(load_telemetry_t, count));
+  if (count > TELEMETRY_BATCH_MAX || frame->length != TELEMETRY_HEADER_SIZE + count * sizeof(telemetry_sample_t))
+  {
+    return -1;
+  }
+
+  frame_read(frame, frame->payload, telemetry, frame->length);
+
+  return 0;
+}
+#endif
 
 /** Implementations */
 
 /**
- * @brief Calculate the checksum of a given data buffer.
+ * @brief Fills the header and CRC around a payload already in place, moving the payload after the address byte
+ *        of addressed frames.
  *
- * @param data Pointer to the data buffer
- * @param size Size of the data buffer
- * @return uint32_t Checksum of the data buffer
+ * @param tx_buffer Frame buffer, the payload starts at SERVER_HEADER_SIZE
+ * @param type Frame type
+ * @param length Payload length
+ * @return uint32_t Frame size
  */
-static uint32_t calculate_checksum(void *data, uint32_t size)
+static uint32_t frame_finish(uint8_t *tx_buffer, server_msg_type_t type, uint32_t length)
 {
-  uint32_t checksum = 0;
-  uint8_t *data_ptr = (uint8_t *)data;
+  uint32_t header = SERVER_HEADER_SIZE;
+
+  tx_buffer[0] = SERVER_SYNC_BYTE;
+  tx_buffer[1] = (uint8_t)length;
+  tx_buffer[2] = (uint8_t)type;
+  tx_buffer[3] = tx_seq++;
+
+  if (tx_address != SERVER_ADDRESS_BROADCAST) {
+    memmove(&tx_buffer[SERVER_HEADER_SIZE + SERVER_ADDRESS_SIZE], &tx_buffer[SERVER_HEADER_SIZE], length);
+    tx_buffer[2] |= SERVER_MSG_ADDRESSED;
+    tx_buffer[SERVER_HEADER_SIZE] = tx_address;
+    header += SERVER_ADDRESS_SIZE;
+  }
 
-  for (uint32_t i = 0; i < size; i++) {
-    checksum += data_ptr[i];
+  uint16_t crc = 0xFFFFU;
+  for (uint32_t i = 1U; i < header + length; i++) {
+    crc = crc16_update(crc, tx_buffer[i]);
   }
 
-  return checksum;
+  tx_buffer[header + length] = (uint8_t)crc;
+  tx_buffer[header + length + 1U] = (uint8_t)(crc >> 8U);
+
+  return header + length + SERVER_CRC_SIZE;
+}
+
+/**
+ * @brief Header size of a frame, the address byte included.
+ *
+ * @param type Type byte as received
+ * @return uint32_t Offset of the payload from the sync byte
+ */
+static uint32_t frame_header_size(uint8_t type)
+{
+  return (type & SERVER_MSG_ADDRESSED) ? SERVER_HEADER_SIZE + SERVER_ADDRESS_SIZE : SERVER_HEADER_SIZE;
+}
+
+/**
+ * @brief Fills the view of a frame with a valid CRC and tracks its sequence.
+ *
+ * @param frame View to fill
+ * @param buffer Buffer holding the frame
+ * @param size Buffer size
+ * @param start Offset of the sync byte
+ */
+static void frame_accept(server_frame_t *frame, const uint8_t *buffer, uint32_t size, uint32_t start)
+{
+  frame->buffer = buffer;
+  frame->size = size;
+  frame->start = start;
+  frame->length = frame_byte(frame, 1U);
+  frame->type = frame_byte(frame, 2U);
+  frame->seq = frame_byte(frame, 3U);
+  frame->payload = (uint8_t)frame_header_size(frame->type);
+  frame->address = (frame->type & SERVER_MSG_ADDRESSED) ? frame_byte(frame, SERVER_HEADER_SIZE) : SERVER_ADDRESS_BROADCAST;
+  frame->type &= (uint8_t)~SERVER_MSG_ADDRESSED;
+
+  /** A gap means a state frame may be lost, deltas wait for the next whole struct */
+  if (frame->seq != rx_seq) {
+    rx_synced = 0U;
+  }
+  rx_seq = frame->seq + 1U;
+}
+
+/**
+ * @brief Byte of a frame.
+ *
+ * @param frame Frame
+ * @param offset Offset from the sync byte
+ * @return uint8_t Byte
+ */
+static uint8_t frame_byte(const server_frame_t *frame, uint32_t offset)
+{
+  return frame->buffer[(frame->start + offset) % frame->size];
+}
+
+/**
+ * @brief Copies bytes out of a frame, in up to two pieces when it wraps.
+ *
+ * @param frame Frame
+ * @param offset Offset from the sync byte
+ * @param data Destination
+ * @param size Number of bytes
+ */
+static void frame_read(const server_frame_t *frame, uint32_t offset, void *data, uint32_t size)
+{
+  const uint32_t first = (frame->start + offset) % frame->size;
+  const uint32_t until_end = frame->size - first;
+  uint8_t *destination = (uint8_t *)data;
+
+  if (size <= until_end) {
+    memcpy(destination, &frame->buffer[first], size);
+  } else {
+    memcpy(destination, &frame->buffer[first], until_end);
+    memcpy(&destination[until_end], frame->buffer, size - until_end);
+  }
+}
+
+/**
+ * @brief Feeds a byte to a CRC-16/CCITT-FALSE, a nibble at a time.
+ *
+ * @param crc Running CRC, 0xFFFF at the start
+ * @param byte Byte
+ * @return uint16_t Updated CRC
+ */
+static uint16_t crc16_update(uint16_t crc, uint8_t byte)
+{
+  crc = (uint16_t)((crc << 4U) ^ crc16_table[(crc >> 12U) ^ (byte >> 4U)]);
+  crc = (uint16_t)((crc << 4U) ^ crc16_table[(crc >> 12U) ^ (byte & 0x0FU)]);
+  return crc;
 }
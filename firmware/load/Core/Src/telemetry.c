@@ -0,0 +1,300 @@
+#include <string.h>
+#include "telemetry.h"
+#include "timestamp.h"
+
+/**
+ * @brief Conversions drained from each ring at once in raw mode, a control period holds about two of each channel
+ *
+ */
+#define TELEMETRY_RAW_CHUNK_SIZE 8U
+
+telemetry_t h_telemetry;
+
+/* Prototypes */
+static void telemetry_update_time(telemetry_t *telemetry);
+static uint32_t telemetry_time_us(const telemetry_t *telemetry, uint32_t cycles);
+static void telemetry_align_raw(telemetry_t *telemetry);
+static void telemetry_drain_raw(telemetry_t *telemetry, const control_t *control_handler);
+static void telemetry_push(telemetry_t *telemetry, const control_t *control_handler, uint32_t timestamp_us);
+static void telemetry_sample(telemetry_t *telemetry, const control_t *control_handler, telemetry_sample_t *sample,
+							 uint32_t timestamp_us);
+
+/**
+ * @brief Initialize the telemetry, streaming off
+ *
+ * @param telemetry Telemetry handler
+ */
+void telemetry_init(telemetry_t *telemetry)
+{
+	memset(telemetry, 0, sizeof(telemetry_t));
+	adc_reader_init(&telemetry->reader);
+	telemetry->config.mode = TELEMETRY_OFF;
+	telemetry->config.batch = TELEMETRY_BATCH_MAX;
+	telemetry->config.decimation = 1U;
+	telemetry->last_cycles = timestamp_get();
+}
+
+/**
+ * @brief Change the streaming settings, applied on the next control period
+ *
+ * @param telemetry Telemetry handler
+ * @param config Settings
+ * @return HAL_StatusTypeDef HAL_ERROR on invalid settings
+ */
+HAL_StatusTypeDef telemetry_configure(telemetry_t *telemetry, const load_telemetry_config_t *config)
+{
+	if (config->mode > TELEMETRY_RAW || config->batch == 0U || config->batch > TELEMETRY_BATCH_MAX ||
+		config->decimation == 0U)
+	{
+		return HAL_ERROR;
+	}
+
+	telemetry->pending = *config;
+	telemetry->reconfigure = 1U;
+	return HAL_OK;
+}
+
+/**
+ * @brief Take a sample if due, must be called from the control loop after control_update()
+ *
+ * @param telemetry Telemetry handler
+ * @param control_handler Control the DAC code is read from
+ */
+void telemetry_tick(telemetry_t *telemetry, const control_t *control_handler)
+{
+	telemetry_update_time(telemetry);
+
+	/* The batch being filled is dropped, the queued ones keep their settings */
+	if (telemetry->reconfigure)
+	{
+		telemetry->config = telemetry->pending;
+		telemetry->reconfigure = 0U;
+		telemetry->periods = 0U;
+		telemetry->filling = 0U;
+		telemetry->dropped = 0U;
+
+		/* Raw samples start with the conversions that follow */
+		if (telemetry->config.mode == TELEMETRY_RAW)
+		{
+			telemetry_align_raw(telemetry);
+		}
+	}
+
+	if (telemetry->config.mode == TELEMETRY_OFF)
+	{
+		return;
+	}
+
+	/* Every conversion of the period, not just the newest */
+	if (telemetry->config.mode == TELEMETRY_RAW)
+	{
+		telemetry_drain_raw(telemetry, control_handler);
+		return;
+	}
+
+	if (++telemetry->periods < telemetry->config.decimation)
+	{
+		return;
+	}
+	telemetry->periods = 0U;
+
+	/* Consume the samples of the window even when the queue is full, so the next average starts fresh */
+	adc_reader_update(&telemetry->reader);
+	telemetry_push(telemetry, control_handler, telemetry->time_us);
+}
+
+/**
+ * @brief Oldest complete batch, must only be called from the superloop
+ *
+ * @param telemetry Telemetry handler
+ * @return const load_telemetry_t* NULL if none
+ */
+const load_telemetry_t *telemetry_peek(telemetry_t *telemetry)
+{
+	if (telemetry->head == telemetry->tail)
+	{
+		return NULL;
+	}
+
+	__DMB();
+	return &telemetry->queue[telemetry->tail & TELEMETRY_QUEUE_MASK];
+}
+
+/**
+ * @brief Release the batch returned by telemetry_peek() once it is sent
+ *
+ * @param telemetry Telemetry handler
+ */
+void telemetry_release(telemetry_t *telemetry)
+{
+	if (telemetry->head != telemetry->tail)
+	{
+		telemetry->tail++;
+	}
+}
+
+/**
+ * @brief Advance the microseconds since boot, the cycle counter wraps every ~59 s
+ *
+ * @param telemetry Telemetry handler
+ */
+static void telemetry_update_time(telemetry_t *telemetry)
+{
+	const uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+	const uint32_t now = timestamp_get();
+
+	telemetry->cycles_remainder += now - telemetry->last_cycles;
+	telemetry->last_cycles = now;
+
+	telemetry->time_us += telemetry->cycles_remainder / cycles_per_us;
+	telemetry->cycles_remainder %= cycles_per_us;
+}
+
+/**
+ * @brief Cycle counter value of a past instant on the microseconds since boot
+ *
+ * @param telemetry Telemetry handler, time updated this period
+ * @param cycles Cycle counter value, not after the last update
+ * @return uint32_t Microseconds since boot
+ */
+static uint32_t telemetry_time_us(const telemetry_t *telemetry, uint32_t cycles)
+{
+	const uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+	/* time_us was reached cycles_remainder cycles before the last update */
+	const int32_t elapsed = (int32_t)(telemetry->last_cycles - telemetry->cycles_remainder - cycles);
+
+	return (elapsed > 0) ? telemetry->time_us - (uint32_t)elapsed / cycles_per_us : telemetry->time_us;
+}
+
+/**
+ * @brief Put both channel readers on the next conversion of the current
+ * 	The engine converts the voltage then the current, so the voltage ring is never behind the current one and
+ * 	the conversions of a given number on both rings make a pair. The conversions not read yet are skipped.
+ *
+ * @param telemetry Telemetry handler
+ */
+static void telemetry_align_raw(telemetry_t *telemetry)
+{
+	const uint32_t head = telemetry->reader.channels[ADC_INPUT_CURRENT].ring->head;
+
+	telemetry->reader.channels[ADC_INPUT_VOLTAGE].tail = head;
+	telemetry->reader.channels[ADC_INPUT_CURRENT].tail = head;
+}
+
+/**
+ * @brief Sample every `decimation` voltage and current conversion pair acquired since the last period
+ * 	The pairs carry the time of their voltage conversion, the newest temperature and the DAC code of the period.
+ *
+ * @param telemetry Telemetry handler
+ * @param control_handler Control the DAC code is read from
+ */
+static void telemetry_drain_raw(telemetry_t *telemetry, const control_t *control_handler)
+{
+	adc_reader_t *reader = &telemetry->reader;
+	sample_t voltages[TELEMETRY_RAW_CHUNK_SIZE];
+	sample_t currents[TELEMETRY_RAW_CHUNK_SIZE];
+	sample_t temperature;
+
+	while (sample_reader_read(&reader->channels[ADC_TEMPERATURE], &temperature, 1U) > 0U)
+	{
+		reader->value[ADC_TEMPERATURE] = temperature.value;
+	}
+
+	/* A reader lapped by the acquisition loses the pairing */
+	if (reader->channels[ADC_INPUT_VOLTAGE].tail != reader->channels[ADC_INPUT_CURRENT].tail)
+	{
+		telemetry_align_raw(telemetry);
+	}
+
+	for (;;)
+	{
+		const uint32_t voltage_available = sample_reader_available(&reader->channels[ADC_INPUT_VOLTAGE]);
+		const uint32_t current_available = sample_reader_available(&reader->channels[ADC_INPUT_CURRENT]);
+		uint32_t pairs = (voltage_available < current_available) ? voltage_available : current_available;
+
+		if (pairs == 0U)
+		{
+			return;
+		}
+		if (pairs > TELEMETRY_RAW_CHUNK_SIZE)
+		{
+			pairs = TELEMETRY_RAW_CHUNK_SIZE;
+		}
+
+		pairs = sample_reader_read(&reader->channels[ADC_INPUT_VOLTAGE], voltages, pairs);
+		if (sample_reader_read(&reader->channels[ADC_INPUT_CURRENT], currents, pairs) != pairs)
+		{
+			telemetry_align_raw(telemetry);
+			return;
+		}
+
+		for (uint32_t i = 0; i < pairs; i++)
+		{
+			if (++telemetry->periods < telemetry->config.decimation)
+			{
+				continue;
+			}
+			telemetry->periods = 0U;
+
+			reader->value[ADC_INPUT_VOLTAGE] = voltages[i].value;
+			reader->value[ADC_INPUT_CURRENT] = currents[i].value;
+			telemetry_push(telemetry, control_handler, telemetry_time_us(telemetry, voltages[i].timestamp));
+		}
+	}
+}
+
+/**
+ * @brief Add a sample of the reader values to the batch being filled, publish it once complete
+ *
+ * @param telemetry Telemetry handler
+ * @param control_handler Control the DAC code is read from
+ * @param timestamp_us Sample time
+ */
+static void telemetry_push(telemetry_t *telemetry, const control_t *control_handler, uint32_t timestamp_us)
+{
+	if (telemetry->head - telemetry->tail >= TELEMETRY_QUEUE_SIZE)
+	{
+		telemetry->dropped++;
+		return;
+	}
+
+	load_telemetry_t *batch = &telemetry->queue[telemetry->head & TELEMETRY_QUEUE_MASK];
+	telemetry_sample(telemetry, control_handler, &batch->samples[telemetry->filling++], timestamp_us);
+
+	if (telemetry->filling < telemetry->config.batch)
+	{
+		return;
+	}
+
+	batch->mode = telemetry->config.mode;
+	batch->count = (uint8_t)telemetry->filling;
+	batch->decimation = telemetry->config.decimation;
+	batch->dropped = telemetry->dropped;
+	telemetry->filling = 0U;
+
+	/* Publish the batch after it is complete */
+	__DMB();
+	telemetry->head++;
+}
+
+/**
+ * @brief Fill a sample from the reader values
+ *
+ * @param telemetry Telemetry handler
+ * @param control_handler Control handler
+ * @param sample Sample
+ * @param timestamp_us Sample time
+ */
+static void telemetry_sample(telemetry_t *telemetry, const control_t *control_handler, telemetry_sample_t *sample,
+							 uint32_t timestamp_us)
+{
+	const int32_t voltage = q16_to_milli(adc_reader_get_value_q16(&telemetry->reader, ADC_INPUT_VOLTAGE));
+	const int32_t current = q16_to_milli(adc_reader_get_value_q16(&telemetry->reader, ADC_INPUT_CURRENT));
+	const int32_t temperature = q16_to_milli(adc_reader_get_value_q16(&telemetry->reader, ADC_TEMPERATURE)) / 10;
+
+	sample->timestamp_us = timestamp_us;
+	sample->voltage_milli = voltage > 0 ? (uint32_t)voltage : 0U;
+	sample->current_milli = current > 0 ? (uint32_t)current : 0U;
+	sample->temperature_centi = (int16_t)(temperature > INT16_MAX ? INT16_MAX : (temperature < INT16_MIN ? INT16_MIN : temperature));
+	sample->dac_code = control_handler->dac->output;
+}
@@ -1,29 +1,205 @@
+#include <string.h>
+
 #include "uart.h"
 #include "utils.h"
+#include "waveform.h"
+#include "telemetry.h"
+#include "control.h"
+#include "timestamp.h"
+#include "scpi.h"
+
+/** Room for two frames, frames are located at half, full transfer and idle line */
+#define UART_RX_BUFFER_SIZE (SERVER_FRAME_SIZE_MAX * 2U)
+
+/** Measurement period, telemetry batches go out in between as soon as they are complete */
+#define UART_MEASUREMENT_PERIOD_MS 200U
+
+/** Commands waiting for the control loop or for their acknowledgement to leave, power of two */
+#define UART_COMMAND_QUEUE_SIZE 8U
+#define UART_COMMAND_QUEUE_MASK (UART_COMMAND_QUEUE_SIZE - 1U)
+
+/**
+ * @brief Command in flight, filled by the RX interrupt and completed by the control loop
+ *
+ */
+typedef struct
+{
+  load_ack_t ack;
+  uint32_t received;   // Timestamp of the reception
+  uint32_t generation; // Settings generation holding the command
+} uart_command_t;
 
-/** Local load state handler */
+/** Local load state handler, the control settings are handed over by uart_get_control() */
 load_state_t h_load_state;
 
 /** Local uart control and handler */
 static UART_HandleTypeDef *uart;
-static uint8_t uart_dma_busy = 0U;
-static uint16_t uart_buffer_parsed = 0U;
+static volatile uint8_t uart_dma_busy = 0U;
+static uint32_t uart_next_measurement = 0U;
+/** First byte of the ring not consumed yet */
+static uint32_t uart_rx_head = 0U;
+
+/** Control settings double buffer, the RX interrupt fills the back one and swaps */
+static load_control_t uart_control[2];
+static volatile uint8_t uart_control_front = 0U;
+/** Bumped on every swap, lets readers detect a swap during their copy */
+static volatile uint32_t uart_control_generation = 0U;
+/** Generation of the settings last handed over by uart_get_control() */
+static uint32_t uart_control_read_generation = 0U;
+
+/** Command queue, received by the RX interrupt, taken by the control loop, sent by the superloop */
+static uart_command_t uart_commands[UART_COMMAND_QUEUE_SIZE];
+static volatile uint32_t uart_commands_received = 0U;
+static volatile uint32_t uart_commands_taken = 0U;
+static volatile uint32_t uart_commands_sent = 0U;
+/** Reception to application latency of the commands */
+static server_latency_t uart_command_latency;
+
+/** Address on a bus, SERVER_ADDRESS_BROADCAST on a point to point link */
+static uint8_t uart_address = SERVER_ADDRESS_BROADCAST;
+/** Set by a poll, the load answers until its measurement is sent */
+static volatile uint8_t uart_polled = 0U;
+/** A telemetry batch may still go in the current poll slot */
+static volatile uint8_t uart_poll_telemetry = 0U;
+/** Commands held until the next sync, one per setting */
+static load_command_t uart_staged[COMMAND_KEY_COUNT];
+static uint32_t uart_staged_mask = 0U;
+
+/** Text commands, parsed in place in the RX buffer, a complete one waits for the superloop */
+static scpi_stream_t uart_text_stream;
+static scpi_request_t uart_text_request;
+static volatile uint8_t uart_text_pending = 0U;
+
+/** Prototypes */
+static void uart_start_receive(void);
+static uint32_t uart_bus_frame(const load_telemetry_t **batch);
+static void uart_queue_command(const load_command_t *command);
+static void uart_handle_text(uint32_t start, uint32_t length);
+static int uart_frame_after(uint32_t start, uint32_t tail);
+static void uart_text_on_request(const scpi_request_t *request);
+static void uart_scpi_get_control(load_control_t *control);
+static void uart_scpi_get_measurement(load_measurement_t *measurement);
+static int uart_scpi_set(const load_command_t *command);
+
+/** The load side of the text commands */
+static const scpi_target_t uart_scpi_target = {
+  .identification = "Simple Electronic Load,Load",
+  .get_control = uart_scpi_get_control,
+  .get_measurement = uart_scpi_get_measurement,
+  .set = uart_scpi_set,
+};
 
 /** Buffers */
-static uint8_t uart_rx_buffer[RX_MSG_SIZE * 2];
-static uint8_t uart_tx_buffer[TX_MSG_SIZE];
+static uint8_t uart_rx_buffer[UART_RX_BUFFER_SIZE];
+static uint8_t uart_tx_buffer[SERVER_FRAME_SIZE_MAX];
+
+/**
+ * @brief Set the address of the load on a bus, must be called before uart_init()
+ *  On a bus the load takes the plain frames and the ones addressed to it, and only transmits when polled.
+ *
+ * @param address Address, SERVER_ADDRESS_BROADCAST for a point to point link
+ */
+void uart_set_address(uint8_t address)
+{
+  uart_address = address;
+  server_set_address(address);
+}
 
 /* UART initialization */
 void uart_init(UART_HandleTypeDef *huart_rx)
 {
   uart = huart_rx;
 
-  if (HAL_UARTEx_ReceiveToIdle_DMA(uart, uart_rx_buffer, RX_MSG_SIZE * 2) != HAL_OK)
+  scpi_stream_init(&uart_text_stream, &uart_text_on_request);
+  uart_start_receive();
+}
+
+/**
+ * @brief Copy of the last control settings received,
+ *        must not be called from an interrupt preempting the UART one
+ *
+ * @param control Output settings
+ */
+void uart_get_control(load_control_t *control)
+{
+  uint32_t generation;
+
+  do
   {
-    LOG_ERROR("UART receive error\n");
+    generation = uart_control_generation;
+    __DMB();
+    memcpy(control, &uart_control[uart_control_front], sizeof(load_control_t));
+    __DMB();
+  } while (generation != uart_control_generation);
+
+  uart_control_read_generation = generation;
+}
+
+/**
+ * @brief Complete the commands held by the settings last read with uart_get_control(),
+ *        must be called from the control loop once the settings are applied
+ *
+ * @param control_handler Control loop
+ * @param settings Settings returned by uart_get_control()
+ * @param overridden Non zero when the waveform player owns the set points
+ */
+void uart_acknowledge_commands(struct control *control_handler, const load_control_t *settings, uint8_t overridden)
+{
+  uint32_t taken = uart_commands_taken;
+  const uint32_t received = uart_commands_received;
+  __DMB();
+
+  for (; taken != received; taken++) {
+    uart_command_t *command = &uart_commands[taken & UART_COMMAND_QUEUE_MASK];
+
+    /* Received after the settings were read, wait for the next period */
+    if ((int32_t)(command->generation - uart_control_read_generation) > 0) {
+      break;
+    }
+
+    load_ack_t *ack = &command->ack;
+    if (ack->status == ACK_APPLIED && overridden) {
+      ack->status = ACK_OVERRIDDEN;
+    }
+
+    /* Report what the loop runs with, the set points may have been clamped */
+    if (ack->key == COMMAND_ENABLE) {
+      ack->value = settings->enable;
+    } else if (ack->key == COMMAND_MODE) {
+      ack->value = (uint32_t)settings->mode;
+    } else if (ack->key < COMMAND_KEY_COUNT) {
+      const load_mode_t mode = (load_mode_t)(ack->key - COMMAND_CC);
+      const set_point_t *set_points = &settings->cc;
+      ack->value = overridden ? set_points[mode].value_milli
+                              : (uint32_t)CONTROL_VALUE_TO_MILLI(control_get_setpoint(control_handler, control_mode_from_server(mode)));
+    }
+
+    ack->timestamp_us = h_telemetry.time_us;
+    ack->latency_us = timestamp_to_us(timestamp_get() - command->received);
+    server_latency_record(&uart_command_latency, ack->latency_us);
   }
+
+  __DMB();
+  uart_commands_taken = taken;
 }
 
+/**
+ * @brief Copy of the reception to application latency histogram of the commands
+ *
+ * @param latency Output histogram
+ */
+void uart_get_command_latency(server_latency_t *latency)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  *latency = uart_command_latency;
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Send the next frame due, must be called from the superloop as often as possible
+ *  The measurement goes every UART_MEASUREMENT_PERIOD_MS, telemetry batches fill the link in between.
+ */
 void uart_transmit(void)
 {
   if (uart_dma_busy)
@@ -31,11 +207,62 @@ void uart_transmit(void)
     return;
   }
 
-  tx_data(&(h_load_state.measurement), uart_tx_buffer);
+  uint32_t size;
+  const load_telemetry_t *batch = NULL;
+  const uint32_t sent = uart_commands_sent;
+
+  /* On a bus the load only talks in its poll slot */
+  if (uart_address != SERVER_ADDRESS_BROADCAST)
+  {
+    size = uart_bus_frame(&batch);
+    if (size == 0U)
+    {
+      return;
+    }
+  }
+  /* Acknowledgements first, the panel waits on them */
+  else if (sent != uart_commands_taken)
+  {
+    __DMB();
+    size = tx_ack(&uart_commands[sent & UART_COMMAND_QUEUE_MASK].ack, uart_tx_buffer);
+    uart_commands_sent = sent + 1U;
+  }
+  else if (uart_text_pending != 0U)
+  {
+    /* Only queries are answered, sets and rejected commands are dropped */
+    const int length = scpi_request_execute(&uart_scpi_target, &uart_text_request, (char *)uart_tx_buffer,
+                                            SERVER_FRAME_SIZE_MAX);
+    uart_text_pending = 0U;
+    if (length <= 0)
+    {
+      return;
+    }
+    size = (uint32_t)length;
+  }
+  else if ((int32_t)(HAL_GetTick() - uart_next_measurement) >= 0)
+  {
+    uart_next_measurement = HAL_GetTick() + UART_MEASUREMENT_PERIOD_MS;
+    size = tx_data(&(h_load_state.measurement), uart_tx_buffer);
+  }
+  else if ((batch = telemetry_peek(&h_telemetry)) != NULL)
+  {
+    size = tx_telemetry(batch, uart_tx_buffer);
+  }
+  else
+  {
+    return;
+  }
+
+  /* The frame is in the TX buffer, the batch can be reused */
+  if (batch != NULL)
+  {
+    telemetry_release(&h_telemetry);
+  }
 
-  if (HAL_UART_Transmit_DMA(uart, uart_tx_buffer, TX_MSG_SIZE) == HAL_OK)
+  uart_dma_busy = 1U;
+  if (HAL_UART_Transmit_DMA(uart, uart_tx_buffer, (uint16_t)size) != HAL_OK)
   {
-    uart_dma_busy = 1U;
+    uart_dma_busy = 0U;
   }
 }
 
@@ -50,6 +277,275 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
   uart_dma_busy = 0U;
 }
 
+/**
+ * @brief Next frame of the answer to a poll: the acknowledgements, a telemetry batch, then the measurement that ends it
+ *
+ * @param batch Set to the batch sent, to be released once it is in the TX buffer
+ * @return uint32_t Frame size, 0 when not polled
+ */
+static uint32_t uart_bus_frame(const load_telemetry_t **batch)
+{
+  const uint32_t sent = uart_commands_sent;
+
+  if (uart_polled == 0U)
+  {
+    return 0U;
+  }
+
+  if (sent != uart_commands_taken)
+  {
+    __DMB();
+    uart_commands_sent = sent + 1U;
+    return tx_ack(&uart_commands[sent & UART_COMMAND_QUEUE_MASK].ack, uart_tx_buffer);
+  }
+
+  /* A single batch per slot, the other loads wait on the answer */
+  if (uart_poll_telemetry != 0U && (*batch = telemetry_peek(&h_telemetry)) != NULL)
+  {
+    uart_poll_telemetry = 0U;
+    return tx_telemetry(*batch, uart_tx_buffer);
+  }
+
+  /* The controller moves on to the next load once the measurement is in */
+  uart_polled = 0U;
+  return tx_data(&(h_load_state.measurement), uart_tx_buffer);
+}
+
+/**
+ * @brief Apply a command on the settings
+ *
+ * @param command Command
+ * @param control Settings to update
+ * @return int 0 on success, -1 if the command is invalid
+ */
+static int uart_apply_command(const load_command_t *command, load_control_t *control)
+{
+  set_point_t *set_points = &control->cc;
+
+  switch (command->key) {
+    case COMMAND_ENABLE:
+      if (command->value > 1U) {
+        return -1;
+      }
+      control->enable = command->value;
+      return 0;
+    case COMMAND_MODE:
+      if (command->value > (uint32_t)CP) {
+        return -1;
+      }
+      control->mode = (load_mode_t)command->value;
+      return 0;
+    case COMMAND_CC:
+    case COMMAND_CV:
+    case COMMAND_CR:
+    case COMMAND_CP:
+      set_points[command->key - COMMAND_CC].value_milli = command->value;
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+/**
+ * @brief Apply a command on the settings and hand them over, must not be preempted by the RX interrupt
+ *
+ * @param command Command
+ * @return int 0 on success, -1 if the command is invalid
+ */
+static int uart_update_control(const load_command_t *command)
+{
+  /* The command applies on the last settings, readers keep using the front ones meanwhile */
+  const uint8_t back = uart_control_front ^ 1U;
+  memcpy(&uart_control[back], &uart_control[uart_control_front], sizeof(load_control_t));
+
+  if (uart_apply_command(command, &uart_control[back]) < 0) {
+    return -1;
+  }
+
+  uart_control_generation++;
+  __DMB();
+  uart_control_front = back;
+  return 0;
+}
+
+/**
+ * @brief Queue a command and apply it on the settings, the control loop acknowledges it on its next period
+ *
+ * @param command Command
+ */
+static void uart_queue_command(const load_command_t *command)
+{
+  /* The panel retries commands left without acknowledgement */
+  const uint32_t received = uart_commands_received;
+  if (received - uart_commands_sent >= UART_COMMAND_QUEUE_SIZE) {
+    LOG_ERROR("Command queue full\n");
+    return;
+  }
+
+  uart_command_t *entry = &uart_commands[received & UART_COMMAND_QUEUE_MASK];
+  entry->received = timestamp_get();
+  entry->ack.id = command->id;
+  entry->ack.key = command->key;
+  entry->ack.status = ACK_REJECTED;
+  entry->ack.value = command->value;
+
+  if (uart_update_control(command) == 0) {
+    entry->ack.status = ACK_APPLIED;
+  }
+
+  entry->generation = uart_control_generation;
+  __DMB();
+  uart_commands_received = received + 1U;
+}
+
+/**
+ * @brief Queue a received command, or hold a staged one until the next sync
+ *
+ * @param frame Command frame located in the RX ring
+ */
+static void uart_handle_command(const server_frame_t *frame)
+{
+  load_command_t command;
+  if (rx_command(frame, &command) < 0) {
+    LOG_ERROR("RX command error\n");
+    return;
+  }
+
+  /* A later staged command for the same setting replaces the held one, invalid keys are rejected right away */
+  if ((command.flags & COMMAND_FLAG_STAGED) && command.key < COMMAND_KEY_COUNT) {
+    uart_staged[command.key] = command;
+    uart_staged_mask |= 1U << command.key;
+    return;
+  }
+
+  uart_queue_command(&command);
+}
+
+/**
+ * @brief Apply the staged commands together, they are all held by the same settings for the control loop
+ *
+ */
+static void uart_handle_sync(void)
+{
+  for (uint32_t key = 0U; key < COMMAND_KEY_COUNT; key++) {
+    if (uart_staged_mask & (1U << key)) {
+      uart_queue_command(&uart_staged[key]);
+    }
+  }
+
+  uart_staged_mask = 0U;
+}
+
+/**
+ * @brief Dispatch a complete frame by its type
+ *
+ * @param frame Frame located in the RX ring
+ */
+static void uart_handle_frame(const server_frame_t *frame)
+{
+  /* Frames addressed to the other loads of the bus, or to some load when on a point to point link */
+  if (frame->address != SERVER_ADDRESS_BROADCAST && frame->address != uart_address) {
+    return;
+  }
+
+  if (server_frame_type(frame) == SERVER_MSG_POLL) {
+    uart_poll_telemetry = 1U;
+    uart_polled = 1U;
+    return;
+  }
+
+  if (server_frame_type(frame) == SERVER_MSG_SYNC) {
+    uart_handle_sync();
+    return;
+  }
+
+  if (server_frame_type(frame) == SERVER_MSG_WAVEFORM) {
+    load_waveform_t waveform;
+    if (rx_waveform(frame, &waveform) < 0) {
+      LOG_ERROR("RX waveform error\n");
+    } else if (waveform_handle(&h_waveform, &waveform) != HAL_OK) {
+      LOG_ERROR("Waveform command rejected\n");
+    }
+    return;
+  }
+
+  if (server_frame_type(frame) == SERVER_MSG_COMMAND) {
+    uart_handle_command(frame);
+    return;
+  }
+
+  if (server_frame_type(frame) == SERVER_MSG_TELEMETRY_CONFIG) {
+    load_telemetry_config_t config;
+    if (rx_telemetry_config(frame, &config) < 0 || telemetry_configure(&h_telemetry, &config) != HAL_OK) {
+      LOG_ERROR("Telemetry settings rejected\n");
+    }
+    return;
+  }
+
+  /* Deltas apply on the last settings, readers keep using the front ones meanwhile */
+  const uint8_t back = uart_control_front ^ 1U;
+  memcpy(&uart_control[back], &uart_control[uart_control_front], sizeof(load_control_t));
+
+  if (rx_data(frame, &uart_control[back]) < 0) {
+    LOG_ERROR("RX data error\n");
+    return;
+  }
+
+  uart_control_generation++;
+  __DMB();
+  uart_control_front = back;
+}
+
+/**
+ * @brief Parse a run of text bytes where they lie in the RX buffer
+ *
+ * @param start Index of the first byte
+ * @param length Bytes in the run, it does not wrap
+ */
+static void uart_handle_text(uint32_t start, uint32_t length)
+{
+  /* The loads of a bus would all answer at once */
+  if (length > 0U && uart_address == SERVER_ADDRESS_BROADCAST) {
+    scpi_stream_feed(&uart_text_stream, (const char *)&uart_rx_buffer[start], length);
+  }
+}
+
+/**
+ * @brief Whether a complete frame starts after a sync byte, the candidate waiting for its bytes there is then a false
+ *        sync: a frame cut by the end of the data has no complete one inside it
+ *
+ * @param start Index of the sync byte
+ * @param tail Index of the next byte to be received
+ * @return int 1 if a complete frame starts between the sync byte and the tail
+ */
+static int uart_frame_after(uint32_t start, uint32_t tail)
+{
+  /* Only looked at: taking it would move the sequence past the frames consumed before it */
+  for (uint32_t next = (start + 1U) % UART_RX_BUFFER_SIZE; next != tail; next = (next + 1U) % UART_RX_BUFFER_SIZE) {
+    if (uart_rx_buffer[next] == SERVER_SYNC_BYTE &&
+        server_frame_check(uart_rx_buffer, UART_RX_BUFFER_SIZE, next, tail) > 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Hand a complete text command to the superloop, called by the stream from the RX interrupt
+ *
+ * @param request Command matched
+ */
+static void uart_text_on_request(const scpi_request_t *request)
+{
+  /* A command arriving before the last one is executed is dropped */
+  if (uart_text_pending == 0U) {
+    uart_text_request = *request;
+    __DMB();
+    uart_text_pending = 1U;
+  }
+}
+
 void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
 {
   /** We only care about our uart */
@@ -58,17 +554,49 @@ void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
     return;
   }
 
-  while (uart_buffer_parsed != Size) {
-    /* Print all the buffer */
-    uint8_t *msg = parse_byte(uart_rx_buffer[uart_buffer_parsed]);
+  (void)Size;
+
+  /* The DMA counter gives the write position on idle, half and full events alike */
+  const uint32_t tail = (UART_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(huart->hdmarx)) % UART_RX_BUFFER_SIZE;
+  server_frame_t frame;
+  uint32_t text = uart_rx_head;
+
+  /* Frames start with a non ASCII sync byte, the runs of bytes between them belong to text commands */
+  while (uart_rx_head != tail) {
+    int found = server_frame_at(uart_rx_buffer, UART_RX_BUFFER_SIZE, uart_rx_head, tail, &frame);
+
+    /* Resync at the byte after a false sync rather than wait for the bytes its length announces */
+    if (found == 0 && uart_frame_after(uart_rx_head, tail)) {
+      found = -1;
+    }
 
-    if (msg != NULL) {
-      int res = rx_data(msg, &(h_load_state.control));
-      if (res < 0) {
-        LOG_ERROR("RX data error\n");
+    if (found < 0) {
+      uart_rx_head = (uart_rx_head + 1U) % UART_RX_BUFFER_SIZE;
+      if (uart_rx_head == 0U) {
+        uart_handle_text(text, UART_RX_BUFFER_SIZE - text);
+        text = 0U;
       }
+      continue;
     }
-    uart_buffer_parsed = (uart_buffer_parsed + 1) % ((RX_MSG_SIZE * 2U) + 1);
+
+    uart_handle_text(text, uart_rx_head - text);
+    text = uart_rx_head;
+
+    if (found == 0) {
+      break;
+    }
+
+    uart_handle_frame(&frame);
+    uart_rx_head = (uart_rx_head + server_frame_size(&frame)) % UART_RX_BUFFER_SIZE;
+    text = uart_rx_head;
+  }
+
+  /* The stream keeps a command cut by the end of the data for the next event */
+  uart_handle_text(text, uart_rx_head - text);
+
+  /* A normal DMA stops on completion, circular ones keep running */
+  if (huart->RxState == HAL_UART_STATE_READY) {
+    uart_start_receive();
   }
 }
 
@@ -80,7 +608,56 @@ void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
     return;
   }
 
-  if (HAL_UARTEx_ReceiveToIdle_DMA(huart, uart_rx_buffer, RX_MSG_SIZE * 2) != HAL_OK)
+  /* Received bytes are lost, a text command cut by them must not run into the next one */
+  scpi_stream_reset(&uart_text_stream);
+  uart_start_receive();
+}
+
+/**
+ * @brief Settings in effect, for the text commands
+ *
+ * @param control Output settings
+ */
+static void uart_scpi_get_control(load_control_t *control)
+{
+  uart_get_control(control);
+}
+
+/**
+ * @brief Last measurement, for the text commands
+ *
+ * @param measurement Output measurement
+ */
+static void uart_scpi_get_measurement(load_measurement_t *measurement)
+{
+  memcpy(measurement, &(h_load_state.measurement), sizeof(load_measurement_t));
+}
+
+/**
+ * @brief Apply a setting from a text command, the RX interrupt is the other writer of the settings
+ *
+ * @param command Setting
+ * @return int 0 on success, -1 if the setting is invalid
+ */
+static int uart_scpi_set(const load_command_t *command)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const int result = uart_update_control(command);
+  __set_PRIMASK(primask);
+
+  return result;
+}
+
+/**
+ * @brief Start receiving at the start of the ring
+ *
+ */
+static void uart_start_receive(void)
+{
+  uart_rx_head = 0U;
+
+  if (HAL_UARTEx_ReceiveToIdle_DMA(uart, uart_rx_buffer, UART_RX_BUFFER_SIZE) != HAL_OK)
   {
     LOG_ERROR("UART receive error\n");
   }
@@ -0,0 +1,279 @@
+#include <string.h>
+#include "waveform.h"
+
+waveform_t h_waveform;
+
+/* Prototypes */
+static uint8_t waveform_table_locked(const waveform_t *waveform);
+static void waveform_take_request(waveform_t *waveform);
+static uint8_t waveform_next_point(waveform_t *waveform, waveform_point_t *point);
+static void waveform_start(waveform_t *waveform);
+static void waveform_apply(const waveform_point_t *point, control_t *control_handler);
+
+/**
+ * @brief Initialize the player
+ *
+ * @param waveform Player handler
+ */
+void waveform_init(waveform_t *waveform)
+{
+	memset(waveform, 0, sizeof(waveform_t));
+	waveform->state = WAVEFORM_IDLE;
+}
+
+/**
+ * @brief Handle a waveform command from the panel
+ *
+ * @param waveform Player handler
+ * @param command Command
+ * @return HAL_StatusTypeDef HAL_BUSY while playing, HAL_ERROR on an invalid command
+ */
+HAL_StatusTypeDef waveform_handle(waveform_t *waveform, const load_waveform_t *command)
+{
+	switch (command->command)
+	{
+	case WAVEFORM_LOAD:
+		if (waveform_table_locked(waveform))
+		{
+			return HAL_BUSY;
+		}
+		/* Offset and count come from the wire, their sum can wrap */
+		if (command->count > WAVEFORM_CHUNK_POINTS || command->offset > WAVEFORM_POINTS_SIZE ||
+			command->count > WAVEFORM_POINTS_SIZE - command->offset)
+		{
+			return HAL_ERROR;
+		}
+
+		memcpy(&waveform->points[command->offset], command->points, command->count * sizeof(waveform_point_t));
+		/* Chunks may come in any order, the table ends at the furthest point loaded */
+		if (command->offset + command->count > waveform->size)
+		{
+			waveform->size = command->offset + command->count;
+		}
+		return HAL_OK;
+
+	case WAVEFORM_LOAD_SAMPLES:
+		if (waveform_table_locked(waveform))
+		{
+			return HAL_BUSY;
+		}
+		if (command->count > WAVEFORM_CHUNK_POINTS * 2U || command->offset > WAVEFORM_POINTS_SIZE ||
+			command->count > WAVEFORM_POINTS_SIZE - command->offset)
+		{
+			return HAL_ERROR;
+		}
+
+		/* Samples are points sharing mode and duration */
+		for (uint32_t i = 0; i < command->count; ++i)
+		{
+			waveform_point_t *point = &waveform->points[command->offset + i];
+			point->value_milli = command->samples_milli[i];
+			point->duration_ms = (uint16_t)command->period_ms;
+			point->mode = (uint8_t)command->mode;
+			point->enable = 1U;
+		}
+		if (command->offset + command->count > waveform->size)
+		{
+			waveform->size = command->offset + command->count;
+		}
+		return HAL_OK;
+
+	case WAVEFORM_START:
+		if (command->count == 0U || command->count > waveform->size)
+		{
+			return HAL_ERROR;
+		}
+
+		/* Runs above the player tick, which takes the request whole */
+		waveform->request_length = command->count;
+		waveform->request_loops = command->loops;
+		waveform->request_trigger = (waveform_trigger_t)command->trigger;
+		waveform->request = WAVEFORM_REQUEST_START;
+		return HAL_OK;
+
+	case WAVEFORM_STOP:
+		waveform->request = WAVEFORM_REQUEST_STOP;
+		return HAL_OK;
+
+	default:
+		return HAL_ERROR;
+	}
+}
+
+/**
+ * @brief Step the player, called at WAVEFORM_TICK_HZ from the timer interrupt
+ *
+ * @param waveform Player handler
+ * @param control_handler Control the points are stepped into
+ * @param enable Panel enable
+ */
+void waveform_tick(waveform_t *waveform, control_t *control_handler, uint8_t enable)
+{
+	const uint8_t rising = enable && !waveform->last_enable;
+	const uint8_t falling = !enable && waveform->last_enable;
+	waveform->last_enable = enable;
+
+	waveform_take_request(waveform);
+
+	if (waveform->state == WAVEFORM_ARMED && rising)
+	{
+		waveform_start(waveform);
+	}
+
+	if (waveform->state != WAVEFORM_RUNNING)
+	{
+		return;
+	}
+
+	/* The panel can always turn the load off */
+	if (falling)
+	{
+		waveform->state = WAVEFORM_IDLE;
+		control_set_enable(control_handler, 0U);
+		return;
+	}
+
+	/* Hold the current point */
+	if (waveform->remaining > 0U && --waveform->remaining > 0U)
+	{
+		return;
+	}
+
+	if (waveform->index == waveform->length)
+	{
+		waveform->loop++;
+		if (waveform->loops != 0U && waveform->loop >= waveform->loops)
+		{
+			waveform->state = WAVEFORM_IDLE;
+			return;
+		}
+		waveform->index = 0U;
+	}
+
+	waveform_point_t point;
+	if (!waveform_next_point(waveform, &point))
+	{
+		return;
+	}
+	waveform_apply(&point, control_handler);
+
+	/* Durations are in milliseconds, a zero one still lasts a tick */
+	waveform->remaining = ((uint32_t)point.duration_ms * WAVEFORM_TICK_HZ) / 1000U;
+	if (waveform->remaining == 0U)
+	{
+		waveform->remaining = 1U;
+	}
+}
+
+/**
+ * @brief Check if the player owns the control setpoints
+ *
+ * @param waveform Player handler
+ * @return uint8_t 1 if running
+ */
+uint8_t waveform_is_running(const waveform_t *waveform)
+{
+	return waveform->state == WAVEFORM_RUNNING;
+}
+
+/**
+ * @brief Check if the table is in use by the player, or about to be
+ * 	A pending stop frees it, the player reads no point once a stop is requested.
+ *
+ * @param waveform Player handler
+ * @return uint8_t 1 if the table can't be changed
+ */
+static uint8_t waveform_table_locked(const waveform_t *waveform)
+{
+	if (waveform->request == WAVEFORM_REQUEST_STOP)
+	{
+		return 0U;
+	}
+
+	return waveform->state != WAVEFORM_IDLE || waveform->request == WAVEFORM_REQUEST_START;
+}
+
+/**
+ * @brief Take the last request of the panel
+ *
+ * @param waveform Player handler
+ */
+static void waveform_take_request(waveform_t *waveform)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	const waveform_request_t request = waveform->request;
+	const uint32_t length = waveform->request_length;
+	const uint32_t loops = waveform->request_loops;
+	const waveform_trigger_t trigger = waveform->request_trigger;
+	waveform->request = WAVEFORM_REQUEST_NONE;
+	__set_PRIMASK(primask);
+
+	if (request == WAVEFORM_REQUEST_STOP)
+	{
+		waveform->state = WAVEFORM_IDLE;
+	}
+	else if (request == WAVEFORM_REQUEST_START)
+	{
+		waveform->length = length;
+		waveform->loops = loops;
+		waveform->trigger = trigger;
+		if (trigger == WAVEFORM_TRIGGER_NOW)
+		{
+			waveform_start(waveform);
+		}
+		else
+		{
+			waveform->state = WAVEFORM_ARMED;
+		}
+	}
+}
+
+/**
+ * @brief Copy the next point out of the table, unless a stop came in during the tick
+ * 	The panel may reload the table as soon as it has requested a stop.
+ *
+ * @param waveform Player handler
+ * @param point Copy of the point
+ * @return uint8_t 0 if a stop is pending
+ */
+static uint8_t waveform_next_point(waveform_t *waveform, waveform_point_t *point)
+{
+	uint8_t taken = 0U;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (waveform->request != WAVEFORM_REQUEST_STOP)
+	{
+		*point = waveform->points[waveform->index++];
+		taken = 1U;
+	}
+	__set_PRIMASK(primask);
+
+	return taken;
+}
+
+/**
+ * @brief Start playing from the first point
+ *
+ * @param waveform Player handler
+ */
+static void waveform_start(waveform_t *waveform)
+{
+	waveform->index = 0U;
+	waveform->remaining = 0U;
+	waveform->loop = 0U;
+	waveform->state = WAVEFORM_RUNNING;
+}
+
+/**
+ * @brief Step a point into the control
+ *
+ * @param point Point
+ * @param control_handler Control handler
+ */
+static void waveform_apply(const waveform_point_t *point, control_t *control_handler)
+{
+	control_set_enable(control_handler, point->enable);
+	control_step_setpoint(control_handler, control_mode_from_server((load_mode_t)point->mode), CONTROL_VALUE_FROM_MILLI(point->value_milli));
+}
@@ -0,0 +1,319 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "main.h"
+#include "control.h"
+
+#include "sim.h"
+#include "plant.h"
+#include "mcp4725_model.h"
+
+#include "control_backend.h"
+
+/**
+ * @brief Constant power before and after the cascade on the constant current loop
+ *
+ * Usage: cp_bench [SECONDS]
+ *
+ * Closes each control law on the plant model at the nominal control period, with the ADC noise of the plant and
+ * no bus contention, and steps the power setpoint on sources in different bands of the gain schedule:
+ *   legacy    PID on V * I driving the DAC directly, integral sign flipped from the voltage derivative
+ *   cascade   control.c in fixed point, power over voltage into the constant current feed-forward plus a trim
+ * Reports the settling time and the power ripple of each step, then the time per update of both laws on the
+ * recorded readings, once with the voltage changing band of the gain schedule on every update.
+ */
+
+/** Default run time of each timing */
+#define BENCH_SECONDS 0.5
+
+/** Control periods before and after the setpoint step */
+#define BENCH_PERIODS (2U * CONTROL_FREQUENCY_HZ)
+
+/** Settled once the power stays within this fraction of the setpoint */
+#define BENCH_SETTLE_BAND 0.02f
+
+/** Periods at the end of the step the ripple is measured on */
+#define BENCH_RIPPLE_PERIODS (CONTROL_FREQUENCY_HZ / 2U)
+
+/** Updates between two clock reads */
+#define BENCH_BATCH 4096U
+
+/** Constant power PID of the firmware before the cascade */
+#define LEGACY_KI 0.665f
+#define LEGACY_KT 0.5f
+#define LEGACY_RATE_LIMIT 330.0f
+
+typedef struct
+{
+	const char *name;
+	void (*init)(void);
+	void (*setpoint)(float power);
+	float (*step)(int32_t voltage_uv, int32_t current_uv);
+} bench_law_t;
+
+typedef struct
+{
+	float source_voltage;
+	float power_from;
+	float power_to;
+} bench_case_t;
+
+typedef struct
+{
+	float output;
+	float applied;
+	float last_voltage;
+	float setpoint;
+} bench_legacy_t;
+
+typedef struct
+{
+	int32_t voltage_uv;
+	int32_t current_uv;
+} bench_reading_t;
+
+/** A source in each of the lower, middle and upper bands of the schedule */
+static const bench_case_t bench_cases[] = {
+	{ 4.0f, 1.0f, 3.0f },
+	{ 12.0f, 10.0f, 30.0f },
+	{ 24.0f, 20.0f, 60.0f },
+};
+
+#define BENCH_CASES_SIZE (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+static bench_legacy_t legacy;
+static bench_reading_t bench_trace[2U * BENCH_PERIODS];
+
+/**
+ * @brief Calibrated values of adc.c, the legacy law ran on them in float
+ *
+ */
+static float bench_voltage(int32_t voltage_uv)
+{
+	return (float)voltage_uv * 1e-6f * 31.65715446f + 0.20919486f;
+}
+
+static float bench_current(int32_t current_uv)
+{
+	return (float)current_uv * 1e-6f * 11.22826758f - 0.08353555f;
+}
+
+static void legacy_init(void)
+{
+	legacy.output = 0.0f;
+	legacy.applied = 0.0f;
+	legacy.last_voltage = 0.0f;
+	legacy.setpoint = 0.0f;
+}
+
+static void legacy_setpoint(float power)
+{
+	legacy.setpoint = power;
+}
+
+/**
+ * @brief The constant power branch of control_update() before the cascade, kp and kd were 0
+ *
+ */
+static float legacy_step(int32_t voltage_uv, int32_t current_uv)
+{
+	const float voltage = bench_voltage(voltage_uv);
+	const float error = legacy.setpoint - voltage * bench_current(current_uv);
+	const float voltage_derivative = voltage - legacy.last_voltage;
+	legacy.last_voltage = voltage;
+
+	/* Power falls with the output past the maximum power point, flip the integral action there */
+	const float ki_dt = LEGACY_KI / (float)CONTROL_FREQUENCY_HZ;
+	const float integral = (error > 0.0f && voltage_derivative <= 0.0f) ? -ki_dt * error : ki_dt * error;
+
+	legacy.output += LEGACY_KT * (legacy.applied - legacy.output);
+	legacy.output += integral;
+
+	const float rate_step = LEGACY_RATE_LIMIT / (float)CONTROL_FREQUENCY_HZ;
+	float applied = fminf(fmaxf(legacy.output, legacy.applied - rate_step), legacy.applied + rate_step);
+	applied = fminf(fmaxf(applied, 0.0f), 3.3f);
+	legacy.applied = applied;
+
+	return applied;
+}
+
+static void cascade_setpoint(float power)
+{
+	control_backend_fixed_setpoint(CONTROL_MODE_CP, power);
+}
+
+static const bench_law_t bench_laws[] = {
+	{ "legacy", legacy_init, legacy_setpoint, legacy_step },
+	{ "cascade", control_backend_fixed_init, cascade_setpoint, control_backend_fixed_step },
+};
+
+#define BENCH_LAWS_SIZE (sizeof(bench_laws) / sizeof(bench_laws[0]))
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief DAC voltage to the model, as the fast mode write of mcp4725.c
+ *
+ */
+static void bench_dac(float voltage)
+{
+	const float code = fminf(fmaxf(voltage / MCP4725_MODEL_VDD * 4096.0f, 0.0f), 4095.0f);
+	const uint16_t raw = (uint16_t)code;
+	const uint8_t data[2] = { (uint8_t)(raw >> 8), (uint8_t)raw };
+
+	mcp4725_model_write(data, sizeof(data));
+}
+
+/**
+ * @brief One step of the power setpoint, the readings are recorded for the timing
+ *
+ * @param settling Settling time after the step, in seconds, negative if it never settles
+ * @param ripple Peak to peak power at the end of the step, in watts
+ * @param error Mean power error at the end of the step, in watts
+ */
+static void bench_run(const bench_law_t *law, const bench_case_t *test, float *settling, float *ripple, float *error)
+{
+	plant_config_t config;
+	const uint64_t period_ns = 1000000000ULL / CONTROL_FREQUENCY_HZ;
+	uint64_t now_ns = 0U;
+	uint32_t last_out = 0U;
+	float power_min = INFINITY;
+	float power_max = -INFINITY;
+	float error_sum = 0.0f;
+
+	plant_default_config(&config);
+	config.source_voltage = test->source_voltage;
+	plant_init(&config);
+	mcp4725_model_init();
+	HAL_GPIO_WritePin(ENABLE_LOAD_GPIO_Port, ENABLE_LOAD_Pin, GPIO_PIN_SET);
+
+	law->init();
+	law->setpoint(test->power_from);
+
+	for (uint32_t period = 0; period < 2U * BENCH_PERIODS; period++)
+	{
+		if (period == BENCH_PERIODS)
+		{
+			law->setpoint(test->power_to);
+		}
+
+		now_ns += period_ns;
+		plant_update(now_ns);
+
+		const float power = plant_state()->voltage * plant_state()->current;
+		bench_reading_t *reading = &bench_trace[period];
+		reading->voltage_uv = (int32_t)lrintf(plant_adc_input(0) * 1e6f);
+		reading->current_uv = (int32_t)lrintf(plant_adc_input(1) * 1e6f);
+
+		bench_dac(law->step(reading->voltage_uv, reading->current_uv));
+
+		if (period < BENCH_PERIODS)
+		{
+			continue;
+		}
+
+		if (fabsf(power - test->power_to) > BENCH_SETTLE_BAND * test->power_to)
+		{
+			last_out = period - BENCH_PERIODS + 1U;
+		}
+		if (period >= 2U * BENCH_PERIODS - BENCH_RIPPLE_PERIODS)
+		{
+			power_min = fminf(power_min, power);
+			power_max = fmaxf(power_max, power);
+			error_sum += power - test->power_to;
+		}
+	}
+
+	HAL_GPIO_WritePin(ENABLE_LOAD_GPIO_Port, ENABLE_LOAD_Pin, GPIO_PIN_RESET);
+
+	*settling = last_out >= BENCH_PERIODS ? -1.0f : (float)last_out / (float)CONTROL_FREQUENCY_HZ;
+	*ripple = power_max - power_min;
+	*error = error_sum / (float)BENCH_RIPPLE_PERIODS;
+}
+
+/**
+ * @brief Time per update on readings, the output is not fed back
+ *
+ */
+static double bench_time(const bench_law_t *law, const bench_reading_t *readings, uint32_t size, double seconds)
+{
+	volatile float sink = 0.0f;
+	uint64_t processed = 0U;
+	const double start = bench_now();
+	double elapsed = 0.0;
+
+	law->init();
+	law->setpoint(bench_cases[0].power_to);
+
+	while (elapsed < seconds)
+	{
+		for (uint32_t i = 0U; i < BENCH_BATCH; i++)
+		{
+			const bench_reading_t *reading = &readings[(processed + i) % size];
+			sink = law->step(reading->voltage_uv, reading->current_uv);
+		}
+		processed += BENCH_BATCH;
+		elapsed = bench_now() - start;
+	}
+
+	(void)sink;
+	return elapsed * 1e9 / (double)processed;
+}
+
+int main(int argc, char **argv)
+{
+	const double seconds = (argc > 1) ? strtod(argv[1], NULL) : BENCH_SECONDS;
+
+	/* The virtual clock stays at 0, the plant runs on the time of the bench */
+	sim_init_virtual();
+
+	for (size_t c = 0; c < BENCH_CASES_SIZE; c++)
+	{
+		const bench_case_t *test = &bench_cases[c];
+
+		for (size_t l = 0; l < BENCH_LAWS_SIZE; l++)
+		{
+			float settling;
+			float ripple;
+			float error;
+			char settled[16];
+
+			bench_run(&bench_laws[l], test, &settling, &ripple, &error);
+
+			if (settling < 0.0f)
+			{
+				snprintf(settled, sizeof(settled), "never");
+			}
+			else
+			{
+				snprintf(settled, sizeof(settled), "%.0f ms", settling * 1e3f);
+			}
+			printf("%4.0f V, %4.1f -> %4.1f W, %-8s settles in %8s, ripple %.3f W, error %+.3f W\n",
+				   test->source_voltage, test->power_from, test->power_to, bench_laws[l].name, settled, ripple,
+				   error);
+		}
+	}
+
+	/* Readings of the last step, then readings alternating between the 2 V and 5 V bands */
+	static bench_reading_t crossing[2];
+	crossing[0].voltage_uv = (int32_t)((4.7f - 0.20919486f) / 31.65715446f * 1e6f);
+	crossing[1].voltage_uv = (int32_t)((5.3f - 0.20919486f) / 31.65715446f * 1e6f);
+	crossing[0].current_uv = (int32_t)((0.5f + 0.08353555f) / 11.22826758f * 1e6f);
+	crossing[1].current_uv = crossing[0].current_uv;
+
+	for (size_t l = 0; l < BENCH_LAWS_SIZE; l++)
+	{
+		printf("%-8s %.1f ns/update, %.1f ns/update changing band every update\n", bench_laws[l].name,
+			   bench_time(&bench_laws[l], bench_trace, 2U * BENCH_PERIODS, seconds),
+			   bench_time(&bench_laws[l], crossing, 2U, seconds));
+	}
+
+	return EXIT_SUCCESS;
+}
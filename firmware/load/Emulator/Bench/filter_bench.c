@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "filter.h"
+
+/**
+ * @brief Cost of the fixed point filter stages on the host
+ *
+ * Usage: filter_bench [SECONDS]
+ *
+ * Runs a noisy step, as the ADC delivers it in microvolts, through each stage type alone and through the cascade of
+ * the golden vector test, and reports the time per sample. On the host the figures only rank the stages against each
+ * other, on the firmware the median sort dominates as it does here.
+ */
+
+/** Default run time of each configuration */
+#define BENCH_SECONDS 0.5
+
+/** Samples processed between two clock reads */
+#define BENCH_BATCH 4096U
+
+/** Samples of the input, a power of two */
+#define BENCH_INPUT_SIZE 1024U
+
+typedef struct
+{
+	const char *name;
+	int (*setup)(filter_t *filter);
+} bench_config_t;
+
+static int32_t bench_input[BENCH_INPUT_SIZE];
+
+static int bench_boxcar16(filter_t *filter)
+{
+	return filter_add_boxcar(filter, 16);
+}
+
+static int bench_iir8(filter_t *filter)
+{
+	return filter_add_iir(filter, FILTER_Q15(1.0f / 8.0f));
+}
+
+static int bench_median3(filter_t *filter)
+{
+	return filter_add_median(filter, 3);
+}
+
+static int bench_median5(filter_t *filter)
+{
+	return filter_add_median(filter, 5);
+}
+
+static int bench_cascade(filter_t *filter)
+{
+	return filter_add_median(filter, 5) | filter_add_boxcar(filter, 8) | filter_add_iir(filter, FILTER_Q15(1.0f / 4.0f));
+}
+
+static const bench_config_t bench_configs[] = {
+	{ "boxcar16", bench_boxcar16 },
+	{ "iir8", bench_iir8 },
+	{ "median3", bench_median3 },
+	{ "median5", bench_median5 },
+	{ "cascade", bench_cascade },
+};
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	const double seconds = (argc > 1) ? strtod(argv[1], NULL) : BENCH_SECONDS;
+
+	/* Step between two inputs of the notebook captures, with a few tens of microvolts of noise */
+	srand(1);
+	for (uint32_t i = 0; i < BENCH_INPUT_SIZE; i++)
+	{
+		bench_input[i] = (i < BENCH_INPUT_SIZE / 2U ? 38690 : 507630) + (rand() % 64) - 32;
+	}
+
+	for (size_t c = 0; c < sizeof(bench_configs) / sizeof(bench_configs[0]); c++)
+	{
+		filter_t filter;
+		volatile int32_t sink = 0;
+
+		filter_init(&filter);
+		if (bench_configs[c].setup(&filter) != HAL_OK)
+		{
+			fprintf(stderr, "%s cannot be set up\n", bench_configs[c].name);
+			return EXIT_FAILURE;
+		}
+
+		uint64_t processed = 0U;
+		const double start = bench_now();
+		double elapsed = 0.0;
+
+		while (elapsed < seconds)
+		{
+			for (uint32_t i = 0U; i < BENCH_BATCH; i++)
+			{
+				sink = filter_process(&filter, bench_input[(processed + i) & (BENCH_INPUT_SIZE - 1U)]);
+			}
+			processed += BENCH_BATCH;
+			elapsed = bench_now() - start;
+		}
+
+		(void)sink;
+		printf("%-9s %llu samples in %.3f s: %.1f ns/sample\n", bench_configs[c].name,
+			   (unsigned long long)processed, elapsed, elapsed * 1e9 / (double)processed);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scpi.h"
+
+/**
+ * @brief Throughput of the text command parser on the host
+ *
+ * Usage: scpi_bench [SECONDS]
+ *
+ * Runs a mix of queries, sets and malformed lines through scpi_execute() against a target that only copies state,
+ * so the figure is the cost of the parser tree and the answer formatting. The same corpus runs in each build variant
+ * of the CMake file, the figures go to stderr as the traced one writes its traces to stdout, which is dropped.
+ */
+
+/** Default run time */
+#define BENCH_SECONDS 1.0
+
+/** Lines executed between two clock reads */
+#define BENCH_BATCH 4096U
+
+#ifndef SCPI_BENCH_VARIANT
+#define SCPI_BENCH_VARIANT "scpi_bench"
+#endif
+
+static load_control_t bench_control;
+static load_measurement_t bench_measurement = { 1500U, 12000U, 8000U, 18000U, 2500U };
+
+static const char *const bench_corpus[] = {
+  "0:0:0",
+  "0:1:0",
+  "0:2:0",
+  "0:3:1",
+  "0:3:4",
+  "0:4:0",
+  "1:1:0:1",
+  "1:2:2",
+  "1:3:1:1500",
+  "0x1:0x3:0x2:0x2EE0",
+  "1:3:4:25000",
+  "1:1:0:0",
+  "0:3:9",
+  "1:3:1",
+  "2:0:0",
+  "0:0:0:0",
+};
+
+static void bench_get_control(load_control_t *control)
+{
+  *control = bench_control;
+}
+
+static void bench_get_measurement(load_measurement_t *measurement)
+{
+  *measurement = bench_measurement;
+}
+
+static int bench_set(const load_command_t *command)
+{
+  set_point_t *set_points = &bench_control.cc;
+
+  switch (command->key) {
+    case COMMAND_ENABLE:
+      bench_control.enable = command->value;
+      return 0;
+    case COMMAND_MODE:
+      bench_control.mode = (load_mode_t)command->value;
+      return 0;
+    default:
+      set_points[command->key - COMMAND_CC].value_milli = command->value;
+      return 0;
+  }
+}
+
+static const scpi_target_t bench_target = {
+  .identification = "Simple Electronic Load,Bench",
+  .get_control = bench_get_control,
+  .get_measurement = bench_get_measurement,
+  .set = bench_set,
+};
+
+static double bench_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+  const double seconds = (argc > 1) ? strtod(argv[1], NULL) : BENCH_SECONDS;
+  const uint32_t corpus = sizeof(bench_corpus) / sizeof(bench_corpus[0]);
+  uint32_t lengths[sizeof(bench_corpus) / sizeof(bench_corpus[0])];
+  char response[SCPI_RESPONSE_MAX];
+
+#ifdef PARSER_TRACE
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    perror("freopen");
+    return EXIT_FAILURE;
+  }
+#endif
+
+  for (uint32_t i = 0U; i < corpus; i++) {
+    lengths[i] = (uint32_t)strlen(bench_corpus[i]);
+  }
+
+  uint64_t executed = 0U;
+  uint64_t answered = 0U;
+  uint64_t rejected = 0U;
+  const double start = bench_now();
+  double elapsed = 0.0;
+
+  while (elapsed < seconds) {
+    for (uint32_t i = 0U; i < BENCH_BATCH; i++) {
+      const uint32_t line = (uint32_t)(executed + i) % corpus;
+      const int length = scpi_execute(&bench_target, bench_corpus[line], lengths[line], response, sizeof(response));
+      answered += (length > 0) ? 1U : 0U;
+      rejected += (length < 0) ? 1U : 0U;
+    }
+    executed += BENCH_BATCH;
+    elapsed = bench_now() - start;
+  }
+
+  fprintf(stderr, "%-22s %llu commands in %.3f s: %.0f commands/s, %.1f ns/command (%llu answered, %llu rejected)\n",
+          SCPI_BENCH_VARIANT, (unsigned long long)executed, elapsed, (double)executed / elapsed,
+          elapsed * 1e9 / (double)executed, (unsigned long long)answered, (unsigned long long)rejected);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+#ifndef ADS1115_MODEL_H
+#define ADS1115_MODEL_H
+
+#include <stdint.h>
+
+/**
+ * @brief ADS1115 ADC on the I2C bus
+ * 	Conversions sample the plant when they end, after the time of the configured data rate. With the comparator in
+ * 	conversion ready mode (MSB of the high threshold set, of the low threshold clear) the end of a conversion
+ * 	pulls ALERT/RDY, which raises the EXTI interrupt.
+ *
+ */
+
+/**
+ * @brief Power on state, registers at their defaults
+ *
+ */
+void ads1115_model_init(void);
+
+/**
+ * @brief Register write, a config write with OS set starts a single shot conversion
+ *
+ * @param reg Register pointer
+ * @param value Value
+ * @return int 0 on success, -1 on an invalid register
+ */
+int ads1115_model_write(uint8_t reg, uint16_t value);
+
+/**
+ * @brief Register read
+ *
+ * @param reg Register pointer
+ * @param value Value
+ * @return int 0 on success, -1 on an invalid register
+ */
+int ads1115_model_read(uint8_t reg, uint16_t *value);
+
+/**
+ * @brief End of conversion, must be called when the deadline of SIM_IRQ_ADC_ALERT is reached
+ *
+ * @return int 1 if ALERT/RDY is pulled, 0 otherwise
+ */
+int ads1115_model_complete(void);
+
+#endif // ADS1115_MODEL_H
@@ -0,0 +1,74 @@
+#ifndef FIRMWARE_H
+#define FIRMWARE_H
+
+#include <stdint.h>
+
+#include "main.h"
+#include "control.h"
+
+/**
+ * @brief Firmware of the load on the simulated board
+ * 	Handles, interrupt priorities, start up and superloop as Core/Src/main.c wires them, shared by the emulator and
+ * 	the host tests. The models and the emulated time must be initialized first.
+ *
+ */
+
+/**
+ * @brief Time the superloop takes to go round on the virtual clock
+ *
+ */
+#define FIRMWARE_SUPERLOOP_NS 20000U
+
+/**
+ * @brief Time given to a text command to cross the UART and be executed
+ *
+ */
+#define FIRMWARE_COMMAND_NS 3000000U
+
+/**
+ * @brief Peripherals, configured as the MX_*_Init() functions of the firmware do
+ *
+ */
+extern ADC_HandleTypeDef hadc1;
+extern I2C_HandleTypeDef hi2c2;
+extern TIM_HandleTypeDef htim1;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim3;
+extern UART_HandleTypeDef huart1;
+
+/**
+ * @brief Configure the peripherals and run the start up of the firmware, the control loop is running on return
+ *
+ * @param address Address of the load on a bus, SERVER_ADDRESS_BROADCAST for a point to point link
+ */
+void firmware_init(uint8_t address);
+
+/**
+ * @brief One round of the superloop, without the wait
+ *
+ */
+void firmware_poll(void);
+
+/**
+ * @brief Run the superloop for a time on the virtual clock
+ *
+ * @param duration_ns Time
+ */
+void firmware_run_ns(uint64_t duration_ns);
+
+/**
+ * @brief Send a text command line to the UART as the host would, see Core/Inc/scpi.h
+ * 	The load holds one text command at a time, the firmware runs for FIRMWARE_COMMAND_NS so it is executed on return.
+ *
+ * @param line Command, with its line feed
+ */
+void firmware_send(const char *line);
+
+/**
+ * @brief Control loop, run from TIM3
+ *
+ * @return control_t* Control
+ */
+control_t *firmware_control(void);
+
+#endif // FIRMWARE_H
@@ -0,0 +1,43 @@
+#ifndef HAL_SIM_H
+#define HAL_SIM_H
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * @brief Host side of the simulated HAL
+ *
+ */
+
+/**
+ * @brief Connect a UART to a file descriptor, the master side of a pty
+ *
+ * @param huart UART
+ * @param fd Non blocking file descriptor
+ */
+void hal_sim_uart_attach(UART_HandleTypeDef *huart, int fd);
+
+/**
+ * @brief Put bytes on the wire of the attached UART as the host would, for the host tests
+ * 	Bytes that do not fit in the host FIFO are dropped.
+ *
+ * @param data Bytes
+ * @param size Number of bytes
+ */
+void hal_sim_uart_inject(const uint8_t *data, uint32_t size);
+
+/**
+ * @brief Wait for host bytes or the next interrupt deadline, then update the free running peripherals
+ * 	Stands for the time the superloop spins on the chip.
+ *
+ * @param max_wait_ns Upper bound of the wait
+ */
+void hal_sim_poll(uint64_t max_wait_ns);
+
+/**
+ * @brief Make the next I2C transfers fail as if no device acknowledged them, for the host tests
+ *
+ * @param transfers Transfers to fail
+ */
+void hal_sim_i2c_fail(uint32_t transfers);
+
+#endif // HAL_SIM_H
@@ -0,0 +1,47 @@
+#ifndef MCP4725_MODEL_H
+#define MCP4725_MODEL_H
+
+#include <stdint.h>
+
+/**
+ * @brief MCP4725 DAC on the I2C bus, fast and register write commands and the 5 byte read
+ *
+ */
+
+/**
+ * @brief Supply and reference of the DAC, in volts
+ *
+ */
+#define MCP4725_MODEL_VDD 3.3f
+
+/**
+ * @brief Power on state, code 0 and powered up
+ *
+ */
+void mcp4725_model_init(void);
+
+/**
+ * @brief Write transfer addressed to the DAC
+ *
+ * @param data Bytes
+ * @param size Number of bytes
+ * @return int 0 on success, -1 if the transfer is not a valid command
+ */
+int mcp4725_model_write(const uint8_t *data, uint16_t size);
+
+/**
+ * @brief Read transfer addressed to the DAC
+ *
+ * @param data Bytes
+ * @param size Number of bytes, up to 5
+ */
+void mcp4725_model_read(uint8_t *data, uint16_t size);
+
+/**
+ * @brief Output voltage
+ *
+ * @return float Volts, 0 while powered down
+ */
+float mcp4725_model_voltage(void);
+
+#endif // MCP4725_MODEL_H
@@ -0,0 +1,96 @@
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdint.h>
+
+/**
+ * @brief Electrical and thermal model of the load and the source under test
+ * 	A voltage source with a series resistance and a current limit feeds the power stage. The analog constant
+ * 	current loop follows the DAC with a first order response, the heatsink temperature follows the dissipated power.
+ *
+ */
+
+typedef struct
+{
+	/* Source open circuit voltage, in volts */
+	float source_voltage;
+	/* Source series resistance, in ohms */
+	float source_resistance;
+	/* Source current limit, in amperes */
+	float source_current_limit;
+	/* Power stage resistance fully on, in ohms */
+	float on_resistance;
+	/* Time constant of the analog current loop, in seconds */
+	float current_time_constant;
+	/* Ambient temperature, in degrees Celsius */
+	float ambient_temperature;
+	/* Heatsink thermal resistance, in kelvin per watt */
+	float thermal_resistance;
+	/* Heatsink thermal time constant, in seconds */
+	float thermal_time_constant;
+	/* RMS noise added to the ADC inputs, in volts */
+	float adc_noise;
+} plant_config_t;
+
+typedef struct
+{
+	/* Current drawn from the source, in amperes */
+	float current;
+	/* Voltage at the load terminals, in volts */
+	float voltage;
+	/* Heatsink temperature, in degrees Celsius */
+	float temperature;
+} plant_state_t;
+
+/**
+ * @brief Defaults, a 12 V bench supply on a load at 25 C
+ *
+ * @param config Configuration
+ */
+void plant_default_config(plant_config_t *config);
+
+/**
+ * @brief Initialize the model at rest
+ *
+ * @param config Configuration, copied
+ */
+void plant_init(const plant_config_t *config);
+
+/**
+ * @brief Advance the model to the emulated time
+ *
+ * @param now_ns Emulated time
+ */
+void plant_update(uint64_t now_ns);
+
+/**
+ * @brief Step the source open circuit voltage, the rest of the state carries on
+ *
+ * @param now_ns Emulated time, the model runs on the old voltage up to it
+ * @param voltage Volts
+ */
+void plant_set_source_voltage(uint64_t now_ns, float voltage);
+
+/**
+ * @brief State on the last update
+ *
+ * @return const plant_state_t* State
+ */
+const plant_state_t *plant_state(void);
+
+/**
+ * @brief Voltage on an ADS1115 input, single ended
+ *
+ * @param input Input, AIN0 to AIN3
+ * @return float Volts
+ */
+float plant_adc_input(uint8_t input);
+
+/**
+ * @brief Voltage of the temperature sensor on the internal ADC
+ *
+ * @return float Volts
+ */
+float plant_temperature_sensor(void);
+
+#endif // PLANT_H
@@ -0,0 +1,128 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+/**
+ * @brief Interrupt model of the emulator
+ * 	Every interrupt source has a pending deadline and a priority, as configured on the NVIC of the board.
+ * 	Due interrupts are served by priority from the superloop, and from busy waits (HAL_GetTick(), HAL_Delay() and
+ * 	blocking transfers) when they preempt the one running, so a handler spinning on a flag set by a higher priority
+ * 	one behaves as on the chip. Everything runs on a single thread.
+ *
+ */
+
+/**
+ * @brief Interrupt sources, ties between equal priorities go to the lower index as on the NVIC
+ *
+ */
+typedef enum {
+	SIM_IRQ_UART_RX,
+	SIM_IRQ_UART_TX,
+	SIM_IRQ_I2C,
+	SIM_IRQ_ADC_ALERT,
+	SIM_IRQ_TIM2,
+	SIM_IRQ_TIM3,
+	SIM_IRQ_COUNT,
+} sim_irq_t;
+
+/**
+ * @brief Priority of the superloop, below every interrupt
+ *
+ */
+#define SIM_THREAD_PRIORITY 256U
+
+/**
+ * @brief Never due
+ *
+ */
+#define SIM_NEVER UINT64_MAX
+
+typedef void (*sim_handler_t)(void);
+
+/**
+ * @brief Every read of the virtual clock takes this long, so code polling the time moves on
+ *
+ */
+#define SIM_VIRTUAL_READ_NS 50U
+
+/**
+ * @brief Start the emulated time
+ *
+ */
+void sim_init(void);
+
+/**
+ * @brief Start the emulated time on a virtual clock, for the host tests
+ * 	Time only moves on busy waits, which jump from deadline to deadline, and by SIM_VIRTUAL_READ_NS on every read.
+ * 	Runs are deterministic and take no wall clock time.
+ *
+ */
+void sim_init_virtual(void);
+
+/**
+ * @brief Nanoseconds since sim_init()
+ *
+ * @return uint64_t Time
+ */
+uint64_t sim_now_ns(void);
+
+/**
+ * @brief Set the priority and handler of an interrupt
+ *
+ * @param irq Interrupt
+ * @param priority NVIC preemption priority, lower is more urgent
+ * @param handler Handler
+ */
+void sim_irq_configure(sim_irq_t irq, uint8_t priority, sim_handler_t handler);
+
+/**
+ * @brief Make an interrupt pending at a time, replacing the previous deadline
+ *
+ * @param irq Interrupt
+ * @param due_ns Time it becomes pending
+ */
+void sim_irq_schedule(sim_irq_t irq, uint64_t due_ns);
+
+/**
+ * @brief Deadline of an interrupt
+ *
+ * @param irq Interrupt
+ * @return uint64_t Time it becomes pending, SIM_NEVER if not scheduled
+ */
+uint64_t sim_irq_due(sim_irq_t irq);
+
+/**
+ * @brief Drop the deadline of an interrupt
+ *
+ * @param irq Interrupt
+ */
+void sim_irq_cancel(sim_irq_t irq);
+
+/**
+ * @brief Earliest deadline of all interrupts
+ *
+ * @return uint64_t Time, SIM_NEVER if none is scheduled
+ */
+uint64_t sim_next_due_ns(void);
+
+/**
+ * @brief Serve the due interrupts that preempt the code running, nothing while interrupts are masked
+ *
+ */
+void sim_preempt(void);
+
+/**
+ * @brief Spin for a time serving the interrupts that preempt the code running
+ *
+ * @param duration_ns Time
+ */
+void sim_busy_wait_ns(uint64_t duration_ns);
+
+/**
+ * @brief PRIMASK, set while interrupts are masked
+ *
+ */
+extern volatile uint32_t sim_primask;
+
+#endif // SIM_H
@@ -0,0 +1,7 @@
+#ifndef __STM32F1xx_HAL_I2C_H
+#define __STM32F1xx_HAL_I2C_H
+
+/* The I2C part of the simulated HAL lives in stm32f1xx_hal.h */
+#include "stm32f1xx_hal.h"
+
+#endif /* __STM32F1xx_HAL_I2C_H */
@@ -0,0 +1,153 @@
+#include <math.h>
+
+#include "ads1115_model.h"
+#include "plant.h"
+#include "sim.h"
+
+#define REG_CONVERSION 0U
+#define REG_CONFIG 1U
+#define REG_THRESH_L 2U
+#define REG_THRESH_H 3U
+
+#define CONFIG_OS 0x8000U
+#define CONFIG_MODE_SINGLE_SHOT 0x0100U
+#define CONFIG_COMP_QUE_DISABLE 0x0003U
+
+/**
+ * @brief Wake up time before a single shot conversion starts
+ *
+ */
+#define ADS1115_WAKEUP_NS 25000U
+
+static const uint32_t data_rates[8] = { 8U, 16U, 32U, 64U, 128U, 250U, 475U, 860U };
+static const float full_scales[8] = { 6.144f, 4.096f, 2.048f, 1.024f, 0.512f, 0.256f, 0.256f, 0.256f };
+
+static uint16_t registers[4];
+static uint8_t converting;
+
+/* Prototypes */
+static float ads1115_model_input(uint8_t mux);
+
+/**
+ * @brief Power on state, registers at their defaults
+ *
+ */
+void ads1115_model_init(void)
+{
+	registers[REG_CONVERSION] = 0x0000U;
+	registers[REG_CONFIG] = 0x8583U;
+	registers[REG_THRESH_L] = 0x8000U;
+	registers[REG_THRESH_H] = 0x7FFFU;
+	converting = 0U;
+}
+
+/**
+ * @brief Register write, a config write with OS set starts a single shot conversion
+ *
+ * @param reg Register pointer
+ * @param value Value
+ * @return int 0 on success, -1 on an invalid register
+ */
+int ads1115_model_write(uint8_t reg, uint16_t value)
+{
+	if (reg == REG_CONVERSION || reg > REG_THRESH_H)
+	{
+		return -1;
+	}
+
+	registers[reg] = value;
+
+	if (reg != REG_CONFIG)
+	{
+		return 0;
+	}
+
+	/* Single shot starts on OS, continuous restarts on every config write */
+	const uint8_t single_shot = (value & CONFIG_MODE_SINGLE_SHOT) != 0U;
+	if ((single_shot && (value & CONFIG_OS) != 0U && !converting) || !single_shot)
+	{
+		const uint32_t rate = data_rates[(value >> 5) & 0x07U];
+		converting = 1U;
+		sim_irq_schedule(SIM_IRQ_ADC_ALERT, sim_now_ns() + (single_shot ? ADS1115_WAKEUP_NS : 0U) + 1000000000ULL / rate);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Register read
+ *
+ * @param reg Register pointer
+ * @param value Value
+ * @return int 0 on success, -1 on an invalid register
+ */
+int ads1115_model_read(uint8_t reg, uint16_t *value)
+{
+	if (reg > REG_THRESH_H)
+	{
+		return -1;
+	}
+
+	*value = registers[reg];
+
+	/* OS reads 0 while a conversion is running */
+	if (reg == REG_CONFIG)
+	{
+		*value = (uint16_t)((*value & ~CONFIG_OS) | (converting ? 0U : CONFIG_OS));
+	}
+
+	return 0;
+}
+
+/**
+ * @brief End of conversion, must be called when the deadline of SIM_IRQ_ADC_ALERT is reached
+ *
+ * @return int 1 if ALERT/RDY is pulled, 0 otherwise
+ */
+int ads1115_model_complete(void)
+{
+	const uint16_t config = registers[REG_CONFIG];
+
+	plant_update(sim_now_ns());
+
+	const float full_scale = full_scales[(config >> 9) & 0x07U];
+	float code = roundf(ads1115_model_input((uint8_t)((config >> 12) & 0x07U)) / full_scale * 32768.0f);
+	code = fminf(fmaxf(code, -32768.0f), 32767.0f);
+	registers[REG_CONVERSION] = (uint16_t)(int16_t)code;
+
+	converting = 0U;
+
+	/* Continuous mode goes on with the next conversion */
+	if ((config & CONFIG_MODE_SINGLE_SHOT) == 0U)
+	{
+		converting = 1U;
+		sim_irq_schedule(SIM_IRQ_ADC_ALERT, sim_now_ns() + 1000000000ULL / data_rates[(config >> 5) & 0x07U]);
+	}
+
+	/* Conversion ready mode of the comparator */
+	return (registers[REG_THRESH_H] & 0x8000U) != 0U && (registers[REG_THRESH_L] & 0x8000U) == 0U &&
+		   (config & CONFIG_COMP_QUE_DISABLE) != CONFIG_COMP_QUE_DISABLE;
+}
+
+/**
+ * @brief Differential voltage selected by the multiplexer
+ *
+ * @param mux MUX field of the config register
+ * @return float Volts
+ */
+static float ads1115_model_input(uint8_t mux)
+{
+	switch (mux)
+	{
+	case 0:
+		return plant_adc_input(0) - plant_adc_input(1);
+	case 1:
+		return plant_adc_input(0) - plant_adc_input(3);
+	case 2:
+		return plant_adc_input(1) - plant_adc_input(3);
+	case 3:
+		return plant_adc_input(2) - plant_adc_input(3);
+	default:
+		return plant_adc_input((uint8_t)(mux - 4U));
+	}
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "firmware.h"
+#include "mcp4725.h"
+#include "adc.h"
+#include "uart.h"
+#include "fan.h"
+#include "waveform.h"
+#include "telemetry.h"
+
+#include "sim.h"
+#include "hal_sim.h"
+#include "ads1115_model.h"
+
+/**
+ * @brief Peripherals, configured as the MX_*_Init() functions of the firmware do
+ *
+ */
+ADC_HandleTypeDef hadc1;
+I2C_HandleTypeDef hi2c2;
+TIM_HandleTypeDef htim1;
+TIM_HandleTypeDef htim2;
+TIM_HandleTypeDef htim3;
+UART_HandleTypeDef huart1;
+DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart1_tx;
+
+static TIM_TypeDef tim1;
+static TIM_TypeDef tim2;
+static TIM_TypeDef tim3;
+static DMA_Channel_TypeDef dma1_channel4;
+static DMA_Channel_TypeDef dma1_channel5;
+
+// MCP4725 device descriptor
+static mcp4725_t dac;
+// Control loop, run from TIM3
+static control_t control;
+
+/* Prototypes */
+static void firmware_peripherals_init(void);
+
+/* Interrupt handlers, as in stm32f1xx_it.c */
+
+static void USART1_IRQHandler(void)
+{
+	HAL_UART_IRQHandler(&huart1);
+}
+
+static void DMA1_Channel4_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+static void I2C2_EV_IRQHandler(void)
+{
+	HAL_I2C_EV_IRQHandler(&hi2c2);
+}
+
+static void EXTI1_IRQHandler(void)
+{
+	/* ALERT/RDY falls at the end of the conversion */
+	if (ads1115_model_complete())
+	{
+		HAL_GPIO_EXTI_IRQHandler(ADC_ALERT_Pin);
+	}
+}
+
+static void TIM2_IRQHandler(void)
+{
+	HAL_TIM_IRQHandler(&htim2);
+}
+
+static void TIM3_IRQHandler(void)
+{
+	HAL_TIM_IRQHandler(&htim3);
+}
+
+/* Application callbacks, as in main.c */
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	if (GPIO_Pin == ADC_ALERT_Pin)
+	{
+		adc_conversion_ready_callback();
+	}
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	/* Both run at the same priority, so they never preempt each other */
+	load_control_t server_control;
+
+	if (htim == &htim3)
+	{
+		/* The waveform player owns the setpoints while it runs */
+		const uint8_t overridden = waveform_is_running(&h_waveform);
+		uart_get_control(&server_control);
+		if (!overridden)
+		{
+			control_set_from_server(&control, &server_control);
+		}
+		control_update(&control);
+		telemetry_tick(&h_telemetry, &control);
+		/* Commands are acknowledged once the loop runs with them */
+		uart_acknowledge_commands(&control, &server_control, overridden);
+	}
+	else if (htim == &htim2)
+	{
+		uart_get_control(&server_control);
+		waveform_tick(&h_waveform, &control, (uint8_t)server_control.enable);
+	}
+}
+
+void Error_Handler(void)
+{
+	fprintf(stderr, "Error_Handler\n");
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Configure the peripherals and run the start up of the firmware, the control loop is running on return
+ *
+ * @param address Address of the load on a bus, SERVER_ADDRESS_BROADCAST for a point to point link
+ */
+void firmware_init(uint8_t address)
+{
+	firmware_peripherals_init();
+
+	/* Firmware start up, as in main.c */
+	if (mcp4725_init(&dac, &hi2c2, MCP4725_I2C_ADDR) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	adc_init(&hi2c2, &hadc1);
+	uart_set_address(address);
+	uart_init(&huart1);
+	fan_init(&htim1);
+	control_init(&control, &dac);
+
+	waveform_init(&h_waveform);
+	telemetry_init(&h_telemetry);
+
+	if (control_start(&control, &htim3, CONTROL_FREQUENCY_HZ) != HAL_OK)
+	{
+		Error_Handler();
+	}
+
+	/* Waveform player ticks at WAVEFORM_TICK_HZ */
+	HAL_TIM_Base_Start_IT(&htim2);
+
+	HAL_GPIO_WritePin(ENABLE_LOAD_GPIO_Port, ENABLE_LOAD_Pin, GPIO_PIN_RESET);
+
+	/* No host until the emulator connects its pty, the tests inject their bytes */
+	hal_sim_uart_attach(&huart1, -1);
+}
+
+/**
+ * @brief One round of the superloop, without the wait
+ *
+ */
+void firmware_poll(void)
+{
+	/* ADC is acquired from the ALERT and I2C interrupts */
+	adc_watchdog();
+
+	/* Control loop runs from TIM3, the superloop only handles telemetry */
+	if (adc_all_channels_measured())
+	{
+		adc_update_measurement();
+	}
+
+	/* Telemetry batches leave as soon as the link is free */
+	uart_transmit();
+
+	static uint32_t next_fan_update = 0;
+	if (HAL_GetTick() >= next_fan_update)
+	{
+		next_fan_update = HAL_GetTick() + 200;
+		fan_update();
+	}
+}
+
+/**
+ * @brief Run the superloop for a time on the virtual clock
+ *
+ * @param duration_ns Time
+ */
+void firmware_run_ns(uint64_t duration_ns)
+{
+	const uint64_t end = sim_now_ns() + duration_ns;
+
+	while (sim_now_ns() < end)
+	{
+		sim_busy_wait_ns(FIRMWARE_SUPERLOOP_NS);
+		firmware_poll();
+	}
+}
+
+/**
+ * @brief Send a text command line to the UART as the host would, then let the firmware execute it
+ *
+ * @param line Command, with its line feed
+ */
+void firmware_send(const char *line)
+{
+	hal_sim_uart_inject((const uint8_t *)line, (uint32_t)strlen(line));
+	firmware_run_ns(FIRMWARE_COMMAND_NS);
+}
+
+/**
+ * @brief Control loop, run from TIM3
+ *
+ * @return control_t* Control
+ */
+control_t *firmware_control(void)
+{
+	return &control;
+}
+
+/**
+ * @brief Handles as left by the MX_*_Init() functions and the NVIC priorities of the board
+ *
+ */
+static void firmware_peripherals_init(void)
+{
+	hi2c2.Init.ClockSpeed = 400000;
+
+	htim1.Instance = &tim1;
+	htim1.Init.Prescaler = 0;
+	htim1.Init.Period = 65535;
+	htim1.sim_irq = -1;
+
+	htim2.Instance = &tim2;
+	htim2.Init.Prescaler = 71;
+	htim2.Init.Period = 999;
+	htim2.sim_irq = SIM_IRQ_TIM2;
+
+	htim3.Instance = &tim3;
+	htim3.Init.Prescaler = 71;
+	htim3.Init.Period = 4999;
+	htim3.sim_irq = SIM_IRQ_TIM3;
+
+	TIM_HandleTypeDef *timers[] = { &htim1, &htim2, &htim3 };
+	for (uint32_t i = 0; i < sizeof(timers) / sizeof(timers[0]); i++)
+	{
+		timers[i]->Instance->PSC = timers[i]->Init.Prescaler;
+		timers[i]->Instance->ARR = timers[i]->Init.Period;
+	}
+
+	hdma_usart1_rx.Instance = &dma1_channel5;
+	hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+	hdma_usart1_tx.Instance = &dma1_channel4;
+	hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+
+	huart1.Init.BaudRate = 1000000;
+	huart1.gState = HAL_UART_STATE_READY;
+	huart1.RxState = HAL_UART_STATE_READY;
+	__HAL_LINKDMA(&huart1, hdmarx, hdma_usart1_rx);
+	__HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
+
+	sim_irq_configure(SIM_IRQ_UART_RX, 0, USART1_IRQHandler);
+	sim_irq_configure(SIM_IRQ_UART_TX, 0, DMA1_Channel4_IRQHandler);
+	sim_irq_configure(SIM_IRQ_I2C, 5, I2C2_EV_IRQHandler);
+	sim_irq_configure(SIM_IRQ_ADC_ALERT, 6, EXTI1_IRQHandler);
+	sim_irq_configure(SIM_IRQ_TIM2, 7, TIM2_IRQHandler);
+	sim_irq_configure(SIM_IRQ_TIM3, 7, TIM3_IRQHandler);
+}
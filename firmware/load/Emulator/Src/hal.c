@@ -0,0 +1,884 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hal_sim.h"
+#include "sim.h"
+#include "plant.h"
+#include "ads1115_model.h"
+#include "mcp4725_model.h"
+
+/**
+ * @brief Addresses of the devices on the I2C bus, shifted as the HAL takes them
+ *
+ */
+#define I2C_ADDR_ADS1115 (0x48U << 1)
+#define I2C_ADDR_MCP4725 (0x60U << 1)
+
+/**
+ * @brief Longest transfer on the I2C bus
+ *
+ */
+#define I2C_TRANSFER_MAX 32U
+
+/**
+ * @brief Bit times per byte on the wire, with the ACK on I2C, start and stop bits on the UART
+ *
+ */
+#define I2C_BITS_PER_BYTE 9U
+#define UART_BITS_PER_BYTE 10U
+
+/**
+ * @brief Host bytes waiting for the RX DMA
+ *
+ */
+#define UART_HOST_FIFO_SIZE 4096U
+
+/**
+ * @brief Full scale of the internal ADC, as converted by adc.c
+ *
+ */
+#define ADC_INTERNAL_FULL_SCALE 3.778742f
+#define ADC_INTERNAL_MAX_VALUE 4095.0f
+
+typedef struct
+{
+	UART_HandleTypeDef *huart;
+	int fd;
+	uint8_t fifo[UART_HOST_FIFO_SIZE];
+	uint32_t fifo_head;
+	uint32_t fifo_count;
+	/* Bytes written by the RX DMA since the last event */
+	uint32_t rx_since_event;
+} hal_sim_uart_t;
+
+typedef struct
+{
+	I2C_HandleTypeDef *hi2c;
+	uint16_t address;
+	uint16_t reg;
+	uint8_t *data;
+	uint16_t size;
+	uint8_t read;
+} hal_sim_i2c_transfer_t;
+
+uint32_t SystemCoreClock = 72000000U;
+CoreDebug_Type sim_core_debug;
+RCC_TypeDef sim_rcc = { RCC_CFGR_PPRE1_DIV2 };
+GPIO_TypeDef sim_gpio[3];
+
+static DWT_Type dwt;
+
+/** Next update event of the running timers, by interrupt */
+static uint64_t timer_due[SIM_IRQ_COUNT];
+
+static hal_sim_uart_t uart = { .fd = -1 };
+
+/** Non blocking I2C transfer in flight */
+static hal_sim_i2c_transfer_t i2c_transfer;
+/** ADS1115 register pointer, kept between transfers */
+static uint8_t ads1115_pointer;
+/** Transfers left to fail, see hal_sim_i2c_fail() */
+static uint32_t i2c_failures;
+
+/** Internal ADC DMA buffer, circular */
+static volatile uint16_t *adc_dma_buffer;
+static uint32_t adc_dma_length;
+
+/* Prototypes */
+static uint64_t hal_sim_timer_period_ns(const TIM_HandleTypeDef *htim);
+static uint64_t hal_sim_uart_time_ns(const UART_HandleTypeDef *huart, uint32_t bytes);
+static void hal_sim_uart_write(const uint8_t *data, uint16_t size);
+static void hal_sim_uart_read(void);
+static uint64_t hal_sim_i2c_time_ns(const I2C_HandleTypeDef *hi2c, uint32_t bytes);
+static HAL_StatusTypeDef hal_sim_i2c_write(uint16_t address, const uint8_t *data, uint16_t size);
+static HAL_StatusTypeDef hal_sim_i2c_read(uint16_t address, uint8_t *data, uint16_t size);
+static HAL_StatusTypeDef hal_sim_i2c_mem_write(uint16_t address, uint16_t reg, const uint8_t *data, uint16_t size);
+static HAL_StatusTypeDef hal_sim_i2c_mem_read(uint16_t address, uint16_t reg, uint8_t *data, uint16_t size);
+static void hal_sim_adc_refresh(void);
+
+/* Core */
+
+uint32_t __get_PRIMASK(void)
+{
+	return sim_primask;
+}
+
+/**
+ * @brief Interrupts pending while masked are taken as soon as they are unmasked
+ *
+ */
+void __set_PRIMASK(uint32_t primask)
+{
+	sim_primask = primask;
+
+	if (!primask)
+	{
+		sim_preempt();
+	}
+}
+
+void __disable_irq(void)
+{
+	sim_primask = 1U;
+}
+
+void __enable_irq(void)
+{
+	__set_PRIMASK(0U);
+}
+
+DWT_Type *sim_dwt(void)
+{
+	dwt.CYCCNT = (uint32_t)(sim_now_ns() * (SystemCoreClock / 1000000U) / 1000U);
+
+	return &dwt;
+}
+
+/**
+ * @brief Milliseconds of the emulated time, a busy loop on it is served interrupts
+ *
+ */
+uint32_t HAL_GetTick(void)
+{
+	sim_preempt();
+
+	return (uint32_t)(sim_now_ns() / 1000000U);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	sim_busy_wait_ns((uint64_t)Delay * 1000000U);
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	if ((sim_rcc.CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1)
+	{
+		return SystemCoreClock;
+	}
+
+	return SystemCoreClock / 2U;
+}
+
+/* GPIO */
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	/* The plant runs on the old state up to now */
+	plant_update(sim_now_ns());
+
+	if (PinState == GPIO_PIN_SET)
+	{
+		GPIOx->ODR |= GPIO_Pin;
+	}
+	else
+	{
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	}
+
+	GPIOx->IDR = GPIOx->ODR;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	HAL_GPIO_WritePin(GPIOx, GPIO_Pin, HAL_GPIO_ReadPin(GPIOx, GPIO_Pin) == GPIO_PIN_SET ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin)
+{
+	HAL_GPIO_EXTI_Callback(GPIO_Pin);
+}
+
+__attribute__((weak)) void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	(void)GPIO_Pin;
+}
+
+/* TIM */
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+	if (htim->sim_irq < 0)
+	{
+		return HAL_OK;
+	}
+
+	timer_due[htim->sim_irq] = sim_now_ns() + hal_sim_timer_period_ns(htim);
+	sim_irq_schedule((sim_irq_t)htim->sim_irq, timer_due[htim->sim_irq]);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim)
+{
+	if (htim->sim_irq < 0)
+	{
+		return HAL_OK;
+	}
+
+	timer_due[htim->sim_irq] = SIM_NEVER;
+	sim_irq_cancel((sim_irq_t)htim->sim_irq);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	(void)htim;
+	(void)Channel;
+
+	return HAL_OK;
+}
+
+/**
+ * @brief The update event reloads the prescaler and restarts the period
+ *
+ */
+HAL_StatusTypeDef HAL_TIM_GenerateEvent(TIM_HandleTypeDef *htim, uint32_t EventSource)
+{
+	if (EventSource & TIM_EVENTSOURCE_UPDATE)
+	{
+		htim->Instance->CNT = 0U;
+		htim->Instance->SR |= TIM_FLAG_UPDATE;
+
+		if (htim->sim_irq >= 0 && timer_due[htim->sim_irq] != SIM_NEVER)
+		{
+			HAL_TIM_Base_Start_IT(htim);
+		}
+	}
+
+	return HAL_OK;
+}
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim)
+{
+	if (htim->sim_irq < 0 || timer_due[htim->sim_irq] == SIM_NEVER)
+	{
+		return;
+	}
+
+	/* Update events missed while the interrupt was held off are lost, the flag holds one */
+	const uint64_t period = hal_sim_timer_period_ns(htim);
+	const uint64_t now = sim_now_ns();
+	uint64_t due = timer_due[htim->sim_irq];
+	do
+	{
+		due += period;
+	} while (due <= now);
+
+	timer_due[htim->sim_irq] = due;
+	sim_irq_schedule((sim_irq_t)htim->sim_irq, due);
+
+	htim->Instance->SR &= ~TIM_FLAG_UPDATE;
+	HAL_TIM_PeriodElapsedCallback(htim);
+}
+
+__attribute__((weak)) void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	(void)htim;
+}
+
+/**
+ * @brief Period of the update event, timers on APB1 run at twice its clock when it is divided
+ *
+ */
+static uint64_t hal_sim_timer_period_ns(const TIM_HandleTypeDef *htim)
+{
+	const uint64_t ticks = (uint64_t)(htim->Instance->PSC + 1U) * (htim->Instance->ARR + 1U);
+	uint64_t clock = HAL_RCC_GetPCLK1Freq();
+
+	if ((sim_rcc.CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+	{
+		clock *= 2U;
+	}
+
+	return ticks * 1000000000ULL / clock;
+}
+
+/* DMA */
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+	UART_HandleTypeDef *huart = (UART_HandleTypeDef *)hdma->Parent;
+
+	/* Only the UART TX channel raises transfer complete, RX events come from the UART interrupt */
+	if (huart == NULL || hdma != huart->hdmatx || huart->gState != HAL_UART_STATE_BUSY_TX)
+	{
+		return;
+	}
+
+	huart->gState = HAL_UART_STATE_READY;
+	HAL_UART_TxCpltCallback(huart);
+}
+
+/* UART */
+
+void hal_sim_uart_attach(UART_HandleTypeDef *huart, int fd)
+{
+	uart.huart = huart;
+	uart.fd = fd;
+	uart.fifo_head = 0U;
+	uart.fifo_count = 0U;
+	uart.rx_since_event = 0U;
+}
+
+void hal_sim_uart_inject(const uint8_t *data, uint32_t size)
+{
+	uint32_t received = 0U;
+
+	while (received < size && uart.fifo_count < UART_HOST_FIFO_SIZE)
+	{
+		uart.fifo[(uart.fifo_head + uart.fifo_count) % UART_HOST_FIFO_SIZE] = data[received++];
+		uart.fifo_count++;
+	}
+
+	/* Same timing as the bytes read from the pty */
+	if (received > 0U && uart.huart != NULL && sim_irq_due(SIM_IRQ_UART_RX) == SIM_NEVER)
+	{
+		sim_irq_schedule(SIM_IRQ_UART_RX, sim_now_ns() + hal_sim_uart_time_ns(uart.huart, received + 1U));
+	}
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+
+	if (huart->gState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	hal_sim_uart_write(pData, Size);
+	sim_busy_wait_ns(hal_sim_uart_time_ns(huart, Size));
+	huart->gState = HAL_UART_STATE_READY;
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Bytes leave at once, transfer complete is raised when the last one is on the wire
+ *
+ */
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+	if (huart->gState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	hal_sim_uart_write(pData, Size);
+	sim_irq_schedule(SIM_IRQ_UART_TX, sim_now_ns() + hal_sim_uart_time_ns(huart, Size));
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if (huart->RxState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	huart->pRxBuffPtr = pData;
+	huart->RxXferSize = Size;
+	huart->hdmarx->Instance->CNDTR = Size;
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+	uart.rx_since_event = 0U;
+
+	if (uart.fifo_count > 0U)
+	{
+		sim_irq_schedule(SIM_IRQ_UART_RX, sim_now_ns());
+	}
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Move the host bytes into the RX DMA buffer, with the half, full and idle events on the way
+ *
+ */
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
+{
+	if (huart != uart.huart)
+	{
+		return;
+	}
+
+	DMA_Channel_TypeDef *dma = huart->hdmarx->Instance;
+	const uint16_t half = huart->RxXferSize / 2U;
+
+	while (uart.fifo_count > 0U && huart->RxState == HAL_UART_STATE_BUSY_RX)
+	{
+		const uint16_t position = (uint16_t)(huart->RxXferSize - dma->CNDTR);
+
+		huart->pRxBuffPtr[position] = uart.fifo[uart.fifo_head];
+		uart.fifo_head = (uart.fifo_head + 1U) % UART_HOST_FIFO_SIZE;
+		uart.fifo_count--;
+		uart.rx_since_event++;
+		dma->CNDTR--;
+
+		if (position + 1U == half)
+		{
+			uart.rx_since_event = 0U;
+			HAL_UARTEx_RxEventCallback(huart, half);
+		}
+		else if (position + 1U == huart->RxXferSize)
+		{
+			/* A circular DMA reloads its counter, a normal one stops */
+			dma->CNDTR = huart->RxXferSize;
+			if (huart->hdmarx->Init.Mode != DMA_CIRCULAR)
+			{
+				huart->RxState = HAL_UART_STATE_READY;
+			}
+
+			uart.rx_since_event = 0U;
+			HAL_UARTEx_RxEventCallback(huart, huart->RxXferSize);
+		}
+	}
+
+	/* The line went idle after the last byte */
+	if (uart.rx_since_event > 0U && huart->RxState == HAL_UART_STATE_BUSY_RX)
+	{
+		uart.rx_since_event = 0U;
+		HAL_UARTEx_RxEventCallback(huart, (uint16_t)(huart->RxXferSize - dma->CNDTR));
+	}
+}
+
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	(void)huart;
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	(void)huart;
+}
+
+__attribute__((weak)) void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	(void)huart;
+	(void)Size;
+}
+
+/**
+ * @brief Time on the wire
+ *
+ */
+static uint64_t hal_sim_uart_time_ns(const UART_HandleTypeDef *huart, uint32_t bytes)
+{
+	return (uint64_t)bytes * UART_BITS_PER_BYTE * 1000000000ULL / huart->Init.BaudRate;
+}
+
+/**
+ * @brief Hand bytes to the host, dropped if it does not keep up as on a real line
+ *
+ */
+static void hal_sim_uart_write(const uint8_t *data, uint16_t size)
+{
+	while (uart.fd >= 0 && size > 0U)
+	{
+		const ssize_t written = write(uart.fd, data, size);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			return;
+		}
+
+		data += written;
+		size = (uint16_t)(size - written);
+	}
+}
+
+/**
+ * @brief Read what the host sent, it arrives on the RX pin at the baud rate
+ *
+ */
+static void hal_sim_uart_read(void)
+{
+	uint32_t received = 0U;
+
+	while (uart.fifo_count < UART_HOST_FIFO_SIZE)
+	{
+		const uint32_t tail = (uart.fifo_head + uart.fifo_count) % UART_HOST_FIFO_SIZE;
+		uint32_t room = UART_HOST_FIFO_SIZE - uart.fifo_count;
+		if (room > UART_HOST_FIFO_SIZE - tail)
+		{
+			room = UART_HOST_FIFO_SIZE - tail;
+		}
+
+		const ssize_t size = read(uart.fd, &uart.fifo[tail], room);
+		if (size < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (size <= 0)
+		{
+			break;
+		}
+
+		uart.fifo_count += (uint32_t)size;
+		received += (uint32_t)size;
+	}
+
+	/* The DMA sees the bytes once on the wire, idle is detected one byte time later */
+	if (received > 0U && sim_irq_due(SIM_IRQ_UART_RX) == SIM_NEVER)
+	{
+		sim_irq_schedule(SIM_IRQ_UART_RX, sim_now_ns() + hal_sim_uart_time_ns(uart.huart, received + 1U));
+	}
+}
+
+/* I2C */
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout)
+{
+	(void)Trials;
+	(void)Timeout;
+
+	if (hi2c->busy)
+	{
+		return HAL_BUSY;
+	}
+
+	sim_busy_wait_ns(hal_sim_i2c_time_ns(hi2c, 0U));
+
+	return (DevAddress == I2C_ADDR_ADS1115 || DevAddress == I2C_ADDR_MCP4725) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+
+	if (hi2c->busy)
+	{
+		return HAL_BUSY;
+	}
+
+	sim_busy_wait_ns(hal_sim_i2c_time_ns(hi2c, Size));
+
+	return hal_sim_i2c_write(DevAddress, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+
+	if (hi2c->busy)
+	{
+		return HAL_BUSY;
+	}
+
+	sim_busy_wait_ns(hal_sim_i2c_time_ns(hi2c, Size));
+
+	return hal_sim_i2c_read(DevAddress, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)MemAddSize;
+	(void)Timeout;
+
+	if (hi2c->busy)
+	{
+		return HAL_BUSY;
+	}
+
+	sim_busy_wait_ns(hal_sim_i2c_time_ns(hi2c, 1U + Size));
+
+	return hal_sim_i2c_mem_write(DevAddress, MemAddress, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)MemAddSize;
+	(void)Timeout;
+
+	if (hi2c->busy)
+	{
+		return HAL_BUSY;
+	}
+
+	/* Register pointer, then the repeated start with the address again */
+	sim_busy_wait_ns(hal_sim_i2c_time_ns(hi2c, 2U + Size));
+
+	return hal_sim_i2c_mem_read(DevAddress, MemAddress, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	(void)MemAddSize;
+
+	if (hi2c->busy)
+	{
+		return HAL_BUSY;
+	}
+
+	i2c_transfer = (hal_sim_i2c_transfer_t){ hi2c, DevAddress, MemAddress, pData, Size, 0U };
+	hi2c->busy = 1U;
+	sim_irq_schedule(SIM_IRQ_I2C, sim_now_ns() + hal_sim_i2c_time_ns(hi2c, 1U + Size));
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	(void)MemAddSize;
+
+	if (hi2c->busy)
+	{
+		return HAL_BUSY;
+	}
+
+	i2c_transfer = (hal_sim_i2c_transfer_t){ hi2c, DevAddress, MemAddress, pData, Size, 1U };
+	hi2c->busy = 1U;
+	sim_irq_schedule(SIM_IRQ_I2C, sim_now_ns() + hal_sim_i2c_time_ns(hi2c, 2U + Size));
+
+	return HAL_OK;
+}
+
+/**
+ * @brief End of the non blocking transfer, the devices see it as a whole
+ *
+ */
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef *hi2c)
+{
+	if (!hi2c->busy || i2c_transfer.hi2c != hi2c)
+	{
+		return;
+	}
+
+	HAL_StatusTypeDef status;
+	if (i2c_transfer.read)
+	{
+		status = hal_sim_i2c_mem_read(i2c_transfer.address, i2c_transfer.reg, i2c_transfer.data, i2c_transfer.size);
+	}
+	else
+	{
+		status = hal_sim_i2c_mem_write(i2c_transfer.address, i2c_transfer.reg, i2c_transfer.data, i2c_transfer.size);
+	}
+
+	hi2c->busy = 0U;
+
+	if (status != HAL_OK)
+	{
+		HAL_I2C_ErrorCallback(hi2c);
+	}
+	else if (i2c_transfer.read)
+	{
+		HAL_I2C_MemRxCpltCallback(hi2c);
+	}
+	else
+	{
+		HAL_I2C_MemTxCpltCallback(hi2c);
+	}
+}
+
+__attribute__((weak)) void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+/**
+ * @brief Time on the bus, the address byte and the data bytes plus start and stop
+ *
+ */
+static uint64_t hal_sim_i2c_time_ns(const I2C_HandleTypeDef *hi2c, uint32_t bytes)
+{
+	return ((uint64_t)(1U + bytes) * I2C_BITS_PER_BYTE + 2U) * 1000000000ULL / hi2c->Init.ClockSpeed;
+}
+
+/**
+ * @brief Write transfer, NACK if no device answers the address
+ *
+ */
+static HAL_StatusTypeDef hal_sim_i2c_write(uint16_t address, const uint8_t *data, uint16_t size)
+{
+	/* The plant runs on the old DAC code up to now */
+	plant_update(sim_now_ns());
+
+	/* Taken on the write phase, register reads send their pointer first */
+	if (i2c_failures > 0U)
+	{
+		i2c_failures--;
+		return HAL_ERROR;
+	}
+
+	if (address == I2C_ADDR_MCP4725)
+	{
+		return mcp4725_model_write(data, size) == 0 ? HAL_OK : HAL_ERROR;
+	}
+
+	if (address != I2C_ADDR_ADS1115 || size == 0U)
+	{
+		return HAL_ERROR;
+	}
+
+	/* Pointer byte, then the register value MSB first */
+	ads1115_pointer = data[0];
+	if (size == 1U)
+	{
+		return HAL_OK;
+	}
+	if (size != 3U)
+	{
+		return HAL_ERROR;
+	}
+
+	return ads1115_model_write(data[0], (uint16_t)((data[1] << 8) | data[2])) == 0 ? HAL_OK : HAL_ERROR;
+}
+
+/**
+ * @brief Read transfer, NACK if no device answers the address
+ *
+ */
+static HAL_StatusTypeDef hal_sim_i2c_read(uint16_t address, uint8_t *data, uint16_t size)
+{
+	if (address == I2C_ADDR_MCP4725)
+	{
+		mcp4725_model_read(data, size);
+		return HAL_OK;
+	}
+
+	uint16_t value;
+	if (address != I2C_ADDR_ADS1115 || ads1115_model_read(ads1115_pointer, &value) != 0)
+	{
+		return HAL_ERROR;
+	}
+
+	for (uint16_t i = 0; i < size; i++)
+	{
+		data[i] = (i == 0U) ? (uint8_t)(value >> 8) : (i == 1U) ? (uint8_t)value : 0xFFU;
+	}
+
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef hal_sim_i2c_mem_write(uint16_t address, uint16_t reg, const uint8_t *data, uint16_t size)
+{
+	uint8_t buffer[I2C_TRANSFER_MAX];
+
+	if (size >= I2C_TRANSFER_MAX)
+	{
+		return HAL_ERROR;
+	}
+
+	buffer[0] = (uint8_t)reg;
+	memcpy(&buffer[1], data, size);
+
+	return hal_sim_i2c_write(address, buffer, (uint16_t)(1U + size));
+}
+
+static HAL_StatusTypeDef hal_sim_i2c_mem_read(uint16_t address, uint16_t reg, uint8_t *data, uint16_t size)
+{
+	const uint8_t pointer = (uint8_t)reg;
+
+	if (hal_sim_i2c_write(address, &pointer, 1U) != HAL_OK)
+	{
+		return HAL_ERROR;
+	}
+
+	return hal_sim_i2c_read(address, data, size);
+}
+
+/* ADC */
+
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef *hadc)
+{
+	(void)hadc;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length)
+{
+	(void)hadc;
+
+	adc_dma_buffer = (volatile uint16_t *)pData;
+	adc_dma_length = Length;
+	hal_sim_adc_refresh();
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Fill the DMA buffer with fresh conversions of the temperature sensor
+ *
+ */
+static void hal_sim_adc_refresh(void)
+{
+	if (adc_dma_buffer == NULL)
+	{
+		return;
+	}
+
+	plant_update(sim_now_ns());
+
+	for (uint32_t i = 0; i < adc_dma_length; i++)
+	{
+		float code = plant_temperature_sensor() / ADC_INTERNAL_FULL_SCALE * ADC_INTERNAL_MAX_VALUE + 0.5f;
+		code = code < 0.0f ? 0.0f : code > ADC_INTERNAL_MAX_VALUE ? ADC_INTERNAL_MAX_VALUE : code;
+		adc_dma_buffer[i] = (uint16_t)code;
+	}
+}
+
+/* Host */
+
+void hal_sim_i2c_fail(uint32_t transfers)
+{
+	i2c_failures = transfers;
+}
+
+void hal_sim_poll(uint64_t max_wait_ns)
+{
+	const uint64_t now = sim_now_ns();
+	const uint64_t next = sim_next_due_ns();
+	uint64_t wait = (next <= now) ? 0U : next - now;
+
+	if (wait > max_wait_ns)
+	{
+		wait = max_wait_ns;
+	}
+
+	const struct timespec timeout = {
+		.tv_sec = (time_t)(wait / 1000000000ULL),
+		.tv_nsec = (long)(wait % 1000000000ULL),
+	};
+
+	if (uart.fd >= 0 && uart.fifo_count < UART_HOST_FIFO_SIZE)
+	{
+		struct pollfd pfd = { .fd = uart.fd, .events = POLLIN, .revents = 0 };
+
+		if (ppoll(&pfd, 1, &timeout, NULL) > 0 && (pfd.revents & POLLIN))
+		{
+			hal_sim_uart_read();
+		}
+	}
+	else
+	{
+		nanosleep(&timeout, NULL);
+	}
+
+	hal_sim_adc_refresh();
+}
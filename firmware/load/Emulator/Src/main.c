@@ -0,0 +1,189 @@
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "firmware.h"
+#include "server.h"
+
+#include "hal_sim.h"
+#include "sim.h"
+#include "plant.h"
+#include "ads1115_model.h"
+#include "mcp4725_model.h"
+
+/**
+ * @brief Longest sleep of the superloop between two interrupts
+ *
+ */
+#define EMULATOR_POLL_MAX_NS 1000000U
+
+static volatile sig_atomic_t running = 1;
+
+/* Prototypes */
+static void emulator_usage(const char *name);
+static int emulator_open_pty(const char *link);
+static void emulator_signal(int signal);
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "link", required_argument, NULL, 'l' },
+		{ "source-voltage", required_argument, NULL, 'v' },
+		{ "source-resistance", required_argument, NULL, 'r' },
+		{ "source-current-limit", required_argument, NULL, 'i' },
+		{ "ambient", required_argument, NULL, 't' },
+		{ "noise", required_argument, NULL, 'n' },
+		{ "address", required_argument, NULL, 'a' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	plant_config_t plant_config;
+	const char *link = NULL;
+	unsigned long address = SERVER_ADDRESS_BROADCAST;
+	int option;
+
+	plant_default_config(&plant_config);
+
+	while ((option = getopt_long(argc, argv, "l:v:r:i:t:n:a:h", options, NULL)) != -1)
+	{
+		switch (option)
+		{
+		case 'l':
+			link = optarg;
+			break;
+		case 'v':
+			plant_config.source_voltage = strtof(optarg, NULL);
+			break;
+		case 'r':
+			plant_config.source_resistance = strtof(optarg, NULL);
+			break;
+		case 'i':
+			plant_config.source_current_limit = strtof(optarg, NULL);
+			break;
+		case 't':
+			plant_config.ambient_temperature = strtof(optarg, NULL);
+			break;
+		case 'n':
+			plant_config.adc_noise = strtof(optarg, NULL);
+			break;
+		case 'a':
+			address = strtoul(optarg, NULL, 0);
+			if (address > UINT8_MAX)
+			{
+				fprintf(stderr, "Address out of range: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			emulator_usage(argv[0]);
+			return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	const int fd = emulator_open_pty(link);
+	if (fd < 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGINT, emulator_signal);
+	signal(SIGTERM, emulator_signal);
+
+	sim_init();
+	plant_init(&plant_config);
+	mcp4725_model_init();
+	ads1115_model_init();
+
+	firmware_init((uint8_t)address);
+	hal_sim_uart_attach(&huart1, fd);
+
+	while (running)
+	{
+		/* Time the superloop spins on the chip, interrupts due meanwhile are taken before it goes on */
+		hal_sim_poll(EMULATOR_POLL_MAX_NS);
+		sim_preempt();
+		firmware_poll();
+	}
+
+	if (link != NULL)
+	{
+		unlink(link);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static void emulator_usage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  -l, --link PATH                  symlink to the pty of the load\n"
+			"  -v, --source-voltage VOLTS       source open circuit voltage\n"
+			"  -r, --source-resistance OHMS     source series resistance\n"
+			"  -i, --source-current-limit AMPS  source current limit\n"
+			"  -t, --ambient CELSIUS            ambient temperature\n"
+			"  -n, --noise VOLTS                RMS noise on the ADC inputs\n"
+			"  -a, --address N                  address of the load on a bus, 0 for a point to point link\n",
+			name);
+}
+
+/**
+ * @brief Open the pty the host talks to, the slave side stays open so the link survives the host closing it
+ *
+ * @param link Symlink to the slave, NULL for none
+ * @return int Master file descriptor, -1 on error
+ */
+static int emulator_open_pty(const char *link)
+{
+	const int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		perror("posix_openpt");
+		return -1;
+	}
+
+	const char *path = ptsname(master);
+	const int slave = (path != NULL) ? open(path, O_RDWR | O_NOCTTY) : -1;
+	if (slave < 0)
+	{
+		perror("ptsname");
+		close(master);
+		return -1;
+	}
+
+	/* Raw bytes both ways, the line discipline must not touch the frames */
+	struct termios tio;
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+	if (link != NULL)
+	{
+		unlink(link);
+		if (symlink(path, link) != 0)
+		{
+			perror("symlink");
+			close(slave);
+			close(master);
+			return -1;
+		}
+	}
+
+	printf("%s\n", link != NULL ? link : path);
+	fflush(stdout);
+
+	return master;
+}
+
+static void emulator_signal(int signal)
+{
+	(void)signal;
+	running = 0;
+}
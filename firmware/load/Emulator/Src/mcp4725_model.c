@@ -0,0 +1,95 @@
+#include "mcp4725_model.h"
+
+#define CMD_FAST_MASK 0xC0U
+#define CMD_DAC 0x40U
+#define CMD_EEPROM 0x60U
+#define CMD_MASK 0xE0U
+#define BIT_READY 0x80U
+
+static uint16_t dac_code;
+static uint8_t dac_power_down;
+static uint16_t eeprom_code;
+static uint8_t eeprom_power_down;
+
+/**
+ * @brief Power on state, code 0 and powered up
+ *
+ */
+void mcp4725_model_init(void)
+{
+	dac_code = 0U;
+	dac_power_down = 0U;
+	eeprom_code = 0U;
+	eeprom_power_down = 0U;
+}
+
+/**
+ * @brief Write transfer addressed to the DAC
+ *
+ * @param data Bytes
+ * @param size Number of bytes
+ * @return int 0 on success, -1 if the transfer is not a valid command
+ */
+int mcp4725_model_write(const uint8_t *data, uint16_t size)
+{
+	/* Fast mode: power down bits and the 12 bit code in two bytes */
+	if (size == 2U && (data[0] & CMD_FAST_MASK) == 0U)
+	{
+		dac_power_down = (data[0] >> 4) & 0x03U;
+		dac_code = (uint16_t)(((data[0] & 0x0FU) << 8) | data[1]);
+		return 0;
+	}
+
+	if (size != 3U || ((data[0] & CMD_MASK) != CMD_DAC && (data[0] & CMD_MASK) != CMD_EEPROM))
+	{
+		return -1;
+	}
+
+	dac_power_down = (data[0] >> 1) & 0x03U;
+	dac_code = (uint16_t)((data[1] << 4) | (data[2] >> 4));
+
+	if ((data[0] & CMD_MASK) == CMD_EEPROM)
+	{
+		eeprom_power_down = dac_power_down;
+		eeprom_code = dac_code;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Read transfer addressed to the DAC
+ *
+ * @param data Bytes
+ * @param size Number of bytes, up to 5
+ */
+void mcp4725_model_read(uint8_t *data, uint16_t size)
+{
+	const uint8_t response[5] = {
+		(uint8_t)(BIT_READY | (dac_power_down << 1)),
+		(uint8_t)(dac_code >> 4),
+		(uint8_t)(dac_code << 4),
+		(uint8_t)((eeprom_power_down << 5) | (eeprom_code >> 8)),
+		(uint8_t)eeprom_code,
+	};
+
+	for (uint16_t i = 0; i < size; i++)
+	{
+		data[i] = (i < sizeof(response)) ? response[i] : 0xFFU;
+	}
+}
+
+/**
+ * @brief Output voltage
+ *
+ * @return float Volts, 0 while powered down
+ */
+float mcp4725_model_voltage(void)
+{
+	if (dac_power_down != 0U)
+	{
+		return 0.0f;
+	}
+
+	return MCP4725_MODEL_VDD * (float)dac_code / 4096.0f;
+}
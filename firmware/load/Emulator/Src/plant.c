@@ -0,0 +1,176 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "main.h"
+#include "plant.h"
+#include "mcp4725_model.h"
+
+/**
+ * @brief Current drawn per DAC volt and DAC offset of the analog loop,
+ * 	the constant current feed-forward of control.c is calibrated on them
+ *
+ */
+#define PLANT_AMPS_PER_DAC_VOLT (1.0f / 0.08906093f)
+#define PLANT_DAC_OFFSET 0.00743f
+
+/**
+ * @brief Input dividers, shunt amplifier and temperature sensor, inverse of the correction coefficients of adc.c
+ *
+ */
+#define PLANT_VOLTAGE_GAIN 31.65715446f
+#define PLANT_VOLTAGE_OFFSET 0.20919486f
+#define PLANT_CURRENT_GAIN 11.22826758f
+#define PLANT_CURRENT_OFFSET -0.08353555f
+
+#define PLANT_TEMPERATURE_GAIN -72.69488f
+#define PLANT_TEMPERATURE_OFFSET 192.02738f
+
+static plant_config_t plant_config;
+static plant_state_t plant;
+static uint64_t last_update_ns;
+static unsigned int noise_seed = 1U;
+
+/* Prototypes */
+static float plant_noise(void);
+
+/**
+ * @brief Defaults, a 12 V bench supply on a load at 25 C
+ *
+ * @param config Configuration
+ */
+void plant_default_config(plant_config_t *config)
+{
+	config->source_voltage = 12.0f;
+	config->source_resistance = 0.05f;
+	config->source_current_limit = 5.0f;
+	config->on_resistance = 0.1f;
+	config->current_time_constant = 100e-6f;
+	config->ambient_temperature = 25.0f;
+	config->thermal_resistance = 1.5f;
+	config->thermal_time_constant = 60.0f;
+	config->adc_noise = 100e-6f;
+}
+
+/**
+ * @brief Initialize the model at rest
+ *
+ * @param config Configuration, copied
+ */
+void plant_init(const plant_config_t *config)
+{
+	plant_config = *config;
+	plant.current = 0.0f;
+	plant.voltage = config->source_voltage;
+	plant.temperature = config->ambient_temperature;
+	last_update_ns = 0U;
+}
+
+/**
+ * @brief Advance the model to the emulated time
+ *
+ * @param now_ns Emulated time
+ */
+void plant_update(uint64_t now_ns)
+{
+	if (now_ns <= last_update_ns)
+	{
+		return;
+	}
+
+	const float dt = (float)(now_ns - last_update_ns) * 1e-9f;
+	last_update_ns = now_ns;
+
+	/* Current the analog loop settles to, within what the source and the power stage can give */
+	float target = 0.0f;
+	if (HAL_GPIO_ReadPin(ENABLE_LOAD_GPIO_Port, ENABLE_LOAD_Pin) == GPIO_PIN_SET)
+	{
+		target = (mcp4725_model_voltage() - PLANT_DAC_OFFSET) * PLANT_AMPS_PER_DAC_VOLT;
+	}
+
+	const float available = plant_config.source_voltage / (plant_config.source_resistance + plant_config.on_resistance);
+	target = fminf(target, fminf(available, plant_config.source_current_limit));
+	target = fmaxf(target, 0.0f);
+
+	plant.current += (target - plant.current) * (1.0f - expf(-dt / plant_config.current_time_constant));
+
+	/* A current limited source folds its voltage down */
+	plant.voltage = plant_config.source_voltage - plant.current * plant_config.source_resistance;
+	if (plant.current >= plant_config.source_current_limit * 0.999f)
+	{
+		plant.voltage = fminf(plant.voltage, plant.current * plant_config.on_resistance);
+	}
+	plant.voltage = fmaxf(plant.voltage, 0.0f);
+
+	const float settled = plant_config.ambient_temperature + plant.voltage * plant.current * plant_config.thermal_resistance;
+	plant.temperature += (settled - plant.temperature) * (1.0f - expf(-dt / plant_config.thermal_time_constant));
+}
+
+/**
+ * @brief Step the source open circuit voltage, the rest of the state carries on
+ *
+ * @param now_ns Emulated time, the model runs on the old voltage up to it
+ * @param voltage Volts
+ */
+void plant_set_source_voltage(uint64_t now_ns, float voltage)
+{
+	plant_update(now_ns);
+	plant_config.source_voltage = voltage;
+}
+
+/**
+ * @brief State on the last update
+ *
+ * @return const plant_state_t* State
+ */
+const plant_state_t *plant_state(void)
+{
+	return &plant;
+}
+
+/**
+ * @brief Voltage on an ADS1115 input, single ended
+ *
+ * @param input Input, AIN0 to AIN3
+ * @return float Volts
+ */
+float plant_adc_input(uint8_t input)
+{
+	switch (input)
+	{
+	case 0:
+		return (plant.voltage - PLANT_VOLTAGE_OFFSET) / PLANT_VOLTAGE_GAIN + plant_noise();
+	case 1:
+		return (plant.current - PLANT_CURRENT_OFFSET) / PLANT_CURRENT_GAIN + plant_noise();
+	default:
+		return plant_noise();
+	}
+}
+
+/**
+ * @brief Voltage of the temperature sensor on the internal ADC
+ *
+ * @return float Volts
+ */
+float plant_temperature_sensor(void)
+{
+	return (plant.temperature - PLANT_TEMPERATURE_OFFSET) / PLANT_TEMPERATURE_GAIN + plant_noise();
+}
+
+/**
+ * @brief Gaussian noise of the configured RMS value
+ *
+ * @return float Volts
+ */
+static float plant_noise(void)
+{
+	if (plant_config.adc_noise <= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	/* Box-Muller */
+	const float u1 = ((float)rand_r(&noise_seed) + 1.0f) / ((float)RAND_MAX + 2.0f);
+	const float u2 = (float)rand_r(&noise_seed) / (float)RAND_MAX;
+
+	return plant_config.adc_noise * sqrtf(-2.0f * logf(u1)) * cosf(6.28318531f * u2);
+}
@@ -0,0 +1,232 @@
+#include <time.h>
+
+#include "sim.h"
+
+typedef struct
+{
+	uint8_t priority;
+	sim_handler_t handler;
+	uint64_t due_ns;
+} sim_irq_state_t;
+
+volatile uint32_t sim_primask = 0U;
+
+static sim_irq_state_t irqs[SIM_IRQ_COUNT];
+static uint32_t active_priority = SIM_THREAD_PRIORITY;
+static struct timespec start;
+
+/** Virtual clock, used instead of the monotonic one when set */
+static uint8_t virtual_clock;
+static uint64_t virtual_now_ns;
+
+/* Prototypes */
+static void sim_serve(uint32_t ceiling);
+static uint64_t sim_next_due_after_ns(uint64_t time_ns);
+
+/**
+ * @brief Start the emulated time
+ *
+ */
+void sim_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	virtual_clock = 0U;
+	active_priority = SIM_THREAD_PRIORITY;
+	sim_primask = 0U;
+
+	for (uint32_t i = 0; i < SIM_IRQ_COUNT; i++)
+	{
+		irqs[i].priority = 0U;
+		irqs[i].handler = NULL;
+		irqs[i].due_ns = SIM_NEVER;
+	}
+}
+
+/**
+ * @brief Start the emulated time on a virtual clock, for the host tests
+ *
+ */
+void sim_init_virtual(void)
+{
+	sim_init();
+	virtual_clock = 1U;
+	virtual_now_ns = 0U;
+}
+
+/**
+ * @brief Nanoseconds since sim_init()
+ *
+ * @return uint64_t Time
+ */
+uint64_t sim_now_ns(void)
+{
+	if (virtual_clock)
+	{
+		virtual_now_ns += SIM_VIRTUAL_READ_NS;
+		return virtual_now_ns;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000ULL + (uint64_t)now.tv_nsec - (uint64_t)start.tv_nsec;
+}
+
+/**
+ * @brief Set the priority and handler of an interrupt
+ *
+ * @param irq Interrupt
+ * @param priority NVIC preemption priority, lower is more urgent
+ * @param handler Handler
+ */
+void sim_irq_configure(sim_irq_t irq, uint8_t priority, sim_handler_t handler)
+{
+	irqs[irq].priority = priority;
+	irqs[irq].handler = handler;
+}
+
+/**
+ * @brief Make an interrupt pending at a time, replacing the previous deadline
+ *
+ * @param irq Interrupt
+ * @param due_ns Time it becomes pending
+ */
+void sim_irq_schedule(sim_irq_t irq, uint64_t due_ns)
+{
+	irqs[irq].due_ns = due_ns;
+}
+
+/**
+ * @brief Deadline of an interrupt
+ *
+ * @param irq Interrupt
+ * @return uint64_t Time it becomes pending, SIM_NEVER if not scheduled
+ */
+uint64_t sim_irq_due(sim_irq_t irq)
+{
+	return irqs[irq].due_ns;
+}
+
+/**
+ * @brief Drop the deadline of an interrupt
+ *
+ * @param irq Interrupt
+ */
+void sim_irq_cancel(sim_irq_t irq)
+{
+	irqs[irq].due_ns = SIM_NEVER;
+}
+
+/**
+ * @brief Earliest deadline of all interrupts
+ *
+ * @return uint64_t Time, SIM_NEVER if none is scheduled
+ */
+uint64_t sim_next_due_ns(void)
+{
+	uint64_t next = SIM_NEVER;
+
+	for (uint32_t i = 0; i < SIM_IRQ_COUNT; i++)
+	{
+		if (irqs[i].due_ns < next)
+		{
+			next = irqs[i].due_ns;
+		}
+	}
+
+	return next;
+}
+
+/**
+ * @brief Serve the due interrupts that preempt the code running, nothing while interrupts are masked
+ *
+ */
+void sim_preempt(void)
+{
+	sim_serve(active_priority);
+}
+
+/**
+ * @brief Spin for a time serving the interrupts that preempt the code running
+ *
+ * @param duration_ns Time
+ */
+void sim_busy_wait_ns(uint64_t duration_ns)
+{
+	const uint64_t end = sim_now_ns() + duration_ns;
+
+	if (virtual_clock)
+	{
+		/* Nothing happens between two deadlines, skip to the next one */
+		sim_preempt();
+		while (virtual_now_ns < end)
+		{
+			const uint64_t next = sim_next_due_after_ns(virtual_now_ns);
+			virtual_now_ns = (next < end) ? next : end;
+			sim_preempt();
+		}
+		return;
+	}
+
+	while (sim_now_ns() < end)
+	{
+		sim_preempt();
+	}
+}
+
+/**
+ * @brief Run the most urgent due interrupts above a priority until none is left
+ *
+ * @param ceiling Priority of the code running, only more urgent interrupts preempt it
+ */
+static void sim_serve(uint32_t ceiling)
+{
+	while (!sim_primask)
+	{
+		const uint64_t now = sim_now_ns();
+		int32_t next = -1;
+
+		for (uint32_t i = 0; i < SIM_IRQ_COUNT; i++)
+		{
+			if (irqs[i].due_ns <= now && irqs[i].handler != NULL && irqs[i].priority < ceiling &&
+				(next < 0 || irqs[i].priority < irqs[next].priority))
+			{
+				next = (int32_t)i;
+			}
+		}
+
+		if (next < 0)
+		{
+			return;
+		}
+
+		/* Pending is cleared on entry, the handler may schedule itself again */
+		irqs[next].due_ns = SIM_NEVER;
+
+		const uint32_t preempted = active_priority;
+		active_priority = irqs[next].priority;
+		irqs[next].handler();
+		active_priority = preempted;
+	}
+}
+
+/**
+ * @brief Earliest deadline after a time
+ *
+ * @param time_ns Time
+ * @return uint64_t Deadline, SIM_NEVER if none is scheduled after the time
+ */
+static uint64_t sim_next_due_after_ns(uint64_t time_ns)
+{
+	uint64_t next = SIM_NEVER;
+
+	for (uint32_t i = 0; i < SIM_IRQ_COUNT; i++)
+	{
+		if (irqs[i].due_ns > time_ns && irqs[i].due_ns < next)
+		{
+			next = irqs[i].due_ns;
+		}
+	}
+
+	return next;
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "firmware.h"
+#include "adc.h"
+#include "server.h"
+
+#include "hal_sim.h"
+#include "sim.h"
+#include "plant.h"
+#include "ads1115_model.h"
+#include "mcp4725_model.h"
+
+#include "test_check.h"
+
+/**
+ * @brief ADS111x acquisition engine on the simulated HAL
+ *
+ * Usage: adc_engine_test
+ *
+ * The firmware runs on the virtual clock against the ADS1115 model: ALERT -> read result -> write the next config,
+ * from the interrupts only. Checks the conversion rate and the values against the plant, then that borrowing the
+ * bus holds the chain and serves the ALERT missed meanwhile on release, and that the watchdog restarts the chain
+ * after an I2C error and after a lost ALERT edge.
+ */
+
+/** Conversions per second, single shot at 860 SPS plus the wake up and the two transfers of each one */
+#define TEST_RATE_MIN 650U
+#define TEST_RATE_MAX 860U
+
+/** Error allowed on the averaged inputs, in microvolts: the model noise and one code of the 4.096 V range */
+#define TEST_VALUE_TOLERANCE_UV 500
+
+/** Time the watchdog may take to restart the chain, its timeout plus a conversion */
+#define TEST_RESTART_NS 15000000ULL
+
+extern adc_t adc;
+
+/**
+ * @brief Time until the next conversion completes, SIM_NEVER if none does within a limit
+ *
+ * @param limit_ns Limit
+ * @return uint64_t Time
+ */
+static uint64_t test_time_to_conversion(uint64_t limit_ns)
+{
+	const uint32_t conversions = adc_get_conversion_count();
+	const uint64_t start = sim_now_ns();
+
+	while (adc_get_conversion_count() == conversions)
+	{
+		if (sim_now_ns() - start > limit_ns)
+		{
+			return SIM_NEVER;
+		}
+		firmware_run_ns(FIRMWARE_SUPERLOOP_NS);
+	}
+
+	return sim_now_ns() - start;
+}
+
+/**
+ * @brief Conversion rate and values of the input channels
+ *
+ */
+static void test_rate(void)
+{
+	adc_reader_t reader;
+	char what[96];
+
+	adc_reader_init(&reader);
+
+	const uint32_t conversions = adc_get_conversion_count();
+	firmware_run_ns(1000000000ULL);
+	const uint32_t rate = adc_get_conversion_count() - conversions;
+
+	snprintf(what, sizeof(what), "%u conversions/s, expected %u to %u", rate, TEST_RATE_MIN, TEST_RATE_MAX);
+	test_check(rate >= TEST_RATE_MIN && rate <= TEST_RATE_MAX, what);
+	test_check(adc.errors == 0U, "no I2C error");
+
+	adc_reader_update(&reader);
+
+	/* Noise free inputs of the plant, it holds still with the load off */
+	const float voltage = (plant_state()->voltage - 0.20919486f) / 31.65715446f;
+	const float current = (plant_state()->current + 0.08353555f) / 11.22826758f;
+	const int32_t expected[] = { (int32_t)(voltage * 1e6f), (int32_t)(current * 1e6f) };
+
+	for (uint8_t channel = ADC_INPUT_VOLTAGE; channel <= ADC_INPUT_CURRENT; channel++)
+	{
+		snprintf(what, sizeof(what), "channel %u: %d uV, expected %d uV", channel, reader.value[channel],
+				 expected[channel]);
+		test_check(abs(reader.value[channel] - expected[channel]) <= TEST_VALUE_TOLERANCE_UV, what);
+	}
+
+	printf("%u conversions/s, %d uV and %d uV\n", rate, reader.value[ADC_INPUT_VOLTAGE],
+		   reader.value[ADC_INPUT_CURRENT]);
+}
+
+/**
+ * @brief A borrowed bus holds the chain, the ALERT that arrived meanwhile is served on release
+ *
+ */
+static void test_bus_borrow(void)
+{
+	test_check(adc_bus_acquire() == HAL_OK, "bus acquired");
+	test_check(adc.state == ADC_STATE_IDLE, "no transfer in flight once acquired");
+
+	/* Longer than a conversion, its ALERT arrives while the bus is held */
+	const uint32_t conversions = adc_get_conversion_count();
+	sim_busy_wait_ns(3000000ULL);
+
+	test_check(adc_get_conversion_count() == conversions, "no conversion while the bus is held");
+	test_check(adc.conversion_pending, "ALERT kept pending");
+	test_check(!hi2c2.busy, "no transfer started while the bus is held");
+
+	const uint32_t errors = adc.errors;
+	adc_bus_release();
+
+	/* Served at once, well before the watchdog would */
+	const uint64_t resume = test_time_to_conversion(TEST_RESTART_NS);
+	test_check(resume < 1000000ULL, "chain resumed on release");
+	test_check(adc.errors == errors, "no error on release");
+}
+
+/**
+ * @brief The watchdog restarts the chain after a failed transfer
+ *
+ */
+static void test_i2c_error(void)
+{
+	/* Fail the read of a result while it is on the bus, the control loop shares it */
+	while (adc.state != ADC_STATE_READ_RESULT)
+	{
+		sim_busy_wait_ns(1000U);
+	}
+	const uint32_t errors = adc.errors;
+	hal_sim_i2c_fail(1U);
+
+	const uint64_t restart = test_time_to_conversion(2U * TEST_RESTART_NS);
+	test_check(adc.errors == errors + 1U, "I2C error counted");
+	test_check(restart != SIM_NEVER, "chain restarted after an I2C error");
+
+	/* Back to the nominal rate */
+	const uint32_t conversions = adc_get_conversion_count();
+	firmware_run_ns(100000000ULL);
+	test_check(adc_get_conversion_count() - conversions >= TEST_RATE_MIN / 10U, "nominal rate after an I2C error");
+}
+
+/**
+ * @brief The watchdog restarts the chain after a lost ALERT edge
+ *
+ */
+static void test_lost_alert(void)
+{
+	/* Right after a conversion is started, drop its end */
+	test_time_to_conversion(TEST_RESTART_NS);
+	sim_irq_cancel(SIM_IRQ_ADC_ALERT);
+
+	const uint64_t restart = test_time_to_conversion(2U * TEST_RESTART_NS);
+	test_check(restart != SIM_NEVER, "chain restarted after a lost ALERT");
+	test_check(restart <= TEST_RESTART_NS, "restarted within the watchdog timeout");
+}
+
+int main(void)
+{
+	plant_config_t plant_config;
+
+	plant_default_config(&plant_config);
+
+	sim_init_virtual();
+	plant_init(&plant_config);
+	mcp4725_model_init();
+	ads1115_model_init();
+
+	firmware_init(SERVER_ADDRESS_BROADCAST);
+
+	test_rate();
+	test_bus_borrow();
+	test_i2c_error();
+	test_lost_alert();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ads111x.h"
+
+#include "test_check.h"
+
+/**
+ * @brief I2C transactions of the ADS111x driver
+ *
+ * Usage: ads111x_test
+ *
+ * The driver runs against a register file in place of the I2C HAL that counts the transactions on each register.
+ * Checks that the configuration is read once at init and served from the shadow afterwards, that the start up
+ * sequence of the acquisition engine takes one transaction per change, that the non blocking configuration only
+ * lands in the shadow on completion, and that a second device is rejected rather than sharing the shadow.
+ */
+
+/** Registers of the device: conversion, config, low and high thresholds */
+#define TEST_REGISTERS 4U
+#define TEST_REG_CONFIG 1U
+
+/** Config register at power up: AIN0/AIN1, 2.048 V, single shot, 128 SPS, comparator disabled */
+#define TEST_CONFIG_RESET 0x8583U
+
+typedef struct
+{
+	uint16_t reg[TEST_REGISTERS];
+	uint32_t reads[TEST_REGISTERS];
+	uint32_t writes[TEST_REGISTERS];
+} test_device_t;
+
+static test_device_t device;
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+								   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	if (MemAddress >= TEST_REGISTERS || Size != 2U)
+	{
+		return HAL_ERROR;
+	}
+
+	device.reads[MemAddress]++;
+	pData[0] = (uint8_t)(device.reg[MemAddress] >> 8);
+	pData[1] = (uint8_t)device.reg[MemAddress];
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+									uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	if (MemAddress >= TEST_REGISTERS || Size != 2U)
+	{
+		return HAL_ERROR;
+	}
+
+	device.writes[MemAddress]++;
+	device.reg[MemAddress] = (uint16_t)((pData[0] << 8) | pData[1]);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+									  uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return HAL_I2C_Mem_Read(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, 0U);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+									   uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return HAL_I2C_Mem_Write(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, 0U);
+}
+
+/**
+ * @brief Transactions on all the registers since the last call
+ *
+ * @param reads Reads
+ * @param writes Writes
+ */
+static void test_transactions(uint32_t *reads, uint32_t *writes)
+{
+	*reads = 0U;
+	*writes = 0U;
+
+	for (uint32_t i = 0; i < TEST_REGISTERS; i++)
+	{
+		*reads += device.reads[i];
+		*writes += device.writes[i];
+		device.reads[i] = 0U;
+		device.writes[i] = 0U;
+	}
+}
+
+/**
+ * @brief Configuration read once, then served from the shadow
+ *
+ */
+static void test_shadow(I2C_HandleTypeDef *hi2c)
+{
+	uint32_t reads;
+	uint32_t writes;
+	ads111x_gain_t gain;
+	ads111x_mux_t mux;
+	ads111x_data_rate_t rate;
+	ads111x_config_t config;
+
+	test_check(ads111x_init_desc(hi2c, ADS111X_ADDR_GND) == HAL_OK, "init");
+	test_transactions(&reads, &writes);
+	test_check(reads == 1U && writes == 0U, "init reads the config once");
+
+	test_check(ads111x_get_gain(hi2c, &gain) == HAL_OK && gain == ADS111X_GAIN_2V048, "gain at power up");
+	test_check(ads111x_get_input_mux(hi2c, &mux) == HAL_OK && mux == ADS111X_MUX_0_1, "input at power up");
+	test_check(ads111x_get_config(hi2c, &config) == HAL_OK, "get config");
+	test_transactions(&reads, &writes);
+	test_check(reads == 0U && writes == 0U, "getters served from the shadow");
+
+	test_check(ads111x_set_gain(hi2c, ADS111X_GAIN_4V096) == HAL_OK, "set gain");
+	test_check(ads111x_set_data_rate(hi2c, ADS111X_DATA_RATE_860) == HAL_OK, "set data rate");
+	test_transactions(&reads, &writes);
+	test_check(reads == 0U && writes == 2U, "one write per setter, no read");
+
+	test_check(ads111x_get_data_rate(hi2c, &rate) == HAL_OK && rate == ADS111X_DATA_RATE_860, "data rate kept");
+	test_check(ads111x_get_gain(hi2c, &gain) == HAL_OK && gain == ADS111X_GAIN_4V096, "gain kept");
+	test_check((device.reg[TEST_REG_CONFIG] & 0x8000U) == 0U, "setters leave the OS bit clear");
+}
+
+/**
+ * @brief Start up sequence of the acquisition engine, adc_init()
+ *
+ */
+static void test_engine_start(I2C_HandleTypeDef *hi2c)
+{
+	uint32_t reads;
+	uint32_t writes;
+
+	device.reg[TEST_REG_CONFIG] = TEST_CONFIG_RESET;
+	test_transactions(&reads, &writes);
+
+	const ads111x_config_t config = {
+		.mode = ADS111X_MODE_SINGLE_SHOT,
+		.data_rate = ADS111X_DATA_RATE_860,
+		.comp_mode = ADS111X_COMP_MODE_NORMAL,
+		.comp_polarity = ADS111X_COMP_POLARITY_LOW,
+		.comp_latch = ADS111X_COMP_LATCH_DISABLED,
+		.comp_queue = ADS111X_COMP_QUEUE_1,
+	};
+
+	test_check(ads111x_init_desc(hi2c, ADS111X_ADDR_GND) == HAL_OK, "init");
+	test_check(ads111x_set_config(hi2c, &config) == HAL_OK, "set config");
+	test_check(ads111x_enable_conv_ready(hi2c, 1) == HAL_OK, "enable conversion ready");
+	test_check(ads111x_configure(hi2c, ADS111X_MUX_0_GND, ADS111X_GAIN_4V096) == HAL_OK, "configure");
+
+	const uint32_t config_reads = device.reads[TEST_REG_CONFIG];
+	const uint32_t config_writes = device.writes[TEST_REG_CONFIG];
+	test_transactions(&reads, &writes);
+
+	char what[96];
+	snprintf(what, sizeof(what), "%u transactions on the config register, expected 3",
+			 config_reads + config_writes);
+	test_check(config_reads == 1U && config_writes == 2U, what);
+	test_check(reads == 1U && writes == 4U, "two threshold writes");
+	test_check((device.reg[TEST_REG_CONFIG] & 0x8000U) != 0U, "conversion started");
+}
+
+/**
+ * @brief The non blocking configuration lands in the shadow on completion only
+ *
+ */
+static void test_configure_it(I2C_HandleTypeDef *hi2c)
+{
+	uint8_t buf[2];
+	ads111x_mux_t mux;
+	ads111x_gain_t gain;
+
+	test_check(ads111x_configure_it(hi2c, ADS111X_MUX_1_GND, ADS111X_GAIN_0V256, buf) == HAL_OK, "configure it");
+	test_check(ads111x_get_input_mux(hi2c, &mux) == HAL_OK && mux == ADS111X_MUX_0_GND,
+			   "shadow unchanged while in flight");
+
+	ads111x_configure_cplt(hi2c, buf);
+	test_check(ads111x_get_input_mux(hi2c, &mux) == HAL_OK && mux == ADS111X_MUX_1_GND, "input on completion");
+	test_check(ads111x_get_gain(hi2c, &gain) == HAL_OK && gain == ADS111X_GAIN_0V256, "gain on completion");
+
+	/* A following read-modify-write keeps the configuration and does not restart the conversion */
+	test_check(ads111x_set_comp_queue(hi2c, ADS111X_COMP_QUEUE_DISABLED) == HAL_OK, "set comparator queue");
+	test_check(ads111x_get_input_mux(hi2c, &mux) == HAL_OK && mux == ADS111X_MUX_1_GND, "input kept");
+	test_check((device.reg[TEST_REG_CONFIG] & 0x8000U) == 0U, "OS bit clear after completion");
+}
+
+/**
+ * @brief A second device is rejected instead of overwriting the shadow of the first one
+ *
+ */
+static void test_second_device(I2C_HandleTypeDef *hi2c, I2C_HandleTypeDef *other)
+{
+	uint32_t reads;
+	uint32_t writes;
+	ads111x_gain_t gain;
+	uint8_t buf[2] = { 0xFFU, 0xFFU };
+
+	test_transactions(&reads, &writes);
+
+	test_check(ads111x_init_desc(other, ADS111X_ADDR_GND) == HAL_ERROR, "second init rejected");
+	test_check(ads111x_set_gain(other, ADS111X_GAIN_6V144) == HAL_ERROR, "setter on another bus rejected");
+	test_check(ads111x_get_gain(other, &gain) == HAL_ERROR, "getter on another bus rejected");
+	test_check(ads111x_configure(other, ADS111X_MUX_3_GND, ADS111X_GAIN_6V144) == HAL_ERROR,
+			   "configure on another bus rejected");
+	ads111x_configure_cplt(other, buf);
+
+	test_transactions(&reads, &writes);
+	test_check(reads == 0U && writes == 0U, "no transaction for another bus");
+	test_check(ads111x_get_gain(hi2c, &gain) == HAL_OK && gain == ADS111X_GAIN_0V256, "shadow of the device kept");
+}
+
+int main(void)
+{
+	I2C_HandleTypeDef hi2c;
+	I2C_HandleTypeDef other;
+
+	memset(&hi2c, 0, sizeof(hi2c));
+	memset(&other, 0, sizeof(other));
+	device.reg[TEST_REG_CONFIG] = TEST_CONFIG_RESET;
+
+	test_shadow(&hi2c);
+	test_engine_start(&hi2c);
+	test_configure_it(&hi2c);
+	test_second_device(&hi2c, &other);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
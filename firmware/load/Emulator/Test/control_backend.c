@@ -0,0 +1,83 @@
+/**
+ * @brief control.c in the backend selected by CONTROL_BACKEND_FIXED
+ * 	Included by control_backend_fixed.c and control_backend_float.c, so control_equivalence_test holds both copies.
+ * 	The public functions of each copy get the name of the backend, the static ones stay private to the copy.
+ *
+ */
+#include "control_backend.h"
+
+#ifdef CONTROL_BACKEND_FIXED
+#ifndef CONTROL_FIXED_POINT
+#define CONTROL_FIXED_POINT
+#endif
+#define CONTROL_BACKEND_NAME(name) name##_fixed
+#define CONTROL_BACKEND_API(name) control_backend_fixed_##name
+#else
+#undef CONTROL_FIXED_POINT
+#define CONTROL_BACKEND_NAME(name) name##_float
+#define CONTROL_BACKEND_API(name) control_backend_float_##name
+#endif
+
+#define control_init CONTROL_BACKEND_NAME(control_init)
+#define control_start CONTROL_BACKEND_NAME(control_start)
+#define control_update CONTROL_BACKEND_NAME(control_update)
+#define control_step_setpoint CONTROL_BACKEND_NAME(control_step_setpoint)
+#define control_mode_from_server CONTROL_BACKEND_NAME(control_mode_from_server)
+#define control_get_stats CONTROL_BACKEND_NAME(control_get_stats)
+#define control_reset_stats CONTROL_BACKEND_NAME(control_reset_stats)
+#define control_set_enable CONTROL_BACKEND_NAME(control_set_enable)
+#define control_set_from_server CONTROL_BACKEND_NAME(control_set_from_server)
+#define control_set_setpoint CONTROL_BACKEND_NAME(control_set_setpoint)
+#define control_get_setpoint CONTROL_BACKEND_NAME(control_get_setpoint)
+#define control_set_mode CONTROL_BACKEND_NAME(control_set_mode)
+#define control_set_constants CONTROL_BACKEND_NAME(control_set_constants)
+#define control_set_kp CONTROL_BACKEND_NAME(control_set_kp)
+#define control_set_ki CONTROL_BACKEND_NAME(control_set_ki)
+#define control_set_kd CONTROL_BACKEND_NAME(control_set_kd)
+#define control_set_rate_limit CONTROL_BACKEND_NAME(control_set_rate_limit)
+
+#include "control.c"
+
+#ifdef CONTROL_FIXED_POINT
+#define CONTROL_BACKEND_TO_FLOAT(action) ((float)(action) / 268435456.0f)
+#define CONTROL_BACKEND_RAW(action) mcp4725_voltage_to_raw_q16(Q16(3.3f), q28_to_q16(action))
+#else
+#define CONTROL_BACKEND_TO_FLOAT(action) (action)
+#define CONTROL_BACKEND_RAW(action) mcp4725_voltage_to_raw(3.3f, (action))
+#endif
+
+static control_t backend;
+
+void CONTROL_BACKEND_API(init)(void)
+{
+	control_init(&backend, NULL);
+}
+
+void CONTROL_BACKEND_API(setpoint)(int mode, float setpoint)
+{
+	control_set_setpoint(&backend, (control_mode_t)mode, CONTROL_VALUE(setpoint));
+	control_set_mode(&backend, (control_mode_t)mode);
+}
+
+/**
+ * @brief control_update() on given readings at the nominal period, the DAC write is only recorded
+ *
+ */
+float CONTROL_BACKEND_API(step)(int32_t voltage_uv, int32_t current_uv)
+{
+	backend.adc_reader.value[ADC_INPUT_VOLTAGE] = voltage_uv;
+	backend.adc_reader.value[ADC_INPUT_CURRENT] = current_uv;
+
+	control_step(&backend,
+				 CONTROL_ADC_VALUE(&backend.adc_reader, ADC_INPUT_VOLTAGE),
+				 CONTROL_ADC_VALUE(&backend.adc_reader, ADC_INPUT_CURRENT),
+				 CONTROL_VALUE(1.0f));
+	backend.dac_output = control_output(&backend);
+
+	return CONTROL_BACKEND_TO_FLOAT(backend.dac_output);
+}
+
+uint16_t CONTROL_BACKEND_API(raw)(void)
+{
+	return CONTROL_BACKEND_RAW(backend.dac_output);
+}
@@ -0,0 +1,30 @@
+#ifndef CONTROL_BACKEND_H
+#define CONTROL_BACKEND_H
+
+#include <stdint.h>
+
+/**
+ * @brief Control path built in one numeric backend, control_backend.c is compiled once per backend
+ * 	Values cross in float and raw ADC microvolts, so the two builds share no control type.
+ *
+ */
+
+#define CONTROL_BACKEND_DECLARE(backend)                                         \
+	void control_backend_##backend##_init(void);                               \
+	void control_backend_##backend##_setpoint(int mode, float setpoint);       \
+	float control_backend_##backend##_step(int32_t voltage_uv, int32_t current_uv); \
+	uint16_t control_backend_##backend##_raw(void);
+
+/**
+ * @brief Fixed point, CONTROL_FIXED_POINT
+ *
+ */
+CONTROL_BACKEND_DECLARE(fixed)
+
+/**
+ * @brief Float, the reference
+ *
+ */
+CONTROL_BACKEND_DECLARE(float)
+
+#endif // CONTROL_BACKEND_H
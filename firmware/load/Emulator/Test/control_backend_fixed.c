@@ -0,0 +1,3 @@
+/* control.c in fixed point, see control_backend.c */
+#define CONTROL_BACKEND_FIXED
+#include "control_backend.c"
@@ -0,0 +1,2 @@
+/* control.c in float, see control_backend.c */
+#include "control_backend.c"
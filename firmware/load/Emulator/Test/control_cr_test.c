@@ -0,0 +1,132 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "firmware.h"
+#include "control.h"
+#include "server.h"
+
+#include "sim.h"
+#include "plant.h"
+#include "ads1115_model.h"
+#include "mcp4725_model.h"
+
+#include "test_check.h"
+
+/**
+ * @brief Constant resistance on the emulator plant through source voltage steps
+ *
+ * Usage: control_cr_test
+ *
+ * The firmware holds a resistance setpoint through text commands while the open circuit voltage of the source steps
+ * up and down. The current must settle on the terminal voltage over the setpoint: the feed-forward follows the
+ * voltage on the next update, the trim removes what it misses on the plant. Reports the settling time and the
+ * tracking error of each step.
+ */
+
+/** Resistance setpoint, in ohms */
+#define TEST_RESISTANCE 4.0f
+
+/** Sampling of the plant, a fifth of the control period */
+#define TEST_SAMPLE_NS 1000000ULL
+
+/** Time on each source voltage, in milliseconds */
+#define TEST_STEP_MS 500U
+
+/** Time at the end of each step the tracking error is averaged on, in milliseconds */
+#define TEST_AVERAGE_MS 100U
+
+/** Band around the expected current the response settles in, relative to the step */
+#define TEST_BAND 0.02f
+
+/** Time allowed to settle, the feed-forward follows the voltage on the next update and the trim does the rest */
+#define TEST_SETTLING_MS 200.0f
+
+/** Tracking error allowed once settled, in amperes: the calibration of both inputs and their noise */
+#define TEST_TRACKING_ERROR 0.003f
+
+/** Open circuit voltages of the source, one after the other */
+static const float test_sources[] = { 12.0f, 6.0f, 18.0f, 3.0f, 12.0f, 1.5f, 9.0f };
+
+#define TEST_SOURCES_SIZE (sizeof(test_sources) / sizeof(test_sources[0]))
+
+/**
+ * @brief Source voltage steps with the resistance held
+ *
+ */
+static void test_sweep(const plant_config_t *config)
+{
+	char what[128];
+	float worst_settling_ms = 0.0f;
+	float worst_error = 0.0f;
+	float previous = 0.0f;
+
+	for (uint32_t step = 0; step < TEST_SOURCES_SIZE; step++)
+	{
+		const float source = test_sources[step];
+		/* The load in series with the source resistance */
+		const float expected = source / (TEST_RESISTANCE + config->source_resistance);
+		const float band = fabsf(expected - previous) * TEST_BAND;
+		float settling_ms = 0.0f;
+		float error_sum = 0.0f;
+
+		plant_set_source_voltage(sim_now_ns(), source);
+
+		for (uint32_t t = 1; t <= TEST_STEP_MS; t++)
+		{
+			firmware_run_ns(TEST_SAMPLE_NS);
+			const float error = plant_state()->current - expected;
+
+			if (fabsf(error) > band)
+			{
+				settling_ms = (float)t;
+			}
+			if (t > TEST_STEP_MS - TEST_AVERAGE_MS)
+			{
+				error_sum += error;
+			}
+		}
+
+		const float error = error_sum / (float)TEST_AVERAGE_MS;
+
+		printf("%5.1f V: %.3f A expected, %.3f A, settled in %3.0f ms, tracking error %+.1f mA\n", source, expected,
+			   plant_state()->current, settling_ms, error * 1e3f);
+
+		snprintf(what, sizeof(what), "%.1f V step settled in %.0f ms", source, settling_ms);
+		test_check(settling_ms <= TEST_SETTLING_MS, what);
+		snprintf(what, sizeof(what), "%.1f V step tracking error %+.1f mA", source, error * 1e3f);
+		test_check(fabsf(error) <= TEST_TRACKING_ERROR, what);
+
+		worst_settling_ms = fmaxf(worst_settling_ms, settling_ms);
+		worst_error = fmaxf(worst_error, fabsf(error));
+		previous = expected;
+	}
+
+	printf("worst: settled in %.0f ms, tracking error %.1f mA\n", worst_settling_ms, worst_error * 1e3f);
+}
+
+int main(void)
+{
+	plant_config_t plant_config;
+	char line[32];
+
+	plant_default_config(&plant_config);
+
+	sim_init_virtual();
+	plant_init(&plant_config);
+	mcp4725_model_init();
+	ads1115_model_init();
+
+	firmware_init(SERVER_ADDRESS_BROADCAST);
+
+	/* Constant resistance, load on */
+	snprintf(line, sizeof(line), "1:3:3:%lu\n", (unsigned long)(TEST_RESISTANCE * 1000.0f + 0.5f));
+	firmware_send(line);
+	firmware_send("1:2:3\n");
+	firmware_send("1:1:0:1\n");
+
+	test_sweep(&plant_config);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,218 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "firmware.h"
+#include "adc.h"
+#include "control.h"
+#include "mcp4725.h"
+#include "server.h"
+#include "scpi.h"
+
+#include "sim.h"
+#include "plant.h"
+#include "ads1115_model.h"
+#include "mcp4725_model.h"
+
+#include "control_backend.h"
+
+#include "test_check.h"
+
+/**
+ * @brief Fixed point control path against the float reference
+ *
+ * Usage: control_equivalence_test
+ *
+ * Records the ADC readings of the control loop on the emulator plant through setpoint steps in every mode, then
+ * replays them through control.c built in each backend and compares the DAC voltages and codes step by step. The
+ * calibration and the DAC conversion are swept on their own over their whole range first.
+ */
+
+/** Control periods recorded per setpoint */
+#define TEST_PERIODS 100U
+
+/** Largest difference allowed on the DAC voltage, half a code of the 12 bit DAC on 3.3 V */
+#define TEST_ACTION_TOLERANCE (3.3f / 4096.0f / 2.0f)
+
+/** Largest difference allowed on a calibrated value, in volts or amperes, the resolution of the telemetry */
+#define TEST_CALIBRATION_TOLERANCE 0.001f
+
+typedef struct
+{
+	control_mode_t mode;
+	/* Subregister of the mode in the text commands */
+	scpi_subregister_t subregister;
+	float setpoint;
+} test_step_t;
+
+/** Two steps in each mode on the 12 V source */
+static const test_step_t test_steps[] = {
+	{ CONTROL_MODE_CC, SCPI_SUBREGISTER_CC, 0.5f },
+	{ CONTROL_MODE_CC, SCPI_SUBREGISTER_CC, 2.0f },
+	{ CONTROL_MODE_CV, SCPI_SUBREGISTER_CV, 10.0f },
+	{ CONTROL_MODE_CV, SCPI_SUBREGISTER_CV, 8.0f },
+	{ CONTROL_MODE_CP, SCPI_SUBREGISTER_CP, 5.0f },
+	{ CONTROL_MODE_CP, SCPI_SUBREGISTER_CP, 15.0f },
+	{ CONTROL_MODE_CR, SCPI_SUBREGISTER_CR, 20.0f },
+	{ CONTROL_MODE_CR, SCPI_SUBREGISTER_CR, 8.0f },
+};
+
+#define TEST_STEPS_SIZE (sizeof(test_steps) / sizeof(test_steps[0]))
+
+typedef struct
+{
+	int32_t voltage_uv;
+	int32_t current_uv;
+} test_reading_t;
+
+static test_reading_t test_trace[TEST_STEPS_SIZE][TEST_PERIODS];
+
+/**
+ * @brief Calibration of the ADC inputs over their range
+ *
+ */
+static void test_calibration(void)
+{
+	adc_reader_t reader = { 0 };
+	float max_error[ADC_CHANNELS_SIZE] = { 0 };
+	char what[96];
+
+	for (int32_t uv = -100000; uv <= 2100000; uv += 997)
+	{
+		for (uint8_t channel = ADC_INPUT_VOLTAGE; channel <= ADC_INPUT_CURRENT; channel++)
+		{
+			reader.value[channel] = uv;
+
+			const float error = fabsf(adc_reader_get_value_q16(&reader, channel) / 65536.0f -
+									  adc_reader_get_value(&reader, channel));
+			max_error[channel] = fmaxf(max_error[channel], error);
+		}
+	}
+
+	for (uint8_t channel = ADC_INPUT_VOLTAGE; channel <= ADC_INPUT_CURRENT; channel++)
+	{
+		snprintf(what, sizeof(what), "calibration of channel %u off by %.6f", channel, max_error[channel]);
+		test_check(max_error[channel] <= TEST_CALIBRATION_TOLERANCE, what);
+		printf("calibration, channel %u: max error %.6f\n", channel, max_error[channel]);
+	}
+}
+
+/**
+ * @brief DAC code of a voltage over the output range
+ *
+ */
+static void test_dac(void)
+{
+	int max_error = 0;
+	char what[96];
+
+	for (float voltage = -0.1f; voltage <= 3.4f; voltage += 0.0001f)
+	{
+		const int error = abs((int)mcp4725_voltage_to_raw_q16(Q16(3.3f), Q16(voltage)) -
+							  (int)mcp4725_voltage_to_raw(3.3f, voltage));
+		max_error = error > max_error ? error : max_error;
+	}
+
+	snprintf(what, sizeof(what), "DAC codes off by %d", max_error);
+	test_check(max_error <= 1, what);
+	printf("DAC conversion: max error %d code\n", max_error);
+}
+
+/**
+ * @brief Readings of the firmware control loop through the steps, one per control period
+ *
+ */
+static void test_record(void)
+{
+	control_t *control = firmware_control();
+	const uint64_t period_ns = 1000000000ULL / CONTROL_FREQUENCY_HZ;
+	char line[SCPI_LINE_MAX];
+
+	firmware_send("1:1:0:1\n");
+
+	for (uint32_t step = 0; step < TEST_STEPS_SIZE; step++)
+	{
+		snprintf(line, sizeof(line), "1:3:%u:%lu\n", test_steps[step].subregister,
+				 (unsigned long)(test_steps[step].setpoint * 1000.0f + 0.5f));
+		firmware_send(line);
+		snprintf(line, sizeof(line), "1:2:%u\n", test_steps[step].subregister);
+		firmware_send(line);
+
+		for (uint32_t period = 0; period < TEST_PERIODS; period++)
+		{
+			firmware_run_ns(period_ns);
+			test_trace[step][period].voltage_uv = control->adc_reader.value[ADC_INPUT_VOLTAGE];
+			test_trace[step][period].current_uv = control->adc_reader.value[ADC_INPUT_CURRENT];
+		}
+
+		printf("%u: mode %u at %.3f, %.3f V %.3f A\n", step, test_steps[step].mode, test_steps[step].setpoint,
+			   plant_state()->voltage, plant_state()->current);
+	}
+
+	printf("recorded %u periods, ending at %.3f V %.3f A\n", (unsigned)(TEST_STEPS_SIZE * TEST_PERIODS),
+		   plant_state()->voltage, plant_state()->current);
+}
+
+/**
+ * @brief Both backends on the recorded readings
+ *
+ */
+static void test_replay(void)
+{
+	float max_error = 0.0f;
+	int max_raw_error = 0;
+	char what[128];
+
+	control_backend_fixed_init();
+	control_backend_float_init();
+
+	for (uint32_t step = 0; step < TEST_STEPS_SIZE; step++)
+	{
+		control_backend_fixed_setpoint(test_steps[step].mode, test_steps[step].setpoint);
+		control_backend_float_setpoint(test_steps[step].mode, test_steps[step].setpoint);
+
+		for (uint32_t period = 0; period < TEST_PERIODS; period++)
+		{
+			const test_reading_t *reading = &test_trace[step][period];
+			const float fixed = control_backend_fixed_step(reading->voltage_uv, reading->current_uv);
+			const float reference = control_backend_float_step(reading->voltage_uv, reading->current_uv);
+			const int raw_error = abs((int)control_backend_fixed_raw() - (int)control_backend_float_raw());
+
+			if (fabsf(fixed - reference) > TEST_ACTION_TOLERANCE || raw_error > 1)
+			{
+				snprintf(what, sizeof(what), "step %u period %u: %.6f V, reference %.6f V", step, period, fixed,
+						 reference);
+				test_check(0, what);
+			}
+
+			max_error = fmaxf(max_error, fabsf(fixed - reference));
+			max_raw_error = raw_error > max_raw_error ? raw_error : max_raw_error;
+		}
+	}
+
+	printf("control path: max error %.6f V, %d code\n", max_error, max_raw_error);
+}
+
+int main(void)
+{
+	plant_config_t plant_config;
+
+	plant_default_config(&plant_config);
+	/* A soft source, so the constant voltage steps are within reach */
+	plant_config.source_resistance = 1.0f;
+
+	sim_init_virtual();
+	plant_init(&plant_config);
+	mcp4725_model_init();
+	ads1115_model_init();
+
+	firmware_init(SERVER_ADDRESS_BROADCAST);
+
+	test_calibration();
+	test_dac();
+	test_record();
+	test_replay();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,197 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "firmware.h"
+#include "control.h"
+#include "server.h"
+
+#include "sim.h"
+#include "plant.h"
+#include "ads1115_model.h"
+#include "mcp4725_model.h"
+
+#include "test_check.h"
+
+/**
+ * @brief Control loop on the emulator plant
+ *
+ * Usage: control_loop_test
+ *
+ * The firmware drives the plant model through text commands on the virtual clock. Checks the settling time and the
+ * overshoot of a constant current step, that the loop recovers as fast from a step taken after it sat in saturation
+ * (the source cannot deliver the setpoint) as from a plain one, and that the loop skips few updates for the I2C bus.
+ */
+
+/** Sampling of the plant, a fifth of the control period */
+#define TEST_SAMPLE_NS 1000000ULL
+
+/** Band around the setpoint the response settles in */
+#define TEST_BAND 0.02f
+
+/** Time allowed to settle, the feed-forward takes the current most of the way and the trim integrates the rest */
+#define TEST_SETTLING_MS 200.0f
+
+/** Excursion past the setpoint allowed, relative to the step: the error of the feed-forward on the plant */
+#define TEST_OVERSHOOT 0.15f
+
+/**
+ * Time allowed to settle after saturation. The trim is held at its output boundary, 0.3 V, and unwinds from there;
+ * an integrator left to wind up for the second in saturation would hold volts and take seconds.
+ */
+#define TEST_RECOVERY_MS 500.0f
+
+/** Output boundary of the constant current trim */
+#define TEST_TRIM_MAX 0.3f
+
+typedef struct
+{
+	/* Time to enter the band for good, in milliseconds */
+	float settling_ms;
+	/* Largest excursion past the setpoint, relative to the step */
+	float overshoot;
+} test_response_t;
+
+static void test_set_current(float current)
+{
+	char line[32];
+
+	snprintf(line, sizeof(line), "1:3:1:%lu\n", (unsigned long)(current * 1000.0f + 0.5f));
+	firmware_send(line);
+}
+
+/**
+ * @brief Response of the plant current to a setpoint step
+ *
+ * @param from Current before the step, as reached
+ * @param to Setpoint
+ * @param duration_ms Observation time
+ */
+static test_response_t test_step(float from, float to, uint32_t duration_ms)
+{
+	test_response_t response = { 0.0f, 0.0f };
+	const float band = fabsf(to - from) * TEST_BAND;
+	const float direction = to > from ? 1.0f : -1.0f;
+
+	test_set_current(to);
+
+	/* The command took FIRMWARE_COMMAND_NS to go through */
+	const float start_ms = (float)FIRMWARE_COMMAND_NS / 1e6f;
+	response.settling_ms = start_ms;
+
+	for (uint32_t t = 1; t <= duration_ms; t++)
+	{
+		firmware_run_ns(TEST_SAMPLE_NS);
+		const float current = plant_state()->current;
+
+		if (fabsf(current - to) > band)
+		{
+			response.settling_ms = start_ms + (float)t;
+		}
+		response.overshoot = fmaxf(response.overshoot, direction * (current - to) / fabsf(to - from));
+	}
+
+	return response;
+}
+
+/**
+ * @brief Constant current step, from 0.5 A to 2 A
+ *
+ */
+static void test_step_response(void)
+{
+	char what[96];
+
+	test_set_current(0.5f);
+	firmware_run_ns(200000000ULL);
+
+	const test_response_t response = test_step(0.5f, 2.0f, 600U);
+
+	printf("step: settled in %.0f ms, overshoot %.1f %%\n", response.settling_ms, response.overshoot * 100.0f);
+
+	snprintf(what, sizeof(what), "step settled in %.0f ms", response.settling_ms);
+	test_check(response.settling_ms <= TEST_SETTLING_MS, what);
+	snprintf(what, sizeof(what), "step overshoot %.1f %%", response.overshoot * 100.0f);
+	test_check(response.overshoot <= TEST_OVERSHOOT, what);
+}
+
+/**
+ * @brief Same step after the loop sat in saturation, the source is limited to 5 A
+ *
+ */
+static void test_windup_recovery(void)
+{
+	char what[96];
+
+	test_set_current(0.5f);
+	firmware_run_ns(200000000ULL);
+
+	/* Saturated for a second, an unbounded integrator would wind up for all of it */
+	test_set_current(8.0f);
+	firmware_run_ns(1000000000ULL);
+	const float saturated = plant_state()->current;
+	const float trim = (float)firmware_control()->io[CONTROL_MODE_CC].control_action / (float)CONTROL_ACTION(1.0f);
+	test_check(saturated < 5.5f, "source limits the current");
+
+	snprintf(what, sizeof(what), "trim at %.3f V in saturation", trim);
+	test_check(trim <= TEST_TRIM_MAX + 0.001f, what);
+
+	const test_response_t response = test_step(saturated, 2.0f, 600U);
+
+	printf("recovery from %.2f A, trim at %.3f V: settled in %.0f ms, undershoot %.1f %%\n", saturated, trim,
+		   response.settling_ms, response.overshoot * 100.0f);
+
+	snprintf(what, sizeof(what), "recovery settled in %.0f ms", response.settling_ms);
+	test_check(response.settling_ms <= TEST_RECOVERY_MS, what);
+	snprintf(what, sizeof(what), "recovery undershoot %.1f %%", response.overshoot * 100.0f);
+	test_check(response.overshoot <= TEST_OVERSHOOT, what);
+}
+
+/**
+ * @brief Updates skipped because the ADC engine held the I2C bus
+ *
+ */
+static void test_skipped(void)
+{
+	control_stats_t stats;
+	char what[96];
+
+	control_reset_stats(firmware_control());
+	firmware_run_ns(1000000000ULL);
+	control_get_stats(firmware_control(), &stats);
+
+	const float ratio = (float)stats.skipped / (float)(stats.count + stats.skipped);
+
+	printf("%u updates, %u skipped (%.1f %%), period %u to %u cycles\n", stats.count, stats.skipped, ratio * 100.0f,
+		   stats.period_min, stats.period_max);
+
+	snprintf(what, sizeof(what), "%.1f %% of the updates skipped", ratio * 100.0f);
+	test_check(ratio <= 0.25f, what);
+	test_check(stats.period_max <= 2U * (SystemCoreClock / CONTROL_FREQUENCY_HZ) + SystemCoreClock / 10000U,
+			   "never two updates skipped in a row");
+}
+
+int main(void)
+{
+	plant_config_t plant_config;
+
+	plant_default_config(&plant_config);
+
+	sim_init_virtual();
+	plant_init(&plant_config);
+	mcp4725_model_init();
+	ads1115_model_init();
+
+	firmware_init(SERVER_ADDRESS_BROADCAST);
+
+	/* Constant current, load on */
+	firmware_send("1:2:1\n");
+	firmware_send("1:1:0:1\n");
+
+	test_step_response();
+	test_windup_recovery();
+	test_skipped();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
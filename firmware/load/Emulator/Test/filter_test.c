@@ -0,0 +1,189 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+
+/**
+ * @brief Fixed point filters against the golden vectors of tests/adc
+ *
+ * Usage: filter_test GOLDEN_CSV
+ *
+ * Each line of the file is a captured ADC sample in microvolts and the output of the floating point reference for one
+ * filter configuration, as tests/adc/filter_golden.py exports them. The samples run through the same configuration of
+ * filter.c in order, every output must be within the rounding the fixed point stages allow.
+ */
+
+#define TEST_LINE_SIZE 96U
+
+typedef struct
+{
+	filter_type_t type;
+	/* Length of a boxcar or median, Q15 factor of an IIR */
+	int32_t parameter;
+} test_stage_t;
+
+typedef struct
+{
+	const char *name;
+	test_stage_t stages[FILTER_STAGES_SIZE];
+	uint8_t size;
+	/* Error allowed, in microvolts: truncated divisions of the boxcar and of the IIR state */
+	double tolerance;
+} test_config_t;
+
+/** Configurations of filter_golden.py */
+static const test_config_t test_configs[] = {
+	{ "boxcar4", { { FILTER_BOXCAR, 4 } }, 1, 1.0 },
+	{ "boxcar16", { { FILTER_BOXCAR, 16 } }, 1, 1.0 },
+	{ "iir8", { { FILTER_IIR, FILTER_Q15(1.0f / 8.0f) } }, 1, 2.0 },
+	{ "iir64", { { FILTER_IIR, FILTER_Q15(1.0f / 64.0f) } }, 1, 2.0 },
+	{ "median3", { { FILTER_MEDIAN, 3 } }, 1, 0.0 },
+	{ "median5", { { FILTER_MEDIAN, 5 } }, 1, 0.0 },
+	{ "cascade", { { FILTER_MEDIAN, 5 }, { FILTER_BOXCAR, 8 }, { FILTER_IIR, FILTER_Q15(1.0f / 4.0f) } }, 3, 3.0 },
+};
+
+#define TEST_CONFIGS_SIZE (sizeof(test_configs) / sizeof(test_configs[0]))
+
+typedef struct
+{
+	filter_t filter;
+	uint32_t samples;
+	double max_error;
+} test_state_t;
+
+static const test_config_t *test_find(const char *name, size_t *index)
+{
+	for (size_t i = 0; i < TEST_CONFIGS_SIZE; i++)
+	{
+		if (strcmp(test_configs[i].name, name) == 0)
+		{
+			*index = i;
+			return &test_configs[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int test_setup(filter_t *filter, const test_config_t *config)
+{
+	filter_init(filter);
+
+	for (uint8_t i = 0; i < config->size; i++)
+	{
+		const test_stage_t *stage = &config->stages[i];
+		HAL_StatusTypeDef status = HAL_ERROR;
+
+		switch (stage->type)
+		{
+		case FILTER_BOXCAR:
+			status = filter_add_boxcar(filter, (uint8_t)stage->parameter);
+			break;
+		case FILTER_IIR:
+			status = filter_add_iir(filter, (int16_t)stage->parameter);
+			break;
+		case FILTER_MEDIAN:
+			status = filter_add_median(filter, (uint8_t)stage->parameter);
+			break;
+		}
+
+		if (status != HAL_OK)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	test_state_t states[TEST_CONFIGS_SIZE];
+	char line[TEST_LINE_SIZE];
+	int failures = 0;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: %s GOLDEN_CSV\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *file = fopen(argv[1], "r");
+	if (!file)
+	{
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < TEST_CONFIGS_SIZE; i++)
+	{
+		if (test_setup(&states[i].filter, &test_configs[i]) != 0)
+		{
+			fprintf(stderr, "FAIL: %s cannot be set up\n", test_configs[i].name);
+			return EXIT_FAILURE;
+		}
+		states[i].samples = 0;
+		states[i].max_error = 0.0;
+	}
+
+	/* Header */
+	if (!fgets(line, sizeof(line), file))
+	{
+		fprintf(stderr, "FAIL: %s is empty\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	while (fgets(line, sizeof(line), file))
+	{
+		char name[32];
+		long input;
+		double expected;
+		size_t index;
+
+		if (sscanf(line, "%31[^,],%ld,%lf", name, &input, &expected) != 3)
+		{
+			fprintf(stderr, "FAIL: malformed line %s", line);
+			failures++;
+			continue;
+		}
+
+		const test_config_t *config = test_find(name, &index);
+		if (!config)
+		{
+			fprintf(stderr, "FAIL: unknown filter %s\n", name);
+			failures++;
+			continue;
+		}
+
+		test_state_t *state = &states[index];
+		const int32_t output = filter_process(&state->filter, (int32_t)input);
+		const double error = fabs((double)output - expected);
+
+		if (error > config->tolerance + 0.001)
+		{
+			fprintf(stderr, "FAIL: %s sample %u: %d uV, expected %.3f uV\n", name, state->samples, output, expected);
+			failures++;
+		}
+
+		state->max_error = error > state->max_error ? error : state->max_error;
+		state->samples++;
+	}
+
+	fclose(file);
+
+	for (size_t i = 0; i < TEST_CONFIGS_SIZE; i++)
+	{
+		printf("%-9s %4u samples, max error %.3f uV\n", test_configs[i].name, states[i].samples, states[i].max_error);
+
+		if (states[i].samples == 0U)
+		{
+			fprintf(stderr, "FAIL: no golden vector for %s\n", test_configs[i].name);
+			failures++;
+		}
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,140 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sample_ring.h"
+
+/**
+ * @brief Sample ring with a producer and concurrent readers
+ *
+ * Usage: sample_ring_test [samples]
+ *
+ * A thread pushes numbered samples as fast as it can, as the ADC interrupt would, while two threads drain the ring
+ * through their own reader in batches of varying size. Every sample read must be one that was pushed, whole, in
+ * order, and each reader must account for every sample either as read or as an overrun.
+ */
+
+#define TEST_SAMPLES 4000000U
+#define TEST_READERS 2U
+
+typedef struct
+{
+	sample_reader_t reader;
+	/* Samples read */
+	uint32_t count;
+	/* Samples read that were torn or out of order */
+	uint32_t errors;
+	/* Samples skipped between two samples read */
+	uint32_t skipped;
+	/* Timestamp of the next sample due */
+	uint32_t next;
+} test_reader_t;
+
+static sample_ring_t ring;
+static volatile int producing;
+static uint32_t samples_total = TEST_SAMPLES;
+
+/**
+ * @brief Value pushed with a timestamp, a sample mixing two pushes does not match
+ *
+ */
+static int32_t test_value(uint32_t timestamp)
+{
+	return (int32_t)(timestamp * 2654435761U);
+}
+
+static void *test_producer(void *arg)
+{
+	for (uint32_t i = 0; i < samples_total; i++)
+	{
+		sample_ring_push(&ring, i, test_value(i));
+	}
+
+	__atomic_store_n(&producing, 0, __ATOMIC_SEQ_CST);
+
+	return NULL;
+}
+
+static void *test_consumer(void *arg)
+{
+	test_reader_t *test = arg;
+	sample_t samples[SAMPLE_RING_SIZE];
+	uint32_t batch = 1U;
+	int done = 0;
+	uint32_t count = 0;
+
+	/* The producer is seen done before the reads that drain whatever it pushed */
+	while (!done || count != 0U)
+	{
+		done = done || !__atomic_load_n(&producing, __ATOMIC_SEQ_CST);
+
+		count = sample_reader_read(&test->reader, samples, batch);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (samples[i].timestamp < test->next || samples[i].value != test_value(samples[i].timestamp))
+			{
+				test->errors++;
+				continue;
+			}
+			test->skipped += samples[i].timestamp - test->next;
+			test->next = samples[i].timestamp + 1U;
+		}
+
+		test->count += count;
+		batch = batch % SAMPLE_RING_SIZE + 1U;
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t producer;
+	pthread_t consumers[TEST_READERS];
+	test_reader_t readers[TEST_READERS] = { 0 };
+	int failures = 0;
+
+	if (argc > 1)
+	{
+		samples_total = (uint32_t)strtoul(argv[1], NULL, 0);
+	}
+
+	sample_ring_init(&ring);
+	producing = 1;
+
+	for (uint32_t i = 0; i < TEST_READERS; i++)
+	{
+		sample_reader_init(&readers[i].reader, &ring);
+		pthread_create(&consumers[i], NULL, test_consumer, &readers[i]);
+	}
+	pthread_create(&producer, NULL, test_producer, NULL);
+
+	pthread_join(producer, NULL);
+	for (uint32_t i = 0; i < TEST_READERS; i++)
+	{
+		pthread_join(consumers[i], NULL);
+	}
+
+	for (uint32_t i = 0; i < TEST_READERS; i++)
+	{
+		const test_reader_t *test = &readers[i];
+
+		printf("reader %u: %u read, %u overruns, %u errors\n", i, test->count, test->reader.overruns, test->errors);
+
+		if (test->errors != 0U)
+		{
+			fprintf(stderr, "FAIL: reader %u got %u torn or out of order samples\n", i, test->errors);
+			failures++;
+		}
+		if (test->count + test->reader.overruns != samples_total || test->skipped != test->reader.overruns ||
+			test->next != samples_total)
+		{
+			fprintf(stderr, "FAIL: reader %u did not account for every sample\n", i);
+			failures++;
+		}
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scpi.h"
+
+/**
+ * @brief Text commands parsed as a stream, against the whole line parser
+ *
+ * Usage: scpi_stream_test
+ *
+ * The whole line parser is checked against the expected answers first. Then every line of the corpus, and the corpus
+ * as one stream, is fed one byte at a time and in two chunks cut at every possible point. Each feed must give the
+ * answers of the whole line parser: the stream keeps the cut token and the tree position on its own.
+ */
+
+/** Longest output of the corpus, one answer per line */
+#define TEST_OUTPUT_MAX 2048U
+
+typedef struct test_line
+{
+  const char *line;     /**< Command, with its line ending */
+  const char *answer;   /**< Expected answer, "" for an applied set, NULL for a rejected command */
+} test_line_t;
+
+static const test_line_t test_corpus[] = {
+  { "0:0:0\n", "Simple Electronic Load,Test\n" },
+  { "0:1:0\r\n", "0\n" },
+  { "1:2:2\n", "" },
+  { "0:2:0\r", "CV\n" },
+  { "1:3:1:1500\n", "" },
+  { "0:3:1\n", "1500\n" },
+  { "0x1:0x3:0x4:0x61A8\n", "" },
+  { "0:3:4\n", "25000\n" },
+  { "1:1:0:1\n", "" },
+  { "0:4:0\n", "1,CV,1500,0,0,25000,1500,12000\n" },
+  { "1:1:0:2\n", NULL },
+  { "0:3:9\n", NULL },
+  { "1:3:1\n", NULL },
+  { "2:0:0\n", NULL },
+  { "0:0:0:0\n", NULL },
+  { "0::0\n", NULL },
+  { "0:0\n", NULL },
+  { "1:3:1:4294967296\n", NULL },
+  { "1:3:1:00000000000000000000000000000000001500\n", NULL },
+  { "0:1:\x01\n", NULL },
+  { "\n", NULL },
+  { "1:1:0:0\n", "" },
+  { "0:1:0\n", "0\n" },
+};
+
+#define TEST_LINES (sizeof(test_corpus) / sizeof(test_corpus[0]))
+
+static const load_measurement_t test_measurement = { 1500U, 12000U, 8000U, 18000U, 2500U };
+static load_control_t test_control;
+
+/** What a feed produced, one entry per complete command */
+static char test_output[TEST_OUTPUT_MAX];
+static uint32_t test_output_length;
+
+static void test_get_control(load_control_t *control)
+{
+  *control = test_control;
+}
+
+static void test_get_measurement(load_measurement_t *measurement)
+{
+  *measurement = test_measurement;
+}
+
+static int test_set(const load_command_t *command)
+{
+  set_point_t *set_points = &test_control.cc;
+
+  switch (command->key) {
+    case COMMAND_ENABLE:
+      if (command->value > 1U) {
+        return -1;
+      }
+      test_control.enable = command->value;
+      return 0;
+    case COMMAND_MODE:
+      test_control.mode = (load_mode_t)command->value;
+      return 0;
+    default:
+      set_points[command->key - COMMAND_CC].value_milli = command->value;
+      return 0;
+  }
+}
+
+static const scpi_target_t test_target = {
+  .identification = "Simple Electronic Load,Test",
+  .get_control = test_get_control,
+  .get_measurement = test_get_measurement,
+  .set = test_set,
+};
+
+/**
+ * @brief Records the answer of a command, "+" for an applied set, nothing for a rejected command as the stream hands
+ * over only the complete ones.
+ *
+ * @param length Value returned by the execution
+ * @param answer Answer, when length is positive
+ */
+static void test_record(int length, const char *answer)
+{
+  const char *text = (length > 0) ? answer : "+\n";
+  const size_t size = (length > 0) ? (size_t)length : 2U;
+
+  if (length >= 0 && test_output_length + size < TEST_OUTPUT_MAX) {
+    memcpy(&test_output[test_output_length], text, size);
+    test_output_length += (uint32_t)size;
+    test_output[test_output_length] = '\0';
+  }
+}
+
+static void test_on_request(const scpi_request_t *request)
+{
+  char answer[SCPI_RESPONSE_MAX];
+  test_record(scpi_request_execute(&test_target, request, answer, sizeof(answer)), answer);
+}
+
+static void test_reset(void)
+{
+  memset(&test_control, 0, sizeof(test_control));
+  test_output_length = 0U;
+  test_output[0] = '\0';
+}
+
+/**
+ * @brief Expected output of lines, from the whole line parser.
+ *
+ * @param first First line
+ * @param count Lines
+ * @param expected Output
+ * @param size Size of expected
+ */
+static void test_expected(uint32_t first, uint32_t count, char *expected, size_t size)
+{
+  char answer[SCPI_RESPONSE_MAX];
+
+  test_reset();
+  for (uint32_t i = first; i < first + count; i++) {
+    const char *line = test_corpus[i].line;
+    const uint32_t length = (uint32_t)strcspn(line, "\r\n");
+
+    /** Line endings alone are no command to the stream */
+    if (length == 0U) {
+      continue;
+    }
+
+    test_record(scpi_execute(&test_target, line, length, answer, sizeof(answer)), answer);
+  }
+  snprintf(expected, size, "%s", test_output);
+}
+
+/**
+ * @brief Feeds a text in two chunks, then in chunks of one byte.
+ *
+ * @param text Stream
+ * @param cut Length of the first chunk, 0 for single bytes
+ * @return const char* Output
+ */
+static const char *test_feed(const char *text, uint32_t cut)
+{
+  scpi_stream_t stream;
+  const uint32_t length = (uint32_t)strlen(text);
+
+  test_reset();
+  scpi_stream_init(&stream, &test_on_request);
+
+  if (cut == 0U) {
+    for (uint32_t i = 0U; i < length; i++) {
+      scpi_stream_feed(&stream, &text[i], 1U);
+    }
+  } else {
+    /** The chunks are copied out so that nothing can read past their end */
+    char *first = malloc(cut);
+    char *second = malloc(length - cut + 1U);
+    memcpy(first, text, cut);
+    memcpy(second, &text[cut], length - cut);
+    scpi_stream_feed(&stream, first, cut);
+    scpi_stream_feed(&stream, second, length - cut);
+    free(first);
+    free(second);
+  }
+
+  return test_output;
+}
+
+/**
+ * @brief Checks a text at every cut.
+ *
+ * @param name Name in the failure messages
+ * @param text Stream
+ * @param expected Output
+ * @return int Failures
+ */
+static int test_text(const char *name, const char *text, const char *expected)
+{
+  const uint32_t length = (uint32_t)strlen(text);
+  int failures = 0;
+
+  for (uint32_t cut = 0U; cut < length; cut++) {
+    const char *output = test_feed(text, cut);
+    if (strcmp(output, expected) != 0) {
+      fprintf(stderr, "%s cut at %u: got \"%s\", expected \"%s\"\n", name, cut, output, expected);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+/**
+ * @brief Checks the whole line parser against the expected answers, the lines in order.
+ *
+ * @return int Failures
+ */
+static int test_answers(void)
+{
+  char answer[SCPI_RESPONSE_MAX];
+  int failures = 0;
+
+  test_reset();
+  for (uint32_t i = 0U; i < TEST_LINES; i++) {
+    const test_line_t *line = &test_corpus[i];
+    const uint32_t length = (uint32_t)strcspn(line->line, "\r\n");
+
+    if (length == 0U) {
+      continue;
+    }
+
+    const uint32_t start = test_output_length;
+    test_record(scpi_execute(&test_target, line->line, length, answer, sizeof(answer)), answer);
+
+    const char *expected = (line->answer == NULL) ? "" : (line->answer[0] == '\0') ? "+\n" : line->answer;
+    if (strcmp(&test_output[start], expected) != 0) {
+      fprintf(stderr, "line %u: answered \"%s\", expected \"%s\"\n", i, &test_output[start], expected);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+int main(void)
+{
+  static char corpus[TEST_OUTPUT_MAX];
+  static char expected[TEST_OUTPUT_MAX];
+  uint32_t corpus_length = 0U;
+  uint32_t cuts = 0U;
+  int failures = test_answers();
+
+  /** Each line on its own */
+  for (uint32_t i = 0U; i < TEST_LINES; i++) {
+    const char *line = test_corpus[i].line;
+    const uint32_t length = (uint32_t)strlen(line);
+
+    test_expected(i, 1U, expected, sizeof(expected));
+    failures += test_text(line, line, expected);
+    cuts += length;
+
+    memcpy(&corpus[corpus_length], line, length);
+    corpus_length += length;
+  }
+
+  /** The corpus as one stream, the settings carry over from line to line */
+  corpus[corpus_length] = '\0';
+  test_expected(0U, TEST_LINES, expected, sizeof(expected));
+  failures += test_text("corpus", corpus, expected);
+  cuts += corpus_length;
+
+  printf("%u lines, %u cuts: %s\n", (unsigned)TEST_LINES, cuts, failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "server.h"
+
+#include "test_check.h"
+
+/**
+ * @brief Frame decoder of server.c on random and damaged traffic
+ *
+ * Usage: server_fuzz_test [FRAMES]
+ *
+ * Builds a stream of frames with a valid CRC, some of random type, length and address, some of the exact size of a
+ * message, and mixes in frames cut short, frames with a byte flipped and runs of noise rich in sync bytes. The stream
+ * goes through parse_byte() and, in fragments of random size, through server_frame_find() on a ring allocated to its
+ * exact size, and every frame found goes through all the decoders of the load. Every intact frame must come out of the
+ * ring, in order and unchanged; the sanitizers the test is built with catch any read past a buffer.
+ *
+ * Then reports the throughput of the encoders and of both decoding paths on a stream of whole frames.
+ */
+
+/** Frames in the damaged stream by default */
+#define TEST_FRAMES 200000U
+
+/** Frames encoded and decoded for the throughput */
+#define TEST_BENCH_FRAMES 200000U
+
+/** Ring of the decoder, not a multiple of any frame size so that frames wrap at every offset */
+#define TEST_RING_SIZE 509U
+
+/** Longest run of noise between two frames */
+#define TEST_NOISE_MAX 24U
+
+/** Intact frames the ring may still have to find */
+#define TEST_PENDING 64U
+
+typedef enum
+{
+	TEST_INTACT = 0,
+	TEST_TRUNCATED,
+	TEST_CORRUPTED,
+	TEST_NOISE,
+} test_kind_t;
+
+typedef struct
+{
+	uint8_t bytes[SERVER_FRAME_SIZE_MAX];
+	uint32_t size;
+} test_frame_t;
+
+/** Types of the protocol, frames take one of them most of the time */
+static const uint8_t test_types[] = {
+	SERVER_MSG_CONTROL,
+	SERVER_MSG_CONTROL_DELTA,
+	SERVER_MSG_COMMAND,
+	SERVER_MSG_POLL,
+	SERVER_MSG_SYNC,
+	SERVER_MSG_MEASUREMENT,
+	SERVER_MSG_MEASUREMENT_DELTA,
+	SERVER_MSG_TELEMETRY,
+	SERVER_MSG_ACK,
+	SERVER_MSG_WAVEFORM,
+	SERVER_MSG_TELEMETRY_CONFIG,
+};
+
+#define TEST_TYPES_SIZE (sizeof(test_types) / sizeof(test_types[0]))
+
+static uint32_t test_seed = 0x2545F491U;
+
+static uint32_t test_random(void)
+{
+	/* xorshift32 */
+	test_seed ^= test_seed << 13;
+	test_seed ^= test_seed >> 17;
+	test_seed ^= test_seed << 5;
+	return test_seed;
+}
+
+static double test_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief CRC-16/CCITT-FALSE bit by bit, the reference of the nibble table of server.c
+ *
+ */
+static uint16_t test_crc16(const uint8_t *data, uint32_t size)
+{
+	uint16_t crc = 0xFFFFU;
+
+	for (uint32_t i = 0; i < size; i++)
+	{
+		crc ^= (uint16_t)(data[i] << 8);
+		for (uint8_t bit = 0; bit < 8U; bit++)
+		{
+			crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+/**
+ * @brief Payload length the decoders accept for a type, a random one otherwise
+ *
+ */
+static uint8_t test_length(uint8_t type)
+{
+	switch (type)
+	{
+	case SERVER_MSG_CONTROL:
+		return sizeof(load_control_t);
+	case SERVER_MSG_CONTROL_DELTA:
+		return (uint8_t)(sizeof(uint16_t) + (test_random() % 5U) * sizeof(uint32_t));
+	case SERVER_MSG_COMMAND:
+		return sizeof(load_command_t);
+	case SERVER_MSG_WAVEFORM:
+		return sizeof(load_waveform_t);
+	case SERVER_MSG_TELEMETRY_CONFIG:
+		return sizeof(load_telemetry_config_t);
+	default:
+		return 0U;
+	}
+}
+
+/**
+ * @brief Frame with a valid CRC, of a type of the protocol or not, addressed or not
+ *
+ */
+static void test_make_frame(test_frame_t *frame)
+{
+	uint8_t type = test_types[test_random() % TEST_TYPES_SIZE];
+	uint8_t length = (test_random() & 1U) ? test_length(type) : (uint8_t)(test_random() % (SERVER_PAYLOAD_MAX + 1U));
+
+	if ((test_random() % 8U) == 0U)
+	{
+		type = (uint8_t)test_random() & (uint8_t)~SERVER_MSG_ADDRESSED;
+	}
+
+	uint32_t header = SERVER_HEADER_SIZE;
+	frame->bytes[0] = SERVER_SYNC_BYTE;
+	frame->bytes[1] = length;
+	frame->bytes[2] = type;
+	frame->bytes[3] = (uint8_t)test_random();
+
+	if (test_random() & 1U)
+	{
+		frame->bytes[2] |= SERVER_MSG_ADDRESSED;
+		frame->bytes[header++] = (uint8_t)test_random();
+	}
+
+	for (uint32_t i = 0; i < length; i++)
+	{
+		frame->bytes[header + i] = (uint8_t)test_random();
+	}
+
+	/* Deltas mostly carry a mask that matches their length */
+	const uint32_t words = length >= sizeof(uint16_t) ? (length - sizeof(uint16_t)) / sizeof(uint32_t) : 16U;
+	if (type == SERVER_MSG_CONTROL_DELTA && words < 16U && (test_random() & 1U))
+	{
+		const uint16_t mask = (uint16_t)((1U << words) - 1U);
+		frame->bytes[header] = (uint8_t)mask;
+		frame->bytes[header + 1U] = (uint8_t)(mask >> 8);
+	}
+
+	const uint16_t crc = test_crc16(&frame->bytes[1], header - 1U + length);
+	frame->bytes[header + length] = (uint8_t)crc;
+	frame->bytes[header + length + 1U] = (uint8_t)(crc >> 8);
+	frame->size = header + length + SERVER_CRC_SIZE;
+}
+
+/**
+ * @brief Whether a frame found holds the bytes of a frame sent
+ *
+ */
+static int test_same(const server_frame_t *found, const test_frame_t *sent)
+{
+	if (server_frame_size(found) != sent->size)
+	{
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < sent->size; i++)
+	{
+		if (found->buffer[(found->start + i) % found->size] != sent->bytes[i])
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Decoders of the load on a frame found, the frame must be one a sender could have built
+ *
+ */
+static void test_decode(const server_frame_t *frame)
+{
+	static load_control_t control;
+	load_command_t command;
+	load_waveform_t waveform;
+	load_telemetry_config_t config;
+	uint8_t bytes[SERVER_FRAME_SIZE_MAX];
+
+	const uint32_t size = server_frame_size(frame);
+	if (size > SERVER_FRAME_SIZE_MAX || frame->length > SERVER_PAYLOAD_MAX || frame->payload + frame->length > size)
+	{
+		test_check(0, "frame larger than the protocol allows");
+		return;
+	}
+
+	/* The whole frame is readable and its CRC holds */
+	for (uint32_t i = 0; i < size; i++)
+	{
+		bytes[i] = frame->buffer[(frame->start + i) % frame->size];
+	}
+	const uint16_t crc = test_crc16(&bytes[1], size - 1U - SERVER_CRC_SIZE);
+	test_check(bytes[size - 2U] == (uint8_t)crc && bytes[size - 1U] == (uint8_t)(crc >> 8), "frame with a bad CRC");
+
+	(void)rx_data(frame, &control);
+	(void)rx_command(frame, &command);
+	(void)rx_waveform(frame, &waveform);
+	(void)rx_telemetry_config(frame, &config);
+	(void)server_frame_type(frame);
+}
+
+/**
+ * @brief Damaged stream through both decoding paths
+ *
+ */
+static void test_fuzz(uint32_t frames)
+{
+	uint8_t *ring = malloc(TEST_RING_SIZE);
+	test_frame_t *intact = malloc(sizeof(test_frame_t) * TEST_PENDING);
+	uint32_t intact_head = 0U;
+	uint32_t intact_tail = 0U;
+	uint32_t head = 0U;
+	uint32_t tail = 0U;
+	uint32_t emitted = 0U;
+	uint32_t matched = 0U;
+	uint32_t lost = 0U;
+	uint32_t spurious = 0U;
+	uint32_t parsed = 0U;
+	uint32_t kinds[TEST_NOISE + 1] = { 0 };
+	char what[128];
+
+	for (uint32_t f = 0; f < frames && failures == 0; f++)
+	{
+		test_frame_t frame;
+		uint8_t chunk[SERVER_FRAME_SIZE_MAX + TEST_NOISE_MAX];
+		uint32_t chunk_size = 0U;
+		const uint32_t roll = test_random() % 10U;
+		const test_kind_t kind = roll < 6U ? TEST_INTACT : roll < 7U ? TEST_TRUNCATED : roll < 8U ? TEST_CORRUPTED : TEST_NOISE;
+
+		kinds[kind]++;
+		test_make_frame(&frame);
+
+		switch (kind)
+		{
+		case TEST_INTACT:
+			memcpy(chunk, frame.bytes, frame.size);
+			chunk_size = frame.size;
+			intact[intact_tail++ % TEST_PENDING] = frame;
+			emitted++;
+			break;
+		case TEST_TRUNCATED:
+			chunk_size = 1U + test_random() % (frame.size - 1U);
+			memcpy(chunk, frame.bytes, chunk_size);
+			break;
+		case TEST_CORRUPTED:
+			memcpy(chunk, frame.bytes, frame.size);
+			chunk_size = frame.size;
+			chunk[1U + test_random() % (frame.size - 1U)] ^= (uint8_t)(1U << (test_random() % 8U));
+			break;
+		case TEST_NOISE:
+			chunk_size = 1U + test_random() % TEST_NOISE_MAX;
+			for (uint32_t i = 0; i < chunk_size; i++)
+			{
+				chunk[i] = (test_random() % 4U) == 0U ? SERVER_SYNC_BYTE : (uint8_t)test_random();
+			}
+			break;
+		}
+
+		/* Byte by byte */
+		for (uint32_t i = 0; i < chunk_size; i++)
+		{
+			const server_frame_t *found = parse_byte(chunk[i]);
+			if (found)
+			{
+				test_decode(found);
+				parsed++;
+			}
+		}
+
+		/* Into the ring in fragments, found frames consumed in place */
+		for (uint32_t i = 0; i < chunk_size;)
+		{
+			uint32_t fragment = 1U + test_random() % 32U;
+			const uint32_t space = (head + TEST_RING_SIZE - tail - 1U) % TEST_RING_SIZE;
+			fragment = fragment > chunk_size - i ? chunk_size - i : fragment;
+			fragment = fragment > space ? space : fragment;
+
+			for (uint32_t j = 0; j < fragment; j++)
+			{
+				ring[tail] = chunk[i + j];
+				tail = (tail + 1U) % TEST_RING_SIZE;
+			}
+			i += fragment;
+
+			server_frame_t found;
+			while (server_frame_find(ring, TEST_RING_SIZE, &head, tail, &found))
+			{
+				test_decode(&found);
+
+				/* Intact frames come out in order, those skipped are lost */
+				uint32_t pending = intact_head;
+				while (pending != intact_tail && !test_same(&found, &intact[pending % TEST_PENDING]))
+				{
+					pending++;
+				}
+
+				if (pending != intact_tail)
+				{
+					lost += pending - intact_head;
+					matched++;
+					intact_head = pending + 1U;
+				}
+				else
+				{
+					spurious++;
+				}
+			}
+
+			/* Any frame fits the ring, a full one always holds a frame or a byte to skip */
+			if (fragment == 0U)
+			{
+				test_check(0, "ring full without a frame");
+				break;
+			}
+		}
+
+		if (intact_tail - intact_head >= TEST_PENDING)
+		{
+			lost += intact_tail - intact_head - TEST_PENDING + 1U;
+			intact_head = intact_tail - TEST_PENDING + 1U;
+		}
+	}
+
+	printf("fuzz: %u intact, %u truncated, %u corrupted, %u runs of noise\n", kinds[TEST_INTACT],
+		   kinds[TEST_TRUNCATED], kinds[TEST_CORRUPTED], kinds[TEST_NOISE]);
+	printf("fuzz: ring found %u of %u intact frames, lost %u, found %u others; parse_byte found %u\n", matched, emitted,
+		   lost, spurious, parsed);
+
+	/* Only a false sync whose CRC happens to hold, 1 in 65536, can hide the intact frames it spans; the last ones may
+	   still wait on a false sync for more bytes */
+	snprintf(what, sizeof(what), "%u intact frames lost in the ring", lost);
+	test_check(lost <= emitted / 1000U, what);
+	test_check(emitted - matched - lost <= 2U, "intact frames left in the ring");
+
+	free(intact);
+	free(ring);
+}
+
+/**
+ * @brief Throughput of the encoders and of both decoding paths
+ *
+ */
+static void test_throughput(uint32_t frames)
+{
+	uint8_t *stream = malloc((size_t)frames * SERVER_FRAME_SIZE_MAX);
+	uint8_t *ring = malloc(TEST_RING_SIZE);
+	load_measurement_t measurement = { 0 };
+	load_telemetry_t telemetry = { .mode = TELEMETRY_FILTERED, .count = TELEMETRY_BATCH_MAX, .decimation = 1U };
+	load_ack_t ack = { 0 };
+	size_t size = 0U;
+	char what[96];
+
+	double start = test_now();
+	for (uint32_t f = 0; f < frames; f++)
+	{
+		switch (f % 3U)
+		{
+		case 0:
+			measurement.cv_milli = test_random() % 30000U;
+			size += tx_data(&measurement, &stream[size]);
+			break;
+		case 1:
+			telemetry.samples[f % TELEMETRY_BATCH_MAX].voltage_milli = f;
+			size += tx_telemetry(&telemetry, &stream[size]);
+			break;
+		default:
+			ack.id = (uint16_t)f;
+			size += tx_ack(&ack, &stream[size]);
+			break;
+		}
+	}
+	const double encode = test_now() - start;
+
+	/* Out of whatever frame the damaged stream left the parser in */
+	while (!parse_idle())
+	{
+		parse_byte(0U);
+	}
+
+	uint32_t parsed = 0U;
+	start = test_now();
+	for (size_t i = 0; i < size; i++)
+	{
+		parsed += parse_byte(stream[i]) != NULL;
+	}
+	const double parse = test_now() - start;
+
+	uint32_t found_count = 0U;
+	uint32_t head = 0U;
+	uint32_t tail = 0U;
+	server_frame_t found;
+	start = test_now();
+	for (size_t i = 0; i < size;)
+	{
+		while (i < size && (tail + 1U) % TEST_RING_SIZE != head)
+		{
+			ring[tail] = stream[i++];
+			tail = (tail + 1U) % TEST_RING_SIZE;
+		}
+		while (server_frame_find(ring, TEST_RING_SIZE, &head, tail, &found))
+		{
+			found_count++;
+		}
+	}
+	const double find = test_now() - start;
+
+	const double mbytes = (double)size / 1e6;
+	printf("throughput: %u frames, %.1f MB: encode %.1f MB/s, parse_byte %.1f MB/s, ring %.1f MB/s\n", frames, mbytes,
+		   mbytes / encode, mbytes / parse, mbytes / find);
+
+	snprintf(what, sizeof(what), "parse_byte found %u of %u frames", parsed, frames);
+	test_check(parsed == frames, what);
+	snprintf(what, sizeof(what), "ring found %u of %u frames", found_count, frames);
+	test_check(found_count == frames, what);
+
+	free(ring);
+	free(stream);
+}
+
+int main(int argc, char **argv)
+{
+	const uint32_t frames = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : TEST_FRAMES;
+
+	test_fuzz(frames);
+	test_throughput(TEST_BENCH_FRAMES);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
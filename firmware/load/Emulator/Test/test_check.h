@@ -0,0 +1,33 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+
+/**
+ * @brief Checks of the host tests, each test is a single translation unit including this once
+ * 	A failed check is reported and counted, the test goes on so that one run shows every failure.
+ *
+ */
+
+/**
+ * @brief Checks failed so far, the test passes while it is 0
+ *
+ */
+static int failures;
+
+/**
+ * @brief Report and count a failed check
+ *
+ * @param condition Check, 0 when it failed
+ * @param what What was checked
+ */
+static inline void test_check(int condition, const char *what)
+{
+	if (!condition)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+#endif // TEST_CHECK_H
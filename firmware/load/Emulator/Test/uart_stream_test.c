@@ -0,0 +1,366 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "firmware.h"
+#include "server.h"
+#include "uart.h"
+
+#include "sim.h"
+#include "hal_sim.h"
+#include "plant.h"
+#include "ads1115_model.h"
+#include "mcp4725_model.h"
+
+#include "test_check.h"
+
+/**
+ * @brief Frame reception of uart.c on the emulator, through noise and fragmentation
+ *
+ * Usage: uart_stream_test [COMMANDS]
+ *
+ * Sends commands to the firmware one at a time, each after a run of noise rich in sync bytes, some after a false sync
+ * announcing a long frame and some after a copy of the command with a byte flipped. The bytes reach the RX ring in
+ * fragments of random size, so frames wrap around the ring and straddle the half, full and idle events. The line then
+ * stays silent: every command must be acknowledged within a few control periods with the value it set, and no damaged
+ * copy may be acknowledged. A receiver that waits for the bytes a false sync announces stalls here.
+ *
+ * Then sends whole control settings followed by deltas, each delta after noise ending in a false sync. Every delta
+ * must be applied: a receiver whose look-ahead past the false sync takes the frame it finds sees that frame again out
+ * of sequence, and drops the deltas until the next whole settings.
+ */
+
+/** Commands sent by default */
+#define TEST_COMMANDS 2000U
+
+/** Control deltas sent after the commands, each after a false sync */
+#define TEST_DELTAS 200U
+
+/** Longest run of noise before a command */
+#define TEST_NOISE_MAX 24U
+
+/** Largest fragment handed to the UART at once */
+#define TEST_FRAGMENT_MAX 48U
+
+/** Longest gap between two fragments, in nanoseconds */
+#define TEST_GAP_NS 300000U
+
+/** Time allowed for the acknowledgement once the command is on the wire, the loop takes it on its next period */
+#define TEST_ACK_MS 20U
+
+/** Identifiers of the damaged copies, never acknowledged */
+#define TEST_DAMAGED_ID 0x8000U
+
+/** Noise, damaged copy and command */
+#define TEST_STREAM_SIZE (TEST_NOISE_MAX + 2U + 2U * SERVER_FRAME_SIZE_MAX)
+
+static uint32_t test_seed = 0x2545F491U;
+/** Host end of the link, the firmware transmits to it */
+static int test_host = -1;
+
+static uint32_t test_random(void)
+{
+	/* xorshift32 */
+	test_seed ^= test_seed << 13;
+	test_seed ^= test_seed >> 17;
+	test_seed ^= test_seed << 5;
+	return test_seed;
+}
+
+/**
+ * @brief CRC-16/CCITT-FALSE bit by bit, independent of the table of server.c
+ *
+ */
+static uint16_t test_crc16(const uint8_t *data, uint32_t size)
+{
+	uint16_t crc = 0xFFFFU;
+
+	for (uint32_t i = 0; i < size; i++)
+	{
+		crc ^= (uint16_t)(data[i] << 8);
+		for (uint8_t bit = 0; bit < 8U; bit++)
+		{
+			crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+/**
+ * @brief Plain frame as the panel sends it, the encoders are only built on the panel side
+ *
+ * @return uint32_t Frame size
+ */
+static uint32_t test_frame(server_msg_type_t type, uint8_t seq, const void *payload, uint8_t length, uint8_t *frame)
+{
+	frame[0] = SERVER_SYNC_BYTE;
+	frame[1] = length;
+	frame[2] = (uint8_t)type;
+	frame[3] = seq;
+	memcpy(&frame[SERVER_HEADER_SIZE], payload, length);
+
+	const uint32_t crc_offset = SERVER_HEADER_SIZE + length;
+	const uint16_t crc = test_crc16(&frame[1], crc_offset - 1U);
+	frame[crc_offset] = (uint8_t)crc;
+	frame[crc_offset + 1U] = (uint8_t)(crc >> 8);
+
+	return crc_offset + SERVER_CRC_SIZE;
+}
+
+static uint32_t test_command_frame(const load_command_t *command, uint8_t seq, uint8_t *frame)
+{
+	return test_frame(SERVER_MSG_COMMAND, seq, command, (uint8_t)sizeof(load_command_t), frame);
+}
+
+/**
+ * @brief Control delta setting the constant current, the word mask comes first
+ *
+ * @return uint32_t Frame size
+ */
+static uint32_t test_delta_frame(uint32_t cc_milli, uint8_t seq, uint8_t *frame)
+{
+	const uint32_t word = offsetof(load_control_t, cc.value_milli) / sizeof(uint32_t);
+	uint8_t payload[sizeof(uint16_t) + sizeof(uint32_t)];
+
+	payload[0] = (uint8_t)(1U << word);
+	payload[1] = (uint8_t)((1U << word) >> 8);
+	memcpy(&payload[sizeof(uint16_t)], &cc_milli, sizeof(uint32_t));
+
+	return test_frame(SERVER_MSG_CONTROL_DELTA, seq, payload, (uint8_t)sizeof(payload), frame);
+}
+
+/**
+ * @brief Noise before a frame, may end with a sync byte and a length that fits a frame
+ *
+ * @param false_sync Non zero to always end with one
+ * @return uint32_t Bytes written
+ */
+static uint32_t test_noise(uint8_t *stream, int false_sync)
+{
+	uint32_t size = test_random() % (TEST_NOISE_MAX + 1U);
+
+	for (uint32_t i = 0; i < size; i++)
+	{
+		stream[i] = (test_random() % 4U == 0U) ? SERVER_SYNC_BYTE : (uint8_t)test_random();
+	}
+
+	/* A false sync announcing a frame longer than anything sent after it */
+	if (false_sync || test_random() % 4U == 0U)
+	{
+		stream[size++] = SERVER_SYNC_BYTE;
+		stream[size++] = (uint8_t)(SERVER_PAYLOAD_MAX / 2U + test_random() % (SERVER_PAYLOAD_MAX / 2U + 1U));
+	}
+
+	return size;
+}
+
+/**
+ * @brief Hand the stream to the UART in fragments, the firmware runs in between
+ *
+ */
+static void test_send(const uint8_t *stream, uint32_t size)
+{
+	uint32_t sent = 0U;
+
+	while (sent < size)
+	{
+		uint32_t fragment = 1U + test_random() % TEST_FRAGMENT_MAX;
+		if (fragment > size - sent)
+		{
+			fragment = size - sent;
+		}
+
+		hal_sim_uart_inject(&stream[sent], fragment);
+		sent += fragment;
+		firmware_run_ns(test_random() % TEST_GAP_NS);
+	}
+}
+
+/**
+ * @brief Acknowledgements among the frames the firmware sent since the last call
+ *
+ * @param id Identifier of the command waited for
+ * @param ack Its acknowledgement
+ * @return int 1 once it arrived
+ */
+static int test_receive(uint16_t id, load_ack_t *ack)
+{
+	uint8_t data[256];
+	char what[96];
+	int found = 0;
+	ssize_t size;
+
+	while ((size = read(test_host, data, sizeof(data))) > 0)
+	{
+		for (ssize_t i = 0; i < size; i++)
+		{
+			const server_frame_t *frame = parse_byte(data[i]);
+			load_ack_t received;
+
+			if (frame == NULL || server_frame_type(frame) != SERVER_MSG_ACK || frame->length != sizeof(load_ack_t))
+			{
+				continue;
+			}
+
+			/* parse_byte() holds the frame whole in its buffer */
+			memcpy(&received, &frame->buffer[frame->start + frame->payload], sizeof(load_ack_t));
+
+			snprintf(what, sizeof(what), "acknowledgement of damaged command %u", received.id & ~TEST_DAMAGED_ID);
+			test_check((received.id & TEST_DAMAGED_ID) == 0U, what);
+
+			if (received.id == id)
+			{
+				*ack = received;
+				found = 1;
+			}
+		}
+	}
+
+	return found;
+}
+
+int main(int argc, char **argv)
+{
+	const uint32_t commands = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : TEST_COMMANDS;
+	plant_config_t plant_config;
+	static uint8_t stream[TEST_STREAM_SIZE];
+	uint8_t frame[SERVER_FRAME_SIZE_MAX];
+	char what[96];
+	int link[2];
+	uint32_t acknowledged = 0U;
+	uint32_t damaged = 0U;
+	uint32_t false_syncs = 0U;
+	uint32_t worst_ms = 0U;
+
+	plant_default_config(&plant_config);
+
+	sim_init_virtual();
+	plant_init(&plant_config);
+	mcp4725_model_init();
+	ads1115_model_init();
+
+	firmware_init(SERVER_ADDRESS_BROADCAST);
+
+	/* The transmitted frames are read back on the other end, the commands are injected */
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, link) < 0)
+	{
+		perror("socketpair");
+		return EXIT_FAILURE;
+	}
+	fcntl(link[0], F_SETFL, O_NONBLOCK);
+	fcntl(link[1], F_SETFL, O_NONBLOCK);
+	hal_sim_uart_attach(&huart1, link[0]);
+	test_host = link[1];
+
+	for (uint32_t i = 0; i < commands; i++)
+	{
+		const load_command_t command = {
+			.id = (uint16_t)(i % TEST_DAMAGED_ID),
+			.key = COMMAND_CC,
+			.flags = 0U,
+			.value = 100U + test_random() % 1000U,
+		};
+		uint32_t size = test_noise(stream, 0);
+		load_ack_t ack;
+
+		false_syncs += (size >= 2U && stream[size - 2U] == SERVER_SYNC_BYTE) ? 1U : 0U;
+
+		/* A copy with a byte flipped, its CRC no longer matches */
+		if (test_random() % 4U == 0U)
+		{
+			load_command_t copy = command;
+			copy.id |= TEST_DAMAGED_ID;
+
+			const uint32_t length = test_command_frame(&copy, (uint8_t)i, frame);
+			frame[1U + test_random() % (length - 1U)] ^= (uint8_t)(1U + test_random() % 255U);
+			memcpy(&stream[size], frame, length);
+			size += length;
+			damaged++;
+		}
+
+		const uint32_t length = test_command_frame(&command, (uint8_t)i, frame);
+		memcpy(&stream[size], frame, length);
+		size += length;
+
+		test_send(stream, size);
+
+		/* Nothing else comes, the frame must be taken on what the ring holds */
+		uint32_t elapsed_ms = 0U;
+		int found = test_receive(command.id, &ack);
+		while (!found && elapsed_ms < TEST_ACK_MS)
+		{
+			firmware_run_ns(1000000ULL);
+			elapsed_ms++;
+			found = test_receive(command.id, &ack);
+		}
+
+		snprintf(what, sizeof(what), "command %u acknowledged within %u ms", (unsigned)i, TEST_ACK_MS);
+		test_check(found, what);
+		if (!found)
+		{
+			continue;
+		}
+
+		acknowledged++;
+		worst_ms = (elapsed_ms > worst_ms) ? elapsed_ms : worst_ms;
+
+		snprintf(what, sizeof(what), "command %u applied at %lu mA, acknowledged %lu mA", (unsigned)i,
+				 (unsigned long)command.value, (unsigned long)ack.value);
+		test_check(ack.status == ACK_APPLIED && ack.value + 1U >= command.value && ack.value <= command.value + 1U,
+				   what);
+	}
+
+	printf("%lu commands, %lu acknowledged within %lu ms, after %lu false syncs and %lu damaged copies\n",
+		   (unsigned long)commands, (unsigned long)acknowledged, (unsigned long)worst_ms, (unsigned long)false_syncs,
+		   (unsigned long)damaged);
+
+	/* Whole settings, the deltas apply on them as long as no frame goes missing */
+	load_control_t control = { 0 };
+	uint8_t seq = (uint8_t)commands;
+	uint32_t applied = 0U;
+
+	worst_ms = 0U;
+	control.mode = CC;
+	control.cc.value_milli = 100U;
+	control.cc.max_value_milli = 10000U;
+	test_send(frame, test_frame(SERVER_MSG_CONTROL, seq++, &control, (uint8_t)sizeof(control), frame));
+	firmware_run_ns(1000000ULL);
+
+	for (uint32_t i = 0; i < TEST_DELTAS; i++)
+	{
+		const uint32_t cc_milli = 200U + i;
+		uint32_t size = test_noise(stream, 1);
+
+		size += test_delta_frame(cc_milli, seq++, &stream[size]);
+		test_send(stream, size);
+
+		uint32_t elapsed_ms = 0U;
+		uart_get_control(&control);
+		while (control.cc.value_milli != cc_milli && elapsed_ms < TEST_ACK_MS)
+		{
+			firmware_run_ns(1000000ULL);
+			elapsed_ms++;
+			uart_get_control(&control);
+		}
+
+		snprintf(what, sizeof(what), "delta %u after a false sync applied within %u ms", (unsigned)i, TEST_ACK_MS);
+		test_check(control.cc.value_milli == cc_milli, what);
+		applied += (control.cc.value_milli == cc_milli) ? 1U : 0U;
+		worst_ms = (elapsed_ms > worst_ms) ? elapsed_ms : worst_ms;
+	}
+
+	printf("%lu deltas after a false sync, %lu applied within %lu ms\n", (unsigned long)TEST_DELTAS,
+		   (unsigned long)applied, (unsigned long)worst_ms);
+
+	close(link[0]);
+	close(link[1]);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
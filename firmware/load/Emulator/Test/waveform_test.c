@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "waveform.h"
+
+#include "test_check.h"
+
+/**
+ * @brief Waveform player against a recording control
+ *
+ * Usage: waveform_test
+ *
+ * The player runs on its own, the control calls it makes are recorded with the tick they happen on and the tick is
+ * called by hand. Checks that chunks out of range are rejected however their offset wraps, that chunks load in any
+ * order, that a table plays with its durations and loops, and that start and stop, including ones landing in the
+ * middle of a tick as the UART interrupt does, are taken whole on the next tick.
+ */
+
+/** Points recorded, more than any test plays */
+#define TEST_LOG_SIZE 256U
+
+typedef struct
+{
+	uint32_t tick;
+	load_mode_t mode;
+	uint32_t value_milli;
+} test_step_t;
+
+static waveform_t waveform;
+static control_t control;
+static test_step_t test_log[TEST_LOG_SIZE];
+static uint32_t test_log_size;
+static uint32_t test_ticks;
+static uint8_t test_enable;
+
+/** Command handled from within the next point step, as the UART interrupt preempting the tick */
+static const load_waveform_t *test_preempt;
+
+/* Interrupt masking, the ticks are called by hand */
+
+static uint32_t primask;
+
+uint32_t __get_PRIMASK(void)
+{
+	return primask;
+}
+
+void __set_PRIMASK(uint32_t value)
+{
+	primask = value;
+}
+
+void __disable_irq(void)
+{
+	primask = 1U;
+}
+
+void __enable_irq(void)
+{
+	primask = 0U;
+}
+
+/* Control, recorded */
+
+control_mode_t control_mode_from_server(load_mode_t mode)
+{
+	return (control_mode_t)mode;
+}
+
+void control_set_enable(control_t *control_handler, uint8_t enable)
+{
+	test_enable = enable;
+}
+
+void control_step_setpoint(control_t *control_handler, control_mode_t mode, control_value_t setpoint)
+{
+	if (test_log_size < TEST_LOG_SIZE)
+	{
+		test_log[test_log_size].tick = test_ticks;
+		test_log[test_log_size].mode = (load_mode_t)mode;
+		test_log[test_log_size].value_milli = (uint32_t)CONTROL_VALUE_TO_MILLI(setpoint);
+		test_log_size++;
+	}
+
+	if (test_preempt)
+	{
+		const load_waveform_t *command = test_preempt;
+		test_preempt = NULL;
+		test_check(primask == 0U, "points are stepped with the interrupts enabled");
+		waveform_handle(&waveform, command);
+	}
+}
+
+static void test_tick(uint32_t ticks, uint8_t enable)
+{
+	for (uint32_t i = 0; i < ticks; i++)
+	{
+		test_ticks++;
+		waveform_tick(&waveform, &control, enable);
+	}
+}
+
+static void test_reset(void)
+{
+	waveform_init(&waveform);
+	test_log_size = 0U;
+	test_ticks = 0U;
+	test_enable = 0U;
+	test_preempt = NULL;
+}
+
+/**
+ * @brief Point i of the test tables: its value tells where it came from
+ *
+ * @param base Value of the first point, in milli-units
+ */
+static waveform_point_t test_point(uint32_t base, uint32_t i, uint16_t duration_ms)
+{
+	return (waveform_point_t){ .value_milli = base + i, .duration_ms = duration_ms, .mode = CC, .enable = 1U };
+}
+
+static HAL_StatusTypeDef test_load(uint32_t offset, uint32_t count, uint32_t base, uint16_t duration_ms)
+{
+	load_waveform_t command = { .command = WAVEFORM_LOAD, .offset = offset, .count = count };
+
+	for (uint32_t i = 0; i < count && i < WAVEFORM_CHUNK_POINTS; i++)
+	{
+		command.points[i] = test_point(base, offset + i, duration_ms);
+	}
+
+	return waveform_handle(&waveform, &command);
+}
+
+static HAL_StatusTypeDef test_start(uint32_t count, uint32_t loops, waveform_trigger_t trigger)
+{
+	const load_waveform_t command = { .command = WAVEFORM_START, .count = count, .loops = loops, .trigger = trigger };
+
+	return waveform_handle(&waveform, &command);
+}
+
+static HAL_StatusTypeDef test_stop(void)
+{
+	const load_waveform_t command = { .command = WAVEFORM_STOP };
+
+	return waveform_handle(&waveform, &command);
+}
+
+/**
+ * @brief Chunks past the table are rejected, including when offset + count wraps
+ *
+ */
+static void test_ranges(void)
+{
+	load_waveform_t samples = { .command = WAVEFORM_LOAD_SAMPLES, .mode = CV, .period_ms = 1U };
+
+	test_reset();
+
+	test_check(test_load(WAVEFORM_POINTS_SIZE - WAVEFORM_CHUNK_POINTS, WAVEFORM_CHUNK_POINTS, 0U, 1U) == HAL_OK,
+			   "last chunk of the table");
+	test_check(waveform.size == WAVEFORM_POINTS_SIZE, "table full");
+
+	test_reset();
+
+	test_check(test_load(WAVEFORM_POINTS_SIZE - 4U, WAVEFORM_CHUNK_POINTS, 0U, 1U) == HAL_ERROR, "chunk past the end");
+	test_check(test_load(WAVEFORM_POINTS_SIZE + 1U, 0U, 0U, 1U) == HAL_ERROR, "empty chunk past the end");
+	test_check(test_load(UINT32_MAX - 3U, WAVEFORM_CHUNK_POINTS, 0U, 1U) == HAL_ERROR, "offset wrapping on count");
+	test_check(test_load(0U, WAVEFORM_CHUNK_POINTS + 1U, 0U, 1U) == HAL_ERROR, "chunk larger than a message");
+
+	samples.offset = UINT32_MAX - 7U;
+	samples.count = WAVEFORM_CHUNK_POINTS * 2U;
+	test_check(waveform_handle(&waveform, &samples) == HAL_ERROR, "samples offset wrapping on count");
+	samples.offset = WAVEFORM_POINTS_SIZE - WAVEFORM_CHUNK_POINTS;
+	test_check(waveform_handle(&waveform, &samples) == HAL_ERROR, "samples past the end");
+	samples.offset = 0U;
+	samples.count = WAVEFORM_CHUNK_POINTS * 2U + 1U;
+	test_check(waveform_handle(&waveform, &samples) == HAL_ERROR, "samples larger than a message");
+
+	test_check(waveform.size == 0U, "nothing loaded by the rejected chunks");
+	test_check(test_start(1U, 1U, WAVEFORM_TRIGGER_NOW) == HAL_ERROR, "start on an empty table");
+}
+
+/**
+ * @brief Chunks in any order, the table ends at the furthest point loaded
+ *
+ */
+static void test_order(void)
+{
+	test_reset();
+
+	test_check(test_load(WAVEFORM_CHUNK_POINTS, WAVEFORM_CHUNK_POINTS, 0U, 1U) == HAL_OK, "second chunk first");
+	test_check(test_load(0U, WAVEFORM_CHUNK_POINTS, 0U, 1U) == HAL_OK, "first chunk last");
+	test_check(waveform.size == 2U * WAVEFORM_CHUNK_POINTS, "size kept by an earlier chunk");
+	test_check(test_start(2U * WAVEFORM_CHUNK_POINTS, 1U, WAVEFORM_TRIGGER_NOW) == HAL_OK, "start on both chunks");
+
+	test_tick(2U * WAVEFORM_CHUNK_POINTS + 1U, 1U);
+
+	uint8_t in_order = test_log_size == 2U * WAVEFORM_CHUNK_POINTS;
+	for (uint32_t i = 0; in_order && i < test_log_size; i++)
+	{
+		in_order = test_log[i].value_milli == i;
+	}
+	test_check(in_order, "both chunks played in table order");
+	test_check(!waveform_is_running(&waveform), "done after one loop");
+}
+
+/**
+ * @brief Durations and repetitions
+ *
+ */
+static void test_play(void)
+{
+	char what[96];
+
+	test_reset();
+	test_load(0U, 3U, 100U, 2U);
+
+	test_check(test_start(3U, 2U, WAVEFORM_TRIGGER_NOW) == HAL_OK, "start");
+	test_check(test_log_size == 0U && !waveform_is_running(&waveform), "start taken by the tick only");
+
+	test_tick(20U, 1U);
+
+	snprintf(what, sizeof(what), "%u points played, expected 6", test_log_size);
+	test_check(test_log_size == 6U, what);
+	for (uint32_t i = 0; i < test_log_size && i < 6U; i++)
+	{
+		snprintf(what, sizeof(what), "point %u: %u mA on tick %u", i, test_log[i].value_milli, test_log[i].tick);
+		test_check(test_log[i].value_milli == 100U + i % 3U && test_log[i].tick == 1U + 2U * i, what);
+	}
+	test_check(!waveform_is_running(&waveform), "done after two loops");
+
+	/* Forever, until stopped */
+	test_reset();
+	test_load(0U, 3U, 100U, 1U);
+	test_start(3U, 0U, WAVEFORM_TRIGGER_NOW);
+	test_tick(30U, 1U);
+	test_check(test_log_size == 30U && waveform_is_running(&waveform), "loops forever");
+}
+
+/**
+ * @brief Stop taken by the next tick, the table is free as soon as it is requested
+ *
+ */
+static void test_stop_request(void)
+{
+	test_reset();
+	test_load(0U, 4U, 100U, 1U);
+	test_start(4U, 0U, WAVEFORM_TRIGGER_NOW);
+	test_tick(2U, 1U);
+
+	test_check(test_load(0U, 4U, 200U, 1U) == HAL_BUSY, "table locked while playing");
+	test_check(test_stop() == HAL_OK, "stop");
+	test_check(waveform_is_running(&waveform), "stop taken by the tick only");
+	test_check(test_load(0U, 4U, 200U, 1U) == HAL_OK, "table free once a stop is requested");
+
+	const uint32_t played = test_log_size;
+	test_tick(1U, 1U);
+	test_check(!waveform_is_running(&waveform) && test_log_size == played, "stopped on the next tick");
+
+	/* The new table plays from its start */
+	test_start(4U, 1U, WAVEFORM_TRIGGER_NOW);
+	test_tick(5U, 1U);
+	test_check(test_log_size == played + 4U && test_log[played].value_milli == 200U, "new table played");
+}
+
+/**
+ * @brief Start and stop landing in the middle of a tick, while it steps a point
+ *
+ */
+static void test_preemption(void)
+{
+	const load_waveform_t stop = { .command = WAVEFORM_STOP };
+	const load_waveform_t restart = { .command = WAVEFORM_START, .count = 4U, .loops = 1U };
+
+	test_reset();
+	test_load(0U, 4U, 100U, 1U);
+	test_start(4U, 0U, WAVEFORM_TRIGGER_NOW);
+	test_tick(2U, 1U);
+
+	/* The point in flight completes, no other one follows */
+	test_preempt = &stop;
+	test_tick(1U, 1U);
+	test_check(test_log_size == 3U && waveform_is_running(&waveform), "point in flight completes");
+	test_check(test_load(0U, 4U, 300U, 1U) == HAL_OK, "table free after a stop in the middle of a tick");
+	test_tick(3U, 1U);
+	test_check(test_log_size == 3U && !waveform_is_running(&waveform), "nothing played after the stop");
+
+	/* A restart in the middle of a point starts over on the next tick */
+	test_start(4U, 0U, WAVEFORM_TRIGGER_NOW);
+	test_tick(2U, 1U);
+	test_preempt = &restart;
+	test_tick(1U, 1U);
+	test_tick(1U, 1U);
+	test_check(test_log_size == 7U && test_log[6].value_milli == 300U, "restart from the first point");
+	test_tick(5U, 1U);
+	test_check(test_log_size == 10U && !waveform_is_running(&waveform), "restart plays its own loops");
+}
+
+/**
+ * @brief Start on the panel enable, a falling enable stops the player
+ *
+ */
+static void test_trigger(void)
+{
+	test_reset();
+	test_load(0U, 2U, 100U, 1U);
+
+	test_check(test_start(2U, 0U, WAVEFORM_TRIGGER_ENABLE) == HAL_OK, "armed start");
+	test_tick(3U, 0U);
+	test_check(test_log_size == 0U && waveform.state == WAVEFORM_ARMED, "armed until the panel enables");
+	test_check(test_load(0U, 2U, 100U, 1U) == HAL_BUSY, "table locked while armed");
+
+	test_tick(3U, 1U);
+	test_check(test_log_size == 3U && test_log[0].tick == 4U, "started on the rising enable");
+
+	test_enable = 1U;
+	test_tick(1U, 0U);
+	test_check(!waveform_is_running(&waveform) && test_enable == 0U, "falling enable stops and turns the load off");
+}
+
+int main(void)
+{
+	memset(&control, 0, sizeof(control));
+
+	test_ranges();
+	test_order();
+	test_play();
+	test_stop_request();
+	test_preemption();
+	test_trigger();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,43 +24,82 @@
  *
  * @return const nodes_t* Pointer to the next level of the tree after parsing the buffer data
  *
+ * Levels made with MAKE_KEYED_NODES are dispatched by key in constant time, the others are scanned in order. Building
+ * with PARSER_SCAN_DISPATCH scans the keyed levels too, to compare both.
+ *
  * @note This function assumes that the `nodes` argument is a valid pointer to a valid nodes_t structure,
  *       and that the `buffer` argument is a valid pointer to a valid buffer_t structure.
  * @note This function may return NULL if an error occurs or if the actual node is a leaf node.
  * @note The caller of this function should handle the NULL node that represent an end of tree or an error
  * @note This function may log information, warning, or error messages using logging functions such as LOG_INFO,
  *       LOG_WARN, and LOG_ERROR. It is assumed that these logging functions are properly defined and configured
- *       in the system to provide meaningful logs for debugging and troubleshooting purposes.
+ *       in the system to provide meaningful logs for debugging and troubleshooting purposes. The per level traces
+ *       are only compiled in with PARSER_TRACE.
  */
 const nodes_t *node_parser(buffer_t *buffer, const nodes_t *nodes);
+static inline const nodes_t *node_follow(buffer_t *buffer, const node_t *node);
+static void stream_match(parser_stream_t *stream, const char *token, uint32_t length);
+static void stream_end(parser_stream_t *stream);
 
 const nodes_t *node_parser(buffer_t *buffer, const nodes_t *nodes)
 {
     const node_t *node = nodes->nodes;
-    LOG_INFO("parsing node %s", nodes->name);
-    /* Check for a match in the level of the tree */
-    for (int i = 0; i < nodes->size; i++)
+    PARSER_LOG_TRACE("parsing node %s", nodes->name);
+    if (nodes->match_func == NULL)
     {
-        if (nodes->match_func == NULL)
+        LOG_ERROR("inexistent match function");
+        return NULL;
+    }
+
+#ifndef PARSER_SCAN_DISPATCH
+    /* Keyed levels hold the only node the data can match at its key, the match confirms it */
+    if (nodes->key_func != NULL)
+    {
+        const int key = nodes->key_func(buffer->actual);
+        if (key >= 0 && key < nodes->size && node[key].value != NULL &&
+            nodes->match_func(buffer->actual, node[key].value) == PARSER_MATCH_EQUAL)
         {
-            LOG_ERROR("inexistent match function");
-            return NULL;
+            return node_follow(buffer, &node[key]);
         }
+        PARSER_LOG_MISS("Unrecognized command\n");
+        return NULL;
+    }
+#endif
+
+    /* Check for a match in the level of the tree */
+    for (int i = 0; i < nodes->size; i++)
+    {
+        /* Unused slots of keyed levels are not wildcards */
+        if (node[i].value == NULL && nodes->key_func != NULL)
+            continue;
 
         /* check if buffer data match with the node or if is a wildcard node*/
         if (node[i].value == NULL || nodes->match_func(buffer->actual, node[i].value) == PARSER_MATCH_EQUAL)
         {
-            if (node[i].callback != NULL)
-                node[i].callback(buffer, node[i].value);
-
-            //LOG_INFO("next node is %s", node[i].next != NULL ? node[i].next->name : "NULL");
-            return node[i].next;
+            return node_follow(buffer, &node[i]);
         }
     }
-    LOG_WARN("Unrecognized command\n");
+    PARSER_LOG_MISS("Unrecognized command\n");
     return NULL;
 }
 
+/**
+ * @brief Run the callback of a matched node
+ *
+ * @param buffer Pointer to the buffer, at the data matched
+ * @param node Matched node
+ *
+ * @return const nodes_t* Next level of the tree, NULL on a leaf
+ */
+static inline const nodes_t *node_follow(buffer_t *buffer, const node_t *node)
+{
+    if (node->callback != NULL)
+        node->callback(buffer, node->value);
+
+    //LOG_INFO("next node is %s", node->next != NULL ? node->next->name : "NULL");
+    return node->next;
+}
+
 void parser(buffer_t *buffer, const nodes_t *root_node)
 {
     const nodes_t *nodes = root_node;
@@ -73,4 +112,139 @@ void parser(buffer_t *buffer, const nodes_t *root_node)
         }
         nodes = node_parser(buffer, nodes);
     }
-}
\ No newline at end of file
+}
+
+void parser_stream_init(parser_stream_t *stream, const nodes_t *root_node, char separator,
+                        void (*on_end)(parser_stream_t *stream), void *context)
+{
+    stream->root = root_node;
+    stream->separator = separator;
+    stream->on_end = on_end;
+    stream->context = context;
+    parser_stream_reset(stream);
+}
+
+void parser_stream_reset(parser_stream_t *stream)
+{
+    stream->nodes = stream->root;
+    stream->spoiled = 0;
+    stream->tokens = 0;
+    stream->length = 0;
+}
+
+void parser_stream_feed(parser_stream_t *stream, const char *data, uint32_t length)
+{
+    /* Start of the token in the chunk, the kept one continues at the start of the chunk */
+    uint32_t start = 0;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        const char byte = data[i];
+        const uint8_t end_of_line = (byte == '\r' || byte == '\n');
+
+        if (byte != stream->separator && !end_of_line)
+        {
+            /* Control characters are binary noise, not text */
+            if ((unsigned char)byte < 0x20 || byte == 0x7F)
+                stream->spoiled = 1;
+            continue;
+        }
+
+        /* A line ending right after another one ends an empty command */
+        if (!end_of_line || i > start || stream->length > 0 || stream->tokens > 0 || stream->spoiled)
+        {
+            if (stream->length > 0)
+            {
+                /* Rest of the kept token */
+                const uint32_t rest = i - start;
+                if (stream->length + rest > PARSER_STREAM_TOKEN_MAX)
+                {
+                    stream->spoiled = 1;
+                    stream_match(stream, NULL, 0);
+                }
+                else
+                {
+                    for (uint32_t j = 0; j < rest; j++)
+                        stream->token[stream->length + j] = data[start + j];
+                    stream->token[stream->length + rest] = '\0';
+                    stream_match(stream, stream->token, stream->length + rest);
+                }
+                stream->length = 0;
+            }
+            else
+            {
+                stream_match(stream, &data[start], i - start);
+            }
+
+            if (end_of_line)
+                stream_end(stream);
+        }
+
+        start = i + 1;
+    }
+
+    /* Keep the token cut by the end of the chunk */
+    const uint32_t rest = length - start;
+    if (rest == 0)
+        return;
+
+    if (stream->length + rest > PARSER_STREAM_TOKEN_MAX)
+    {
+        /* Past the limit the token is only waited for, to be skipped */
+        stream->spoiled = 1;
+        stream->length = PARSER_STREAM_TOKEN_MAX + 1;
+        return;
+    }
+
+    for (uint32_t j = 0; j < rest; j++)
+        stream->token[stream->length + j] = data[start + j];
+    stream->length += rest;
+}
+
+/**
+ * @brief Match a complete token at the level of the stream
+ *
+ * @param stream Stream context
+ * @param token Token, ended by its separator, its line ending or a NUL, NULL for an overlong one
+ * @param length Bytes in the token
+ */
+static void stream_match(parser_stream_t *stream, const char *token, uint32_t length)
+{
+    stream->tokens++;
+
+    if (token == NULL || stream->nodes == NULL)
+    {
+        stream->nodes = NULL;
+        return;
+    }
+
+    if (length > PARSER_STREAM_TOKEN_MAX)
+    {
+        stream->spoiled = 1;
+        stream->nodes = NULL;
+        return;
+    }
+
+    /* The tree only reads the token */
+    buffer_t buffer = {
+        .begin = token,
+        .actual = (void *)token,
+        .end = token + length,
+        .consumer = NULL,
+        .context = stream->context,
+    };
+    stream->nodes = node_parser(&buffer, stream->nodes);
+}
+
+/**
+ * @brief Close the command at a line ending and go back to the root
+ *
+ * @param stream Stream context
+ */
+static void stream_end(parser_stream_t *stream)
+{
+    if (stream->on_end != NULL)
+        stream->on_end(stream);
+
+    parser_stream_reset(stream);
+}
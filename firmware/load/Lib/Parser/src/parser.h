@@ -3,6 +3,7 @@
 
 #include "stdio.h"
 #include "stdlib.h"
+#include "stdint.h"
 
 typedef enum parser_consumer_data
 {
@@ -20,6 +21,7 @@ typedef struct buffer_t
     void *actual;       /**< Points to the to consume buffer */
     const void *end;    /**< Points to the end of the buffer */
     parser_consumer_data_t (*consumer)(struct buffer_t *buffer);   /**< Buffer consumer function */
+    void *context;      /**< User data for the node callbacks */
 } buffer_t;
 
 typedef enum parser_match
@@ -41,6 +43,7 @@ typedef struct nodes_t
     const char *name;   /**< Node group name */
     const int size;     /**< size of the array of nodes */
     parser_match_t (*match_func)(void *data, const void *match_value); /**< Match function */
+    int (*key_func)(void *data);    /**< Index of the node the data can match, NULL to scan the nodes */
     const node_t *nodes;    /**< Nodes array */
 } nodes_t;
 
@@ -68,6 +71,17 @@ typedef struct nodes_t
     printf("\033[0m\n")
 #endif
 
+/**
+ * Per level traces of the parser, compiled in only with PARSER_TRACE as they run on every field parsed
+ */
+#ifdef PARSER_TRACE
+#define PARSER_LOG_TRACE(...) LOG_INFO(__VA_ARGS__)
+#define PARSER_LOG_MISS(...) LOG_WARN(__VA_ARGS__)
+#else
+#define PARSER_LOG_TRACE(...)
+#define PARSER_LOG_MISS(...)
+#endif
+
 /**
  * @brief Helper macro for making an array of nodes
  *
@@ -85,6 +99,38 @@ typedef struct nodes_t
         .size = sizeof(NAME##_NODE) / sizeof(node_t), \
     }
 
+/**
+ * @brief Helper macro for making an array of nodes indexed by key
+ *
+ * The nodes are placed with MAKE_KEYED_NODE at the index KEY_FUNC returns for the data they match, so a level is
+ * dispatched with one key computation and one match instead of a scan. KEY_FUNC must map every node value to its own
+ * index, a perfect hash of the values, and may return anything, negative included, for other data: the match
+ * function confirms the slot. Unused indexes are left empty, so keyed arrays hold no wildcard node.
+ *
+ * Example:
+ * \code
+ * MAKE_KEYED_NODES(reg, &match_number, &key_number, {
+ *     MAKE_KEYED_NODE(1, &one, &callback_1, NULL),
+ *     MAKE_KEYED_NODE(3, &three, &callback_3, NULL),
+ * });
+ * \endcode
+ *
+ * @param NAME Name of the array
+ * @param MATCH_FUNC Match function for the nodes
+ * @param KEY_FUNC Key function, index of the only node the data can match
+ * @param ... Array of node_t made with MAKE_KEYED_NODE
+ */
+#define MAKE_KEYED_NODES(NAME, MATCH_FUNC, KEY_FUNC, ...) \
+    const node_t NAME##_NODE[] =                          \
+        __VA_ARGS__;                                      \
+    const nodes_t NAME = {                                \
+        .name = #NAME,                                    \
+        .nodes = NAME##_NODE,                             \
+        .match_func = MATCH_FUNC,                         \
+        .key_func = KEY_FUNC,                             \
+        .size = sizeof(NAME##_NODE) / sizeof(node_t),     \
+    }
+
 /**
  * @brief Helper macro for making an empty array of nodes
  * This is a workaround to create circular nodes.
@@ -136,6 +182,17 @@ typedef struct nodes_t
     }
 
 
+/**
+ * @brief Helper macro for creating parsing nodes of a keyed array
+ *
+ * @param KEY Index returned by the key function for VALUE
+ * @param VALUE Value to be matched with the buffer, not NULL
+ * @param CALLBACK Callback function for the node
+ * @param NEXT Next node in the tree
+ */
+#define MAKE_KEYED_NODE(KEY, VALUE, CALLBACK, NEXT) \
+    [KEY] = MAKE_NODE(VALUE, CALLBACK, NEXT)
+
 /**
  * @brief Helper macro for creating a wildcard parsing node.
  *
@@ -157,6 +214,34 @@ typedef struct nodes_t
         .next = NEXT,                      \
     }
 
+/**
+ * Longest token a stream keeps across two chunks, longer tokens spoil the command
+ */
+#ifndef PARSER_STREAM_TOKEN_MAX
+#define PARSER_STREAM_TOKEN_MAX 16
+#endif
+
+/**
+ * Resumable parse of commands arriving in chunks of any size
+ *
+ * A command is a line of tokens split by the separator and ended by a carriage return or a line feed. Tokens that
+ * end within their chunk are matched in place, followed by their separator or line ending, so the match functions
+ * must stop on those. A token cut by the end of a chunk is kept in the context, up to PARSER_STREAM_TOKEN_MAX bytes,
+ * and matched NUL terminated once its end arrives.
+ */
+typedef struct parser_stream_t
+{
+    const nodes_t *root;    /**< Root of the tree */
+    const nodes_t *nodes;   /**< Level of the next token, NULL past a leaf or a mismatch */
+    void (*on_end)(struct parser_stream_t *stream); /**< Called at the end of every non empty command */
+    void *context;          /**< Handed to the node callbacks in buffer_t.context */
+    char separator;         /**< Token separator */
+    uint8_t spoiled;        /**< Set by a control character or an overlong token in the command */
+    uint32_t tokens;        /**< Tokens of the command matched or skipped so far */
+    uint32_t length;        /**< Bytes of the token kept across chunks */
+    char token[PARSER_STREAM_TOKEN_MAX + 1];    /**< Token kept across chunks */
+} parser_stream_t;
+
 /**
  * @brief Parse data from buffer using a tree structure starting from the root node
  *
@@ -178,8 +263,41 @@ typedef struct nodes_t
  *       the tree structure is correctly set up before calling this function to avoid unexpected behavior.
  * @note This function may log information, warning, or error messages using logging functions such as LOG_INFO,
  *       LOG_WARN, and LOG_ERROR. It is assumed that these logging functions are properly defined and configured
- *       in the system to provide meaningful logs for debugging and troubleshooting purposes.
+ *       in the system to provide meaningful logs for debugging and troubleshooting purposes. The per level traces
+ *       are only compiled in with PARSER_TRACE.
  */
 void parser(buffer_t *buffer, const nodes_t *root_node);
 
+/**
+ * @brief Set up a stream at the root of a tree
+ *
+ * @param stream Stream context
+ * @param root_node Root of the tree
+ * @param separator Token separator
+ * @param on_end Called at the end of every non empty command, with the stream still holding its token count and
+ *        spoiled flag, may be NULL
+ * @param context Handed to the node callbacks in buffer_t.context and left for on_end
+ */
+void parser_stream_init(parser_stream_t *stream, const nodes_t *root_node, char separator,
+                        void (*on_end)(parser_stream_t *stream), void *context);
+
+/**
+ * @brief Drop the command in progress, the next byte starts a new one
+ *
+ * @param stream Stream context
+ */
+void parser_stream_reset(parser_stream_t *stream);
+
+/**
+ * @brief Parse the next chunk of the input
+ *
+ * The chunk may end anywhere, the tree position and the cut token are kept for the next one. Every token is matched
+ * as soon as its end arrives, and on_end runs on every line ending, within this call.
+ *
+ * @param stream Stream context
+ * @param data Chunk, only read, it may be the receive buffer of a peripheral
+ * @param length Bytes in the chunk
+ */
+void parser_stream_feed(parser_stream_t *stream, const char *data, uint32_t length);
+
 #endif
\ No newline at end of file
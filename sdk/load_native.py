@@ -0,0 +1,284 @@
+"""
+Python bindings of the native load client in sdk/native, loaded with ctypes.
+
+Build the library first:
+    cmake -S sdk/native -B sdk/native/build && cmake --build sdk/native/build
+
+The library is looked up in $LOAD_CLIENT_LIBRARY, then sdk/native/build, then
+the system library path.
+"""
+
+import ctypes
+import ctypes.util
+import os
+
+# Structs of firmware/hmi/main/server/server.h
+
+
+class SetPoint(ctypes.Structure):
+    _fields_ = [
+        ("value_milli", ctypes.c_uint32),
+        ("min_value_milli", ctypes.c_uint32),
+        ("max_value_milli", ctypes.c_uint32),
+    ]
+
+
+class Control(ctypes.Structure):
+    _fields_ = [
+        ("enable", ctypes.c_uint32),
+        ("mode", ctypes.c_uint32),
+        ("cc", SetPoint),
+        ("cv", SetPoint),
+        ("cr", SetPoint),
+        ("cp", SetPoint),
+    ]
+
+
+class Measurement(ctypes.Structure):
+    _fields_ = [
+        ("cc_milli", ctypes.c_uint32),
+        ("cv_milli", ctypes.c_uint32),
+        ("cr_milli", ctypes.c_uint32),
+        ("cp_milli", ctypes.c_uint32),
+        ("temp_milli", ctypes.c_uint32),
+    ]
+
+
+class WaveformPoint(ctypes.Structure):
+    _fields_ = [
+        ("value_milli", ctypes.c_uint32),
+        ("duration_ms", ctypes.c_uint16),
+        ("mode", ctypes.c_uint8),
+        ("enable", ctypes.c_uint8),
+    ]
+
+
+class _WaveformData(ctypes.Union):
+    _fields_ = [
+        ("points", WaveformPoint * 8),
+        ("samples_milli", ctypes.c_uint32 * 16),
+    ]
+
+
+class Waveform(ctypes.Structure):
+    _anonymous_ = ("data",)
+    _fields_ = [
+        ("command", ctypes.c_uint32),
+        ("offset", ctypes.c_uint32),
+        ("count", ctypes.c_uint32),
+        ("mode", ctypes.c_uint32),
+        ("period_ms", ctypes.c_uint32),
+        ("loops", ctypes.c_uint32),
+        ("trigger", ctypes.c_uint32),
+        ("data", _WaveformData),
+    ]
+
+
+class TelemetryConfig(ctypes.Structure):
+    _fields_ = [
+        ("mode", ctypes.c_uint8),
+        ("batch", ctypes.c_uint8),
+        ("decimation", ctypes.c_uint16),
+    ]
+
+
+class TelemetrySample(ctypes.Structure):
+    _fields_ = [
+        ("timestamp_us", ctypes.c_uint32),
+        ("voltage_milli", ctypes.c_uint32),
+        ("current_milli", ctypes.c_uint32),
+        ("temperature_centi", ctypes.c_int16),
+        ("dac_code", ctypes.c_uint16),
+    ]
+
+
+class Ack(ctypes.Structure):
+    _fields_ = [
+        ("id", ctypes.c_uint16),
+        ("key", ctypes.c_uint8),
+        ("status", ctypes.c_uint8),
+        ("value", ctypes.c_uint32),
+        ("timestamp_us", ctypes.c_uint32),
+        ("latency_us", ctypes.c_uint32),
+    ]
+
+
+class Latency(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_uint32),
+        ("min_us", ctypes.c_uint32),
+        ("max_us", ctypes.c_uint32),
+        ("sum_us", ctypes.c_uint64),
+        ("buckets", ctypes.c_uint32 * 20),
+    ]
+
+
+class Stats(ctypes.Structure):
+    _fields_ = [
+        ("bytes_received", ctypes.c_uint64),
+        ("frames_received", ctypes.c_uint64),
+        ("measurements", ctypes.c_uint64),
+        ("telemetry_samples", ctypes.c_uint64),
+        ("telemetry_overruns", ctypes.c_uint64),
+        ("telemetry_dropped", ctypes.c_uint32),
+        ("commands", ctypes.c_uint64),
+        ("command_retries", ctypes.c_uint64),
+        ("command_acks", ctypes.c_uint64),
+    ]
+
+
+# load_command_key_t and load_ack_status_t
+COMMAND_ENABLE, COMMAND_MODE, COMMAND_CC, COMMAND_CV, COMMAND_CR, COMMAND_CP = range(6)
+ACK_APPLIED, ACK_OVERRIDDEN, ACK_REJECTED = range(3)
+
+
+def _struct_to_dict(struct):
+    return {name: getattr(struct, name) for name, _ in struct._fields_}
+
+
+def _latency_to_dict(latency):
+    """Histogram as a dict, buckets keyed by their upper bound in microseconds."""
+    result = _struct_to_dict(latency)
+    result["mean_us"] = latency.sum_us / latency.count if latency.count else 0.0
+    result["buckets"] = {1 << i: latency.buckets[i] for i in range(len(latency.buckets)) if latency.buckets[i]}
+    return result
+
+
+def _load_library():
+    candidates = [
+        os.environ.get("LOAD_CLIENT_LIBRARY"),
+        os.path.join(os.path.dirname(os.path.abspath(__file__)), "native", "build", "libload_client.so"),
+        ctypes.util.find_library("load_client"),
+    ]
+    for path in candidates:
+        if path and (os.path.exists(path) or not os.path.isabs(path)):
+            return ctypes.CDLL(path, use_errno=True)
+    raise OSError("libload_client not found, build sdk/native or set LOAD_CLIENT_LIBRARY")
+
+
+_lib = None
+
+
+def _library():
+    global _lib
+    if _lib is None:
+        lib = _load_library()
+        client = ctypes.c_void_p
+        lib.load_client_open.argtypes = [ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint32]
+        lib.load_client_open.restype = client
+        lib.load_client_close.argtypes = [client]
+        lib.load_client_close.restype = None
+        lib.load_client_set_control.argtypes = [client, ctypes.POINTER(Control)]
+        lib.load_client_set_control.restype = ctypes.c_int
+        lib.load_client_send_waveform.argtypes = [client, ctypes.POINTER(Waveform)]
+        lib.load_client_send_waveform.restype = ctypes.c_int
+        lib.load_client_set_telemetry.argtypes = [client, ctypes.POINTER(TelemetryConfig)]
+        lib.load_client_set_telemetry.restype = ctypes.c_int
+        lib.load_client_get_measurement.argtypes = [client, ctypes.POINTER(Measurement)]
+        lib.load_client_get_measurement.restype = ctypes.c_uint64
+        lib.load_client_wait_measurement.argtypes = [client, ctypes.c_uint64, ctypes.POINTER(Measurement), ctypes.c_int]
+        lib.load_client_wait_measurement.restype = ctypes.c_uint64
+        lib.load_client_read_telemetry.argtypes = [client, ctypes.POINTER(TelemetrySample), ctypes.c_uint32]
+        lib.load_client_read_telemetry.restype = ctypes.c_uint32
+        lib.load_client_command.argtypes = [client, ctypes.c_uint32, ctypes.c_uint32, ctypes.POINTER(Ack), ctypes.c_int]
+        lib.load_client_command.restype = ctypes.c_int
+        lib.load_client_get_latency.argtypes = [client, ctypes.POINTER(Latency), ctypes.POINTER(Latency)]
+        lib.load_client_get_latency.restype = None
+        lib.load_client_get_stats.argtypes = [client, ctypes.POINTER(Stats)]
+        lib.load_client_get_stats.restype = None
+        _lib = lib
+    return _lib
+
+
+def _raise_errno(what):
+    error = ctypes.get_errno()
+    raise OSError(error, "{}: {}".format(what, os.strerror(error)))
+
+
+class LoadClient:
+    """
+    Native client of the load. The I/O runs in the library thread, calls here
+    only copy state in and out, so they never wait on the serial port.
+    Only one client can be open at a time.
+    """
+
+    def __init__(self, port, baud=1000000, control_period=0.05):
+        self._lib = _library()
+        self._client = self._lib.load_client_open(port.encode(), baud, int(control_period * 1000))
+        if not self._client:
+            _raise_errno("load_client_open " + port)
+
+        self._measurements = 0
+        self._samples = (TelemetrySample * 4096)()
+
+    def close(self):
+        if self._client:
+            self._lib.load_client_close(self._client)
+            self._client = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def set_control(self, control):
+        """Send a Control now and keep sending it every control period."""
+        if self._lib.load_client_set_control(self._client, ctypes.byref(control)) != 0:
+            _raise_errno("load_client_set_control")
+
+    def command(self, key, value, timeout=1.0):
+        """Send a single setting change and wait for its acknowledgement, returned as a dict."""
+        ack = Ack()
+        if self._lib.load_client_command(self._client, key, value, ctypes.byref(ack), int(timeout * 1000)) != 0:
+            _raise_errno("load_client_command")
+        return _struct_to_dict(ack)
+
+    def latency(self):
+        """Command round trip and load side application latency histograms, as dicts."""
+        round_trip = Latency()
+        apply = Latency()
+        self._lib.load_client_get_latency(self._client, ctypes.byref(round_trip), ctypes.byref(apply))
+        return _latency_to_dict(round_trip), _latency_to_dict(apply)
+
+    def send_waveform(self, waveform):
+        """Send a Waveform player command."""
+        if self._lib.load_client_send_waveform(self._client, ctypes.byref(waveform)) != 0:
+            _raise_errno("load_client_send_waveform")
+
+    def set_telemetry(self, mode, batch, decimation):
+        """Configure the telemetry stream, the samples queued so far are discarded."""
+        config = TelemetryConfig(mode, batch, decimation)
+        if self._lib.load_client_set_telemetry(self._client, ctypes.byref(config)) != 0:
+            _raise_errno("load_client_set_telemetry")
+
+    def get_measurement(self):
+        """Last known measurement as a dict of load_measurement_t fields."""
+        measurement = Measurement()
+        self._measurements = self._lib.load_client_get_measurement(self._client, ctypes.byref(measurement))
+        return _struct_to_dict(measurement)
+
+    def wait_measurement(self, timeout=1.0):
+        """Wait for a measurement newer than the last one returned, None on timeout."""
+        measurement = Measurement()
+        count = self._lib.load_client_wait_measurement(self._client, self._measurements,
+                                                       ctypes.byref(measurement), int(timeout * 1000))
+        if count == 0:
+            return None
+        self._measurements = count
+        return _struct_to_dict(measurement)
+
+    def read_telemetry(self):
+        """Take all queued telemetry samples as dicts, oldest first."""
+        samples = []
+        while True:
+            count = self._lib.load_client_read_telemetry(self._client, self._samples, len(self._samples))
+            samples.extend(_struct_to_dict(self._samples[i]) for i in range(count))
+            if count < len(self._samples):
+                return samples
+
+    def stats(self):
+        """Link counters as a dict."""
+        stats = Stats()
+        self._lib.load_client_get_stats(self._client, ctypes.byref(stats))
+        return _struct_to_dict(stats)
@@ -1,13 +1,100 @@
+import collections
 import threading
 import time
 import struct
 import serial
 
-RX_MAGIC_WORD = 0x2D2D2D2D  # The magic word we send from "panel" to "load"
+# v2 framing, shared with firmware/load/Core/Src/server.c and firmware/hmi/main/server/server.c:
+#   | sync | length | type | seq | payload (length bytes) | crc16 (LE) |
+# The CRC-16/CCITT-FALSE covers length, type, seq and payload.
+SYNC_BYTE = 0xA5
+HEADER_SIZE = 4
+CRC_SIZE = 2
+PAYLOAD_MAX = 200  # sizeof(load_telemetry_t), the largest payload
+
+MSG_CONTROL = 0x01            # Whole load_control_t, panel to load
+MSG_CONTROL_DELTA = 0x02      # Changed load_control_t words, panel to load
+MSG_MEASUREMENT = 0x11        # Whole load_measurement_t, load to panel
+MSG_MEASUREMENT_DELTA = 0x12  # Changed load_measurement_t words, load to panel
+MSG_TELEMETRY = 0x13          # load_telemetry_t batch, load to panel
+MSG_WAVEFORM = 0x21           # load_waveform_t, panel to load
+MSG_TELEMETRY_CONFIG = 0x22   # load_telemetry_config_t, panel to load
+
+# Frames between two whole state structs
+KEYFRAME_INTERVAL = 8
+
+CONTROL_WORDS = 14      # load_control_t
+MEASUREMENT_WORDS = 5   # load_measurement_t
+
+# Telemetry streaming modes (telemetry_mode_t)
+TELEMETRY_OFF = 0       # No streaming
+TELEMETRY_FILTERED = 1  # Samples averaged over the decimation window
+TELEMETRY_RAW = 2       # Every voltage and current conversion pair, at the time of the conversion
+
+TELEMETRY_BATCH_MAX = 12
+TELEMETRY_HEADER = struct.Struct("<BBHI")       # mode, count, decimation, dropped
+TELEMETRY_SAMPLE = struct.Struct("<IIIhH")      # timestamp_us, voltage, current, temperature_centi, dac_code
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), as computed by the firmware."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+class FrameEncoder:
+    """
+    Builds v2 frames. State structs go whole every KEYFRAME_INTERVAL frames
+    and as deltas against the last one sent otherwise: a 16-bit mask of the
+    changed 32-bit words followed by those words.
+    """
+
+    def __init__(self, full_type, delta_type):
+        self._full_type = full_type
+        self._delta_type = delta_type
+        self._seq = 0
+        self._frames_since_key = KEYFRAME_INTERVAL
+        self._reference = None
+
+    def frame(self, msg_type, payload):
+        """Wrap a payload in a frame, consuming a sequence number."""
+        if len(payload) > PAYLOAD_MAX:
+            raise ValueError("payload of {} bytes does not fit a frame".format(len(payload)))
+
+        body = struct.pack("<BBB", len(payload), msg_type, self._seq) + payload
+        self._seq = (self._seq + 1) & 0xFF
+        return bytes([SYNC_BYTE]) + body + struct.pack("<H", crc16_ccitt(body))
+
+    def encode_state(self, words):
+        """Frame a state struct given as a list of uint32 words."""
+        words = list(words)
+
+        if self._frames_since_key >= KEYFRAME_INTERVAL or self._reference is None:
+            self._frames_since_key = 1
+            self._reference = words
+            return self.frame(self._full_type, struct.pack("<{}I".format(len(words)), *words))
+
+        self._frames_since_key += 1
+
+        mask = 0
+        changed = []
+        for i, (word, reference) in enumerate(zip(words, self._reference)):
+            if word != reference:
+                mask |= 1 << i
+                changed.append(word)
+        self._reference = words
 
-def _build_panel_to_load_message(enable, mode, cc, cv, cr, cp):
+        payload = struct.pack("<H{}I".format(len(changed)), mask, *changed)
+        return self.frame(self._delta_type, payload)
+
+
+def _build_panel_to_load_message(encoder, enable, mode, cc, cv, cr, cp):
     """
-    Build a 64-byte 'panel_to_load_t' packet:
+    Build the frame carrying the 'load_control_t' settings:
       - enable (uint32_t)
       - mode   (uint32_t)
       - cc, cv, cr, cp each are dictionaries with:
@@ -16,137 +103,146 @@ def _build_panel_to_load_message(enable, mode, cc, cv, cr, cp):
               "min_value_milli": <int>,
               "max_value_milli": <int>
             }
-      - The final 4 bytes is a checksum over the first 60 bytes (magic + data).
+    Only the words changed since the last frame are sent, except on keyframes.
+    """
+    words = [enable, mode]
+    for set_point in (cc, cv, cr, cp):
+        words += [set_point["value_milli"], set_point["min_value_milli"], set_point["max_value_milli"]]
+
+    return encoder.encode_state(words)
+
+
+def _build_telemetry_config_message(encoder, mode, batch, decimation):
+    """Build the frame carrying the 'load_telemetry_config_t' settings."""
+    return encoder.frame(MSG_TELEMETRY_CONFIG, struct.pack("<BBH", mode, batch, decimation))
+
+
+def parse_telemetry(frame):
+    """
+    Given a frame from LoadParser.parse_byte(), decode a 'load_telemetry_t' batch.
+    Returns:
+        dict with keys mode, decimation, dropped and samples, a list of dicts with
+        timestamp_us, voltage_milli, current_milli, temperature_centi and dac_code,
+        or None if the frame is not a valid batch.
     """
+    msg_type, _, payload = frame
+    if msg_type != MSG_TELEMETRY or len(payload) < TELEMETRY_HEADER.size:
+        return None
+
+    mode, count, decimation, dropped = TELEMETRY_HEADER.unpack_from(payload, 0)
+    if count > TELEMETRY_BATCH_MAX or len(payload) != TELEMETRY_HEADER.size + count * TELEMETRY_SAMPLE.size:
+        return None
+
+    samples = []
+    for offset in range(TELEMETRY_HEADER.size, len(payload), TELEMETRY_SAMPLE.size):
+        timestamp_us, voltage, current, temperature, dac_code = TELEMETRY_SAMPLE.unpack_from(payload, offset)
+        samples.append({
+            "timestamp_us": timestamp_us,
+            "voltage_milli": voltage,
+            "current_milli": current,
+            "temperature_centi": temperature,
+            "dac_code": dac_code,
+        })
+
+    return {"mode": mode, "decimation": decimation, "dropped": dropped, "samples": samples}
 
-    # 1) Magic word (4 bytes)
-    magic_word_packed = struct.pack("<I", RX_MAGIC_WORD)
-
-    # 2) 14x uint32_t (56 bytes total):
-    #    (enable, mode,
-    #     cc.value_milli, cc.min_value_milli, cc.max_value_milli,
-    #     cv.value_milli, cv.min_value_milli, cv.max_value_milli,
-    #     cr.value_milli, cr.min_value_milli, cr.max_value_milli,
-    #     cp.value_milli, cp.min_value_milli, cp.max_value_milli)
-    data_packed = struct.pack(
-        "<14I",
-        enable,
-        mode,
-        cc["value_milli"], cc["min_value_milli"], cc["max_value_milli"],
-        cv["value_milli"], cv["min_value_milli"], cv["max_value_milli"],
-        cr["value_milli"], cr["min_value_milli"], cr["max_value_milli"],
-        cp["value_milli"], cp["min_value_milli"], cp["max_value_milli"]
-    )
-
-    partial_msg = magic_word_packed + data_packed
-
-    # 3) Compute checksum (sum of the first 60 bytes)
-    chksum = sum(partial_msg) & 0xFFFFFFFF
-    chksum_packed = struct.pack("<I", chksum)
-
-    # Final 64 bytes
-    return partial_msg + chksum_packed
 
 class LoadParser:
     """
-    Parser to handle inbound data from the load. It looks for:
-      - Magic word  (4 bytes, 0x2B2B2B2B)
-      - Data block  (20 bytes => 5 x uint32_t)
-      - Checksum    (4 bytes)
-    Total: 28 bytes.
+    Parser to handle inbound v2 frames from the load. Whole and delta
+    'load_measurement_t' frames are applied to the last known measurement,
+    deltas are dropped after a sequence gap until the next whole one.
 
-    Once a valid packet is found, it returns a dict with fields:
+    Once a valid frame is applied, it returns a dict with fields:
         "cc_milli", "cv_milli", "cr_milli", "cp_milli", "temp_milli"
     """
 
     # Parser states
-    PARSER_WAIT_START = 0
-    PARSER_WAIT_DATA  = 1
-    PARSER_WAIT_CS    = 2
-
-    # The load’s TX magic word (0x2B2B2B2B)
-    RX_MAGIC_WORD = 0x2B2B2B2B
-    RX_DATA_SIZE  = 20  # size of load_measurement_t (5 x uint32_t)
-    RX_MSG_SIZE   = 28  # 4 (magic) + 20 (data) + 4 (checksum)
+    PARSER_WAIT_SYNC   = 0
+    PARSER_WAIT_HEADER = 1
+    PARSER_WAIT_DATA   = 2
 
     def __init__(self):
-        self.parser_state = self.PARSER_WAIT_START
-        self.current_byte = 0
-        self.buffer = bytearray(self.RX_MSG_SIZE)
+        self.parser_state = self.PARSER_WAIT_SYNC
+        self.buffer = bytearray()
+        self.length = 0
 
-        # The top byte of 0x2B2B2B2B is 0x2B
-        self.magic_first_byte = (self.RX_MAGIC_WORD >> 24) & 0xFF
+        self._seq = 0
+        self._synced = False
+        self._words = [0] * MEASUREMENT_WORDS
 
     def parse_byte(self, incoming_byte: int):
         """
         Feed a single byte into the parser state machine.
         Returns:
-            - None if we are still waiting for a full packet
-            - 28-byte `bytes` if a full packet is found
+            - None if we are still waiting for a full frame or the CRC is wrong
+            - (type, seq, payload) if a full frame is found
         """
-        if self.parser_state == self.PARSER_WAIT_START:
-            # Looking for the first byte of the magic word (0x2B)
-            if incoming_byte == self.magic_first_byte:
-                self.buffer[self.current_byte] = incoming_byte
-                self.current_byte += 1
-                if self.current_byte == 4:
-                    # We might have matched 4 bytes of magic
-                    self.parser_state = self.PARSER_WAIT_DATA
-            else:
-                self.current_byte = 0  # restart
-
-        elif self.parser_state == self.PARSER_WAIT_DATA:
-            self.buffer[self.current_byte] = incoming_byte
-            self.current_byte += 1
-            if self.current_byte == 4 + self.RX_DATA_SIZE:
-                # Next we expect the checksum
-                self.parser_state = self.PARSER_WAIT_CS
-
-        elif self.parser_state == self.PARSER_WAIT_CS:
-            self.buffer[self.current_byte] = incoming_byte
-            self.current_byte += 1
-            if self.current_byte == self.RX_MSG_SIZE:
-                # We have all 28 bytes
-                complete_message = bytes(self.buffer)
-
-                # Reset parser for next time
-                self.parser_state = self.PARSER_WAIT_START
-                self.current_byte = 0
-
-                return complete_message
+        if self.parser_state == self.PARSER_WAIT_SYNC:
+            if incoming_byte == SYNC_BYTE:
+                self.buffer = bytearray()
+                self.parser_state = self.PARSER_WAIT_HEADER
+            return None
 
-        else:
-            # Shouldn't happen, reset
-            self.parser_state = self.PARSER_WAIT_START
-            self.current_byte = 0
+        if self.parser_state == self.PARSER_WAIT_HEADER and not self.buffer and incoming_byte > PAYLOAD_MAX:
+            # A length that can't fit is a false sync
+            self.parser_state = self.PARSER_WAIT_SYNC
+            return None
 
-        return None
+        self.buffer.append(incoming_byte)
 
-    def parse_message(self, msg: bytes):
-        """
-        Given a 28-byte message, validate magic & checksum,
-        then parse out the load_measurement_t data.
-        Returns:
-            dict with keys cc_milli, cv_milli, cr_milli, cp_milli, temp_milli
-            or None if invalid.
-        """
-        if len(msg) != self.RX_MSG_SIZE:
+        if self.parser_state == self.PARSER_WAIT_HEADER:
+            if len(self.buffer) == HEADER_SIZE - 1:
+                self.length = self.buffer[0]
+                self.parser_state = self.PARSER_WAIT_DATA
             return None
 
-        magic_word, = struct.unpack_from("<I", msg, 0)
-        if magic_word != self.RX_MAGIC_WORD:
+        if len(self.buffer) < HEADER_SIZE - 1 + self.length + CRC_SIZE:
             return None
 
-        data_section = msg[4 : 4 + self.RX_DATA_SIZE]  # next 20 bytes
-        checksum, = struct.unpack_from("<I", msg, 4 + self.RX_DATA_SIZE)
+        self.parser_state = self.PARSER_WAIT_SYNC
+
+        body = bytes(self.buffer[:-CRC_SIZE])
+        crc, = struct.unpack_from("<H", self.buffer, len(body))
+        if crc16_ccitt(body) != crc:
+            return None
+
+        _, msg_type, seq = struct.unpack_from("<BBB", body, 0)
+
+        # A gap means a state frame may be lost, deltas wait for the next whole struct
+        if seq != self._seq:
+            self._synced = False
+        self._seq = (seq + 1) & 0xFF
 
-        # Recompute checksum over the first 24 bytes
-        calc_sum = sum(msg[0 : 4 + self.RX_DATA_SIZE]) & 0xFFFFFFFF
-        if calc_sum != checksum:
+        return msg_type, seq, body[HEADER_SIZE - 1:]
+
+    def parse_message(self, frame):
+        """
+        Given a frame from parse_byte(), apply it to the last known
+        load_measurement_t.
+        Returns:
+            dict with keys cc_milli, cv_milli, cr_milli, cp_milli, temp_milli
+            or None if the frame is not a measurement or can't be applied.
+        """
+        msg_type, _, payload = frame
+
+        if msg_type == MSG_MEASUREMENT:
+            if len(payload) != MEASUREMENT_WORDS * 4:
+                return None
+            self._words = list(struct.unpack("<{}I".format(MEASUREMENT_WORDS), payload))
+            self._synced = True
+        elif msg_type == MSG_MEASUREMENT_DELTA and self._synced and len(payload) >= 2:
+            mask, = struct.unpack_from("<H", payload, 0)
+            indexes = [i for i in range(MEASUREMENT_WORDS) if mask & (1 << i)]
+            if mask >> MEASUREMENT_WORDS or len(payload) != 2 + 4 * len(indexes):
+                return None
+            values = struct.unpack_from("<{}I".format(len(indexes)), payload, 2)
+            for i, value in zip(indexes, values):
+                self._words[i] = value
+        else:
             return None
 
-        # Unpack the 5 measurement fields
-        cc_milli, cv_milli, cr_milli, cp_milli, temp_milli = struct.unpack("<5I", data_section)
+        cc_milli, cv_milli, cr_milli, cp_milli, temp_milli = self._words
 
         return {
             "cc_milli": cc_milli,
@@ -162,12 +258,16 @@ class ElectronicLoadSDK:
     High-level SDK that:
       - Connects to the load via a serial port.
       - Spawns two threads:
-          1) Writer: periodically sends “panel_to_load_t” with the SDK’s current
-             settings (enable, mode, and setpoints for CC, CV, CR, CP).
+          1) Writer: periodically sends the SDK’s current settings (enable, mode,
+             and setpoints for CC, CV, CR, CP), as deltas between keyframes.
           2) Reader: continuously parses inbound “load_measurement_t” messages
              to update the latest measured values (cc, cv, cr, cp, temperature).
       - Provides API methods to enable/disable, set modes and setpoints, and get
         measured current/voltage/resistance/power.
+
+    With native=True the I/O runs in the native client of sdk/native instead of
+    the two threads: settings are sent as soon as they change and then every
+    write_interval, measurements and telemetry are parsed in bulk as they arrive.
     """
 
     MODE_CC = 0  # Constant Current
@@ -175,11 +275,16 @@ class ElectronicLoadSDK:
     MODE_CR = 2  # Constant Resistance
     MODE_CP = 3  # Constant Power
 
-    def __init__(self, port="/dev/ttyACM0", baud=115200,
-                 write_interval=1.0, read_interval=0.01):
+    # Telemetry samples kept until read with get_telemetry()
+    TELEMETRY_BACKLOG = 100000
+
+    def __init__(self, port="/dev/ttyACM0", baud=1000000,
+                 write_interval=0.05, read_interval=0.01, native=False):
         # Connection params
         self._port = port
         self._baud = baud
+        self._native = native
+        self._client = None
 
         # Thread intervals
         self._write_interval = write_interval
@@ -190,6 +295,9 @@ class ElectronicLoadSDK:
         self._stop_event = threading.Event()
         self._lock = threading.Lock()
         self._parser = LoadParser()
+        self._encoder = FrameEncoder(MSG_CONTROL, MSG_CONTROL_DELTA)
+        self._telemetry = collections.deque(maxlen=self.TELEMETRY_BACKLOG)
+        self._telemetry_dropped = 0
 
         # Worker threads
         self._writer_thread = None
@@ -230,6 +338,16 @@ class ElectronicLoadSDK:
 
     def connect(self):
         """Open serial port and start background threads."""
+        if self._native:
+            import load_native
+
+            with self._lock:
+                if self._client is not None:
+                    return  # already connected
+                self._client = load_native.LoadClient(self._port, self._baud, self._write_interval)
+            self._push_control()
+            return
+
         with self._lock:
             if self._ser is not None:
                 return  # already connected
@@ -246,6 +364,13 @@ class ElectronicLoadSDK:
 
     def disconnect(self):
         """Signal threads to stop, then close the serial port."""
+        if self._native:
+            with self._lock:
+                if self._client is not None:
+                    self._client.close()
+                    self._client = None
+            return
+
         with self._lock:
             if self._ser is None:
                 return  # already disconnected
@@ -268,11 +393,13 @@ class ElectronicLoadSDK:
         """Enable the load (set enable=1)."""
         with self._lock:
             self._enable = 1
+        self._push_control()
 
     def disable_load(self):
         """Disable the load (set enable=0)."""
         with self._lock:
             self._enable = 0
+        self._push_control()
 
     def set_cc(self, milli_amp):
         """
@@ -281,6 +408,7 @@ class ElectronicLoadSDK:
         with self._lock:
             self._mode = self.MODE_CC
             self._cc_value = int(milli_amp)
+        self._push_control()
 
     def set_cv(self, milli_volt):
         """
@@ -289,6 +417,7 @@ class ElectronicLoadSDK:
         with self._lock:
             self._mode = self.MODE_CV
             self._cv_value = int(milli_volt)
+        self._push_control()
 
     def set_cr(self, milli_ohm):
         """
@@ -297,6 +426,7 @@ class ElectronicLoadSDK:
         with self._lock:
             self._mode = self.MODE_CR
             self._cr_value = int(milli_ohm)
+        self._push_control()
 
     def set_cp(self, milli_watt):
         """
@@ -305,31 +435,66 @@ class ElectronicLoadSDK:
         with self._lock:
             self._mode = self.MODE_CP
             self._cp_value = int(milli_watt)
+        self._push_control()
 
     def get_current(self):
         """Return the last measured CC (in mA) from the device."""
-        with self._lock:
-            return self._last_measurement["cc_milli"]
+        return self.get_measurements()["cc_milli"]
 
     def get_voltage(self):
         """Return the last measured CV (in mV) from the device."""
-        with self._lock:
-            return self._last_measurement["cv_milli"]
+        return self.get_measurements()["cv_milli"]
 
     def get_resistance(self):
         """Return the last measured CR (in milliohms) from the device."""
-        with self._lock:
-            return self._last_measurement["cr_milli"]
+        return self.get_measurements()["cr_milli"]
 
     def get_power(self):
         """Return the last measured CP (in mW) from the device."""
-        with self._lock:
-            return self._last_measurement["cp_milli"]
+        return self.get_measurements()["cp_milli"]
 
     def get_temperature(self):
         """Return the last measured temperature (in milli-degC, if device provides it)."""
+        return self.get_measurements()["temp_milli"]
+
+    def set_telemetry(self, mode, batch=TELEMETRY_BATCH_MAX, decimation=1):
+        """
+        Configure the telemetry stream: mode is TELEMETRY_OFF, TELEMETRY_FILTERED or
+        TELEMETRY_RAW, batch the samples per frame (1 to TELEMETRY_BATCH_MAX) and
+        decimation the control periods per sample, or the conversion pairs in raw mode.
+        """
+        if not 1 <= batch <= TELEMETRY_BATCH_MAX or not 1 <= decimation <= 0xFFFF:
+            raise ValueError("invalid telemetry batch or decimation")
+
+        with self._lock:
+            if self._client:
+                self._client.set_telemetry(mode, batch, decimation)
+                return
+
+            self._telemetry.clear()
+            if self._ser:
+                self._ser.write(_build_telemetry_config_message(self._encoder, mode, batch, decimation))
+
+    def get_telemetry(self):
+        """
+        Return and forget the telemetry samples received so far, oldest first.
+        Each one is a dict with timestamp_us, voltage_milli, current_milli,
+        temperature_centi and dac_code.
+        """
         with self._lock:
-            return self._last_measurement["temp_milli"]
+            if self._client:
+                return self._client.read_telemetry()
+
+            samples = list(self._telemetry)
+            self._telemetry.clear()
+            return samples
+
+    def get_telemetry_dropped(self):
+        """Return the samples the load dropped because the link was too slow."""
+        with self._lock:
+            if self._client:
+                return self._client.stats()["telemetry_dropped"]
+            return self._telemetry_dropped
 
     def get_measurements(self):
         """
@@ -343,12 +508,43 @@ class ElectronicLoadSDK:
             }
         """
         with self._lock:
+            if self._client:
+                return self._client.get_measurement()
             return dict(self._last_measurement)
 
+    def _control_settings(self):
+        """Current enable, mode and CC/CV/CR/CP set points, must be called with the lock held."""
+        def set_point(value, min_value, max_value):
+            return {"value_milli": value, "min_value_milli": min_value, "max_value_milli": max_value}
+
+        return (
+            self._enable,
+            self._mode,
+            set_point(self._cc_value, self._cc_min, self._cc_max),
+            set_point(self._cv_value, self._cv_min, self._cv_max),
+            set_point(self._cr_value, self._cr_min, self._cr_max),
+            set_point(self._cp_value, self._cp_min, self._cp_max),
+        )
+
+    def _push_control(self):
+        """Hand the settings to the native client, the Python writer thread sends them on its own."""
+        with self._lock:
+            if not self._client:
+                return
+
+            import load_native
+
+            enable, mode, *set_points = self._control_settings()
+            control = load_native.Control(enable, mode, *(
+                load_native.SetPoint(sp["value_milli"], sp["min_value_milli"], sp["max_value_milli"])
+                for sp in set_points
+            ))
+            self._client.set_control(control)
+
     def _writer_loop(self):
         """
-        Periodically build and send the 64-byte "panel_to_load_t" packet
-        based on the current enable, mode, and setpoint values.
+        Periodically build and send the control frame based on the current
+        enable, mode, and setpoint values.
         """
         while True:
             with self._lock:
@@ -357,37 +553,8 @@ class ElectronicLoadSDK:
                 if not self._ser:
                     break
 
-                # Build the sub-structs for CC, CV, CR, CP
-                cc_struct = {
-                    "value_milli": self._cc_value,
-                    "min_value_milli": self._cc_min,
-                    "max_value_milli": self._cc_max,
-                }
-                cv_struct = {
-                    "value_milli": self._cv_value,
-                    "min_value_milli": self._cv_min,
-                    "max_value_milli": self._cv_max,
-                }
-                cr_struct = {
-                    "value_milli": self._cr_value,
-                    "min_value_milli": self._cr_min,
-                    "max_value_milli": self._cr_max,
-                }
-                cp_struct = {
-                    "value_milli": self._cp_value,
-                    "min_value_milli": self._cp_min,
-                    "max_value_milli": self._cp_max,
-                }
-
-                # Build the 64-byte payload
-                msg = _build_panel_to_load_message(
-                    self._enable,
-                    self._mode,
-                    cc_struct,
-                    cv_struct,
-                    cr_struct,
-                    cp_struct
-                )
+                # Build the frame, unchanged settings go as an empty delta
+                msg = _build_panel_to_load_message(self._encoder, *self._control_settings())
 
                 # Send out over serial
                 self._ser.write(msg)
@@ -406,15 +573,24 @@ class ElectronicLoadSDK:
                 if not self._ser:
                     break
 
-                incoming_data = self._ser.read(32)  # read up to 32 bytes each time
+                # Drain whatever arrived, telemetry can stream faster than a fixed chunk
+                incoming_data = self._ser.read(max(1, self._ser.in_waiting))
 
             # Parse each byte
             for b in incoming_data:
                 complete_msg = self._parser.parse_byte(b)
                 if complete_msg:
+                    batch = parse_telemetry(complete_msg)
+                    if batch is not None:
+                        with self._lock:
+                            self._telemetry.extend(batch["samples"])
+                            self._telemetry_dropped = batch["dropped"]
+                        continue
+
                     result = self._parser.parse_message(complete_msg)
                     if result is not None:
                         with self._lock:
                             self._last_measurement = result
 
-            time.sleep(self._read_interval)
+            if not incoming_data:
+                time.sleep(self._read_interval)
@@ -0,0 +1,145 @@
+#ifndef __LOAD_BUS_H__
+#define __LOAD_BUS_H__
+
+#include <stdint.h>
+
+#include "server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Host controller of several loads sharing one serial link, each load set to its own address.
+ *
+ * A single I/O thread owns the link and polls the loads in turn, one slot per load and per round. In its slot a load
+ * first gets the commands queued for it, then a poll, and answers with its pending acknowledgements, at most one
+ * telemetry batch and its measurement, which ends the slot. Every load gets the same share of the link whatever the
+ * others do: the answers are bounded and a load that stays silent for LOAD_BUS_POLL_TIMEOUT_MS loses its slot. A
+ * silent load is then polled every 2, 4... up to LOAD_BUS_BACKOFF_MAX rounds, so that dead loads cost the others
+ * little and are found again once they answer.
+ *
+ * Set points can also be changed on every load at once: the command is staged by all of them and applied on the same
+ * sync frame, then acknowledged by each load in its next slot.
+ *
+ * The protocol state lives in server.c, shared with the firmware, so a bus can't be open together with a
+ * load_client_t, nor with another bus.
+ */
+
+/** Loads on a bus, addresses go from 1 to 255 */
+#define LOAD_BUS_LOADS_MAX 32U
+
+/** Wait for the answer of a load to its poll */
+#define LOAD_BUS_POLL_TIMEOUT_MS 20U
+
+/** Rounds skipped at most by a load that doesn't answer */
+#define LOAD_BUS_BACKOFF_MAX 16U
+
+/** Commands sent to a load in a single slot */
+#define LOAD_BUS_COMMANDS_PER_SLOT 4U
+
+/** Commands waiting for their acknowledgement, per load */
+#define LOAD_BUS_COMMANDS_PENDING 8U
+
+/** Wait for an acknowledgement before a command is sent again */
+#define LOAD_BUS_COMMAND_RETRY_MS 50U
+
+typedef struct load_bus load_bus_t;
+
+/**
+ * @brief Counters of a load.
+ */
+typedef struct load_bus_stats
+{
+  uint64_t polls;              /**< Slots the load was polled in */
+  uint64_t timeouts;           /**< Polls left without a measurement */
+  uint64_t skipped;            /**< Rounds skipped while backing off */
+  uint64_t measurements;       /**< Measurement frames applied */
+  uint64_t telemetry_samples;  /**< Telemetry samples received, the samples themselves are not kept */
+  uint64_t commands;           /**< Commands sent, retries excluded */
+  uint64_t command_retries;    /**< Commands sent again for a missing acknowledgement */
+  uint64_t command_acks;       /**< Acknowledgements matched to a pending command */
+} load_bus_stats_t;
+
+/**
+ * @brief Opens the serial device and starts polling the loads.
+ *
+ * @param device Serial device path, e.g. /dev/ttyUSB0
+ * @param baud Baud rate, one of the standard termios rates
+ * @param addresses Addresses of the loads, polled in this order
+ * @param count Number of loads, up to LOAD_BUS_LOADS_MAX
+ * @return load_bus_t* NULL with errno set on failure, EINVAL on a wrong address, EBUSY if a bus is already open
+ */
+load_bus_t *load_bus_open(const char *device, uint32_t baud, const uint8_t *addresses, uint32_t count);
+
+/**
+ * @brief Stops polling and closes the device.
+ *
+ * @param bus Bus, may be NULL
+ */
+void load_bus_close(load_bus_t *bus);
+
+/**
+ * @brief Sends a single setting change to a load in its next slot and waits for the acknowledgement, sending it again
+ *        every LOAD_BUS_COMMAND_RETRY_MS meanwhile.
+ *
+ * @param bus Bus
+ * @param address Load
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @param ack Where the acknowledgement is stored, may be NULL
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return int 0 once acknowledged, even if rejected, -1 with errno set on timeout (ETIMEDOUT), link loss (EIO),
+ *         unknown load (EINVAL) or too many commands pending (EBUSY)
+ */
+int load_bus_command(load_bus_t *bus, uint8_t address, load_command_key_t key, uint32_t value, load_ack_t *ack,
+                     int timeout_ms);
+
+/**
+ * @brief Changes a setting on every load at once: the command is staged by all of them, applied on a single sync
+ *        frame and waited for until every load has acknowledged it. Loads that miss it get it again addressed, on a
+ *        new sync, every LOAD_BUS_COMMAND_RETRY_MS.
+ *
+ * @param bus Bus
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @param acks Acknowledgements, in the order of the addresses given to load_bus_open(), may be NULL
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return int Number of loads that acknowledged, -1 with errno set on link loss (EIO) or another broadcast in
+ *         progress (EBUSY). Fewer than all the loads means the others timed out, or had too many commands
+ *         pending to take this one.
+ */
+int load_bus_broadcast(load_bus_t *bus, load_command_key_t key, uint32_t value, load_ack_t *acks, int timeout_ms);
+
+/**
+ * @brief Last known measurement of a load.
+ *
+ * @param bus Bus
+ * @param address Load
+ * @param measurement Where the measurement is stored
+ * @return uint64_t Number of measurements applied so far, 0 if none yet or for an unknown load
+ */
+uint64_t load_bus_get_measurement(load_bus_t *bus, uint8_t address, load_measurement_t *measurement);
+
+/**
+ * @brief Counters of a load.
+ *
+ * @param bus Bus
+ * @param address Load
+ * @param stats Where the counters are stored, zeroed for an unknown load
+ */
+void load_bus_get_stats(load_bus_t *bus, uint8_t address, load_bus_stats_t *stats);
+
+/**
+ * @brief Polling rounds completed, every load had its slot or was skipped in each.
+ *
+ * @param bus Bus
+ * @return uint64_t Rounds
+ */
+uint64_t load_bus_get_rounds(load_bus_t *bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LOAD_BUS_H__
@@ -0,0 +1,197 @@
+#ifndef __LOAD_CLIENT_H__
+#define __LOAD_CLIENT_H__
+
+#include <stdint.h>
+
+#include "server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Host client of the load, speaking the panel side of the v2 protocol over a serial device.
+ *
+ * A single I/O thread waits on the device, a timer and a wake-up event with epoll. Received bytes are read in bulk
+ * into a ring buffer and the frames are located in place with server_frame_find(). The last control settings are
+ * sent again every control period, as the panel does, so the load keeps its watchdog fed.
+ *
+ * Setting changes also go right away as commands, which the load acknowledges once its control loop runs with them.
+ * The round trip and the application latency reported by the load are kept as histograms.
+ *
+ * Measurements are kept as the last known `load_measurement_t`, telemetry samples are queued in a ring buffer.
+ * Both can also be delivered by callbacks, called from the I/O thread, which must return quickly.
+ *
+ * The protocol state lives in server.c, shared with the firmware, so only one client can be open at a time.
+ */
+
+/** Default period of the control frames, as the panel sends them */
+#define LOAD_CLIENT_CONTROL_PERIOD_MS 50U
+
+/** Telemetry samples queued until read, older ones are overwritten */
+#define LOAD_CLIENT_TELEMETRY_QUEUE 65536U
+
+/** Commands waiting for their acknowledgement */
+#define LOAD_CLIENT_COMMANDS_PENDING 16U
+
+/** Wait for an acknowledgement before a command is sent again */
+#define LOAD_CLIENT_COMMAND_RETRY_MS 50U
+
+typedef struct load_client load_client_t;
+
+/**
+ * @brief Called from the I/O thread on every measurement frame applied.
+ *
+ * @param measurement Last known measurement
+ * @param context Pointer given to load_client_set_callbacks()
+ */
+typedef void (*load_client_measurement_cb_t)(const load_measurement_t *measurement, void *context);
+
+/**
+ * @brief Called from the I/O thread on every telemetry batch received.
+ *
+ * @param samples Samples of the batch, oldest first
+ * @param count Number of samples
+ * @param dropped Samples the load dropped since the stream was configured
+ * @param context Pointer given to load_client_set_callbacks()
+ */
+typedef void (*load_client_telemetry_cb_t)(const telemetry_sample_t *samples, uint32_t count, uint32_t dropped, void *context);
+
+/**
+ * @brief Link counters.
+ */
+typedef struct load_client_stats
+{
+  uint64_t bytes_received;      /**< Bytes read from the device */
+  uint64_t frames_received;     /**< Frames with a valid CRC */
+  uint64_t measurements;        /**< Measurement frames applied */
+  uint64_t telemetry_samples;   /**< Telemetry samples received */
+  uint64_t telemetry_overruns;  /**< Samples overwritten before being read */
+  uint32_t telemetry_dropped;   /**< Samples the load dropped, from the last batch */
+  uint64_t commands;            /**< Commands sent, retries excluded */
+  uint64_t command_retries;     /**< Commands sent again for a missing acknowledgement */
+  uint64_t command_acks;        /**< Acknowledgements matched to a pending command */
+} load_client_stats_t;
+
+/**
+ * @brief Opens the serial device and starts the I/O thread.
+ *
+ * @param device Serial device path, e.g. /dev/ttyACM0
+ * @param baud Baud rate, one of the standard termios rates
+ * @param control_period_ms Period of the control frames, 0 for LOAD_CLIENT_CONTROL_PERIOD_MS
+ * @return load_client_t* NULL with errno set on failure, EBUSY if a client is already open
+ */
+load_client_t *load_client_open(const char *device, uint32_t baud, uint32_t control_period_ms);
+
+/**
+ * @brief Stops the I/O thread and closes the device.
+ *
+ * @param client Client, may be NULL
+ */
+void load_client_close(load_client_t *client);
+
+/**
+ * @brief Sets the callbacks, either may be NULL.
+ *
+ * @param client Client
+ * @param on_measurement Called on every measurement applied
+ * @param on_telemetry Called on every telemetry batch
+ * @param context Passed back to the callbacks
+ */
+void load_client_set_callbacks(load_client_t *client, load_client_measurement_cb_t on_measurement,
+                               load_client_telemetry_cb_t on_telemetry, void *context);
+
+/**
+ * @brief Sends the control settings now and keeps sending them every control period.
+ *        The settings changed since the last call also go as commands, without waiting for their acknowledgements.
+ *
+ * @param client Client
+ * @param control Settings
+ * @return int 0 on success, -1 with errno set on a write error
+ */
+int load_client_set_control(load_client_t *client, const load_control_t *control);
+
+/**
+ * @brief Sends a single setting change and waits for the load to acknowledge it, sending it again every
+ *        LOAD_CLIENT_COMMAND_RETRY_MS meanwhile. The periodic control settings are not updated.
+ *
+ * @param client Client
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @param ack Where the acknowledgement is stored, may be NULL
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return int 0 once acknowledged, even if rejected, -1 with errno set on timeout (ETIMEDOUT), link loss (EIO),
+ *         too many commands pending (EBUSY) or a write error
+ */
+int load_client_command(load_client_t *client, load_command_key_t key, uint32_t value, load_ack_t *ack, int timeout_ms);
+
+/**
+ * @brief Command latency histograms.
+ *
+ * @param client Client
+ * @param round_trip Command sent to acknowledgement received, may be NULL
+ * @param apply Command received to applied, as reported by the load, may be NULL
+ */
+void load_client_get_latency(load_client_t *client, server_latency_t *round_trip, server_latency_t *apply);
+
+/**
+ * @brief Sends a waveform player command.
+ *
+ * @param client Client
+ * @param waveform Command
+ * @return int 0 on success, -1 with errno set on a write error
+ */
+int load_client_send_waveform(load_client_t *client, const load_waveform_t *waveform);
+
+/**
+ * @brief Configures the telemetry stream, the samples queued so far are discarded.
+ *
+ * @param client Client
+ * @param config Settings
+ * @return int 0 on success, -1 with errno set on invalid settings or a write error
+ */
+int load_client_set_telemetry(load_client_t *client, const load_telemetry_config_t *config);
+
+/**
+ * @brief Last known measurement.
+ *
+ * @param client Client
+ * @param measurement Where the measurement is stored
+ * @return uint64_t Number of measurements applied so far, 0 if none yet
+ */
+uint64_t load_client_get_measurement(load_client_t *client, load_measurement_t *measurement);
+
+/**
+ * @brief Waits for a measurement newer than `after`.
+ *
+ * @param client Client
+ * @param after Count returned by load_client_get_measurement() or a previous wait
+ * @param measurement Where the measurement is stored
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return uint64_t Number of measurements applied so far, 0 with errno set on timeout (ETIMEDOUT) or link loss (EIO)
+ */
+uint64_t load_client_wait_measurement(load_client_t *client, uint64_t after, load_measurement_t *measurement, int timeout_ms);
+
+/**
+ * @brief Takes the oldest queued telemetry samples.
+ *
+ * @param client Client
+ * @param samples Where the samples are stored
+ * @param max Maximum number of samples
+ * @return uint32_t Number of samples taken
+ */
+uint32_t load_client_read_telemetry(load_client_t *client, telemetry_sample_t *samples, uint32_t max);
+
+/**
+ * @brief Link counters.
+ *
+ * @param client Client
+ * @param stats Where the counters are stored
+ */
+void load_client_get_stats(load_client_t *client, load_client_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LOAD_CLIENT_H__
@@ -0,0 +1,185 @@
+#ifndef __LOAD_CLIENT_HPP__
+#define __LOAD_CLIENT_HPP__
+
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "load_client.h"
+
+namespace load
+{
+
+/**
+ * @brief RAII wrapper of load_client_t, errors are thrown as std::system_error.
+ */
+class Client
+{
+public:
+  using MeasurementCallback = std::function<void(const load_measurement_t &)>;
+  using TelemetryCallback = std::function<void(const telemetry_sample_t *samples, uint32_t count, uint32_t dropped)>;
+
+  /**
+   * @brief Opens the serial device and starts the I/O thread.
+   *
+   * @param device Serial device path
+   * @param baud Baud rate
+   * @param control_period Period of the control frames
+   */
+  explicit Client(const std::string &device, uint32_t baud = 1000000U,
+                  std::chrono::milliseconds control_period = std::chrono::milliseconds(LOAD_CLIENT_CONTROL_PERIOD_MS))
+    : client_(load_client_open(device.c_str(), baud, static_cast<uint32_t>(control_period.count())))
+  {
+    if (client_ == nullptr) {
+      throw std::system_error(errno, std::generic_category(), "load_client_open " + device);
+    }
+  }
+
+  ~Client()
+  {
+    load_client_close(client_);
+  }
+
+  Client(const Client &) = delete;
+  Client &operator=(const Client &) = delete;
+
+  /**
+   * @brief Sets the callbacks, called from the I/O thread. Must not be changed while the client is receiving.
+   *
+   * @param on_measurement Called on every measurement applied, may be empty
+   * @param on_telemetry Called on every telemetry batch, may be empty
+   */
+  void set_callbacks(MeasurementCallback on_measurement, TelemetryCallback on_telemetry)
+  {
+    load_client_set_callbacks(client_, nullptr, nullptr, nullptr);
+    on_measurement_ = std::move(on_measurement);
+    on_telemetry_ = std::move(on_telemetry);
+    load_client_set_callbacks(client_, on_measurement_ ? measurement_trampoline : nullptr,
+                              on_telemetry_ ? telemetry_trampoline : nullptr, this);
+  }
+
+  /** @brief Sends the control settings now and keeps sending them every control period. */
+  void set_control(const load_control_t &control)
+  {
+    check(load_client_set_control(client_, &control), "load_client_set_control");
+  }
+
+  /**
+   * @brief Sends a single setting change and waits for the load to acknowledge it.
+   *
+   * @param key Setting
+   * @param value Enable flag, load_mode_t or set point value in milli-units
+   * @param timeout Maximum wait
+   * @return load_ack_t Acknowledgement, throws on timeout or link loss
+   */
+  load_ack_t command(load_command_key_t key, uint32_t value, std::chrono::milliseconds timeout)
+  {
+    load_ack_t ack;
+    check(load_client_command(client_, key, value, &ack, static_cast<int>(timeout.count())), "load_client_command");
+    return ack;
+  }
+
+  /** @brief Command sent to acknowledgement received latency histogram. */
+  server_latency_t round_trip_latency() const
+  {
+    server_latency_t latency;
+    load_client_get_latency(client_, &latency, nullptr);
+    return latency;
+  }
+
+  /** @brief Command received to applied latency histogram, as reported by the load. */
+  server_latency_t apply_latency() const
+  {
+    server_latency_t latency;
+    load_client_get_latency(client_, nullptr, &latency);
+    return latency;
+  }
+
+  /** @brief Sends a waveform player command. */
+  void send_waveform(const load_waveform_t &waveform)
+  {
+    check(load_client_send_waveform(client_, &waveform), "load_client_send_waveform");
+  }
+
+  /** @brief Configures the telemetry stream. */
+  void set_telemetry(telemetry_mode_t mode, uint8_t batch = TELEMETRY_BATCH_MAX, uint16_t decimation = 1U)
+  {
+    const load_telemetry_config_t config = { static_cast<uint8_t>(mode), batch, decimation };
+    check(load_client_set_telemetry(client_, &config), "load_client_set_telemetry");
+  }
+
+  /** @brief Last known measurement. */
+  load_measurement_t measurement() const
+  {
+    load_measurement_t measurement;
+    load_client_get_measurement(client_, &measurement);
+    return measurement;
+  }
+
+  /**
+   * @brief Waits for the next measurement.
+   *
+   * @param timeout Maximum wait
+   * @return load_measurement_t Measurement, throws on timeout or link loss
+   */
+  load_measurement_t wait_measurement(std::chrono::milliseconds timeout)
+  {
+    load_measurement_t measurement;
+    const uint64_t after = load_client_get_measurement(client_, &measurement);
+
+    if (load_client_wait_measurement(client_, after, &measurement, static_cast<int>(timeout.count())) == 0U) {
+      throw std::system_error(errno, std::generic_category(), "load_client_wait_measurement");
+    }
+    return measurement;
+  }
+
+  /**
+   * @brief Takes the queued telemetry samples.
+   *
+   * @param max Maximum number of samples
+   * @return std::vector<telemetry_sample_t> Samples, oldest first
+   */
+  std::vector<telemetry_sample_t> read_telemetry(uint32_t max = LOAD_CLIENT_TELEMETRY_QUEUE)
+  {
+    std::vector<telemetry_sample_t> samples(max);
+    samples.resize(load_client_read_telemetry(client_, samples.data(), max));
+    return samples;
+  }
+
+  /** @brief Link counters. */
+  load_client_stats_t stats() const
+  {
+    load_client_stats_t stats;
+    load_client_get_stats(client_, &stats);
+    return stats;
+  }
+
+private:
+  static void check(int result, const char *what)
+  {
+    if (result != 0) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+  }
+
+  static void measurement_trampoline(const load_measurement_t *measurement, void *context)
+  {
+    static_cast<Client *>(context)->on_measurement_(*measurement);
+  }
+
+  static void telemetry_trampoline(const telemetry_sample_t *samples, uint32_t count, uint32_t dropped, void *context)
+  {
+    static_cast<Client *>(context)->on_telemetry_(samples, count, dropped);
+  }
+
+  load_client_t *client_;
+  MeasurementCallback on_measurement_;
+  TelemetryCallback on_telemetry_;
+};
+
+} // namespace load
+
+#endif // __LOAD_CLIENT_HPP__
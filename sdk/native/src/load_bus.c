@@ -0,0 +1,848 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "load_bus.h"
+#include "serial.h"
+
+/** Definitions */
+
+/** Received bytes waiting to be parsed, holds the whole answer to a poll */
+#define RX_RING_SIZE 4096U
+
+/** Consecutive silent polls after which the backoff stops growing */
+#define BACKOFF_SHIFT_MAX 8U
+
+/** Command table entries */
+typedef enum bus_command_state
+{
+  BUS_COMMAND_FREE = 0,
+  BUS_COMMAND_QUEUED,   /**< Waiting for the slot of its load */
+  BUS_COMMAND_STAGED,   /**< Part of a broadcast, waiting for the plain frames at the start of the next round */
+  BUS_COMMAND_PENDING,  /**< Sent, waiting for the acknowledgement */
+  BUS_COMMAND_ACKED,    /**< Acknowledged, the waiting caller takes the result */
+} bus_command_state_t;
+
+typedef struct bus_command
+{
+  load_command_t command;
+  bus_command_state_t state;
+  uint64_t sent_ns;  /**< Last time the command was written, 0 if never */
+  load_ack_t ack;
+} bus_command_t;
+
+/** Outcome of a slot */
+typedef enum bus_slot
+{
+  BUS_SLOT_ANSWERED = 0,
+  BUS_SLOT_SILENT,
+  BUS_SLOT_STOP,
+  BUS_SLOT_LOST,
+} bus_slot_t;
+
+typedef struct bus_load
+{
+  uint8_t address;
+  uint32_t misses;  /**< Consecutive polls left without a measurement */
+  uint32_t skip;    /**< Rounds left to skip */
+  load_measurement_t measurement;
+  load_bus_stats_t stats;
+  bus_command_t commands[LOAD_BUS_COMMANDS_PENDING];
+} bus_load_t;
+
+_Static_assert(RX_RING_SIZE > 2U * SERVER_FRAME_SIZE_MAX, "RX ring must hold a frame while the next one is read");
+_Static_assert(LOAD_BUS_LOADS_MAX < 255U, "Addresses must fit a byte");
+
+struct load_bus
+{
+  int fd;        /**< Serial device */
+  int event_fd;  /**< Wakes the I/O thread to stop */
+  pthread_t thread;
+
+  /** State shared with the I/O thread, the I/O thread alone builds and writes frames */
+  pthread_mutex_t lock;
+  pthread_cond_t updated;
+  int link_lost;
+  bus_load_t loads[LOAD_BUS_LOADS_MAX];
+  uint32_t count;
+  uint16_t command_id;
+  uint64_t rounds;
+  /** Broadcast in progress and whether its plain frames are still to be sent */
+  int broadcast_active;
+  int broadcast_due;
+  load_command_t broadcast;
+
+  /** Only used by the I/O thread */
+  uint8_t rx_ring[RX_RING_SIZE];
+  uint32_t rx_head;
+  uint32_t rx_tail;
+};
+
+/** Globals */
+
+/** server.c holds the protocol state, a single bus may use it */
+static pthread_mutex_t bus_open_lock = PTHREAD_MUTEX_INITIALIZER;
+static int bus_open = 0;
+
+/** Prototypes */
+static bus_load_t *bus_find(load_bus_t *bus, uint8_t address);
+static bus_command_t *command_allocate(load_bus_t *bus, bus_load_t *load, load_command_key_t key, uint32_t value,
+                                       bus_command_state_t state);
+static void command_acknowledge(load_bus_t *bus, bus_load_t *load, const server_frame_t *frame);
+static uint64_t monotonic_ns(void);
+static void deadline_after(struct timespec *deadline, int timeout_ms);
+static void *io_thread(void *arg);
+static int io_broadcast(load_bus_t *bus);
+static bus_slot_t io_slot(load_bus_t *bus, bus_load_t *load);
+static int io_receive(load_bus_t *bus, const bus_load_t *polled);
+static int io_dispatch(load_bus_t *bus, const server_frame_t *frame, const bus_load_t *polled);
+static void io_wait_stop(load_bus_t *bus);
+static void lose_link(load_bus_t *bus);
+
+/**
+ * @brief Opens the serial device and starts polling the loads.
+ *
+ * @param device Serial device path, e.g. /dev/ttyUSB0
+ * @param baud Baud rate, one of the standard termios rates
+ * @param addresses Addresses of the loads, polled in this order
+ * @param count Number of loads, up to LOAD_BUS_LOADS_MAX
+ * @return load_bus_t* NULL with errno set on failure, EINVAL on a wrong address, EBUSY if a bus is already open
+ */
+load_bus_t *load_bus_open(const char *device, uint32_t baud, const uint8_t *addresses, uint32_t count)
+{
+  if (count == 0U || count > LOAD_BUS_LOADS_MAX) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  /** Plain frames are broadcasts, and each load needs its own slot */
+  for (uint32_t i = 0U; i < count; i++) {
+    for (uint32_t j = 0U; j < i; j++) {
+      if (addresses[j] == addresses[i]) {
+        errno = EINVAL;
+        return NULL;
+      }
+    }
+    if (addresses[i] == SERVER_ADDRESS_BROADCAST) {
+      errno = EINVAL;
+      return NULL;
+    }
+  }
+
+  pthread_mutex_lock(&bus_open_lock);
+  if (bus_open) {
+    pthread_mutex_unlock(&bus_open_lock);
+    errno = EBUSY;
+    return NULL;
+  }
+
+  load_bus_t *bus = calloc(1U, sizeof(load_bus_t));
+  if (bus == NULL) {
+    pthread_mutex_unlock(&bus_open_lock);
+    return NULL;
+  }
+
+  bus->fd = -1;
+  bus->event_fd = -1;
+  bus->count = count;
+  for (uint32_t i = 0U; i < count; i++) {
+    bus->loads[i].address = addresses[i];
+  }
+  pthread_mutex_init(&bus->lock, NULL);
+
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&bus->updated, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+
+  bus->fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (bus->fd < 0 || serial_configure(bus->fd, baud) != 0) {
+    goto fail;
+  }
+
+  bus->event_fd = eventfd(0U, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (bus->event_fd < 0) {
+    goto fail;
+  }
+
+  const int error = pthread_create(&bus->thread, NULL, io_thread, bus);
+  if (error != 0) {
+    errno = error;
+    goto fail;
+  }
+
+  bus_open = 1;
+  pthread_mutex_unlock(&bus_open_lock);
+  return bus;
+
+fail:;
+  const int saved = errno;
+  if (bus->fd >= 0) {
+    close(bus->fd);
+  }
+  if (bus->event_fd >= 0) {
+    close(bus->event_fd);
+  }
+  pthread_cond_destroy(&bus->updated);
+  pthread_mutex_destroy(&bus->lock);
+  free(bus);
+  pthread_mutex_unlock(&bus_open_lock);
+  errno = saved;
+  return NULL;
+}
+
+/**
+ * @brief Stops polling and closes the device.
+ *
+ * @param bus Bus, may be NULL
+ */
+void load_bus_close(load_bus_t *bus)
+{
+  if (bus == NULL) {
+    return;
+  }
+
+  const uint64_t stop = 1U;
+  (void)!write(bus->event_fd, &stop, sizeof(stop));
+  pthread_join(bus->thread, NULL);
+
+  /** The next frames built by server.c are plain again */
+  server_set_address(SERVER_ADDRESS_BROADCAST);
+
+  close(bus->event_fd);
+  close(bus->fd);
+  pthread_cond_destroy(&bus->updated);
+  pthread_mutex_destroy(&bus->lock);
+  free(bus);
+
+  pthread_mutex_lock(&bus_open_lock);
+  bus_open = 0;
+  pthread_mutex_unlock(&bus_open_lock);
+}
+
+/**
+ * @brief Sends a single setting change to a load in its next slot and waits for the acknowledgement, sending it again
+ *        every LOAD_BUS_COMMAND_RETRY_MS meanwhile.
+ *
+ * @param bus Bus
+ * @param address Load
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @param ack Where the acknowledgement is stored, may be NULL
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return int 0 once acknowledged, even if rejected, -1 with errno set on timeout (ETIMEDOUT), link loss (EIO),
+ *         unknown load (EINVAL) or too many commands pending (EBUSY)
+ */
+int load_bus_command(load_bus_t *bus, uint8_t address, load_command_key_t key, uint32_t value, load_ack_t *ack,
+                     int timeout_ms)
+{
+  struct timespec deadline;
+  deadline_after(&deadline, timeout_ms);
+
+  pthread_mutex_lock(&bus->lock);
+  bus_load_t *load = bus_find(bus, address);
+  if (load == NULL) {
+    pthread_mutex_unlock(&bus->lock);
+    errno = EINVAL;
+    return -1;
+  }
+
+  bus_command_t *entry = command_allocate(bus, load, key, value, BUS_COMMAND_QUEUED);
+  if (entry == NULL) {
+    pthread_mutex_unlock(&bus->lock);
+    errno = EBUSY;
+    return -1;
+  }
+
+  /** The I/O thread sends it in the slot of the load, and again when the acknowledgement is late */
+  int error = 0;
+  while (entry->state != BUS_COMMAND_ACKED && !bus->link_lost && error == 0) {
+    if (timeout_ms < 0) {
+      pthread_cond_wait(&bus->updated, &bus->lock);
+    } else {
+      error = pthread_cond_timedwait(&bus->updated, &bus->lock, &deadline);
+    }
+  }
+
+  int result = 0;
+  if (entry->state == BUS_COMMAND_ACKED) {
+    if (ack != NULL) {
+      *ack = entry->ack;
+    }
+  } else {
+    errno = bus->link_lost ? EIO : ETIMEDOUT;
+    result = -1;
+  }
+  entry->state = BUS_COMMAND_FREE;
+  pthread_mutex_unlock(&bus->lock);
+
+  return result;
+}
+
+/**
+ * @brief Changes a setting on every load at once: the command is staged by all of them, applied on a single sync
+ *        frame and waited for until every load has acknowledged it. Loads that miss it get it again addressed, on a
+ *        new sync, every LOAD_BUS_COMMAND_RETRY_MS.
+ *
+ * @param bus Bus
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @param acks Acknowledgements, in the order of the addresses given to load_bus_open(), may be NULL
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return int Number of loads that acknowledged, -1 with errno set on link loss (EIO) or another broadcast in
+ *         progress (EBUSY). Fewer than all the loads means the others timed out, or had too many commands
+ *         pending to take this one.
+ */
+int load_bus_broadcast(load_bus_t *bus, load_command_key_t key, uint32_t value, load_ack_t *acks, int timeout_ms)
+{
+  bus_command_t *entries[LOAD_BUS_LOADS_MAX] = { NULL };
+  struct timespec deadline;
+  deadline_after(&deadline, timeout_ms);
+
+  pthread_mutex_lock(&bus->lock);
+  if (bus->broadcast_active) {
+    pthread_mutex_unlock(&bus->lock);
+    errno = EBUSY;
+    return -1;
+  }
+
+  /** Every load holds the command under the same identifier, a load with a full table only misses it */
+  const uint16_t id = bus->command_id;
+  uint32_t staged = 0U;
+  for (uint32_t i = 0U; i < bus->count; i++) {
+    bus->command_id = id;
+    entries[i] = command_allocate(bus, &bus->loads[i], key, value, BUS_COMMAND_STAGED);
+    staged += (entries[i] != NULL) ? 1U : 0U;
+  }
+  bus->command_id = (uint16_t)(id + 1U);
+
+  bus->broadcast.id = id;
+  bus->broadcast.key = (uint8_t)key;
+  bus->broadcast.flags = COMMAND_FLAG_STAGED;
+  bus->broadcast.value = value;
+  bus->broadcast_active = 1;
+  bus->broadcast_due = 1;
+
+  int error = 0;
+  uint32_t acked = 0U;
+  for (;;) {
+    acked = 0U;
+    for (uint32_t i = 0U; i < bus->count; i++) {
+      acked += (entries[i] != NULL && entries[i]->state == BUS_COMMAND_ACKED) ? 1U : 0U;
+    }
+    if (acked == staged || bus->link_lost || error != 0) {
+      break;
+    }
+
+    if (timeout_ms < 0) {
+      pthread_cond_wait(&bus->updated, &bus->lock);
+    } else {
+      error = pthread_cond_timedwait(&bus->updated, &bus->lock, &deadline);
+    }
+  }
+
+  for (uint32_t i = 0U; i < bus->count; i++) {
+    if (entries[i] == NULL) {
+      continue;
+    }
+    if (acks != NULL && entries[i]->state == BUS_COMMAND_ACKED) {
+      acks[i] = entries[i]->ack;
+    }
+    entries[i]->state = BUS_COMMAND_FREE;
+  }
+  bus->broadcast_active = 0;
+  bus->broadcast_due = 0;
+  const int lost = bus->link_lost;
+  pthread_mutex_unlock(&bus->lock);
+
+  if (lost && acked < staged) {
+    errno = EIO;
+    return -1;
+  }
+
+  return (int)acked;
+}
+
+/**
+ * @brief Last known measurement of a load.
+ *
+ * @param bus Bus
+ * @param address Load
+ * @param measurement Where the measurement is stored
+ * @return uint64_t Number of measurements applied so far, 0 if none yet or for an unknown load
+ */
+uint64_t load_bus_get_measurement(load_bus_t *bus, uint8_t address, load_measurement_t *measurement)
+{
+  uint64_t count = 0U;
+
+  pthread_mutex_lock(&bus->lock);
+  const bus_load_t *load = bus_find(bus, address);
+  if (load != NULL) {
+    *measurement = load->measurement;
+    count = load->stats.measurements;
+  }
+  pthread_mutex_unlock(&bus->lock);
+
+  return count;
+}
+
+/**
+ * @brief Counters of a load.
+ *
+ * @param bus Bus
+ * @param address Load
+ * @param stats Where the counters are stored, zeroed for an unknown load
+ */
+void load_bus_get_stats(load_bus_t *bus, uint8_t address, load_bus_stats_t *stats)
+{
+  pthread_mutex_lock(&bus->lock);
+  const bus_load_t *load = bus_find(bus, address);
+  if (load != NULL) {
+    *stats = load->stats;
+  } else {
+    memset(stats, 0, sizeof(load_bus_stats_t));
+  }
+  pthread_mutex_unlock(&bus->lock);
+}
+
+/**
+ * @brief Polling rounds completed, every load had its slot or was skipped in each.
+ *
+ * @param bus Bus
+ * @return uint64_t Rounds
+ */
+uint64_t load_bus_get_rounds(load_bus_t *bus)
+{
+  pthread_mutex_lock(&bus->lock);
+  const uint64_t rounds = bus->rounds;
+  pthread_mutex_unlock(&bus->lock);
+
+  return rounds;
+}
+
+/** Implementations */
+
+/**
+ * @brief Load of an address.
+ *
+ * @param bus Bus
+ * @param address Address
+ * @return bus_load_t* NULL for an unknown address
+ */
+static bus_load_t *bus_find(load_bus_t *bus, uint8_t address)
+{
+  for (uint32_t i = 0U; i < bus->count; i++) {
+    if (bus->loads[i].address == address) {
+      return &bus->loads[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Takes an entry of the command table of a load for a new command. Must be called with the lock held.
+ *
+ * @param bus Bus
+ * @param load Load
+ * @param key Setting
+ * @param value Value
+ * @param state BUS_COMMAND_QUEUED for its slot, BUS_COMMAND_STAGED for the next broadcast
+ * @return bus_command_t* NULL if every entry is in use
+ */
+static bus_command_t *command_allocate(load_bus_t *bus, bus_load_t *load, load_command_key_t key, uint32_t value,
+                                       bus_command_state_t state)
+{
+  for (uint32_t i = 0U; i < LOAD_BUS_COMMANDS_PENDING; i++) {
+    bus_command_t *entry = &load->commands[i];
+    if (entry->state != BUS_COMMAND_FREE) {
+      continue;
+    }
+
+    entry->command.id = bus->command_id++;
+    entry->command.key = (uint8_t)key;
+    entry->command.flags = (state == BUS_COMMAND_STAGED) ? COMMAND_FLAG_STAGED : 0U;
+    entry->command.value = value;
+    entry->state = state;
+    entry->sent_ns = 0U;
+    return entry;
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Matches an acknowledgement to its pending command.
+ *
+ * @param bus Bus
+ * @param load Load the acknowledgement comes from
+ * @param frame Acknowledgement frame
+ */
+static void command_acknowledge(load_bus_t *bus, bus_load_t *load, const server_frame_t *frame)
+{
+  load_ack_t ack;
+  if (rx_ack(frame, &ack) != 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&bus->lock);
+  for (uint32_t i = 0U; i < LOAD_BUS_COMMANDS_PENDING; i++) {
+    bus_command_t *entry = &load->commands[i];
+    if (entry->state != BUS_COMMAND_PENDING || entry->command.id != ack.id) {
+      continue;
+    }
+
+    entry->ack = ack;
+    entry->state = BUS_COMMAND_ACKED;
+    load->stats.command_acks++;
+    pthread_cond_broadcast(&bus->updated);
+    break;
+  }
+  pthread_mutex_unlock(&bus->lock);
+}
+
+/**
+ * @brief Monotonic time.
+ *
+ * @return uint64_t Nanoseconds
+ */
+static uint64_t monotonic_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Absolute monotonic deadline for the condition waits.
+ *
+ * @param deadline Where the deadline is stored
+ * @param timeout_ms Wait from now, ignored when negative
+ */
+static void deadline_after(struct timespec *deadline, int timeout_ms)
+{
+  clock_gettime(CLOCK_MONOTONIC, deadline);
+  if (timeout_ms >= 0) {
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+      deadline->tv_sec++;
+      deadline->tv_nsec -= 1000000000L;
+    }
+  }
+}
+
+/**
+ * @brief Polls the loads in turn until stopped.
+ *
+ * @param arg Bus
+ * @return void* NULL
+ */
+static void *io_thread(void *arg)
+{
+  load_bus_t *bus = arg;
+
+  for (;;) {
+    if (io_broadcast(bus) != 0) {
+      io_wait_stop(bus);
+      return NULL;
+    }
+
+    for (uint32_t i = 0U; i < bus->count; i++) {
+      bus_load_t *load = &bus->loads[i];
+
+      if (load->skip > 0U) {
+        pthread_mutex_lock(&bus->lock);
+        load->skip--;
+        load->stats.skipped++;
+        pthread_mutex_unlock(&bus->lock);
+        continue;
+      }
+
+      const bus_slot_t slot = io_slot(bus, load);
+      if (slot == BUS_SLOT_STOP) {
+        return NULL;
+      }
+      if (slot == BUS_SLOT_LOST) {
+        io_wait_stop(bus);
+        return NULL;
+      }
+
+      /** A silent load is polled every 2, 4... up to LOAD_BUS_BACKOFF_MAX rounds */
+      if (slot == BUS_SLOT_SILENT) {
+        if (load->misses < BACKOFF_SHIFT_MAX) {
+          load->misses++;
+        }
+        const uint32_t period = 1U << load->misses;
+        load->skip = ((period < LOAD_BUS_BACKOFF_MAX) ? period : LOAD_BUS_BACKOFF_MAX) - 1U;
+      } else {
+        load->misses = 0U;
+      }
+    }
+
+    pthread_mutex_lock(&bus->lock);
+    bus->rounds++;
+    pthread_mutex_unlock(&bus->lock);
+  }
+}
+
+/**
+ * @brief Sends the plain frames of a new broadcast, the staged command and the sync applying it.
+ *
+ * @param bus Bus
+ * @return int 0 on success, -1 if the device is gone
+ */
+static int io_broadcast(load_bus_t *bus)
+{
+  uint8_t frame[2U * SERVER_FRAME_SIZE_MAX];
+  uint32_t size = 0U;
+
+  pthread_mutex_lock(&bus->lock);
+  if (bus->broadcast_due) {
+    const uint64_t now = monotonic_ns();
+
+    server_set_address(SERVER_ADDRESS_BROADCAST);
+    size = tx_command(&bus->broadcast, frame);
+    size += tx_sync(&frame[size]);
+
+    for (uint32_t i = 0U; i < bus->count; i++) {
+      for (uint32_t j = 0U; j < LOAD_BUS_COMMANDS_PENDING; j++) {
+        bus_command_t *entry = &bus->loads[i].commands[j];
+        if (entry->state == BUS_COMMAND_STAGED) {
+          entry->state = BUS_COMMAND_PENDING;
+          entry->sent_ns = now;
+          bus->loads[i].stats.commands++;
+        }
+      }
+    }
+    bus->broadcast_due = 0;
+  }
+  pthread_mutex_unlock(&bus->lock);
+
+  if (size > 0U && serial_write(bus->fd, frame, size) != 0) {
+    lose_link(bus);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Slot of a load: its due commands, a sync if some were staged, the poll, then its answer up to the
+ *        measurement.
+ *
+ * @param bus Bus
+ * @param load Load
+ * @return bus_slot_t Outcome
+ */
+static bus_slot_t io_slot(load_bus_t *bus, bus_load_t *load)
+{
+  uint8_t frame[(LOAD_BUS_COMMANDS_PER_SLOT + 2U) * SERVER_FRAME_SIZE_MAX];
+  uint32_t size = 0U;
+  uint32_t written = 0U;
+  int staged = 0;
+
+  pthread_mutex_lock(&bus->lock);
+  const uint64_t now = monotonic_ns();
+  server_set_address(load->address);
+
+  /** New commands, and the ones left without acknowledgement, which includes the missed broadcasts */
+  for (uint32_t i = 0U; i < LOAD_BUS_COMMANDS_PENDING && written < LOAD_BUS_COMMANDS_PER_SLOT; i++) {
+    bus_command_t *entry = &load->commands[i];
+    const int retry = entry->state == BUS_COMMAND_PENDING &&
+                      now - entry->sent_ns >= LOAD_BUS_COMMAND_RETRY_MS * 1000000U;
+
+    if (entry->state != BUS_COMMAND_QUEUED && !retry) {
+      continue;
+    }
+
+    if (retry) {
+      load->stats.command_retries++;
+    } else {
+      load->stats.commands++;
+    }
+    staged |= (entry->command.flags & COMMAND_FLAG_STAGED) != 0U;
+    size += tx_command(&entry->command, &frame[size]);
+    entry->state = BUS_COMMAND_PENDING;
+    entry->sent_ns = now;
+    written++;
+  }
+
+  if (staged) {
+    size += tx_sync(&frame[size]);
+  }
+  size += tx_poll(&frame[size]);
+  load->stats.polls++;
+  pthread_mutex_unlock(&bus->lock);
+
+  if (serial_write(bus->fd, frame, size) != 0) {
+    lose_link(bus);
+    return BUS_SLOT_LOST;
+  }
+
+  /** Each frame of the answer gives the load another timeout for the next one */
+  uint64_t give_up = monotonic_ns() + LOAD_BUS_POLL_TIMEOUT_MS * 1000000U;
+  for (;;) {
+    const uint64_t current = monotonic_ns();
+    if (current >= give_up) {
+      pthread_mutex_lock(&bus->lock);
+      load->stats.timeouts++;
+      pthread_mutex_unlock(&bus->lock);
+      return BUS_SLOT_SILENT;
+    }
+
+    struct pollfd fds[2] = {
+      { .fd = bus->fd, .events = POLLIN },
+      { .fd = bus->event_fd, .events = POLLIN },
+    };
+    const int ready = poll(fds, 2U, (int)((give_up - current + 999999U) / 1000000U));
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      lose_link(bus);
+      return BUS_SLOT_LOST;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      return BUS_SLOT_STOP;
+    }
+    if (ready == 0) {
+      continue;
+    }
+
+    const int received = io_receive(bus, load);
+    if (received < 0 || (fds[0].revents & (POLLHUP | POLLERR))) {
+      lose_link(bus);
+      return BUS_SLOT_LOST;
+    }
+    if (received & 2) {
+      return BUS_SLOT_ANSWERED;
+    }
+    if (received & 1) {
+      give_up = monotonic_ns() + LOAD_BUS_POLL_TIMEOUT_MS * 1000000U;
+    }
+  }
+}
+
+/**
+ * @brief Reads all pending bytes and dispatches the complete frames.
+ *
+ * @param bus Bus
+ * @param polled Load of the current slot
+ * @return int -1 if the device is gone, otherwise bit 0 set when the polled load sent a frame, bit 1 when it sent
+ *         its measurement
+ */
+static int io_receive(load_bus_t *bus, const bus_load_t *polled)
+{
+  int result = 0;
+
+  for (;;) {
+    /** Contiguous free space, a byte is kept free to tell a full ring from an empty one */
+    uint32_t room = (bus->rx_tail >= bus->rx_head) ? RX_RING_SIZE - bus->rx_tail : bus->rx_head - bus->rx_tail - 1U;
+    if (bus->rx_head == 0U && bus->rx_tail >= bus->rx_head) {
+      room--;
+    }
+
+    const ssize_t received = read(bus->fd, &bus->rx_ring[bus->rx_tail], room);
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (errno == EAGAIN) ? result : -1;
+    }
+    if (received == 0) {
+      return result;
+    }
+
+    bus->rx_tail = (bus->rx_tail + (uint32_t)received) % RX_RING_SIZE;
+
+    server_frame_t frame;
+    while (server_frame_find(bus->rx_ring, RX_RING_SIZE, &bus->rx_head, bus->rx_tail, &frame)) {
+      result |= io_dispatch(bus, &frame, polled);
+    }
+  }
+}
+
+/**
+ * @brief Applies a received frame to the load it comes from, late answers of the previous slots included.
+ *
+ * @param bus Bus
+ * @param frame Frame
+ * @param polled Load of the current slot
+ * @return int Bit 0 set when the frame comes from the polled load, bit 1 when it is its measurement
+ */
+static int io_dispatch(load_bus_t *bus, const server_frame_t *frame, const bus_load_t *polled)
+{
+  bus_load_t *load = bus_find(bus, frame->address);
+  if (load == NULL) {
+    return 0;
+  }
+
+  const int from_polled = (load == polled) ? 1 : 0;
+
+  switch (server_frame_type(frame)) {
+    case SERVER_MSG_MEASUREMENT: {
+      pthread_mutex_lock(&bus->lock);
+      load_measurement_t measurement = load->measurement;
+      const int applied = rx_data(frame, &measurement) == 0;
+      if (applied) {
+        load->measurement = measurement;
+        load->stats.measurements++;
+        pthread_cond_broadcast(&bus->updated);
+      }
+      pthread_mutex_unlock(&bus->lock);
+      return from_polled | ((from_polled && applied) ? 2 : 0);
+    }
+    case SERVER_MSG_ACK:
+      command_acknowledge(bus, load, frame);
+      return from_polled;
+    case SERVER_MSG_TELEMETRY: {
+      load_telemetry_t batch;
+      if (rx_telemetry(frame, &batch) == 0) {
+        pthread_mutex_lock(&bus->lock);
+        load->stats.telemetry_samples += batch.count;
+        pthread_mutex_unlock(&bus->lock);
+      }
+      return from_polled;
+    }
+    default:
+      return from_polled;
+  }
+}
+
+/**
+ * @brief Waits for the stop request once the device is gone, the waiters have been woken already.
+ *
+ * @param bus Bus
+ */
+static void io_wait_stop(load_bus_t *bus)
+{
+  struct pollfd stop = { .fd = bus->event_fd, .events = POLLIN };
+
+  while (poll(&stop, 1U, -1) < 0 && errno == EINTR) {
+  }
+}
+
+/**
+ * @brief Wakes the waiters once the device is gone.
+ *
+ * @param bus Bus
+ */
+static void lose_link(load_bus_t *bus)
+{
+  pthread_mutex_lock(&bus->lock);
+  bus->link_lost = 1;
+  pthread_cond_broadcast(&bus->updated);
+  pthread_mutex_unlock(&bus->lock);
+}
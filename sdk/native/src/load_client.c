@@ -0,0 +1,834 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "load_client.h"
+#include "serial.h"
+
+/** Definitions */
+
+/** Received bytes waiting to be parsed, holds many frames so a read is rarely split */
+#define RX_RING_SIZE 4096U
+
+#define TELEMETRY_QUEUE_MASK (LOAD_CLIENT_TELEMETRY_QUEUE - 1U)
+
+/** Command table entries */
+typedef enum client_command_state
+{
+  COMMAND_FREE = 0,
+  COMMAND_PENDING,  /**< Sent, waiting for the acknowledgement */
+  COMMAND_ACKED,    /**< Acknowledged, the waiting caller takes the result */
+} client_command_state_t;
+
+typedef struct client_command
+{
+  load_command_t command;
+  client_command_state_t state;
+  int waited;        /**< A caller waits on it, otherwise freed on acknowledgement */
+  uint64_t sent_ns;  /**< Last time the command was written */
+  load_ack_t ack;
+} client_command_t;
+
+_Static_assert((LOAD_CLIENT_TELEMETRY_QUEUE & TELEMETRY_QUEUE_MASK) == 0U, "Telemetry queue must be a power of two");
+_Static_assert(RX_RING_SIZE > 2U * SERVER_FRAME_SIZE_MAX, "RX ring must hold a frame while the next one is read");
+
+struct load_client
+{
+  int fd;        /**< Serial device */
+  int event_fd;  /**< Wakes the I/O thread to stop */
+  int timer_fd;  /**< Control period */
+  int epoll_fd;
+  pthread_t thread;
+
+  /** Frames are built and written under this lock, server.c keeps a single TX sequence */
+  pthread_mutex_t tx_lock;
+  load_control_t control;
+  int control_set;
+
+  /** State shared with the I/O thread */
+  pthread_mutex_t lock;
+  pthread_cond_t updated;
+  int link_lost;
+  load_measurement_t measurement;
+  telemetry_sample_t telemetry[LOAD_CLIENT_TELEMETRY_QUEUE];
+  uint64_t telemetry_head;
+  uint64_t telemetry_tail;
+  load_client_stats_t stats;
+  load_client_measurement_cb_t on_measurement;
+  load_client_telemetry_cb_t on_telemetry;
+  void *context;
+  client_command_t commands[LOAD_CLIENT_COMMANDS_PENDING];
+  uint16_t command_id;
+  server_latency_t round_trip_latency;
+  server_latency_t apply_latency;
+
+  /** Only used by the I/O thread */
+  uint8_t rx_ring[RX_RING_SIZE];
+  uint32_t rx_head;
+  uint32_t rx_tail;
+};
+
+/** Globals */
+
+/** server.c holds the protocol state, a single client may use it */
+static pthread_mutex_t client_open_lock = PTHREAD_MUTEX_INITIALIZER;
+static int client_open = 0;
+
+/** Prototypes */
+static int send_control(load_client_t *client);
+static client_command_t *command_allocate(load_client_t *client, load_command_key_t key, uint32_t value, int waited);
+static int command_write(load_client_t *client, client_command_t *entry);
+static void command_acknowledge(load_client_t *client, const server_frame_t *frame);
+static uint64_t monotonic_ns(void);
+static void *io_thread(void *arg);
+static int io_receive(load_client_t *client);
+static void io_dispatch(load_client_t *client, const server_frame_t *frame);
+static void lose_link(load_client_t *client);
+
+/**
+ * @brief Opens the serial device and starts the I/O thread.
+ *
+ * @param device Serial device path, e.g. /dev/ttyACM0
+ * @param baud Baud rate, one of the standard termios rates
+ * @param control_period_ms Period of the control frames, 0 for LOAD_CLIENT_CONTROL_PERIOD_MS
+ * @return load_client_t* NULL with errno set on failure, EBUSY if a client is already open
+ */
+load_client_t *load_client_open(const char *device, uint32_t baud, uint32_t control_period_ms)
+{
+  pthread_mutex_lock(&client_open_lock);
+  if (client_open) {
+    pthread_mutex_unlock(&client_open_lock);
+    errno = EBUSY;
+    return NULL;
+  }
+
+  load_client_t *client = calloc(1U, sizeof(load_client_t));
+  if (client == NULL) {
+    pthread_mutex_unlock(&client_open_lock);
+    return NULL;
+  }
+
+  client->fd = -1;
+  client->event_fd = -1;
+  client->timer_fd = -1;
+  client->epoll_fd = -1;
+  pthread_mutex_init(&client->tx_lock, NULL);
+  pthread_mutex_init(&client->lock, NULL);
+
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&client->updated, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+
+  if (control_period_ms == 0U) {
+    control_period_ms = LOAD_CLIENT_CONTROL_PERIOD_MS;
+  }
+
+  const struct itimerspec period = {
+    .it_interval = { control_period_ms / 1000U, (long)(control_period_ms % 1000U) * 1000000L },
+    .it_value = { control_period_ms / 1000U, (long)(control_period_ms % 1000U) * 1000000L },
+  };
+
+  client->fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (client->fd < 0 || serial_configure(client->fd, baud) != 0) {
+    goto fail;
+  }
+
+  client->event_fd = eventfd(0U, EFD_NONBLOCK | EFD_CLOEXEC);
+  client->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  client->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (client->event_fd < 0 || client->timer_fd < 0 || client->epoll_fd < 0 ||
+      timerfd_settime(client->timer_fd, 0, &period, NULL) != 0) {
+    goto fail;
+  }
+
+  const int fds[] = { client->fd, client->event_fd, client->timer_fd };
+  for (uint32_t i = 0U; i < sizeof(fds) / sizeof(fds[0]); i++) {
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = fds[i] };
+    if (epoll_ctl(client->epoll_fd, EPOLL_CTL_ADD, fds[i], &event) != 0) {
+      goto fail;
+    }
+  }
+
+  const int error = pthread_create(&client->thread, NULL, io_thread, client);
+  if (error != 0) {
+    errno = error;
+    goto fail;
+  }
+
+  client_open = 1;
+  pthread_mutex_unlock(&client_open_lock);
+  return client;
+
+fail:;
+  const int saved = errno;
+  const int to_close[] = { client->fd, client->event_fd, client->timer_fd, client->epoll_fd };
+  for (uint32_t i = 0U; i < sizeof(to_close) / sizeof(to_close[0]); i++) {
+    if (to_close[i] >= 0) {
+      close(to_close[i]);
+    }
+  }
+  pthread_cond_destroy(&client->updated);
+  pthread_mutex_destroy(&client->lock);
+  pthread_mutex_destroy(&client->tx_lock);
+  free(client);
+  pthread_mutex_unlock(&client_open_lock);
+  errno = saved;
+  return NULL;
+}
+
+/**
+ * @brief Stops the I/O thread and closes the device.
+ *
+ * @param client Client, may be NULL
+ */
+void load_client_close(load_client_t *client)
+{
+  if (client == NULL) {
+    return;
+  }
+
+  const uint64_t stop = 1U;
+  (void)!write(client->event_fd, &stop, sizeof(stop));
+  pthread_join(client->thread, NULL);
+
+  close(client->epoll_fd);
+  close(client->timer_fd);
+  close(client->event_fd);
+  close(client->fd);
+  pthread_cond_destroy(&client->updated);
+  pthread_mutex_destroy(&client->lock);
+  pthread_mutex_destroy(&client->tx_lock);
+  free(client);
+
+  pthread_mutex_lock(&client_open_lock);
+  client_open = 0;
+  pthread_mutex_unlock(&client_open_lock);
+}
+
+/**
+ * @brief Sets the callbacks, either may be NULL.
+ *
+ * @param client Client
+ * @param on_measurement Called on every measurement applied
+ * @param on_telemetry Called on every telemetry batch
+ * @param context Passed back to the callbacks
+ */
+void load_client_set_callbacks(load_client_t *client, load_client_measurement_cb_t on_measurement,
+                               load_client_telemetry_cb_t on_telemetry, void *context)
+{
+  pthread_mutex_lock(&client->lock);
+  client->on_measurement = on_measurement;
+  client->on_telemetry = on_telemetry;
+  client->context = context;
+  pthread_mutex_unlock(&client->lock);
+}
+
+/**
+ * @brief Sends the control settings now and keeps sending them every control period.
+ *
+ * @param client Client
+ * @param control Settings
+ * @return int 0 on success, -1 with errno set on a write error
+ */
+int load_client_set_control(load_client_t *client, const load_control_t *control)
+{
+  pthread_mutex_lock(&client->tx_lock);
+
+  /** Changes go first as commands, the whole settings follow as the state frame */
+  int result = 0;
+  if (client->control_set) {
+    const set_point_t *before = &client->control.cc;
+    const set_point_t *after = &control->cc;
+    uint32_t changes[COMMAND_KEY_COUNT];
+    uint32_t changed = 0U;
+
+    if (control->enable != client->control.enable) {
+      changes[changed++] = COMMAND_ENABLE;
+    }
+    if (control->mode != client->control.mode) {
+      changes[changed++] = COMMAND_MODE;
+    }
+    for (uint32_t i = 0U; i <= (uint32_t)CP; i++) {
+      if (after[i].value_milli != before[i].value_milli) {
+        changes[changed++] = COMMAND_CC + i;
+      }
+    }
+
+    for (uint32_t i = 0U; i < changed && result == 0; i++) {
+      const load_command_key_t key = (load_command_key_t)changes[i];
+      const uint32_t value = (key == COMMAND_ENABLE) ? control->enable
+                             : (key == COMMAND_MODE) ? (uint32_t)control->mode
+                                                     : after[key - COMMAND_CC].value_milli;
+
+      pthread_mutex_lock(&client->lock);
+      client_command_t *entry = command_allocate(client, key, value, 0);
+      pthread_mutex_unlock(&client->lock);
+
+      /** A full table only loses the acknowledgement, the state frame carries the change */
+      if (entry != NULL) {
+        result = command_write(client, entry);
+      }
+    }
+  }
+
+  client->control = *control;
+  client->control_set = 1;
+  if (result == 0) {
+    result = send_control(client);
+  }
+  pthread_mutex_unlock(&client->tx_lock);
+
+  return result;
+}
+
+/**
+ * @brief Sends a single setting change and waits for the load to acknowledge it, sending it again every
+ *        LOAD_CLIENT_COMMAND_RETRY_MS meanwhile. The periodic control settings are not updated.
+ *
+ * @param client Client
+ * @param key Setting
+ * @param value Enable flag, load_mode_t or set point value in milli-units
+ * @param ack Where the acknowledgement is stored, may be NULL
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return int 0 once acknowledged, even if rejected, -1 with errno set on timeout (ETIMEDOUT), link loss (EIO),
+ *         too many commands pending (EBUSY) or a write error
+ */
+int load_client_command(load_client_t *client, load_command_key_t key, uint32_t value, load_ack_t *ack, int timeout_ms)
+{
+  const uint64_t give_up = (timeout_ms >= 0) ? monotonic_ns() + (uint64_t)timeout_ms * 1000000U : UINT64_MAX;
+
+  pthread_mutex_lock(&client->lock);
+  client_command_t *entry = command_allocate(client, key, value, 1);
+  pthread_mutex_unlock(&client->lock);
+
+  if (entry == NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  int result = 0;
+  uint64_t retries = 0U;
+
+  for (;;) {
+    pthread_mutex_lock(&client->tx_lock);
+    result = command_write(client, entry);
+    pthread_mutex_unlock(&client->tx_lock);
+    if (result != 0) {
+      break;
+    }
+
+    uint64_t retry_ns = monotonic_ns() + LOAD_CLIENT_COMMAND_RETRY_MS * 1000000U;
+    if (retry_ns > give_up) {
+      retry_ns = give_up;
+    }
+    const struct timespec retry = { (time_t)(retry_ns / 1000000000U), (long)(retry_ns % 1000000000U) };
+
+    pthread_mutex_lock(&client->lock);
+    int error = 0;
+    while (entry->state != COMMAND_ACKED && !client->link_lost && error == 0) {
+      error = pthread_cond_timedwait(&client->updated, &client->lock, &retry);
+    }
+    const int done = entry->state == COMMAND_ACKED || client->link_lost;
+    pthread_mutex_unlock(&client->lock);
+
+    if (done || monotonic_ns() >= give_up) {
+      break;
+    }
+    retries++;
+  }
+
+  pthread_mutex_lock(&client->lock);
+  if (result == 0 && entry->state == COMMAND_ACKED) {
+    if (ack != NULL) {
+      *ack = entry->ack;
+    }
+  } else if (result == 0) {
+    errno = client->link_lost ? EIO : ETIMEDOUT;
+    result = -1;
+  }
+  client->stats.command_retries += retries;
+  entry->state = COMMAND_FREE;
+  pthread_mutex_unlock(&client->lock);
+
+  return result;
+}
+
+/**
+ * @brief Command latency histograms.
+ *
+ * @param client Client
+ * @param round_trip Command sent to acknowledgement received, may be NULL
+ * @param apply Command received to applied, as reported by the load, may be NULL
+ */
+void load_client_get_latency(load_client_t *client, server_latency_t *round_trip, server_latency_t *apply)
+{
+  pthread_mutex_lock(&client->lock);
+  if (round_trip != NULL) {
+    *round_trip = client->round_trip_latency;
+  }
+  if (apply != NULL) {
+    *apply = client->apply_latency;
+  }
+  pthread_mutex_unlock(&client->lock);
+}
+
+/**
+ * @brief Sends a waveform player command.
+ *
+ * @param client Client
+ * @param waveform Command
+ * @return int 0 on success, -1 with errno set on a write error
+ */
+int load_client_send_waveform(load_client_t *client, const load_waveform_t *waveform)
+{
+  uint8_t frame[SERVER_FRAME_SIZE_MAX];
+
+  pthread_mutex_lock(&client->tx_lock);
+  const int result = serial_write(client->fd, frame, tx_waveform(waveform, frame));
+  pthread_mutex_unlock(&client->tx_lock);
+
+  return result;
+}
+
+/**
+ * @brief Configures the telemetry stream, the samples queued so far are discarded.
+ *
+ * @param client Client
+ * @param config Settings
+ * @return int 0 on success, -1 with errno set on invalid settings or a write error
+ */
+int load_client_set_telemetry(load_client_t *client, const load_telemetry_config_t *config)
+{
+  if (config->mode > TELEMETRY_RAW || config->batch == 0U || config->batch > TELEMETRY_BATCH_MAX ||
+      config->decimation == 0U) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&client->lock);
+  client->telemetry_tail = client->telemetry_head;
+  pthread_mutex_unlock(&client->lock);
+
+  uint8_t frame[SERVER_FRAME_SIZE_MAX];
+
+  pthread_mutex_lock(&client->tx_lock);
+  const int result = serial_write(client->fd, frame, tx_telemetry_config(config, frame));
+  pthread_mutex_unlock(&client->tx_lock);
+
+  return result;
+}
+
+/**
+ * @brief Last known measurement.
+ *
+ * @param client Client
+ * @param measurement Where the measurement is stored
+ * @return uint64_t Number of measurements applied so far, 0 if none yet
+ */
+uint64_t load_client_get_measurement(load_client_t *client, load_measurement_t *measurement)
+{
+  pthread_mutex_lock(&client->lock);
+  *measurement = client->measurement;
+  const uint64_t count = client->stats.measurements;
+  pthread_mutex_unlock(&client->lock);
+
+  return count;
+}
+
+/**
+ * @brief Waits for a measurement newer than `after`.
+ *
+ * @param client Client
+ * @param after Count returned by load_client_get_measurement() or a previous wait
+ * @param measurement Where the measurement is stored
+ * @param timeout_ms Maximum wait, negative to wait forever
+ * @return uint64_t Number of measurements applied so far, 0 with errno set on timeout (ETIMEDOUT) or link loss (EIO)
+ */
+uint64_t load_client_wait_measurement(load_client_t *client, uint64_t after, load_measurement_t *measurement, int timeout_ms)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  if (timeout_ms >= 0) {
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  uint64_t count = 0U;
+  int error = 0;
+
+  pthread_mutex_lock(&client->lock);
+  while (client->stats.measurements <= after && !client->link_lost && error == 0) {
+    if (timeout_ms < 0) {
+      pthread_cond_wait(&client->updated, &client->lock);
+    } else {
+      error = pthread_cond_timedwait(&client->updated, &client->lock, &deadline);
+    }
+  }
+
+  if (client->stats.measurements > after) {
+    *measurement = client->measurement;
+    count = client->stats.measurements;
+  } else {
+    errno = client->link_lost ? EIO : ETIMEDOUT;
+  }
+  pthread_mutex_unlock(&client->lock);
+
+  return count;
+}
+
+/**
+ * @brief Takes the oldest queued telemetry samples.
+ *
+ * @param client Client
+ * @param samples Where the samples are stored
+ * @param max Maximum number of samples
+ * @return uint32_t Number of samples taken
+ */
+uint32_t load_client_read_telemetry(load_client_t *client, telemetry_sample_t *samples, uint32_t max)
+{
+  uint32_t taken = 0U;
+
+  pthread_mutex_lock(&client->lock);
+  while (taken < max && client->telemetry_tail != client->telemetry_head) {
+    /** Copy up to the end of the queue at a time */
+    const uint32_t first = (uint32_t)(client->telemetry_tail & TELEMETRY_QUEUE_MASK);
+    uint32_t count = (uint32_t)(client->telemetry_head - client->telemetry_tail);
+    if (count > LOAD_CLIENT_TELEMETRY_QUEUE - first) {
+      count = LOAD_CLIENT_TELEMETRY_QUEUE - first;
+    }
+    if (count > max - taken) {
+      count = max - taken;
+    }
+
+    memcpy(&samples[taken], &client->telemetry[first], count * sizeof(telemetry_sample_t));
+    client->telemetry_tail += count;
+    taken += count;
+  }
+  pthread_mutex_unlock(&client->lock);
+
+  return taken;
+}
+
+/**
+ * @brief Link counters.
+ *
+ * @param client Client
+ * @param stats Where the counters are stored
+ */
+void load_client_get_stats(load_client_t *client, load_client_stats_t *stats)
+{
+  pthread_mutex_lock(&client->lock);
+  *stats = client->stats;
+  pthread_mutex_unlock(&client->lock);
+}
+
+/** Implementations */
+
+/**
+ * @brief Sends the control settings, a delta against the last ones when possible. Must be called with the TX lock held.
+ *
+ * @param client Client
+ * @return int 0 on success, -1 with errno set otherwise
+ */
+static int send_control(load_client_t *client)
+{
+  uint8_t frame[SERVER_FRAME_SIZE_MAX];
+
+  return serial_write(client->fd, frame, tx_data(&client->control, frame));
+}
+
+/**
+ * @brief Takes an entry of the command table for a new command. Must be called with the lock held.
+ *
+ * @param client Client
+ * @param key Setting
+ * @param value Value
+ * @param waited Non zero if the caller waits for the acknowledgement
+ * @return client_command_t* NULL if every entry has a caller waiting on it
+ */
+static client_command_t *command_allocate(load_client_t *client, load_command_key_t key, uint32_t value, int waited)
+{
+  client_command_t *entry = NULL;
+
+  /** A free entry, or the oldest command nobody waits for */
+  for (uint32_t i = 0U; i < LOAD_CLIENT_COMMANDS_PENDING; i++) {
+    client_command_t *candidate = &client->commands[i];
+    if (candidate->state == COMMAND_FREE) {
+      entry = candidate;
+      break;
+    }
+    if (!candidate->waited && (entry == NULL || candidate->sent_ns < entry->sent_ns)) {
+      entry = candidate;
+    }
+  }
+
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  entry->command.id = client->command_id++;
+  entry->command.key = (uint8_t)key;
+  entry->command.flags = 0U;
+  entry->command.value = value;
+  entry->state = COMMAND_PENDING;
+  entry->waited = waited;
+  entry->sent_ns = 0U;
+  client->stats.commands++;
+
+  return entry;
+}
+
+/**
+ * @brief Writes a command. Must be called with the TX lock held.
+ *
+ * @param client Client
+ * @param entry Command
+ * @return int 0 on success, -1 with errno set otherwise
+ */
+static int command_write(load_client_t *client, client_command_t *entry)
+{
+  uint8_t frame[SERVER_FRAME_SIZE_MAX];
+
+  pthread_mutex_lock(&client->lock);
+  const uint32_t size = tx_command(&entry->command, frame);
+  entry->sent_ns = monotonic_ns();
+  pthread_mutex_unlock(&client->lock);
+
+  return serial_write(client->fd, frame, size);
+}
+
+/**
+ * @brief Matches an acknowledgement to its pending command and records the latencies.
+ *
+ * @param client Client
+ * @param frame Acknowledgement frame
+ */
+static void command_acknowledge(load_client_t *client, const server_frame_t *frame)
+{
+  load_ack_t ack;
+  if (rx_ack(frame, &ack) != 0) {
+    return;
+  }
+
+  const uint64_t now = monotonic_ns();
+
+  pthread_mutex_lock(&client->lock);
+  for (uint32_t i = 0U; i < LOAD_CLIENT_COMMANDS_PENDING; i++) {
+    client_command_t *entry = &client->commands[i];
+    if (entry->state != COMMAND_PENDING || entry->command.id != ack.id) {
+      continue;
+    }
+
+    server_latency_record(&client->round_trip_latency, (uint32_t)((now - entry->sent_ns) / 1000U));
+    server_latency_record(&client->apply_latency, ack.latency_us);
+    client->stats.command_acks++;
+
+    if (entry->waited) {
+      entry->ack = ack;
+      entry->state = COMMAND_ACKED;
+      pthread_cond_broadcast(&client->updated);
+    } else {
+      entry->state = COMMAND_FREE;
+    }
+    break;
+  }
+  pthread_mutex_unlock(&client->lock);
+}
+
+/**
+ * @brief Monotonic time.
+ *
+ * @return uint64_t Nanoseconds
+ */
+static uint64_t monotonic_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Waits on the device, the control period and the stop event.
+ *
+ * @param arg Client
+ * @return void* NULL
+ */
+static void *io_thread(void *arg)
+{
+  load_client_t *client = arg;
+  struct epoll_event events[3];
+
+  for (;;) {
+    const int ready = epoll_wait(client->epoll_fd, events, 3, -1);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      lose_link(client);
+      return NULL;
+    }
+
+    for (int i = 0; i < ready; i++) {
+      const int fd = events[i].data.fd;
+
+      if (fd == client->event_fd) {
+        return NULL;
+      }
+
+      if (fd == client->timer_fd) {
+        uint64_t expirations;
+        (void)!read(client->timer_fd, &expirations, sizeof(expirations));
+
+        pthread_mutex_lock(&client->tx_lock);
+        if (client->control_set) {
+          (void)send_control(client);
+        }
+        pthread_mutex_unlock(&client->tx_lock);
+        continue;
+      }
+
+      /** Data still pending on a hang up is read first */
+      if (io_receive(client) != 0 || (events[i].events & (EPOLLHUP | EPOLLERR))) {
+        lose_link(client);
+        /** Only a stop request ends the thread, the device stays out of the set */
+        epoll_ctl(client->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Reads all pending bytes and dispatches the complete frames.
+ *
+ * @param client Client
+ * @return int 0 on success, -1 if the device is gone
+ */
+static int io_receive(load_client_t *client)
+{
+  for (;;) {
+    /** Contiguous free space, a byte is kept free to tell a full ring from an empty one */
+    uint32_t room = (client->rx_tail >= client->rx_head) ? RX_RING_SIZE - client->rx_tail : client->rx_head - client->rx_tail - 1U;
+    if (client->rx_head == 0U && client->rx_tail >= client->rx_head) {
+      room--;
+    }
+
+    const ssize_t received = read(client->fd, &client->rx_ring[client->rx_tail], room);
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (errno == EAGAIN) ? 0 : -1;
+    }
+    if (received == 0) {
+      return 0;
+    }
+
+    client->rx_tail = (client->rx_tail + (uint32_t)received) % RX_RING_SIZE;
+
+    uint64_t frames = 0U;
+    server_frame_t frame;
+    while (server_frame_find(client->rx_ring, RX_RING_SIZE, &client->rx_head, client->rx_tail, &frame)) {
+      io_dispatch(client, &frame);
+      frames++;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    client->stats.bytes_received += (uint64_t)received;
+    client->stats.frames_received += frames;
+    pthread_mutex_unlock(&client->lock);
+  }
+}
+
+/**
+ * @brief Applies a received frame and calls back.
+ *
+ * @param client Client
+ * @param frame Frame
+ */
+static void io_dispatch(load_client_t *client, const server_frame_t *frame)
+{
+  switch (server_frame_type(frame)) {
+    case SERVER_MSG_MEASUREMENT:
+    case SERVER_MSG_MEASUREMENT_DELTA: {
+      pthread_mutex_lock(&client->lock);
+      load_measurement_t measurement = client->measurement;
+      if (rx_data(frame, &measurement) != 0) {
+        pthread_mutex_unlock(&client->lock);
+        break;
+      }
+      client->measurement = measurement;
+      client->stats.measurements++;
+      const load_client_measurement_cb_t callback = client->on_measurement;
+      void *context = client->context;
+      pthread_cond_broadcast(&client->updated);
+      pthread_mutex_unlock(&client->lock);
+
+      if (callback != NULL) {
+        callback(&measurement, context);
+      }
+      break;
+    }
+    case SERVER_MSG_ACK:
+      command_acknowledge(client, frame);
+      break;
+    case SERVER_MSG_TELEMETRY: {
+      load_telemetry_t batch;
+      if (rx_telemetry(frame, &batch) != 0) {
+        break;
+      }
+
+      pthread_mutex_lock(&client->lock);
+      for (uint32_t i = 0U; i < batch.count; i++) {
+        /** The oldest sample gives way when nobody reads them */
+        if (client->telemetry_head - client->telemetry_tail == LOAD_CLIENT_TELEMETRY_QUEUE) {
+          client->telemetry_tail++;
+          client->stats.telemetry_overruns++;
+        }
+        client->telemetry[client->telemetry_head++ & TELEMETRY_QUEUE_MASK] = batch.samples[i];
+      }
+      client->stats.telemetry_samples += batch.count;
+      client->stats.telemetry_dropped = batch.dropped;
+      const load_client_telemetry_cb_t callback = client->on_telemetry;
+      void *context = client->context;
+      pthread_cond_broadcast(&client->updated);
+      pthread_mutex_unlock(&client->lock);
+
+      if (callback != NULL) {
+        callback(batch.samples, batch.count, batch.dropped, context);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Wakes the waiters once the device is gone.
+ *
+ * @param client Client
+ */
+static void lose_link(load_client_t *client)
+{
+  pthread_mutex_lock(&client->lock);
+  client->link_lost = 1;
+  pthread_cond_broadcast(&client->updated);
+  pthread_mutex_unlock(&client->lock);
+}
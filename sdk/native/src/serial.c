@@ -0,0 +1,97 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial.h"
+
+/** Definitions */
+
+/** Maximum wait for the device to accept a frame */
+#define TX_TIMEOUT_MS 100
+
+/**
+ * @brief Puts the device in raw mode at the given rate.
+ *
+ * @param fd Serial device
+ * @param baud Baud rate
+ * @return int 0 on success, -1 with errno set otherwise
+ */
+int serial_configure(int fd, uint32_t baud)
+{
+  static const struct { uint32_t baud; speed_t speed; } speeds[] = {
+    { 9600U, B9600 }, { 19200U, B19200 }, { 38400U, B38400 }, { 57600U, B57600 },
+    { 115200U, B115200 }, { 230400U, B230400 }, { 460800U, B460800 }, { 500000U, B500000 },
+    { 921600U, B921600 }, { 1000000U, B1000000 }, { 2000000U, B2000000 },
+  };
+
+  speed_t speed = B0;
+  for (uint32_t i = 0U; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+    if (speeds[i].baud == baud) {
+      speed = speeds[i].speed;
+    }
+  }
+  if (speed == B0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct termios tty;
+  if (tcgetattr(fd, &tty) != 0) {
+    return -1;
+  }
+
+  cfmakeraw(&tty);
+  tty.c_cflag |= CLOCAL | CREAD;
+  tty.c_cflag &= ~(tcflag_t)(CSTOPB | CRTSCTS);
+  tty.c_cc[VMIN] = 0;
+  tty.c_cc[VTIME] = 0;
+
+  if (cfsetispeed(&tty, speed) != 0 || cfsetospeed(&tty, speed) != 0 || tcsetattr(fd, TCSANOW, &tty) != 0) {
+    return -1;
+  }
+
+  return tcflush(fd, TCIOFLUSH);
+}
+
+/**
+ * @brief Writes a whole frame to a non blocking device, waiting for room in its buffer.
+ *
+ * @param fd Serial device
+ * @param frame Frame
+ * @param size Frame size
+ * @return int 0 on success, -1 with errno set otherwise
+ */
+int serial_write(int fd, const uint8_t *frame, uint32_t size)
+{
+  uint32_t sent = 0U;
+
+  while (sent < size) {
+    const ssize_t written = write(fd, &frame[sent], size - sent);
+    if (written > 0) {
+      sent += (uint32_t)written;
+      continue;
+    }
+
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0 && errno != EAGAIN) {
+      return -1;
+    }
+
+    struct pollfd pending = { .fd = fd, .events = POLLOUT };
+    const int ready = poll(&pending, 1U, TX_TIMEOUT_MS);
+    if (ready == 0) {
+      errno = ETIMEDOUT;
+      return -1;
+    }
+    if (ready < 0 && errno != EINTR) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
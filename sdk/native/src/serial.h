@@ -0,0 +1,29 @@
+#ifndef __LOAD_SERIAL_H__
+#define __LOAD_SERIAL_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Serial device helpers shared by the client and the bus controller.
+ */
+
+/**
+ * @brief Puts the device in raw mode at the given rate.
+ *
+ * @param fd Serial device
+ * @param baud Baud rate
+ * @return int 0 on success, -1 with errno set otherwise
+ */
+int serial_configure(int fd, uint32_t baud);
+
+/**
+ * @brief Writes a whole frame to a non blocking device, waiting for room in its buffer.
+ *
+ * @param fd Serial device
+ * @param frame Frame
+ * @param size Frame size
+ * @return int 0 on success, -1 with errno set otherwise
+ */
+int serial_write(int fd, const uint8_t *frame, uint32_t size);
+
+#endif // __LOAD_SERIAL_H__
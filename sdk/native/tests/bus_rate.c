@@ -0,0 +1,467 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "load_bus.h"
+
+/**
+ * @brief Several load emulators sharing one link, polled by the bus controller.
+ *
+ * Usage: bus_rate EMULATOR [SECONDS]
+ *
+ * TEST_LOADS emulators are started at addresses 1 to TEST_LOADS and a relay joins their ptys into one link, as a
+ * shared line would: what the controller sends reaches every load, what a load sends reaches the controller. The
+ * controller also polls an address nobody answers to. The aggregate and per load measurement rates are reported,
+ * every load must get its share of the link, and a set point broadcast must be acknowledged by every load. A second
+ * broadcast is sent while the commands table of the silent address is full: it misses that address and must return
+ * once the other loads have acknowledged, not wait for the timeout.
+ */
+
+/** Loads on the link, the controller polls one more address */
+#define TEST_LOADS 8U
+
+/** Address polled with no load behind it */
+#define TEST_ADDRESS_SILENT (TEST_LOADS + 1U)
+
+/** Measurement rate run by default */
+#define TEST_SECONDS 3.0
+
+/** Slowest load against the fastest one */
+#define TEST_FAIRNESS 0.8
+
+/** Wait for the loads to answer after start up */
+#define TEST_START_TIMEOUT_MS 5000
+
+/** Wait for the acknowledgements */
+#define TEST_ACK_TIMEOUT_MS 1000
+
+/** Commands to the silent address fill its table for longer than the broadcast sent meanwhile can wait */
+#define TEST_FILL_TIMEOUT_MS (3 * TEST_ACK_TIMEOUT_MS)
+#define TEST_BROADCAST_TIMEOUT_MS (2 * TEST_ACK_TIMEOUT_MS)
+
+/** Relay between the controller pty and the emulator ones */
+typedef struct test_relay
+{
+  int controller;           /**< Master side of the pty the controller opens */
+  int loads[TEST_LOADS];    /**< Ptys of the emulators */
+  int stop[2];              /**< Pipe ending the relay */
+  uint64_t bytes_down;      /**< Controller to loads */
+  uint64_t bytes_up;        /**< Loads to controller */
+} test_relay_t;
+
+/** Prototypes */
+static pid_t emulator_start(const char *emulator, const char *link, uint32_t address, char *device, size_t size);
+static int relay_open(test_relay_t *relay, char *device, size_t size);
+static void *relay_thread(void *arg);
+static void relay_write(int fd, const uint8_t *data, size_t size);
+static void *fill_thread(void *arg);
+static double monotonic_s(void);
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s EMULATOR [SECONDS]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const double seconds = (argc > 2) ? strtod(argv[2], NULL) : TEST_SECONDS;
+
+  char directory[] = "/tmp/load_bus.XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+
+  pid_t emulators[TEST_LOADS];
+  char links[TEST_LOADS][sizeof(directory) + 16U];
+  test_relay_t relay = { .controller = -1, .stop = { -1, -1 } };
+  pthread_t relay_handle;
+  int relay_running = 0;
+  load_bus_t *bus = NULL;
+  uint32_t started = 0U;
+  int failures = 0;
+
+  for (; started < TEST_LOADS; started++) {
+    char device[256];
+    snprintf(links[started], sizeof(links[started]), "%s/load%u", directory, started + 1U);
+
+    emulators[started] = emulator_start(argv[1], links[started], started + 1U, device, sizeof(device));
+    if (emulators[started] < 0) {
+      failures++;
+      goto done;
+    }
+
+    relay.loads[started] = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (relay.loads[started] < 0) {
+      perror(device);
+      started++;
+      failures++;
+      goto done;
+    }
+  }
+
+  char device[256];
+  if (relay_open(&relay, device, sizeof(device)) != 0 ||
+      pthread_create(&relay_handle, NULL, relay_thread, &relay) != 0) {
+    perror("relay");
+    failures++;
+    goto done;
+  }
+  relay_running = 1;
+
+  uint8_t addresses[TEST_LOADS + 1U];
+  for (uint32_t i = 0U; i < TEST_LOADS; i++) {
+    addresses[i] = (uint8_t)(i + 1U);
+  }
+  addresses[TEST_LOADS] = TEST_ADDRESS_SILENT;
+
+  bus = load_bus_open(device, 1000000U, addresses, TEST_LOADS + 1U);
+  if (bus == NULL) {
+    perror("load_bus_open");
+    failures++;
+    goto done;
+  }
+
+  /** Every load answers once before the rates are measured */
+  const double start_limit = monotonic_s() + TEST_START_TIMEOUT_MS / 1000.0;
+  uint32_t answering = 0U;
+  while (answering < TEST_LOADS && monotonic_s() < start_limit) {
+    load_measurement_t measurement;
+    answering = 0U;
+    for (uint32_t i = 0U; i < TEST_LOADS; i++) {
+      answering += load_bus_get_measurement(bus, addresses[i], &measurement) > 0U ? 1U : 0U;
+    }
+    usleep(10000U);
+  }
+  if (answering < TEST_LOADS) {
+    fprintf(stderr, "%u of %u loads answered\n", answering, TEST_LOADS);
+    failures++;
+    goto done;
+  }
+
+  load_bus_stats_t before[TEST_LOADS + 1U];
+  load_bus_stats_t after[TEST_LOADS + 1U];
+  for (uint32_t i = 0U; i <= TEST_LOADS; i++) {
+    load_bus_get_stats(bus, addresses[i], &before[i]);
+  }
+  const uint64_t rounds_before = load_bus_get_rounds(bus);
+  const double start = monotonic_s();
+
+  usleep((useconds_t)(seconds * 1000000.0));
+
+  const double elapsed = monotonic_s() - start;
+  const uint64_t rounds = load_bus_get_rounds(bus) - rounds_before;
+  for (uint32_t i = 0U; i <= TEST_LOADS; i++) {
+    load_bus_get_stats(bus, addresses[i], &after[i]);
+  }
+
+  double total = 0.0;
+  double slowest = 0.0;
+  double fastest = 0.0;
+  for (uint32_t i = 0U; i < TEST_LOADS; i++) {
+    const double rate = (double)(after[i].measurements - before[i].measurements) / elapsed;
+    printf("load %u: %.1f measurements/s, %llu polls, %llu timeouts\n", (unsigned)addresses[i], rate,
+           (unsigned long long)(after[i].polls - before[i].polls),
+           (unsigned long long)(after[i].timeouts - before[i].timeouts));
+    total += rate;
+    slowest = (i == 0U || rate < slowest) ? rate : slowest;
+    fastest = (rate > fastest) ? rate : fastest;
+  }
+
+  const load_bus_stats_t *silent = &after[TEST_LOADS];
+  printf("load %u: silent, %llu polls, %llu timeouts, %llu rounds skipped\n", (unsigned)TEST_ADDRESS_SILENT,
+         (unsigned long long)(silent->polls - before[TEST_LOADS].polls),
+         (unsigned long long)(silent->timeouts - before[TEST_LOADS].timeouts),
+         (unsigned long long)(silent->skipped - before[TEST_LOADS].skipped));
+  printf("aggregate: %.1f measurements/s over %u loads, %.1f rounds/s, slowest/fastest %.2f\n", total, TEST_LOADS,
+         (double)rounds / elapsed, fastest > 0.0 ? slowest / fastest : 0.0);
+
+  if (fastest <= 0.0 || slowest / fastest < TEST_FAIRNESS) {
+    fprintf(stderr, "a load got less than %.0f%% of the rate of another\n", TEST_FAIRNESS * 100.0);
+    failures++;
+  }
+
+  /** The silent address must back off instead of taking a timeout every round */
+  if (silent->polls - before[TEST_LOADS].polls > rounds / 4U + 1U) {
+    fprintf(stderr, "the silent address was polled in %llu of %llu rounds\n",
+            (unsigned long long)(silent->polls - before[TEST_LOADS].polls), (unsigned long long)rounds);
+    failures++;
+  }
+
+  /** A set point on every load at once, the silent address times out */
+  load_ack_t acks[TEST_LOADS + 1U];
+  const int acked = load_bus_broadcast(bus, COMMAND_CC, 1234U, acks, TEST_ACK_TIMEOUT_MS);
+  printf("broadcast: acknowledged by %d of %u loads\n", acked, TEST_LOADS);
+  if (acked != (int)TEST_LOADS) {
+    failures++;
+  }
+  for (uint32_t i = 0U; acked == (int)TEST_LOADS && i < TEST_LOADS; i++) {
+    if (acks[i].key != COMMAND_CC || acks[i].status != ACK_APPLIED || acks[i].value != 1234U) {
+      fprintf(stderr, "load %u: broadcast ack key %u status %u value %u\n", (unsigned)addresses[i],
+              (unsigned)acks[i].key, (unsigned)acks[i].status, acks[i].value);
+      failures++;
+    }
+  }
+
+  /** A command to a single load */
+  load_ack_t ack;
+  if (load_bus_command(bus, 3U, COMMAND_CV, 8000U, &ack, TEST_ACK_TIMEOUT_MS) != 0) {
+    fprintf(stderr, "command to load 3: %s\n", strerror(errno));
+    failures++;
+  } else if (ack.key != COMMAND_CV || ack.status != ACK_APPLIED || ack.value != 8000U) {
+    fprintf(stderr, "load 3: ack key %u status %u value %u\n", (unsigned)ack.key, (unsigned)ack.status, ack.value);
+    failures++;
+  }
+
+  /** A broadcast while the silent address has no room left for it */
+  pthread_t fill_handles[LOAD_BUS_COMMANDS_PENDING];
+  uint32_t filling = 0U;
+  for (; filling < LOAD_BUS_COMMANDS_PENDING; filling++) {
+    if (pthread_create(&fill_handles[filling], NULL, fill_thread, bus) != 0) {
+      break;
+    }
+  }
+
+  /** Full once a command that would not wait is refused, a check that got an entry would take it from a filler */
+  usleep(100000U);
+  const int full = load_bus_command(bus, TEST_ADDRESS_SILENT, COMMAND_CC, 0U, NULL, 0) != 0 && errno == EBUSY;
+  if (!full) {
+    fprintf(stderr, "the commands table of the silent address did not fill\n");
+    failures++;
+  } else {
+    const double broadcast_start = monotonic_s();
+    const int missed_acked = load_bus_broadcast(bus, COMMAND_CC, 2345U, acks, TEST_BROADCAST_TIMEOUT_MS);
+    const double broadcast_s = monotonic_s() - broadcast_start;
+    printf("broadcast with a full table: acknowledged by %d of %u loads in %.0f ms\n", missed_acked, TEST_LOADS,
+           broadcast_s * 1000.0);
+    if (missed_acked != (int)TEST_LOADS || broadcast_s > TEST_ACK_TIMEOUT_MS / 1000.0) {
+      fprintf(stderr, "the broadcast waited for the address it missed\n");
+      failures++;
+    }
+  }
+
+  for (uint32_t i = 0U; i < filling; i++) {
+    pthread_join(fill_handles[i], NULL);
+  }
+
+done:
+  load_bus_close(bus);
+
+  if (relay_running) {
+    (void)!write(relay.stop[1], "", 1U);
+    pthread_join(relay_handle, NULL);
+    printf("relay: %llu bytes down, %llu bytes up\n", (unsigned long long)relay.bytes_down,
+           (unsigned long long)relay.bytes_up);
+  }
+  if (relay.controller >= 0) {
+    close(relay.controller);
+  }
+  for (uint32_t i = 0U; i < 2U; i++) {
+    if (relay.stop[i] >= 0) {
+      close(relay.stop[i]);
+    }
+  }
+
+  for (uint32_t i = 0U; i < started; i++) {
+    if (emulators[i] < 0) {
+      continue;
+    }
+    if (relay.loads[i] >= 0) {
+      close(relay.loads[i]);
+    }
+    kill(emulators[i], SIGTERM);
+    waitpid(emulators[i], NULL, 0);
+  }
+  rmdir(directory);
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Starts an emulator at an address and waits for the path of its pty.
+ *
+ * @param emulator Emulator executable
+ * @param link Symlink the emulator creates to its pty
+ * @param address Address of the load
+ * @param device Where the path printed by the emulator is stored
+ * @param size Size of device
+ * @return pid_t Emulator process, -1 on error
+ */
+static pid_t emulator_start(const char *emulator, const char *link, uint32_t address, char *device, size_t size)
+{
+  char option[16];
+  snprintf(option, sizeof(option), "%u", address);
+
+  int output[2];
+  if (pipe(output) != 0) {
+    perror("pipe");
+    return -1;
+  }
+
+  const pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return -1;
+  }
+
+  if (pid == 0) {
+    dup2(output[1], STDOUT_FILENO);
+    close(output[0]);
+    close(output[1]);
+    execl(emulator, emulator, "--link", link, "--address", option, (char *)NULL);
+    perror("execl");
+    _exit(127);
+  }
+
+  close(output[1]);
+
+  /** The emulator prints the path once the pty is ready */
+  FILE *stream = fdopen(output[0], "r");
+  if (stream == NULL || fgets(device, (int)size, stream) == NULL) {
+    fprintf(stderr, "%s did not start\n", emulator);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+  }
+  fclose(stream);
+
+  device[strcspn(device, "\n")] = '\0';
+  return pid;
+}
+
+/**
+ * @brief Opens the pty the controller uses, the relay keeps the master side.
+ *
+ * @param relay Relay
+ * @param device Where the path of the slave side is stored
+ * @param size Size of device
+ * @return int 0 on success, -1 with errno set otherwise
+ */
+static int relay_open(test_relay_t *relay, char *device, size_t size)
+{
+  relay->controller = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (relay->controller < 0 || grantpt(relay->controller) != 0 || unlockpt(relay->controller) != 0) {
+    return -1;
+  }
+
+  const char *path = ptsname(relay->controller);
+  if (path == NULL) {
+    return -1;
+  }
+  snprintf(device, size, "%s", path);
+
+  return pipe(relay->stop);
+}
+
+/**
+ * @brief Copies the controller bytes to every load and the load bytes to the controller, until stopped.
+ *
+ * @param arg Relay
+ * @return void* NULL
+ */
+static void *relay_thread(void *arg)
+{
+  test_relay_t *relay = arg;
+  struct pollfd fds[TEST_LOADS + 2U];
+  uint8_t buffer[4096];
+
+  fds[0].fd = relay->stop[0];
+  fds[1].fd = relay->controller;
+  for (uint32_t i = 0U; i < TEST_LOADS; i++) {
+    fds[i + 2U].fd = relay->loads[i];
+  }
+  for (uint32_t i = 0U; i < TEST_LOADS + 2U; i++) {
+    fds[i].events = POLLIN;
+  }
+
+  for (;;) {
+    if (poll(fds, TEST_LOADS + 2U, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return NULL;
+    }
+
+    if (fds[0].revents != 0) {
+      return NULL;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      const ssize_t received = read(relay->controller, buffer, sizeof(buffer));
+      for (uint32_t i = 0U; received > 0 && i < TEST_LOADS; i++) {
+        relay_write(relay->loads[i], buffer, (size_t)received);
+      }
+      relay->bytes_down += (received > 0) ? (uint64_t)received : 0U;
+    }
+
+    for (uint32_t i = 0U; i < TEST_LOADS; i++) {
+      if (fds[i + 2U].revents & POLLIN) {
+        const ssize_t received = read(relay->loads[i], buffer, sizeof(buffer));
+        if (received > 0) {
+          relay_write(relay->controller, buffer, (size_t)received);
+          relay->bytes_up += (uint64_t)received;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Writes all the bytes to a non blocking pty, waiting for room.
+ *
+ * @param fd Pty
+ * @param data Bytes
+ * @param size Number of bytes
+ */
+static void relay_write(int fd, const uint8_t *data, size_t size)
+{
+  size_t sent = 0U;
+
+  while (sent < size) {
+    const ssize_t written = write(fd, &data[sent], size - sent);
+    if (written > 0) {
+      sent += (size_t)written;
+    } else if (written < 0 && errno == EAGAIN) {
+      struct pollfd pending = { .fd = fd, .events = POLLOUT };
+      poll(&pending, 1U, 100);
+    } else if (written < 0 && errno != EINTR) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Takes an entry of the commands table of the silent address until it times out.
+ *
+ * @param arg Bus
+ * @return void* NULL
+ */
+static void *fill_thread(void *arg)
+{
+  (void)load_bus_command(arg, TEST_ADDRESS_SILENT, COMMAND_CC, 0U, NULL, TEST_FILL_TIMEOUT_MS);
+  return NULL;
+}
+
+/**
+ * @brief Monotonic time.
+ *
+ * @return double Seconds
+ */
+static double monotonic_s(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
@@ -0,0 +1,405 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "load_client.h"
+
+/**
+ * @brief Control settings, measurements and telemetry through the client against the load emulator on a pty.
+ *
+ * Usage: client_stream EMULATOR [SECONDS]
+ *
+ * Sets constant current steps with load_client_set_control() and waits for the measurements to follow the plant,
+ * streams filtered then raw telemetry into the sample ring and the callbacks, then checks the link counters. Each
+ * stream must sustain its rate with no sample dropped by the load nor overwritten in the ring, and the callbacks
+ * must see the same samples as the ring.
+ */
+
+/** Time each telemetry stream runs by default */
+#define TEST_SECONDS 2.0
+
+/** Constant current steps, in milli-amperes */
+#define TEST_CURRENT_LOW_MILLI 1000U
+#define TEST_CURRENT_HIGH_MILLI 2000U
+
+/** Measured current off the set point by more than this is not settled */
+#define TEST_CURRENT_TOLERANCE_MILLI 50U
+
+/** Source of the emulator plant: 12 V behind 50 mOhm */
+#define TEST_SOURCE_MILLI 12000U
+#define TEST_SOURCE_RESISTANCE_MILLI 50U
+#define TEST_VOLTAGE_TOLERANCE_MILLI 200U
+
+/** Wait for the measurements to settle on a step */
+#define TEST_SETTLE_TIMEOUT_MS 2000
+
+/** Settling of the telemetry settings before the samples are counted */
+#define TEST_STREAM_SETTLE_MS 500
+
+/** Control loop period of the load, one filtered sample per period at decimation 1 */
+#define TEST_CONTROL_PERIOD_US 5000U
+
+/** Conversion pairs of the ADS1115 at 860 SPS, one sample per control period would be 200 samples/s */
+#define TEST_RAW_RATE_MIN 250.0
+
+/** Samples read at once from the ring */
+#define TEST_READ_MAX 4096U
+
+/** Counted by the callbacks, from the I/O thread */
+typedef struct test_counters
+{
+  atomic_uint_fast64_t measurements;
+  atomic_uint_fast64_t samples;
+} test_counters_t;
+
+/** Prototypes */
+static pid_t emulator_start(const char *emulator, const char *link, char *device, size_t size);
+static void on_measurement(const load_measurement_t *measurement, void *context);
+static void on_telemetry(const telemetry_sample_t *samples, uint32_t count, uint32_t dropped, void *context);
+static int settle(load_client_t *client, uint32_t current_milli, load_measurement_t *measurement);
+static int stream(load_client_t *client, const char *name, telemetry_mode_t mode, uint32_t current_milli,
+                  double seconds, double rate_min);
+static void sleep_ms(uint32_t ms);
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s EMULATOR [SECONDS]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const double seconds = (argc > 2) ? strtod(argv[2], NULL) : TEST_SECONDS;
+
+  char directory[] = "/tmp/load_test.XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+
+  char link[sizeof(directory) + 8U];
+  snprintf(link, sizeof(link), "%s/load", directory);
+
+  char device[256];
+  const pid_t emulator = emulator_start(argv[1], link, device, sizeof(device));
+  if (emulator < 0) {
+    rmdir(directory);
+    return EXIT_FAILURE;
+  }
+
+  int failures = 0;
+  test_counters_t counters;
+  atomic_init(&counters.measurements, 0U);
+  atomic_init(&counters.samples, 0U);
+
+  load_client_t *client = load_client_open(device, 1000000U, 0U);
+  if (client == NULL) {
+    perror("load_client_open");
+    failures++;
+    goto done;
+  }
+
+  /** The protocol state is shared with server.c, a second client must be refused */
+  load_client_t *second = load_client_open(device, 1000000U, 0U);
+  if (second != NULL || errno != EBUSY) {
+    fprintf(stderr, "second client not refused with EBUSY\n");
+    load_client_close(second);
+    failures++;
+  }
+
+  load_client_set_callbacks(client, on_measurement, on_telemetry, &counters);
+
+  load_control_t control = {
+    .enable = 1U,
+    .mode = CC,
+    .cc = { TEST_CURRENT_LOW_MILLI, 0U, 10000U },
+    .cv = { 600U, 600U, 50000U },
+    .cr = { 10000U, 0U, 100000U },
+    .cp = { 5000U, 0U, 100000U },
+  };
+  load_measurement_t measurement;
+
+  if (load_client_set_control(client, &control) != 0) {
+    perror("load_client_set_control");
+    failures++;
+  }
+  failures += settle(client, TEST_CURRENT_LOW_MILLI, &measurement);
+
+  control.cc.value_milli = TEST_CURRENT_HIGH_MILLI;
+  if (load_client_set_control(client, &control) != 0) {
+    perror("load_client_set_control");
+    failures++;
+  }
+  failures += settle(client, TEST_CURRENT_HIGH_MILLI, &measurement);
+
+  failures += stream(client, "filtered", TELEMETRY_FILTERED, TEST_CURRENT_HIGH_MILLI, seconds,
+                     0.9 * 1000000.0 / TEST_CONTROL_PERIOD_US);
+  failures += stream(client, "raw", TELEMETRY_RAW, TEST_CURRENT_HIGH_MILLI, seconds, TEST_RAW_RATE_MIN);
+
+  const load_telemetry_config_t off = { TELEMETRY_OFF, 1U, 1U };
+  load_client_set_telemetry(client, &off);
+
+  control.enable = 0U;
+  load_client_set_control(client, &control);
+  failures += settle(client, 0U, &measurement);
+
+  load_client_stats_t stats;
+  load_client_get_stats(client, &stats);
+  const uint64_t measured = load_client_get_measurement(client, &measurement);
+  load_client_close(client);
+
+  printf("bytes %llu, frames %llu, measurements %llu, telemetry samples %llu, overruns %llu, dropped %u\n",
+         (unsigned long long)stats.bytes_received, (unsigned long long)stats.frames_received,
+         (unsigned long long)stats.measurements, (unsigned long long)stats.telemetry_samples,
+         (unsigned long long)stats.telemetry_overruns, stats.telemetry_dropped);
+
+  if (stats.measurements == 0U || stats.measurements != atomic_load(&counters.measurements) ||
+      measured < stats.measurements) {
+    fprintf(stderr, "%llu measurements counted, %llu called back, %llu applied\n",
+            (unsigned long long)stats.measurements, (unsigned long long)atomic_load(&counters.measurements),
+            (unsigned long long)measured);
+    failures++;
+  }
+
+  if (stats.telemetry_samples != atomic_load(&counters.samples)) {
+    fprintf(stderr, "%llu telemetry samples counted, %llu called back\n",
+            (unsigned long long)stats.telemetry_samples, (unsigned long long)atomic_load(&counters.samples));
+    failures++;
+  }
+
+  if (stats.telemetry_overruns != 0U) {
+    fprintf(stderr, "telemetry samples overwritten in the ring\n");
+    failures++;
+  }
+
+done:
+  kill(emulator, SIGTERM);
+  waitpid(emulator, NULL, 0);
+  rmdir(directory);
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Starts the emulator and waits for the path of its pty.
+ *
+ * @param emulator Emulator executable
+ * @param link Symlink the emulator creates to its pty
+ * @param device Where the path printed by the emulator is stored
+ * @param size Size of device
+ * @return pid_t Emulator process, -1 on error
+ */
+static pid_t emulator_start(const char *emulator, const char *link, char *device, size_t size)
+{
+  int output[2];
+  if (pipe(output) != 0) {
+    perror("pipe");
+    return -1;
+  }
+
+  const pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return -1;
+  }
+
+  if (pid == 0) {
+    dup2(output[1], STDOUT_FILENO);
+    close(output[0]);
+    close(output[1]);
+    execl(emulator, emulator, "--link", link, (char *)NULL);
+    perror("execl");
+    _exit(127);
+  }
+
+  close(output[1]);
+
+  /** The emulator prints the path once the pty is ready */
+  FILE *stream = fdopen(output[0], "r");
+  if (stream == NULL || fgets(device, (int)size, stream) == NULL) {
+    fprintf(stderr, "%s did not start\n", emulator);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+  }
+  fclose(stream);
+
+  device[strcspn(device, "\n")] = '\0';
+  return pid;
+}
+
+static void on_measurement(const load_measurement_t *measurement, void *context)
+{
+  test_counters_t *counters = context;
+  (void)measurement;
+
+  atomic_fetch_add(&counters->measurements, 1U);
+}
+
+static void on_telemetry(const telemetry_sample_t *samples, uint32_t count, uint32_t dropped, void *context)
+{
+  test_counters_t *counters = context;
+  (void)samples;
+  (void)dropped;
+
+  atomic_fetch_add(&counters->samples, count);
+}
+
+/**
+ * @brief Waits for the measurements to settle on a constant current, the voltage must follow the source.
+ *
+ * @param client Client
+ * @param current_milli Set point, 0 with the load disabled
+ * @param measurement Where the last measurement is stored
+ * @return int Number of failures
+ */
+static int settle(load_client_t *client, uint32_t current_milli, load_measurement_t *measurement)
+{
+  uint64_t count = load_client_get_measurement(client, measurement);
+  uint32_t waited_ms = 0U;
+
+  /** Measurements come with the replies to the control frames, every LOAD_CLIENT_CONTROL_PERIOD_MS */
+  while (waited_ms < TEST_SETTLE_TIMEOUT_MS) {
+    count = load_client_wait_measurement(client, count, measurement, TEST_SETTLE_TIMEOUT_MS);
+    if (count == 0U) {
+      fprintf(stderr, "%u mA: no measurement: %s\n", current_milli, strerror(errno));
+      return 1;
+    }
+
+    if (measurement->cc_milli + TEST_CURRENT_TOLERANCE_MILLI >= current_milli &&
+        measurement->cc_milli <= current_milli + TEST_CURRENT_TOLERANCE_MILLI) {
+      break;
+    }
+
+    waited_ms += LOAD_CLIENT_CONTROL_PERIOD_MS;
+  }
+
+  const uint32_t voltage_milli = TEST_SOURCE_MILLI - current_milli * TEST_SOURCE_RESISTANCE_MILLI / 1000U;
+
+  printf("%-8s %5u mA set, %5u mA %5u mV measured, %u ms\n", current_milli ? "enabled" : "disabled", current_milli,
+         measurement->cc_milli, measurement->cv_milli, waited_ms);
+
+  if (waited_ms >= TEST_SETTLE_TIMEOUT_MS) {
+    fprintf(stderr, "%u mA: measured current did not settle\n", current_milli);
+    return 1;
+  }
+
+  if (measurement->cv_milli + TEST_VOLTAGE_TOLERANCE_MILLI < voltage_milli ||
+      measurement->cv_milli > voltage_milli + TEST_VOLTAGE_TOLERANCE_MILLI) {
+    fprintf(stderr, "%u mA: measured %u mV, expected %u mV\n", current_milli, measurement->cv_milli, voltage_milli);
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Streams telemetry into the ring for a while and checks the samples read back.
+ *
+ * @param client Client
+ * @param name Stream name, for the report
+ * @param mode Telemetry mode, at decimation 1
+ * @param current_milli Current the samples must be on
+ * @param seconds Time the samples are counted
+ * @param rate_min Lowest rate, in samples per second
+ * @return int Number of failures
+ */
+static int stream(load_client_t *client, const char *name, telemetry_mode_t mode, uint32_t current_milli,
+                  double seconds, double rate_min)
+{
+  static telemetry_sample_t samples[TEST_READ_MAX];
+  const load_telemetry_config_t config = { (uint8_t)mode, TELEMETRY_BATCH_MAX, 1U };
+  int failures = 0;
+
+  if (load_client_set_telemetry(client, &config) != 0) {
+    fprintf(stderr, "%s: load_client_set_telemetry: %s\n", name, strerror(errno));
+    return 1;
+  }
+
+  /** The first batches may still be of the previous settings */
+  sleep_ms(TEST_STREAM_SETTLE_MS);
+  while (load_client_read_telemetry(client, samples, TEST_READ_MAX) == TEST_READ_MAX) {
+  }
+
+  load_client_stats_t before;
+  load_client_get_stats(client, &before);
+
+  sleep_ms((uint32_t)(seconds * 1000.0));
+
+  load_client_stats_t after;
+  load_client_get_stats(client, &after);
+
+  uint32_t count = 0U;
+  uint32_t strays = 0U;
+  uint32_t gap_min = UINT32_MAX;
+  uint32_t gap_max = 0U;
+  uint32_t previous = 0U;
+  uint32_t taken;
+
+  while ((taken = load_client_read_telemetry(client, samples, TEST_READ_MAX)) != 0U) {
+    for (uint32_t i = 0U; i < taken; i++, count++) {
+      if (count != 0U) {
+        const uint32_t gap = samples[i].timestamp_us - previous;
+        gap_min = (gap < gap_min) ? gap : gap_min;
+        gap_max = (gap > gap_max) ? gap : gap_max;
+      }
+      previous = samples[i].timestamp_us;
+
+      if (samples[i].current_milli + TEST_CURRENT_TOLERANCE_MILLI < current_milli ||
+          samples[i].current_milli > current_milli + TEST_CURRENT_TOLERANCE_MILLI) {
+        strays++;
+      }
+    }
+  }
+
+  const double rate = (double)(after.telemetry_samples - before.telemetry_samples) / seconds;
+
+  printf("%-8s %6.0f samples/s, %u samples, period %u..%u us, %u off the set point, %u dropped\n", name, rate, count,
+         gap_min, gap_max, strays, after.telemetry_dropped);
+
+  if (rate < rate_min) {
+    fprintf(stderr, "%s: %.0f samples/s, below %.0f\n", name, rate, rate_min);
+    failures++;
+  }
+
+  /** Every sample received during the stream is still in the ring */
+  if (count < after.telemetry_samples - before.telemetry_samples) {
+    fprintf(stderr, "%s: %llu samples received, %u read\n", name,
+            (unsigned long long)(after.telemetry_samples - before.telemetry_samples), count);
+    failures++;
+  }
+
+  /** The load timestamps on its host clock, only a lost batch leaves a gap of a whole batch */
+  if (count > 1U && (gap_min == 0U || gap_max >= TELEMETRY_BATCH_MAX * (uint32_t)(1000000.0 / rate_min))) {
+    fprintf(stderr, "%s: timestamps out of order or with a batch missing\n", name);
+    failures++;
+  }
+
+  if (after.telemetry_dropped != 0U || after.telemetry_overruns != before.telemetry_overruns) {
+    fprintf(stderr, "%s: samples dropped by the load or overwritten in the ring\n", name);
+    failures++;
+  }
+
+  if (strays > count / 100U) {
+    fprintf(stderr, "%s: current away from %u mA\n", name, current_milli);
+    failures++;
+  }
+
+  return failures;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+  struct timespec delay = { ms / 1000U, (long)(ms % 1000U) * 1000000L };
+
+  while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+  }
+}
@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "load_client.h"
+
+/**
+ * @brief Command to acknowledgement latency against the load emulator on a pty.
+ *
+ * Usage: command_latency EMULATOR [COMMANDS]
+ *
+ * Every command must be acknowledged with the value the control loop runs with, the round trip must stay within a
+ * couple of control periods.
+ */
+
+/** Commands sent by default */
+#define TEST_COMMANDS 200U
+
+/** Wait for each acknowledgement, retries included */
+#define TEST_ACK_TIMEOUT_MS 1000
+
+/** Bound of the 99th percentile of the round trip, the control loop runs every 5 ms */
+#define TEST_ROUND_TRIP_P99_US 32768U
+
+typedef struct test_command
+{
+  load_command_key_t key;
+  uint32_t value;
+  load_ack_status_t status;
+  uint32_t expected;
+} test_command_t;
+
+/** Sequence sent over and over, constant voltage is clamped to 0.6 - 50 V by the load */
+static const test_command_t test_sequence[] = {
+  { COMMAND_MODE, CC, ACK_APPLIED, CC },
+  { COMMAND_CC, 250U, ACK_APPLIED, 250U },
+  { COMMAND_ENABLE, 1U, ACK_APPLIED, 1U },
+  { COMMAND_CC, 1234U, ACK_APPLIED, 1234U },
+  { COMMAND_CV, 60000U, ACK_APPLIED, 50000U },
+  { COMMAND_CV, 100U, ACK_APPLIED, 600U },
+  { COMMAND_CV, 8000U, ACK_APPLIED, 8000U },
+  { COMMAND_MODE, CV, ACK_APPLIED, CV },
+  { COMMAND_CR, 10000U, ACK_APPLIED, 10000U },
+  { COMMAND_CP, 5000U, ACK_APPLIED, 5000U },
+  { COMMAND_MODE, 7U, ACK_REJECTED, CV },
+  { COMMAND_ENABLE, 2U, ACK_REJECTED, 1U },
+  { COMMAND_ENABLE, 0U, ACK_APPLIED, 0U },
+};
+
+/** Prototypes */
+static pid_t emulator_start(const char *emulator, const char *link, char *device, size_t size);
+static uint32_t latency_percentile(const server_latency_t *latency, uint32_t percent);
+static void latency_print(const char *name, const server_latency_t *latency);
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s EMULATOR [COMMANDS]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const uint32_t commands = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : TEST_COMMANDS;
+
+  char directory[] = "/tmp/load_test.XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+
+  char link[sizeof(directory) + 8U];
+  snprintf(link, sizeof(link), "%s/load", directory);
+
+  char device[256];
+  const pid_t emulator = emulator_start(argv[1], link, device, sizeof(device));
+  if (emulator < 0) {
+    rmdir(directory);
+    return EXIT_FAILURE;
+  }
+
+  int failures = 0;
+
+  load_client_t *client = load_client_open(device, 1000000U, 0U);
+  if (client == NULL) {
+    perror("load_client_open");
+    failures++;
+    goto done;
+  }
+
+  for (uint32_t i = 0U; i < commands; i++) {
+    const test_command_t *command = &test_sequence[i % (sizeof(test_sequence) / sizeof(test_sequence[0]))];
+    load_ack_t ack;
+
+    if (load_client_command(client, command->key, command->value, &ack, TEST_ACK_TIMEOUT_MS) != 0) {
+      fprintf(stderr, "command %u: key %u value %u: %s\n", i, (unsigned)command->key, command->value, strerror(errno));
+      failures++;
+      continue;
+    }
+
+    if (ack.key != command->key || ack.status != command->status || ack.value != command->expected) {
+      fprintf(stderr, "command %u: key %u value %u: ack key %u status %u value %u, expected status %u value %u\n", i,
+              (unsigned)command->key, command->value, (unsigned)ack.key, (unsigned)ack.status, ack.value,
+              (unsigned)command->status, command->expected);
+      failures++;
+    }
+  }
+
+  server_latency_t round_trip;
+  server_latency_t apply;
+  load_client_stats_t stats;
+  load_client_get_latency(client, &round_trip, &apply);
+  load_client_get_stats(client, &stats);
+  load_client_close(client);
+
+  latency_print("round trip", &round_trip);
+  latency_print("load apply", &apply);
+  printf("commands %llu, retries %llu, acknowledgements %llu\n", (unsigned long long)stats.commands,
+         (unsigned long long)stats.command_retries, (unsigned long long)stats.command_acks);
+
+  if (round_trip.count != commands) {
+    fprintf(stderr, "%u round trips recorded for %u commands\n", round_trip.count, commands);
+    failures++;
+  }
+
+  if (latency_percentile(&round_trip, 99U) > TEST_ROUND_TRIP_P99_US) {
+    fprintf(stderr, "round trip p99 above %u us\n", TEST_ROUND_TRIP_P99_US);
+    failures++;
+  }
+
+done:
+  kill(emulator, SIGTERM);
+  waitpid(emulator, NULL, 0);
+  rmdir(directory);
+
+  printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Starts the emulator and waits for the path of its pty.
+ *
+ * @param emulator Emulator executable
+ * @param link Symlink the emulator creates to its pty
+ * @param device Where the path printed by the emulator is stored
+ * @param size Size of device
+ * @return pid_t Emulator process, -1 on error
+ */
+static pid_t emulator_start(const char *emulator, const char *link, char *device, size_t size)
+{
+  int output[2];
+  if (pipe(output) != 0) {
+    perror("pipe");
+    return -1;
+  }
+
+  const pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return -1;
+  }
+
+  if (pid == 0) {
+    dup2(output[1], STDOUT_FILENO);
+    close(output[0]);
+    close(output[1]);
+    execl(emulator, emulator, "--link", link, (char *)NULL);
+    perror("execl");
+    _exit(127);
+  }
+
+  close(output[1]);
+
+  /** The emulator prints the path once the pty is ready */
+  FILE *stream = fdopen(output[0], "r");
+  if (stream == NULL || fgets(device, (int)size, stream) == NULL) {
+    fprintf(stderr, "%s did not start\n", emulator);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+  }
+  fclose(stream);
+
+  device[strcspn(device, "\n")] = '\0';
+  return pid;
+}
+
+/**
+ * @brief Upper bound of the bucket holding a percentile.
+ *
+ * @param latency Histogram
+ * @param percent Percentile
+ * @return uint32_t Microseconds, UINT32_MAX for the open ended last bucket
+ */
+static uint32_t latency_percentile(const server_latency_t *latency, uint32_t percent)
+{
+  const uint64_t target = ((uint64_t)latency->count * percent + 99U) / 100U;
+  uint64_t seen = 0U;
+
+  for (uint32_t i = 0U; i < SERVER_LATENCY_BUCKETS; i++) {
+    seen += latency->buckets[i];
+    if (seen >= target) {
+      return (i < SERVER_LATENCY_BUCKETS - 1U) ? (1U << i) : UINT32_MAX;
+    }
+  }
+
+  return UINT32_MAX;
+}
+
+static void latency_print(const char *name, const server_latency_t *latency)
+{
+  const double mean = latency->count ? (double)latency->sum_us / latency->count : 0.0;
+
+  printf("%s: %u samples, min %u us, mean %.0f us, max %u us, p50 < %u us, p99 < %u us\n", name, latency->count,
+         latency->min_us, mean, latency->max_us, latency_percentile(latency, 50U), latency_percentile(latency, 99U));
+
+  for (uint32_t i = 0U; i < SERVER_LATENCY_BUCKETS; i++) {
+    if (latency->buckets[i] != 0U) {
+      printf("  < %8u us %6u\n", 1U << i, latency->buckets[i]);
+    }
+  }
+}
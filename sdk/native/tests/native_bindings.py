@@ -0,0 +1,121 @@
+"""Python bindings of the native client against the load emulator, over a pty.
+
+Usage: python3 native_bindings.py EMULATOR LIBRARY
+
+Drives the emulator through load_native.LoadClient: a command, constant
+current settings, the measurements that follow them, a filtered telemetry
+stream and the link counters. The structs of load_native.py are declared by
+hand, a field out of line with server.h shows up here as values off the
+settings.
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', '..'))
+
+# Constant current held, in milli-amperes
+CURRENT_MILLI = 1500
+
+# Measured current off the setting by more than this is not settled
+CURRENT_TOLERANCE_MILLI = 50
+
+# Wait for the measurements to settle
+SETTLE_SECONDS = 2.0
+
+# Filtered telemetry at decimation 1, one sample per 5 ms control period
+TELEMETRY_FILTERED = 1
+TELEMETRY_BATCH_MAX = 12
+STREAM_SECONDS = 1.0
+STREAM_RATE_MIN = 180.0
+
+
+def start_emulator(emulator, link):
+    process = subprocess.Popen([emulator, '--link', link], stdout=subprocess.PIPE, universal_newlines=True)
+    # The emulator prints the path once the pty is ready
+    device = process.stdout.readline().strip()
+    if not device:
+        process.kill()
+        process.wait()
+        raise RuntimeError('{} did not start'.format(emulator))
+    return process, device
+
+
+def settle(client, current_milli):
+    """Last measurement once the current is on the setting, None on timeout."""
+    deadline = time.monotonic() + SETTLE_SECONDS
+    while time.monotonic() < deadline:
+        measurement = client.wait_measurement()
+        if measurement and abs(measurement['cc_milli'] - current_milli) <= CURRENT_TOLERANCE_MILLI:
+            return measurement
+    return None
+
+
+def run(load_native, device):
+    failures = 0
+
+    with load_native.LoadClient(device) as client:
+        ack = client.command(load_native.COMMAND_MODE, 0)
+        print('command  mode CC, ack {}'.format(ack))
+        if ack['key'] != load_native.COMMAND_MODE or ack['status'] != load_native.ACK_APPLIED or ack['value'] != 0:
+            print('FAIL: mode command acknowledged as {}'.format(ack))
+            failures += 1
+
+        setting = load_native.SetPoint(CURRENT_MILLI, 0, 10000)
+        client.set_control(load_native.Control(1, 0, setting, load_native.SetPoint(600, 600, 50000),
+                                               load_native.SetPoint(10000, 0, 100000),
+                                               load_native.SetPoint(5000, 0, 100000)))
+        measurement = settle(client, CURRENT_MILLI)
+        print('measured {}'.format(measurement))
+        if measurement is None:
+            print('FAIL: measured current did not settle on {} mA'.format(CURRENT_MILLI))
+            failures += 1
+
+        client.set_telemetry(TELEMETRY_FILTERED, TELEMETRY_BATCH_MAX, 1)
+        time.sleep(0.5)
+        client.read_telemetry()
+        time.sleep(STREAM_SECONDS)
+        samples = client.read_telemetry()
+        rate = len(samples) / STREAM_SECONDS
+        strays = [s for s in samples if abs(s['current_milli'] - CURRENT_MILLI) > CURRENT_TOLERANCE_MILLI]
+        print('filtered {:.0f} samples/s, {} off the setting'.format(rate, len(strays)))
+        if rate < STREAM_RATE_MIN or len(strays) > len(samples) // 100:
+            print('FAIL: telemetry below {:.0f} samples/s or away from {} mA'.format(STREAM_RATE_MIN, CURRENT_MILLI))
+            failures += 1
+
+        client.set_telemetry(0, 1, 1)
+        stats = client.stats()
+        print('stats    {}'.format(stats))
+        if stats['measurements'] == 0 or stats['telemetry_samples'] < len(samples) or stats['telemetry_dropped']:
+            print('FAIL: link counters')
+            failures += 1
+
+    return failures
+
+
+def main():
+    if len(sys.argv) < 3:
+        print('Usage: {} EMULATOR LIBRARY'.format(sys.argv[0]))
+        return 2
+
+    os.environ['LOAD_CLIENT_LIBRARY'] = sys.argv[2]
+    import load_native
+
+    with tempfile.TemporaryDirectory() as directory:
+        process, device = start_emulator(sys.argv[1], os.path.join(directory, 'load'))
+        try:
+            failures = run(load_native, device)
+        finally:
+            process.terminate()
+            process.wait()
+
+    print('PASS' if failures == 0 else 'FAIL')
+    return 0 if failures == 0 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,112 @@
+"""Golden vectors of the firmware ADC filters, from the captures of adc.ipynb.
+
+Usage: python3 filter_golden.py [output]
+
+The input is the `adc` column of input_voltage.csv and input_current.csv, in
+microvolts as the firmware stores samples. Where the captures are not checked
+out, the rows adc.ipynb displays are used instead. Each filter configuration
+runs through a floating point reference of filter.c, and its output is written
+next to its input in filter_golden.csv. The firmware filter is checked against
+it by filter_test.
+"""
+
+import csv
+import json
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# Captured sequence is cycled so that every stage sees its steps several times
+CYCLES = 4
+
+# Q15 smoothing factors are quantized as FILTER_Q15() does
+def q15(alpha):
+    return int(alpha * 32768.0) / 32768.0
+
+# Configurations checked, stages applied in order as filter_add_*() appends them
+FILTERS = {
+    'boxcar4': [('boxcar', 4)],
+    'boxcar16': [('boxcar', 16)],
+    'iir8': [('iir', q15(1 / 8))],
+    'iir64': [('iir', q15(1 / 64))],
+    'median3': [('median', 3)],
+    'median5': [('median', 5)],
+    'cascade': [('median', 5), ('boxcar', 8), ('iir', q15(1 / 4))],
+}
+
+
+def captures_from_csv(name):
+    path = os.path.join(HERE, name)
+    if not os.path.exists(path):
+        return None
+    with open(path, newline='') as f:
+        return [float(row['adc']) for row in csv.DictReader(f)]
+
+
+def captures_from_notebook():
+    """Rows of the data frames displayed by adc.ipynb, in cell order."""
+    with open(os.path.join(HERE, 'adc.ipynb')) as f:
+        notebook = json.load(f)
+
+    captures = []
+    for cell in notebook['cells']:
+        for output in cell.get('outputs', []):
+            lines = ''.join(output.get('data', {}).get('text/plain', '')).splitlines()
+            if not lines or 'adc' not in lines[0].split():
+                continue
+            column = lines[0].split().index('adc') + 1
+            for line in lines[1:]:
+                if re.match(r'^\d+\s', line):
+                    captures.append(float(line.split()[column]))
+    return captures
+
+
+def boxcar(values, size):
+    window = []
+    for value in values:
+        window = (window + [value])[-size:]
+        yield sum(window) / len(window)
+
+
+def iir(values, alpha):
+    state = None
+    for value in values:
+        state = value if state is None else state + alpha * (value - state)
+        yield state
+
+
+def median(values, size):
+    window = []
+    for value in values:
+        window = (window + [value])[-size:]
+        yield sorted(window)[len(window) // 2]
+
+
+STAGES = {'boxcar': boxcar, 'iir': iir, 'median': median}
+
+
+def main():
+    output = sys.argv[1] if len(sys.argv) > 1 else os.path.join(HERE, 'filter_golden.csv')
+
+    voltage = captures_from_csv('input_voltage.csv')
+    current = captures_from_csv('input_current.csv')
+    captures = voltage + current if voltage and current else captures_from_notebook()
+    samples = [round(value * 1e6) for value in captures] * CYCLES
+
+    with open(output, 'w', newline='') as f:
+        writer = csv.writer(f, lineterminator='\n')
+        writer.writerow(['filter', 'input', 'expected'])
+        for name, stages in FILTERS.items():
+            values = samples
+            for stage, parameter in stages:
+                values = list(STAGES[stage](values, parameter))
+            for value, expected in zip(samples, values):
+                writer.writerow([name, value, f'{expected:.3f}'])
+
+    print(f'{len(samples)} samples, {len(FILTERS)} filters, {output}')
+
+
+if __name__ == '__main__':
+    main()
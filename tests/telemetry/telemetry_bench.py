@@ -0,0 +1,108 @@
+"""Throughput of the telemetry frames through the encoder and decoder of load_sdk.py.
+
+Usage: python3 telemetry_bench.py [seconds]
+
+Builds full raw batches as tx_telemetry() does, framed by FrameEncoder, and
+decodes the byte stream with LoadParser.parse_byte() and parse_telemetry() as
+the reader thread of the SDK does. Reports samples per second both ways
+against the most a 1 Mbaud link carries, and fails if the decoder can't keep
+up with a full link: the SDK would then drop what the load streams.
+"""
+
+import os
+import struct
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', '..', 'sdk'))
+
+try:
+    import load_sdk
+except ImportError as error:
+    # pyserial is only needed for the port, the test is skipped without it
+    print('SKIP: {}'.format(error))
+    sys.exit(77)
+
+SECONDS = 1.0
+
+# 8N1 on the wire
+BAUD = 1000000
+BITS_PER_BYTE = 10
+
+BATCH = load_sdk.TELEMETRY_BATCH_MAX
+FRAME_SIZE = (load_sdk.HEADER_SIZE + load_sdk.TELEMETRY_HEADER.size + BATCH * load_sdk.TELEMETRY_SAMPLE.size +
+              load_sdk.CRC_SIZE)
+
+# Samples per second of a link carrying nothing but full batches
+LINK_RATE = BAUD / BITS_PER_BYTE / FRAME_SIZE * BATCH
+
+# Conversion pair period of the ADS1115 at 860 SPS, raw samples arrive at most this often
+RAW_PERIOD_US = 2 * 1000000 // 860
+
+
+def encode(encoder, first):
+    """One full raw batch, the samples continue the previous one."""
+    payload = bytearray(load_sdk.TELEMETRY_HEADER.pack(load_sdk.TELEMETRY_RAW, BATCH, 1, 0))
+    for i in range(first, first + BATCH):
+        payload += load_sdk.TELEMETRY_SAMPLE.pack(i * RAW_PERIOD_US, 12000 + i % 7, 1000 + i % 5, 2500, 1241)
+    return encoder.frame(load_sdk.MSG_TELEMETRY, bytes(payload))
+
+
+def bench_encode(seconds):
+    encoder = load_sdk.FrameEncoder(load_sdk.MSG_CONTROL, load_sdk.MSG_CONTROL_DELTA)
+    frames = []
+    start = time.perf_counter()
+    while time.perf_counter() - start < seconds:
+        frames.append(encode(encoder, len(frames) * BATCH))
+    return frames, len(frames) * BATCH / (time.perf_counter() - start)
+
+
+def bench_decode(stream, seconds):
+    parser = load_sdk.LoadParser()
+    decoded = []
+    start = time.perf_counter()
+    for byte in stream:
+        frame = parser.parse_byte(byte)
+        if frame:
+            batch = load_sdk.parse_telemetry(frame)
+            if batch is not None:
+                decoded.extend(batch['samples'])
+            if time.perf_counter() - start > seconds:
+                break
+    return decoded, len(decoded) / (time.perf_counter() - start)
+
+
+def main():
+    seconds = float(sys.argv[1]) if len(sys.argv) > 1 else SECONDS
+    failures = 0
+
+    frames, encode_rate = bench_encode(seconds)
+    decoded, decode_rate = bench_decode(b''.join(frames), seconds)
+
+    print('link    {:9.0f} samples/s, {} byte frames of {} samples at {} baud'.format(LINK_RATE, FRAME_SIZE, BATCH,
+                                                                                      BAUD))
+    print('encode  {:9.0f} samples/s, {:5.1f} x the link'.format(encode_rate, encode_rate / LINK_RATE))
+    print('decode  {:9.0f} samples/s, {:5.1f} x the link'.format(decode_rate, decode_rate / LINK_RATE))
+
+    # Every sample decoded must be the one encoded, in order
+    for i, sample in enumerate(decoded):
+        if sample['timestamp_us'] != i * RAW_PERIOD_US or sample['current_milli'] != 1000 + i % 5:
+            print('FAIL: sample {} decoded as {}'.format(i, sample))
+            failures += 1
+            break
+
+    if not decoded:
+        print('FAIL: no sample decoded')
+        failures += 1
+
+    if decode_rate < LINK_RATE:
+        print('FAIL: the decoder does not keep up with a full link')
+        failures += 1
+
+    print('PASS' if failures == 0 else 'FAIL')
+    return 0 if failures == 0 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,131 @@
+"""Telemetry stream of the load emulator into load_sdk.py, over a pty.
+
+Usage: python3 telemetry_loopback.py EMULATOR [seconds]
+
+Starts the emulator on a pty, connects ElectronicLoadSDK to it, holds a
+constant current and streams raw then filtered telemetry. Each stream must
+sustain its rate end to end: every conversion pair in raw mode, every control
+period in filtered mode, no sample dropped by the load, no batch lost on the
+way and the current on the setpoint. The emulator runs on the host clock, so a
+late conversion shifts the timestamps, but only a lost frame leaves a gap of a
+whole batch.
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', '..', 'sdk'))
+
+try:
+    import load_sdk
+except ImportError as error:
+    # pyserial is only needed for the port, the test is skipped without it
+    print('SKIP: {}'.format(error))
+    sys.exit(77)
+
+SECONDS = 3.0
+
+# Constant current held during the streams, in milli-amperes
+CURRENT_MILLI = 1000
+
+# Settling of the loop and of the settings before the samples are counted
+SETTLE_SECONDS = 0.5
+
+# Control loop period
+CONTROL_PERIOD_US = 5000
+
+# The ADS1115 converts the voltage and then the current at 860 SPS, the I2C transfers add to it. One sample per
+# control period would be 200 samples/s
+RAW_RATE_MIN = 250.0
+
+# Current of a sample away from the setpoint by more than this, allowed on a hundredth of the samples
+CURRENT_TOLERANCE_MILLI = 50
+
+
+def start_emulator(emulator, link):
+    process = subprocess.Popen([emulator, '--link', link], stdout=subprocess.PIPE, universal_newlines=True)
+    # The emulator prints the path once the pty is ready
+    device = process.stdout.readline().strip()
+    if not device:
+        process.kill()
+        process.wait()
+        raise RuntimeError('{} did not start'.format(emulator))
+    return process, device
+
+
+def stream(load, mode, decimation, seconds):
+    """Samples of a stream, once settled."""
+    load.set_telemetry(mode, load_sdk.TELEMETRY_BATCH_MAX, decimation)
+    time.sleep(SETTLE_SECONDS)
+    load.get_telemetry()
+    time.sleep(seconds)
+    return load.get_telemetry()
+
+
+def check(name, samples, seconds, rate_min, period_us, dropped):
+    failures = 0
+    rate = len(samples) / seconds
+    gaps = [(b['timestamp_us'] - a['timestamp_us']) & 0xFFFFFFFF for a, b in zip(samples, samples[1:])]
+    strays = [s for s in samples if abs(s['current_milli'] - CURRENT_MILLI) > CURRENT_TOLERANCE_MILLI]
+
+    print('{:8} {:6.0f} samples/s, {} samples, period {}..{} us, {} off the setpoint, {} dropped'.format(
+        name, rate, len(samples), min(gaps) if gaps else 0, max(gaps) if gaps else 0, len(strays), dropped))
+
+    if rate < rate_min:
+        print('FAIL: {} at {:.0f} samples/s, below {:.0f}'.format(name, rate, rate_min))
+        failures += 1
+    if gaps and (min(gaps) == 0 or max(gaps) >= load_sdk.TELEMETRY_BATCH_MAX * period_us):
+        print('FAIL: {} timestamps out of order or with a batch missing'.format(name))
+        failures += 1
+    if dropped:
+        print('FAIL: {} samples dropped by the load'.format(name))
+        failures += 1
+    if len(strays) > len(samples) // 100:
+        print('FAIL: {} current away from {} mA'.format(name, CURRENT_MILLI))
+        failures += 1
+
+    return failures
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Usage: {} EMULATOR [seconds]'.format(sys.argv[0]))
+        return 2
+
+    seconds = float(sys.argv[2]) if len(sys.argv) > 2 else SECONDS
+    failures = 0
+
+    with tempfile.TemporaryDirectory() as directory:
+        process, device = start_emulator(sys.argv[1], os.path.join(directory, 'load'))
+        load = load_sdk.ElectronicLoadSDK(port=device)
+
+        try:
+            load.connect()
+            load.set_cc(CURRENT_MILLI)
+            load.enable_load()
+
+            samples = stream(load, load_sdk.TELEMETRY_RAW, 1, seconds)
+            failures += check('raw', samples, seconds, RAW_RATE_MIN, 1000000 / RAW_RATE_MIN,
+                              load.get_telemetry_dropped())
+
+            # Two control periods per sample
+            samples = stream(load, load_sdk.TELEMETRY_FILTERED, 2, seconds)
+            failures += check('filtered', samples, seconds, 0.9 * 1000000 / (2 * CONTROL_PERIOD_US),
+                              2 * CONTROL_PERIOD_US, load.get_telemetry_dropped())
+
+            load.set_telemetry(load_sdk.TELEMETRY_OFF)
+        finally:
+            load.disconnect()
+            process.terminate()
+            process.wait()
+
+    print('PASS' if failures == 0 else 'FAIL')
+    return 0 if failures == 0 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())